@@ -46,6 +46,9 @@ public:
 public:
     PoolAllocator()  {}
     ~PoolAllocator() {}
+
+    // The size of the next input, the pool allocators may use it to predict the chunk size.
+    void setSizeHint(size_t inputSize) { (void)inputSize; }
 };
 
 // C-RunTime Allocator
@@ -65,6 +68,15 @@ public:
     static void free(void * ptr)              { std::free(ptr); }
     static void free(void * ptr, size_t size) { (void)size; std::free(ptr); }
 
+    // The same interface as the pool allocators.
+    static void * allocate(size_t size) { return std::malloc(size); }
+    static void * reallocate(void * ptr, size_t size, size_t new_size) {
+        (void)size;
+        return std::realloc(ptr, new_size);
+    }
+    static void deallocate(void * ptr) { std::free(ptr); }
+    static void deallocate(void * ptr, size_t size) { (void)size; std::free(ptr); }
+
     static void * aligned_malloc(size_t size, size_t alignment) {
         return ::_aligned_malloc(size, alignment);
     }
@@ -109,5 +121,7 @@ public:
 #include "JsonFx/Allocator/StdPoolAllocator.h"
 #include "JsonFx/Allocator/SimplePoolAllocator.h"
 #include "JsonFx/Allocator/FastPoolAllocator.h"
+#include "JsonFx/Allocator/SlabPoolAllocator.h"
+#include "JsonFx/Allocator/HugePageAllocator.h"
 
 #endif  /* !_JSONFX_ALLOCATOR_H_ */
@@ -35,6 +35,7 @@ public:
     static const size_t kChunkCapacity      = ChunkCapacity;
     static const size_t kInnerChunkCapacity = InnerChunkCapacity;
     static const size_t kAlignmentSize      = JSONFX_POOL_ALIGNMENT_SIZE;
+    static const size_t kMaxChunkCapacity   = JIMI_MAX(ChunkCapacity, JSONFX_POOL_MAX_CHUNK_CAPACITY);
     static const size_t kChunkCapacityLimit = sizeof(ChunkInfo);
     static const size_t kMinChunkCapacityThreshold =
                     JIMI_MAX(kChunkCapacityLimit + kAlignmentSize * 2,
@@ -59,6 +60,20 @@ private:
     void *      mUserBuffer;
     size_t      mUserBufSize;
 
+    // The free chunks which are kept by reset().
+    ChunkInfo * mFreeChunks;
+    size_t      mFreeCount;
+    size_t      mFreeBytes;
+    size_t      mRetainLimit;       // The high-water mark of the free chunks (bytes).
+    size_t      mTrimResets;
+    size_t      mResetCount;        // The count of resets since the last trimming.
+    size_t      mIdleCount;         // The min count of free chunks at the resets.
+
+    // The adaptive chunk capacity, it's doubled by each new chunk, and it starts
+    // from the predicted used bytes of a document.
+    size_t      mChunkCapacity;
+    size_t      mPredictedUsed;
+
 #if defined(JSONFX_ALLOCATOR_USE_PROFILE) && (JSONFX_ALLOCATOR_USE_PROFILE != 0)
     size_t      mUsedTotal;
     size_t      mCapacityTotal;
@@ -71,7 +86,10 @@ private:
 
 public:
     FastPoolAllocator()
-        : mChunkHead(NULL), mUserBuffer(NULL), mUserBufSize(0)
+        : mChunkHead(NULL), mUserBuffer(NULL), mUserBufSize(0),
+          mFreeChunks(NULL), mFreeCount(0), mFreeBytes(0), mRetainLimit(JSONFX_POOL_RETAIN_LIMIT),
+          mTrimResets(JSONFX_POOL_TRIM_RESETS), mResetCount(0), mIdleCount(0),
+          mChunkCapacity(kChunkCapacity), mPredictedUsed(0)
 #if defined(JSONFX_ALLOCATOR_USE_PROFILE) && (JSONFX_ALLOCATOR_USE_PROFILE != 0)
         , mUsedTotal(0), mCapacityTotal(kInnerChunkCapacity)
 #endif
@@ -81,7 +99,10 @@ public:
     }
 
     FastPoolAllocator(void * userBuffer, size_t bufSize)
-        : mChunkHead(NULL), mUserBuffer(userBuffer), mUserBufSize(bufSize)
+        : mChunkHead(NULL), mUserBuffer(userBuffer), mUserBufSize(bufSize),
+          mFreeChunks(NULL), mFreeCount(0), mFreeBytes(0), mRetainLimit(JSONFX_POOL_RETAIN_LIMIT),
+          mTrimResets(JSONFX_POOL_TRIM_RESETS), mResetCount(0), mIdleCount(0),
+          mChunkCapacity(kChunkCapacity), mPredictedUsed(0)
 #if defined(JSONFX_ALLOCATOR_USE_PROFILE) && (JSONFX_ALLOCATOR_USE_PROFILE != 0)
         , mUsedTotal(0), mCapacityTotal(bufSize)
 #endif
@@ -108,15 +129,84 @@ public:
         }
     }
 
+    //
+    // Release all the allocations. The chunks are kept in the free list for
+    // the next allocations (up to the retain limit bytes), the others are
+    // freed. If some free chunks are never reused in the last getTrimResets()
+    // resets, they are freed. The used bytes of this document predict the
+    // first chunk capacity of the next one.
+    //
     void reset() {
-        // Release the chunk lists.
-        this->release();
+        // The free chunks which are not reused since the last reset.
+        if (mFreeCount < mIdleCount || mResetCount == 0)
+            mIdleCount = mFreeCount;
+        ++mResetCount;
+        if (mResetCount >= mTrimResets) {
+            this->freeChunks(mIdleCount);
+            mResetCount = 0;
+        }
+
+        // Recycle the chunk lists.
+        size_t used = 0;
+        if (this->kAutoRelease) {
+            ChunkInfo * pChunkInfo = mChunkHead;
+            while (pChunkInfo != NULL) {
+                ChunkInfo * next = pChunkInfo->next;
+                used += pChunkInfo->used;
+                if (next != NULL) {
+                    this->recycleChunk(pChunkInfo);
+                }
+                pChunkInfo = next;
+            }
+        }
+
+        // The prediction follows a larger document at once, and decays by half
+        // for the smaller ones.
+        mPredictedUsed = JIMI_MAX(used, mPredictedUsed / 2);
+        mChunkCapacity = this->getStartCapacity(mPredictedUsed);
         // Reset used total counter
         mUsedTotal = 0;
         // Reset the first chunk info and counter info.
         this->init(mUserBuffer, mUserBufSize);
     }
 
+    // Free all the chunks in the free list.
+    void trim() {
+        this->freeChunks(mFreeCount);
+        mResetCount = 0;
+        mIdleCount = 0;
+    }
+
+    size_t getRetainLimit() const   { return mRetainLimit; }
+    size_t getTrimResets() const    { return mTrimResets;  }
+    size_t getFreeChunkCount() const { return mFreeCount;  }
+    size_t getFreeChunkBytes() const { return mFreeBytes;  }
+
+    // The max bytes of the free chunks, 0 means the chunks are always freed.
+    void setRetainLimit(size_t retainLimit) {
+        mRetainLimit = retainLimit;
+        while (mFreeBytes > mRetainLimit) {
+            this->freeChunks(1);
+        }
+    }
+
+    void setTrimResets(size_t trimResets) {
+        mTrimResets = (trimResets != 0) ? trimResets : 1;
+    }
+
+    // The capacity of the next new chunk.
+    size_t getChunkCapacity() const { return mChunkCapacity; }
+
+    //
+    // The size of the next input (bytes), the values are usually not larger
+    // than the input text, so the next chunk is sized to hold them at once.
+    //
+    void setSizeHint(size_t inputSize) {
+        size_t capacity = this->getStartCapacity(JIMI_MAX(inputSize, mPredictedUsed));
+        if (capacity > mChunkCapacity)
+            mChunkCapacity = capacity;
+    }
+
     void * getUserBuffer() const     { return mUserBuffer;  }
     void * getUserBufferSize() const { return mUserBufSize; }
 
@@ -143,6 +233,106 @@ private:
             this->release();
             mChunkHead = NULL;
         }
+        this->freeChunks(mFreeCount);
+    }
+
+    //
+    // The chunks larger than the retain limit are freed by each reset(), so the
+    // chunks don't grow over it, a document up to the limit is parsed in the
+    // kept chunks without allocation. No chunk is kept with a tiny limit.
+    //
+    size_t getMaxCapacity() const {
+        if (mRetainLimit < kChunkCapacity)
+            return kMaxChunkCapacity;
+        return JIMI_MIN(kMaxChunkCapacity, mRetainLimit);
+    }
+
+    size_t getStartCapacity(size_t used) const {
+        size_t maxCapacity = this->getMaxCapacity();
+        if (used <= kChunkCapacity)
+            return kChunkCapacity;
+        else if (used >= maxCapacity)
+            return maxCapacity;
+        else
+            return JIMI_MIN(internal::RoundToPowerOf2(used), maxCapacity);
+    }
+
+    void growChunkCapacity() {
+        size_t maxCapacity = this->getMaxCapacity();
+        if (mChunkCapacity < maxCapacity / 2)
+            mChunkCapacity *= 2;
+        else
+            mChunkCapacity = maxCapacity;
+    }
+
+    //
+    // Allocate a chunk, the first free chunk which is large enough is reused,
+    // its capacity may be larger than nChunkCapacity. Otherwise the largest
+    // free chunk of nMinCapacity bytes at least is reused, it's smaller.
+    //
+    ChunkInfo * allocateChunk(size_t nChunkCapacity, size_t nMinCapacity) {
+        ChunkInfo ** link = &mFreeChunks;
+        ChunkInfo ** found = NULL;
+        while (*link != NULL) {
+            ChunkInfo * chunk = *link;
+            if (chunk->capacity >= nChunkCapacity) {
+                found = link;
+                break;
+            }
+            if (chunk->capacity >= nMinCapacity && (found == NULL || chunk->capacity > (*found)->capacity))
+                found = link;
+            link = &chunk->next;
+        }
+        if (found != NULL) {
+            ChunkInfo * chunk = *found;
+            *found = chunk->next;
+            --mFreeCount;
+            mFreeBytes -= chunk->capacity;
+            return chunk;
+        }
+        ChunkInfo * newChunk = reinterpret_cast<ChunkInfo *>
+                    (AllocatorType::aligned_malloc(nChunkCapacity, kAlignmentSize));
+        jimi_assert(newChunk != NULL);
+        newChunk->capacity = nChunkCapacity;
+        return newChunk;
+    }
+
+    void recycleChunk(ChunkInfo * chunk) {
+        if (chunk->capacity <= mRetainLimit) {
+            // The larger chunk is kept first, the smaller free chunks are freed for it.
+            ChunkInfo ** link = &mFreeChunks;
+            while (mFreeBytes + chunk->capacity > mRetainLimit && *link != NULL) {
+                ChunkInfo * freeChunk = *link;
+                if (freeChunk->capacity < chunk->capacity) {
+                    *link = freeChunk->next;
+                    --mFreeCount;
+                    mFreeBytes -= freeChunk->capacity;
+                    AllocatorType::aligned_free(freeChunk);
+                }
+                else {
+                    link = &freeChunk->next;
+                }
+            }
+            if (mFreeBytes + chunk->capacity <= mRetainLimit) {
+                chunk->next = mFreeChunks;
+                mFreeChunks = chunk;
+                ++mFreeCount;
+                mFreeBytes += chunk->capacity;
+                return;
+            }
+        }
+        AllocatorType::aligned_free(chunk);
+    }
+
+    void freeChunks(size_t count) {
+        while (count > 0 && mFreeChunks != NULL) {
+            ChunkInfo * next = mFreeChunks->next;
+            mFreeBytes -= mFreeChunks->capacity;
+            AllocatorType::aligned_free(mFreeChunks);
+            mFreeChunks = next;
+            --mFreeCount;
+            --count;
+        }
     }
 
     void internal_init() {
@@ -204,18 +394,16 @@ private:
     }
 
     void * addNewChunk(size_t nChunkCapacity, size_t size) {
-        ChunkInfo * newChunk = reinterpret_cast<ChunkInfo *>
-                    (AllocatorType::aligned_malloc(nChunkCapacity, kAlignmentSize));
+        ChunkInfo * newChunk = this->allocateChunk(nChunkCapacity, nChunkCapacity);
         jimi_assert(newChunk != NULL);
 
         // Do not handle out-of-memory explicitly.
         newChunk->next      = mChunkHead;
         newChunk->used      = sizeof(ChunkInfo) + size;
-        newChunk->capacity  = nChunkCapacity;
 
 #if defined(JSONFX_ALLOCATOR_USE_PROFILE) && (JSONFX_ALLOCATOR_USE_PROFILE != 0)
         mUsedTotal      += mChunkHead->used;
-        mCapacityTotal  += nChunkCapacity;
+        mCapacityTotal  += newChunk->capacity;
 #endif  /* JSONFX_ALLOCATOR_USE_PROFILE */  
 
         mChunkHead = newChunk;
@@ -225,18 +413,20 @@ private:
     }
 
     void * insertNewChunkToLast(size_t nChunkCapacity, size_t size) {
-        ChunkInfo * newChunk = reinterpret_cast<ChunkInfo *>
-                    (AllocatorType::aligned_malloc(nChunkCapacity, kAlignmentSize));
+        // The last chunk is the inner chunk or user buffer, it must be kept as the last one.
+        if (mChunkHead->next == NULL)
+            return this->addNewChunk(nChunkCapacity, size);
+
+        ChunkInfo * newChunk = this->allocateChunk(nChunkCapacity, nChunkCapacity);
         jimi_assert(newChunk != NULL);
 
         // Do not handle out-of-memory explicitly.
         newChunk->next      = mChunkHead->next;
         newChunk->used      = sizeof(ChunkInfo) + size;
-        newChunk->capacity  = nChunkCapacity;
 
 #if defined(JSONFX_ALLOCATOR_USE_PROFILE) && (JSONFX_ALLOCATOR_USE_PROFILE != 0)
         mUsedTotal      += sizeof(ChunkInfo) + size;
-        mCapacityTotal  += nChunkCapacity;
+        mCapacityTotal  += newChunk->capacity;
 #endif  /* JSONFX_ALLOCATOR_USE_PROFILE */
 
         mChunkHead->next = newChunk;
@@ -265,20 +455,21 @@ public:
 #endif  /* defined(JSONFX_ALLOCATOR_USE_PROFILE) */
 
     void * addNewChunk(size_t size) {
-        ChunkInfo * newChunk = reinterpret_cast<ChunkInfo *>
-                    (AllocatorType::aligned_malloc(kChunkCapacity, kAlignmentSize));
+        // A smaller free chunk is reused if it holds size (see allocateLarge()).
+        ChunkInfo * newChunk = this->allocateChunk(mChunkCapacity,
+                                                   JIMI_MAX(kChunkCapacity, sizeof(ChunkInfo) + size));
         jimi_assert(newChunk != NULL);
+        this->growChunkCapacity();
 
         // Do not handle out-of-memory explicitly.
         newChunk->next      = mChunkHead;
         newChunk->used      = sizeof(ChunkInfo) + size;
-        newChunk->capacity  = kChunkCapacity;
 
 #if defined(JSONFX_ALLOCATOR_USE_PROFILE) && (JSONFX_ALLOCATOR_USE_PROFILE != 0)
         if (mChunkHead != NULL) {
             mUsedTotal  += mChunkHead->used;
         }
-        mCapacityTotal  += kChunkCapacity;
+        mCapacityTotal  += newChunk->capacity;
 #endif  /* JSONFX_ALLOCATOR_USE_PROFILE */
 
         mChunkHead = newChunk;
@@ -294,7 +485,7 @@ public:
     inline void * addNewChunkAndSkip(size_t skipSize, size_t reserveSize) {
         jimi_assert(mChunkHead != NULL);
         void * cursor;
-        if ((skipSize + reserveSize) <= kChunkCapacity) {
+        if ((skipSize + reserveSize) <= (mChunkCapacity - sizeof(ChunkInfo))) {
             cursor = this->addNewChunk(0);
             return reinterpret_cast<void *>(reinterpret_cast<char *>(cursor) + skipSize);
         }
@@ -393,11 +584,27 @@ public:
         }
     }
 
+    //
+    // The large block shares the active chunk or a new chunk if it's not larger
+    // than the half of the chunk capacity, otherwise it's allocated alone and
+    // the chunk capacity grows, so the next large blocks may share the chunks.
+    //
     void * allocateLarge(size_t size) {
+        jimi_assert(mChunkHead != NULL);
+        size = JIMI_ALIGNED_TO(size, kAlignmentSize);
+        if (size <= (mChunkHead->capacity - mChunkHead->used)) {
+            void * cursor = reinterpret_cast<void *>(reinterpret_cast<char *>(mChunkHead) + mChunkHead->used);
+            mChunkHead->used += size;
+            return cursor;
+        }
+        if (size <= mChunkCapacity / 2)
+            return this->addNewChunk(size);
+
         size_t allocSize = size + sizeof(ChunkInfo);
         allocSize = JIMI_ALIGNED_TO(allocSize, kAlignmentSize);
 
         void * buffer = this->insertNewChunkToLast(allocSize, size);
+        this->growChunkCapacity();
         jimi_assert(mChunkHead != NULL);
         jimi_assert(mChunkHead->next != NULL);
 
@@ -408,7 +615,7 @@ public:
     void * reallocate(const void * ptr, size_t size, size_t new_size) {
         // Do not shrink if new size is smaller than original.
         if (size >= new_size)
-            return ptr;
+            return const_cast<void *>(ptr);
 
         // Simply expand it if it is the last allocation and there is sufficient space.
         if (ptr == reinterpret_cast<void *>(reinterpret_cast<char *>(mChunkHead)
@@ -423,7 +630,11 @@ public:
         }
 
         // Realloc process: allocate and copy memory, do not free original buffer.
-        void * newBuffer = this->allocate(new_size);
+        void * newBuffer;
+        if (new_size <= (kChunkCapacity - sizeof(ChunkInfo)))
+            newBuffer = this->allocate(new_size);
+        else
+            newBuffer = this->allocateLarge(new_size);
         jimi_assert(newBuffer != NULL);     // Do not handle out-of-memory explicitly.
         return reinterpret_cast<void *>(std::memcpy(newBuffer, ptr, size));
     }
@@ -0,0 +1,159 @@
+
+#ifndef _JSONFX_HUGE_PAGE_ALLOCATOR_H_
+#define _JSONFX_HUGE_PAGE_ALLOCATOR_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Allocator.h"
+#include "JsonFx/Allocator/FastPoolAllocator.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/assert.h"
+
+#if defined(__linux__) && (JSONFX_USE_HUGE_PAGES != 0)
+  #define JSONFX_HUGE_PAGE_MMAP     1
+  #include <sys/mman.h>
+  #include <unistd.h>
+  #include "JsonFx/Internal/Thread.h"
+#endif
+
+//
+// The chunk source of the pool allocators for the huge documents: the chunks
+// not less than JSONFX_HUGE_PAGE_THRESHOLD bytes are mapped by mmap() on the
+// 2 MB boundaries, from the explicit huge pages (MAP_HUGETLB) if there are
+// reserved ones, or else from the normal pages with MADV_HUGEPAGE for the
+// transparent huge pages. The less TLB misses speed up the traversal of the
+// large DOM. The header of a mapped chunk is on a normal page before its
+// huge pages, so a chunk of 2^n bytes only takes 2^n bytes of the huge pages.
+// The small chunks and the other systems use the aligned_malloc() of
+// TrivialAllocator.
+//
+// Usage: FastPoolAllocator<kChunkCapacity, kInnerChunkCapacity, HugePageAllocator>,
+//        or HugePagePoolAllocator.
+//
+
+namespace JsonFx {
+
+class HugePageAllocator : public TrivialAllocator
+{
+public:
+    static const size_t kHugePageSize   = 2 * 1024 * 1024;
+    static const size_t kThreshold      = JSONFX_HUGE_PAGE_THRESHOLD;
+    // The header of each block, the alignment must not be larger than it.
+    static const size_t kHeaderSize     = 64;
+
+    HugePageAllocator()  {}
+    ~HugePageAllocator() {}
+
+    static void * aligned_malloc(size_t size, size_t alignment) {
+        jimi_assert(alignment <= kHeaderSize);
+        (void)alignment;
+        char * block = NULL;
+        size_t mapSize = 0;
+#if defined(JSONFX_HUGE_PAGE_MMAP)
+        if (size >= kThreshold) {
+            mapSize = (size + kHugePageSize - 1) & ~(kHugePageSize - 1);
+            char * pages = reinterpret_cast<char *>(mapHugePages(mapSize));
+            if (pages != NULL)
+                block = pages - kHeaderSize;
+        }
+#endif
+        if (block == NULL) {
+            mapSize = 0;
+            block = reinterpret_cast<char *>(TrivialAllocator::aligned_malloc(size + kHeaderSize, kHeaderSize));
+            if (block == NULL)
+                return NULL;
+        }
+        *reinterpret_cast<size_t *>(block) = mapSize;
+        return reinterpret_cast<void *>(block + kHeaderSize);
+    }
+
+    static void aligned_free(void * ptr) {
+        if (ptr == NULL)
+            return;
+        char * block = reinterpret_cast<char *>(ptr) - kHeaderSize;
+        size_t mapSize = *reinterpret_cast<size_t *>(block);
+#if defined(JSONFX_HUGE_PAGE_MMAP)
+        if (mapSize != 0) {
+            size_t pageSize = getPageSize();
+            ::munmap(reinterpret_cast<char *>(ptr) - pageSize, pageSize + mapSize);
+            return;
+        }
+#endif
+        jimi_assert(mapSize == 0);
+        (void)mapSize;
+        TrivialAllocator::aligned_free(block);
+    }
+
+private:
+#if defined(JSONFX_HUGE_PAGE_MMAP)
+    static size_t getPageSize() {
+        return static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    }
+
+    //
+    // Return the pages on the 2 MB boundary, or NULL if they can't be mapped.
+    // The mapSize is multiple of kHugePageSize, a normal page before the pages
+    // is mapped for the header.
+    //
+    static void * mapHugePages(size_t mapSize) {
+        size_t pageSize = getPageSize();
+        jimi_assert(pageSize >= kHeaderSize);
+
+        // Map the more one huge page, and unmap the head and the tail out of the 2 MB boundaries.
+        size_t reserveSize = mapSize + kHugePageSize;
+        void * pages = ::mmap(NULL, reserveSize, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pages == MAP_FAILED)
+            return NULL;
+
+        char * reserved = reinterpret_cast<char *>(pages);
+        char * aligned = reinterpret_cast<char *>(
+            (reinterpret_cast<uintptr_t>(reserved + pageSize) + kHugePageSize - 1) & ~static_cast<uintptr_t>(kHugePageSize - 1));
+        size_t headSize = static_cast<size_t>(aligned - pageSize - reserved);
+        size_t tailSize = reserveSize - headSize - pageSize - mapSize;
+        if (headSize != 0)
+            ::munmap(reserved, headSize);
+        if (tailSize != 0)
+            ::munmap(aligned + mapSize, tailSize);
+
+#if defined(MAP_HUGETLB)
+        // Replace the normal pages by the explicit huge pages. If no huge pages
+        // are reserved, it's not tried again. The flag is shared by the threads,
+        // the initialization of the local static is thread-safe on gcc.
+        static internal::AtomicFlag sNoHugeTlb;
+        if (!sNoHugeTlb.get()) {
+            pages = ::mmap(aligned, mapSize, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+            if (pages != MAP_FAILED)
+                return reinterpret_cast<void *>(aligned);
+            sNoHugeTlb.set(true);
+            pages = ::mmap(aligned, mapSize, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+            if (pages == MAP_FAILED) {
+                ::munmap(aligned - pageSize, pageSize + mapSize);
+                return NULL;
+            }
+        }
+#endif  /* MAP_HUGETLB */
+
+#if defined(MADV_HUGEPAGE)
+        // It's only a hint, the transparent huge pages may be disabled.
+        ::madvise(aligned, mapSize, MADV_HUGEPAGE);
+#endif
+        return reinterpret_cast<void *>(aligned);
+    }
+#endif  /* JSONFX_HUGE_PAGE_MMAP */
+};
+
+// The pool allocator which maps the large chunks on the huge pages.
+typedef FastPoolAllocator<  gDefaultChunkCapacity,
+                            gDefaultInnerChunkCapacity,
+                            HugePageAllocator>          HugePagePoolAllocator;
+
+}  // namespace JsonFx
+
+#endif  /* !_JSONFX_HUGE_PAGE_ALLOCATOR_H_ */
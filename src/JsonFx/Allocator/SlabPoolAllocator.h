@@ -0,0 +1,354 @@
+
+#ifndef _JSONFX_SLAB_POOL_ALLOCATOR_H_
+#define _JSONFX_SLAB_POOL_ALLOCATOR_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Allocator.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/assert.h"
+
+//
+// The size class slab allocator for the mutable documents (kNeedFree is true),
+// the values free their arrays, objects and copied strings by release(), so
+// a long-lived document which is edited repeatedly doesn't grow.
+//
+//   1. The blocks not larger than kMaxBlockSize are rounded up to a size
+//      class (16 bytes steps to 256, then the powers of 2), each slab is a
+//      chunk of kChunkCapacity bytes aligned to kChunkCapacity, and holds
+//      the blocks of one class. The static deallocate() finds the slab
+//      header by masking the address, so both allocate() and deallocate()
+//      are O(1). An empty slab is freed, unless it's the last one of its
+//      class.
+//
+//   2. The larger blocks are allocated alone with the same header.
+//
+//   3. The reader builds the strings in a scratch buffer (skip() and
+//      getChunkBottom()), they are copied to the values, so the scratch
+//      buffer is reused by each string.
+//
+
+namespace JsonFx {
+
+template <size_t ChunkCapacity = gDefaultChunkCapacity,
+          size_t InnerChunkCapacity = gDefaultInnerChunkCapacity,
+          typename Allocator = DefaultAllocator>
+class SlabPoolAllocator : public PoolAllocator
+{
+public:
+    typedef size_t      SizeType;
+    typedef Allocator   AllocatorType;
+
+    static const bool   kNeedFree           = true;
+    static const bool   kAutoRelease        = true;
+    static const size_t kChunkCapacity      = ChunkCapacity;
+    static const size_t kInnerChunkCapacity = InnerChunkCapacity;
+    static const size_t kAlignmentSize      = JSONFX_POOL_ALIGNMENT_SIZE;
+
+    static const size_t kHeaderSize         = 128;
+    static const size_t kClassCount         = 21;
+    static const size_t kMaxBlockSize       = 8192;
+
+private:
+    struct SlabInfo {
+        SlabPoolAllocator * owner;
+        SlabInfo *  prev;           // The list of all slabs.
+        SlabInfo *  next;
+        SlabInfo *  prevPartial;    // The list of the slabs with free blocks of a class.
+        SlabInfo *  nextPartial;
+        void *      freeList;
+        size_t      blockSize;      // 0 for a large block.
+        size_t      sizeClass;      // The size of a large block.
+        uint32_t    used;
+        uint32_t    bumped;         // The blocks never used are after it.
+        uint32_t    capacity;
+        uint32_t    inPartial;
+    };
+
+    SlabInfo *  mSlabs;
+    SlabInfo *  mPartial[kClassCount];
+    size_t      mUsed;
+    size_t      mCapacity;
+
+    // The scratch buffer for the strings of reader.
+    char *      mScratch;
+    size_t      mScratchSize;
+    char *      mOldScratch;
+    char        mInnerScratch[kInnerChunkCapacity];
+
+public:
+    SlabPoolAllocator()
+        : mSlabs(NULL), mUsed(0), mCapacity(0),
+          mScratch(mInnerScratch), mScratchSize(kInnerChunkCapacity), mOldScratch(NULL) {
+        jimi_assert(sizeof(SlabInfo) <= kHeaderSize);
+        // The kChunkCapacity must be a power of 2, and a slab holds a few largest blocks.
+        jimi_assert((kChunkCapacity & (kChunkCapacity - 1)) == 0);
+        jimi_assert(kChunkCapacity >= kHeaderSize + kMaxBlockSize * 4);
+        for (size_t i = 0; i < kClassCount; ++i) {
+            mPartial[i] = NULL;
+        }
+    }
+
+    ~SlabPoolAllocator() {
+        this->destroy();
+    }
+
+private:
+    //! Copy constructor is not permitted.
+    SlabPoolAllocator(const SlabPoolAllocator & rhs);               /* = delete */
+    //! Copy assignment operator is not permitted.
+    SlabPoolAllocator & operator =(const SlabPoolAllocator & rhs);  /* = delete */
+
+    static size_t getSizeClass(size_t size) {
+        if (size <= 256)
+            return ((size != 0) ? (size + 15) / 16 - 1 : 0);
+        size_t sizeClass = 16;
+        size_t blockSize = 512;
+        while (blockSize < size) {
+            blockSize *= 2;
+            ++sizeClass;
+        }
+        return sizeClass;
+    }
+
+    static size_t getClassSize(size_t sizeClass) {
+        return ((sizeClass < 16) ? (sizeClass + 1) * 16 : (size_t(512) << (sizeClass - 16)));
+    }
+
+    static SlabInfo * getSlab(const void * ptr) {
+        return reinterpret_cast<SlabInfo *>(reinterpret_cast<uintptr_t>(ptr)
+                                            & ~static_cast<uintptr_t>(kChunkCapacity - 1));
+    }
+
+    void linkSlab(SlabInfo * slab) {
+        slab->owner = this;
+        slab->prev  = NULL;
+        slab->next  = mSlabs;
+        if (mSlabs != NULL)
+            mSlabs->prev = slab;
+        mSlabs = slab;
+    }
+
+    void unlinkSlab(SlabInfo * slab) {
+        if (slab->prev != NULL)
+            slab->prev->next = slab->next;
+        else
+            mSlabs = slab->next;
+        if (slab->next != NULL)
+            slab->next->prev = slab->prev;
+    }
+
+    void addPartial(SlabInfo * slab) {
+        SlabInfo *& head = mPartial[slab->sizeClass];
+        slab->prevPartial = NULL;
+        slab->nextPartial = head;
+        if (head != NULL)
+            head->prevPartial = slab;
+        head = slab;
+        slab->inPartial = 1;
+    }
+
+    void removePartial(SlabInfo * slab) {
+        if (slab->prevPartial != NULL)
+            slab->prevPartial->nextPartial = slab->nextPartial;
+        else
+            mPartial[slab->sizeClass] = slab->nextPartial;
+        if (slab->nextPartial != NULL)
+            slab->nextPartial->prevPartial = slab->prevPartial;
+        slab->inPartial = 0;
+    }
+
+    SlabInfo * newSlab(size_t sizeClass) {
+        SlabInfo * slab = reinterpret_cast<SlabInfo *>(
+            AllocatorType::aligned_malloc(kChunkCapacity, kChunkCapacity));
+        jimi_assert(slab != NULL);
+        slab->freeList  = NULL;
+        slab->blockSize = getClassSize(sizeClass);
+        slab->sizeClass = sizeClass;
+        slab->used      = 0;
+        slab->bumped    = 0;
+        slab->capacity  = static_cast<uint32_t>((kChunkCapacity - kHeaderSize) / slab->blockSize);
+        this->linkSlab(slab);
+        this->addPartial(slab);
+        mCapacity += kChunkCapacity;
+        return slab;
+    }
+
+    void freeSlab(SlabInfo * slab) {
+        this->unlinkSlab(slab);
+        mCapacity -= (slab->blockSize != 0) ? kChunkCapacity : (kHeaderSize + slab->sizeClass);
+        AllocatorType::aligned_free(slab);
+    }
+
+    void freeBlock(SlabInfo * slab, void * ptr) {
+        if (slab->blockSize == 0) {
+            // It's a large block.
+            mUsed -= slab->sizeClass;
+            this->freeSlab(slab);
+            return;
+        }
+        *reinterpret_cast<void **>(ptr) = slab->freeList;
+        slab->freeList = ptr;
+        if (!slab->inPartial)
+            this->addPartial(slab);
+        --slab->used;
+        mUsed -= slab->blockSize;
+        if (slab->used == 0) {
+            // Keep the last slab of the class for the next allocations.
+            if (mPartial[slab->sizeClass] != slab || slab->nextPartial != NULL) {
+                this->removePartial(slab);
+                this->freeSlab(slab);
+            }
+        }
+    }
+
+    void destroy() {
+        this->reset();
+        if (mOldScratch != NULL) {
+            AllocatorType::aligned_free(mOldScratch);
+            mOldScratch = NULL;
+        }
+        if (mScratch != mInnerScratch) {
+            AllocatorType::aligned_free(mScratch);
+            mScratch = mInnerScratch;
+            mScratchSize = kInnerChunkCapacity;
+        }
+    }
+
+public:
+    // Release all the allocations, the scratch buffer is kept.
+    void reset() {
+        SlabInfo * slab = mSlabs;
+        while (slab != NULL) {
+            SlabInfo * next = slab->next;
+            AllocatorType::aligned_free(slab);
+            slab = next;
+        }
+        mSlabs = NULL;
+        for (size_t i = 0; i < kClassCount; ++i) {
+            mPartial[i] = NULL;
+        }
+        mUsed = 0;
+        mCapacity = 0;
+    }
+
+    size_t getUsed() const      { return mUsed;     }
+    size_t getCapacity() const  { return mCapacity; }
+
+    void * allocate(size_t size) {
+        if (size > kMaxBlockSize)
+            return this->allocateLarge(size);
+
+        size_t sizeClass = getSizeClass(size);
+        SlabInfo * slab = mPartial[sizeClass];
+        if (slab == NULL)
+            slab = this->newSlab(sizeClass);
+
+        void * block;
+        if (slab->freeList != NULL) {
+            block = slab->freeList;
+            slab->freeList = *reinterpret_cast<void **>(block);
+        }
+        else {
+            block = reinterpret_cast<char *>(slab) + kHeaderSize + slab->bumped * slab->blockSize;
+            ++slab->bumped;
+        }
+        ++slab->used;
+        mUsed += slab->blockSize;
+        if (slab->used == slab->capacity)
+            this->removePartial(slab);
+        return block;
+    }
+
+    void * allocateLarge(size_t size) {
+        if (size <= kMaxBlockSize)
+            return this->allocate(size);
+
+        // The header must be found by masking the address, so it's aligned to kChunkCapacity.
+        SlabInfo * slab = reinterpret_cast<SlabInfo *>(
+            AllocatorType::aligned_malloc(kHeaderSize + size, kChunkCapacity));
+        jimi_assert(slab != NULL);
+        slab->freeList  = NULL;
+        slab->blockSize = 0;
+        slab->sizeClass = size;
+        slab->used      = 1;
+        slab->bumped    = 0;
+        slab->capacity  = 1;
+        slab->inPartial = 0;
+        this->linkSlab(slab);
+        mUsed += size;
+        mCapacity += kHeaderSize + size;
+        return reinterpret_cast<void *>(reinterpret_cast<char *>(slab) + kHeaderSize);
+    }
+
+    void * reallocate(const void * ptr, size_t size, size_t new_size) {
+        if (ptr == NULL)
+            return this->allocate(new_size);
+        SlabInfo * slab = getSlab(ptr);
+        size_t blockSize = (slab->blockSize != 0) ? slab->blockSize : slab->sizeClass;
+        if (new_size <= blockSize)
+            return const_cast<void *>(ptr);
+
+        void * newBuffer = this->allocate(new_size);
+        jimi_assert(newBuffer != NULL);     // Do not handle out-of-memory explicitly.
+        std::memcpy(newBuffer, ptr, (size < new_size) ? size : new_size);
+        deallocate(const_cast<void *>(ptr));
+        return newBuffer;
+    }
+
+    static void deallocate(void * ptr) {
+        if (ptr != NULL) {
+            SlabInfo * slab = getSlab(ptr);
+            slab->owner->freeBlock(slab, ptr);
+        }
+    }
+
+    static void deallocate(void * ptr, size_t size) { (void)size; deallocate(ptr); }
+
+    //
+    // The scratch buffer of reader, the string begins at skipSize bytes.
+    //
+    void * skip(size_t skipSize) {
+        return this->skip(skipSize, 0);
+    }
+
+    void * skip(size_t skipSize, size_t reserveSize) {
+        if ((skipSize + reserveSize) > mScratchSize)
+            this->growScratch(skipSize + reserveSize);
+        return reinterpret_cast<void *>(mScratch + skipSize);
+    }
+
+    // The chars in the old buffer are valid until the next growth.
+    void * addNewChunkAndSkip(size_t skipSize) {
+        return this->addNewChunkAndSkip(skipSize, 0);
+    }
+
+    void * addNewChunkAndSkip(size_t skipSize, size_t reserveSize) {
+        this->growScratch(JIMI_MAX(mScratchSize * 2, skipSize + reserveSize));
+        return reinterpret_cast<void *>(mScratch + skipSize);
+    }
+
+    void * getChunkCursor() const   { return reinterpret_cast<void *>(mScratch); }
+    void * getChunkBottom() const   { return reinterpret_cast<void *>(mScratch + mScratchSize); }
+    size_t getChunkRemain() const   { return mScratchSize; }
+
+private:
+    void growScratch(size_t size) {
+        size_t newSize = JIMI_MAX(mScratchSize * 2, size);
+        char * newScratch = reinterpret_cast<char *>(AllocatorType::aligned_malloc(newSize, kAlignmentSize));
+        jimi_assert(newScratch != NULL);
+        if (mOldScratch != NULL)
+            AllocatorType::aligned_free(mOldScratch);
+        mOldScratch = (mScratch != mInnerScratch) ? mScratch : NULL;
+        mScratch = newScratch;
+        mScratchSize = newSize;
+    }
+};
+
+}  // namespace JsonFx
+
+#endif  /* !_JSONFX_SLAB_POOL_ALLOCATOR_H_ */
@@ -170,7 +170,7 @@ public:
     void * reallocate(const void * ptr, size_t size, size_t new_size) {
         // Do not shrink if new size is smaller than original
         if (size >= new_size)
-            return ptr;
+            return const_cast<void *>(ptr);
 
         // Simply expand it if it is the last allocation and there is sufficient space
         if (ptr == reinterpret_cast<void *>(reinterpret_cast<char *>(mChunkHead + 1)
@@ -179,7 +179,7 @@ public:
             increment = JIMI_ALIGNED_TO(increment, kAlignmentSize);
             if (increment <= mChunkHead->remain) {
                 mChunkHead->remain -= increment;
-                return ptr;
+                return const_cast<void *>(ptr);
             }
         }
 
@@ -0,0 +1,254 @@
+
+#ifndef _JSONFX_THREAD_ARENA_ALLOCATOR_H_
+#define _JSONFX_THREAD_ARENA_ALLOCATOR_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Allocator.h"
+#include "JsonFx/Allocator/FastPoolAllocator.h"
+#include "JsonFx/Internal/Thread.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/assert.h"
+
+//
+// The chunk source of the pool allocators with a free chunk cache (arena)
+// for each thread, so the documents which are parsed on the worker threads
+// draw the chunks without the locks and the global heap.
+//
+// Each block remembers its home arena:
+//
+//   1. If it's freed on the home thread, it goes to the free list of arena.
+//
+//   2. If it's freed on another thread (the document was handed off to a
+//      consumer), it's pushed to the return stack of the home arena with
+//      CAS, the home thread takes the whole stack by one exchange when its
+//      free list is empty, so there is no ABA problem.
+//
+// An arena is alive until its thread exits and all its blocks are freed,
+// the last one frees the arena. The arena serves the aligned_malloc() and
+// aligned_free() only, that is what FastPoolAllocator uses.
+//
+// Usage: FastPoolAllocator<kChunkCapacity, kInnerChunkCapacity, ThreadArenaAllocator>,
+//        or ThreadArenaPoolAllocator.
+//
+
+namespace JsonFx {
+
+// Forward declaration.
+template <typename Allocator = DefaultAllocator>
+class BasicThreadArenaAllocator;
+
+template <typename Allocator>
+class BasicThreadArenaAllocator : public TrivialAllocator
+{
+public:
+    typedef Allocator   AllocatorType;
+
+    // The header of each block, the alignment must not be larger than it.
+    static const size_t kHeaderSize = 64;
+    static const size_t kCacheLimit = JSONFX_ARENA_CACHE_LIMIT;
+
+private:
+    struct Arena;
+
+    struct BlockHeader {
+        Arena *         home;
+        BlockHeader *   next;
+        size_t          size;
+    };
+
+    struct Arena {
+        BlockHeader *           freeList;   // Only used by the home thread.
+        size_t                  freeBytes;
+        void * volatile         returned;   // The blocks freed by the other threads.
+        internal::AtomicCounter refs;       // The home thread and the blocks in use.
+
+        Arena() : freeList(NULL), freeBytes(0), returned(NULL), refs(1) {}
+    };
+
+    //
+    // The key of the arena pointers. The key destructor is never called for
+    // the thread which runs the static destructors (the main thread at exit),
+    // so its arena is released when the key is deleted.
+    //
+    struct ArenaKey {
+        internal::ThreadLocalPtr ptr;
+
+        ArenaKey() : ptr(&BasicThreadArenaAllocator::onThreadExit) {}
+        ~ArenaKey() {
+            void * arena = ptr.get();
+            ptr.set(NULL);
+            onThreadExit(arena);
+        }
+    };
+
+    //
+    // The key is created at the first use, a static member of the class
+    // template is dynamically initialized in an unspecified order, it may
+    // be used by the static objects of the other units before that.
+    //
+    static internal::ThreadLocalPtr & getArenaPtr() {
+        static ArenaKey sArenaKey;
+        return sArenaKey.ptr;
+    }
+
+public:
+    BasicThreadArenaAllocator()  {}
+    ~BasicThreadArenaAllocator() {}
+
+    static void * aligned_malloc(size_t size, size_t alignment) {
+        jimi_assert(alignment <= kHeaderSize);
+        (void)alignment;
+        Arena * arena = getThreadArena();
+        if (arena == NULL)
+            return NULL;
+
+        BlockHeader * block = takeBlock(arena, size);
+        if (block == NULL) {
+            drainReturned(arena);
+            block = takeBlock(arena, size);
+        }
+        if (block == NULL) {
+            block = reinterpret_cast<BlockHeader *>(
+                AllocatorType::aligned_malloc(size + kHeaderSize, kHeaderSize));
+            if (block == NULL)
+                return NULL;
+            block->home = arena;
+            block->size = size;
+        }
+        arena->refs.increment();
+        return reinterpret_cast<void *>(reinterpret_cast<char *>(block) + kHeaderSize);
+    }
+
+    static void aligned_free(void * ptr) {
+        if (ptr == NULL)
+            return;
+        BlockHeader * block = reinterpret_cast<BlockHeader *>(reinterpret_cast<char *>(ptr) - kHeaderSize);
+        Arena * home = block->home;
+        if (home == reinterpret_cast<Arena *>(getArenaPtr().get())) {
+            // The home thread holds a reference, it's never the last one.
+            cacheBlock(home, block);
+            home->refs.decrement();
+        }
+        else {
+            for (;;) {
+                void * head = internal::AtomicLoadPointer(&home->returned);
+                block->next = reinterpret_cast<BlockHeader *>(head);
+                if (internal::AtomicCompareExchangePointer(&home->returned, head, block))
+                    break;
+            }
+            if (home->refs.decrement() == 0)
+                destroyArena(home);
+        }
+    }
+
+    // Free the cached blocks of the current thread, include the returned ones.
+    static void trimThreadCache() {
+        Arena * arena = reinterpret_cast<Arena *>(getArenaPtr().get());
+        if (arena != NULL) {
+            drainReturned(arena);
+            freeCachedBlocks(arena);
+        }
+    }
+
+    // The cached bytes of the current thread, not include the returned ones.
+    static size_t getThreadCacheBytes() {
+        Arena * arena = reinterpret_cast<Arena *>(getArenaPtr().get());
+        return ((arena != NULL) ? arena->freeBytes : 0);
+    }
+
+private:
+    static Arena * getThreadArena() {
+        Arena * arena = reinterpret_cast<Arena *>(getArenaPtr().get());
+        if (arena == NULL) {
+            arena = new Arena();
+            jimi_assert(arena != NULL);
+            getArenaPtr().set(arena);
+        }
+        return arena;
+    }
+
+    // Take a cached block not less than size, and not larger than 2 times of size.
+    static BlockHeader * takeBlock(Arena * arena, size_t size) {
+        BlockHeader ** link = &arena->freeList;
+        while (*link != NULL) {
+            BlockHeader * block = *link;
+            if (block->size >= size && (block->size / 2) <= size) {
+                *link = block->next;
+                arena->freeBytes -= block->size;
+                return block;
+            }
+            link = &block->next;
+        }
+        return NULL;
+    }
+
+    static void cacheBlock(Arena * arena, BlockHeader * block) {
+        if (arena->freeBytes + block->size <= kCacheLimit) {
+            block->next = arena->freeList;
+            arena->freeList = block;
+            arena->freeBytes += block->size;
+        }
+        else {
+            AllocatorType::aligned_free(block);
+        }
+    }
+
+    static void drainReturned(Arena * arena) {
+        BlockHeader * block = reinterpret_cast<BlockHeader *>(
+            internal::AtomicExchangePointer(&arena->returned, NULL));
+        while (block != NULL) {
+            BlockHeader * next = block->next;
+            cacheBlock(arena, block);
+            block = next;
+        }
+    }
+
+    static void freeCachedBlocks(Arena * arena) {
+        BlockHeader * block = arena->freeList;
+        while (block != NULL) {
+            BlockHeader * next = block->next;
+            AllocatorType::aligned_free(block);
+            block = next;
+        }
+        arena->freeList = NULL;
+        arena->freeBytes = 0;
+    }
+
+    // No reference is left, the returned blocks are freed too.
+    static void destroyArena(Arena * arena) {
+        BlockHeader * block = reinterpret_cast<BlockHeader *>(
+            internal::AtomicExchangePointer(&arena->returned, NULL));
+        while (block != NULL) {
+            BlockHeader * next = block->next;
+            AllocatorType::aligned_free(block);
+            block = next;
+        }
+        freeCachedBlocks(arena);
+        delete arena;
+    }
+
+    static void JSONFX_THREAD_CALLBACK onThreadExit(void * ptr) {
+        Arena * arena = reinterpret_cast<Arena *>(ptr);
+        if (arena != NULL) {
+            freeCachedBlocks(arena);
+            if (arena->refs.decrement() == 0)
+                destroyArena(arena);
+        }
+    }
+};
+
+// Define default ThreadArenaAllocator class type
+typedef BasicThreadArenaAllocator<>                     ThreadArenaAllocator;
+
+// The pool allocator which draws the chunks from the arena of current thread.
+typedef FastPoolAllocator<  gDefaultChunkCapacity,
+                            gDefaultInnerChunkCapacity,
+                            ThreadArenaAllocator>       ThreadArenaPoolAllocator;
+
+}  // namespace JsonFx
+
+#endif  /* !_JSONFX_THREAD_ARENA_ALLOCATOR_H_ */
@@ -47,6 +47,8 @@
 /* Whether use class wrapper in encoding classes? */
 #define ENCODING_USE_CLASS_WRAPPER      0
 
+#include "JsonFx/Internal/Unicode.h"
+
 namespace JsonFx {
 
 enum {
@@ -64,9 +66,48 @@ enum {
     kUTFMax
 };
 
+namespace internal {
+
+//
+// The encoder and decoder policy of BasicEncoding<CharT, EncodingType>, see
+// "JsonFx/Internal/Unicode.h". The unknown encoding is regarded as the
+// Unicode transformation format of the CharT size in the host byte order.
+//
+template <typename CharT, size_t EncodingType>
+struct EncodingPolicy : public UnicodeCodec<sizeof(CharT), kHostBigEndian> {};
+
+template <typename CharT>
+struct EncodingPolicy<CharT, kUTF8>    : public UnicodeCodec<1, false> {};
+
+template <typename CharT>
+struct EncodingPolicy<CharT, kUTF16>   : public UnicodeCodec<2, kHostBigEndian> {};
+
+template <typename CharT>
+struct EncodingPolicy<CharT, kUTF16LE> : public UnicodeCodec<2, false> {};
+
+template <typename CharT>
+struct EncodingPolicy<CharT, kUTF16BE> : public UnicodeCodec<2, true> {};
+
+template <typename CharT>
+struct EncodingPolicy<CharT, kUTF32>   : public UnicodeCodec<4, kHostBigEndian> {};
+
+template <typename CharT>
+struct EncodingPolicy<CharT, kUTF32LE> : public UnicodeCodec<4, false> {};
+
+template <typename CharT>
+struct EncodingPolicy<CharT, kUTF32BE> : public UnicodeCodec<4, true> {};
+
+}  // namespace internal
+
+//
+// The encoding type, it's also the encoder and decoder of the code points:
+//
+//   BasicEncoding::encode(dest, codepoint);
+//   BasicEncoding::decode(src, end, codepoint);
+//
 template <typename CharT = JSONFX_CHARTYPE,
           size_t _EncodingType = kUTFUnknown>
-struct BasicEncoding
+struct BasicEncoding : public internal::EncodingPolicy<CharT, _EncodingType>
 {
 public:
     typedef CharT CharType;
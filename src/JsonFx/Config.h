@@ -23,6 +23,60 @@
 //! Recommended setting to 128, 256, 4096 or 8192.
 #define JSONFX_POOL_INNER_BUFSIZE       256
 
+//! The max bytes of the free chunks which are kept by the memory pool
+//! for reuse after reset(), it's the default high-water mark.
+#ifndef JSONFX_POOL_RETAIN_LIMIT
+#define JSONFX_POOL_RETAIN_LIMIT        (4 * 1024 * 1024)
+#endif
+
+//! The kept chunks which are not reused in this count of resets are freed.
+#ifndef JSONFX_POOL_TRIM_RESETS
+#define JSONFX_POOL_TRIM_RESETS         64
+#endif
+
+//! The max capacity of the chunks of the memory pool, the chunk capacity grows
+//! geometrically from the default one to it within a document.
+#ifndef JSONFX_POOL_MAX_CHUNK_CAPACITY
+#define JSONFX_POOL_MAX_CHUNK_CAPACITY  (16 * 1024 * 1024)
+#endif
+
+//! Map the large chunks of HugePageAllocator on the huge pages (Linux only).
+//! Setting to 0 to always use the aligned_malloc().
+#ifndef JSONFX_USE_HUGE_PAGES
+#define JSONFX_USE_HUGE_PAGES           1
+#endif
+
+//! The min chunk size which HugePageAllocator maps on the huge pages.
+#ifndef JSONFX_HUGE_PAGE_THRESHOLD
+#define JSONFX_HUGE_PAGE_THRESHOLD      (2 * 1024 * 1024)
+#endif
+
+//! The max bytes of the free chunks which are cached by the arena of each
+//! thread in ThreadArenaAllocator.
+#ifndef JSONFX_ARENA_CACHE_LIMIT
+#define JSONFX_ARENA_CACHE_LIMIT        (16 * 1024 * 1024)
+#endif
+
+//! Pack the pointers of the values into 48 bits, so a value is 16 bytes (see
+//! BasicValue). It's only safe if the top 16 bits of the user space addresses
+//! are the sign extension of bit 47, like on x86-64 and the 32 bits targets,
+//! the top bits of the pointers can be set on the other targets (like the TBI
+//! and MTE tags of ARM64), so the pointers take the full 8 bytes there.
+#ifndef JSONFX_VALUE_PACKED_POINTER
+  #if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__) || defined(__amd64__) \
+      || defined(_M_IX86) || defined(__i386__)
+    #define JSONFX_VALUE_PACKED_POINTER     1
+  #else
+    #define JSONFX_VALUE_PACKED_POINTER     0
+  #endif
+#endif
+
+//! Use the SIMD (SSE2 / AVX2) kernels, they are selected by the CPU features at runtime.
+//! Setting to 0 to use the scalar code only.
+#ifndef JSONFX_USE_SIMD
+#define JSONFX_USE_SIMD                 1
+#endif
+
 #define ALIGN_PREFIX(N)                 __declspec(align(N))
 #define ALIGN_SUFFIX(N)
 
@@ -81,6 +135,10 @@ class SimplePoolAllocator;
 template <size_t ChunkCapacity, size_t InnerChunkCapacity, typename Allocator>
 class FastPoolAllocator;
 
+// Forward declaration.
+template <size_t ChunkCapacity, size_t InnerChunkCapacity, typename Allocator>
+class SlabPoolAllocator;
+
 //! Default StdPoolAllocator chunk capacity (Recommended settings for multiple systems PageSize.)
 static const size_t gDefaultChunkCapacity = 16 * JSONFX_DEFAULT_PAGESIZE;
 
@@ -7,12 +7,15 @@
 #endif
 
 #include <stdio.h>
+#include <new>
 
 #include "JsonFx/Config.h"
 #include "JsonFx/Allocator.h"
 #include "JsonFx/Value.h"
+#include "JsonFx/Stack.h"
 #include "JsonFx/Reader.h"
 #include "JsonFx/Writer.h"
+#include "JsonFx/Projection.h"
 
 #include "JsonFx/Stream/StringInputStream.h"
 
@@ -29,10 +32,6 @@ class BasicDocument;
 // Define default Document class type
 typedef BasicDocument<>    Document;
 
-// Save and setting the packing alignment
-#pragma pack(push)
-#pragma pack(1)
-
 template <typename EncodingT /* = JSONFX_DEFAULT_ENCODING */,
           typename PoolAllocatorT /* = DefaultPoolAllocator */,
           typename AllocatorT /* = DefaultAllocator */>
@@ -40,29 +39,44 @@ class BasicDocument : public BasicValue<EncodingT, PoolAllocatorT>
 {
 public:
     typedef typename EncodingT::CharType            CharType;           //!< Character type derived from Encoding.
+    typedef size_t                                  SizeType;
     typedef BasicValue<EncodingT, PoolAllocatorT>   ValueType;          //!< Value type of the document.
     typedef EncodingT                               EncodingType;       //!< Character encoding type.
     typedef PoolAllocatorT                          PoolAllocatorType;  //!< Pool allocator type from template parameter.
     typedef AllocatorT                              StackAllocatorType; //!< Stack allocator type from template parameter.
     typedef BasicStringInputStream<CharType>        StringInputStreamType;
-    typedef BasicStack<PoolAllocatorT>              StackType;
+    typedef BasicStack<StackAllocatorType>          StackType;
     typedef BasicParseResult<EncodingT>             ParseResultType;
+    typedef BasicProjection<EncodingT, AllocatorT>  ProjectionType;     //!< Compiled paths for the projected parsing.
+
+    static const size_t kDefaultStackCapacity = 1024;
 
 private:
     PoolAllocatorType *     mPoolAllocator;
     bool                    mPoolAllocatorNeedFree;
     StackAllocatorType *    mStackAllocator;
     bool                    mStackAllocatorNeedFree;
-    StackType               mStack;
+    StackType               mStack;         // The values stack for building the DOM.
+    StackType               mReaderStack;   // The container frames stack of reader.
     ParseResultType         mParseResult;
 
 public:
+    //
+    // If the StackAllocatorT is the same type with PoolAllocatorT, the stacks
+    // draw memory from the document's pool allocator, otherwise they use
+    // a own stack allocator (default is the heap allocator), and the stack
+    // buffers are reused across the parses.
+    //
     BasicDocument(const PoolAllocatorType * poolAllocator = NULL)
         : mPoolAllocator(const_cast<PoolAllocatorType *>(poolAllocator)),
           mPoolAllocatorNeedFree(false),
-          mStack(poolAllocator, 100), mParseResult()
+          mStackAllocator(NULL), mStackAllocatorNeedFree(false),
+          mStack(NULL, kDefaultStackCapacity),
+          mReaderStack(NULL, StackType::kDefaultCapacity),
+          mParseResult()
     {
         initPoolAllocator(poolAllocator);
+        initStackAllocator();
     }
 
     ~BasicDocument() {
@@ -80,6 +94,31 @@ public:
     const StackAllocatorType * getStackAllocator() const { return mStackAllocator; }
     const PoolAllocatorType *  getAllocator() const      { return getPoolAllocator();  }
 
+    const ParseResultType & getParseResult() const { return mParseResult; }
+    bool hasParseError() const { return mParseResult.hasError(); }
+
+    //
+    // Release all the values and reset the pool allocator for the next parse,
+    // the chunks of pool allocator and the stack buffers are reused. Notice:
+    // the values of other documents which share the pool allocator are also
+    // released.
+    //
+    void reset() {
+        ValueType::setNull();
+        mParseResult.clear();
+        if (!StackAllocatorType::kNeedFree) {
+            // The stack buffers draw from the pool allocator.
+            mStack.reset();
+            mReaderStack.reset();
+        }
+        mPoolAllocator->reset();
+    }
+
+    // The size of the next input text (bytes), it's a hint for the chunk size of pool allocator.
+    void setSizeHint(size_t inputSize) {
+        mPoolAllocator->setSizeHint(inputSize);
+    }
+
     void visit();
 
     void test() {
@@ -88,6 +127,22 @@ public:
 
 private:
     void destroy() {
+        // Release the values before the pool allocator, if it frees the blocks one by one.
+        if (PoolAllocatorType::kNeedFree) {
+            ValueType::release();
+            ValueType::setNull();
+        }
+
+        // Release the stacks buffer before the allocators.
+        mStack.setAllocator(NULL);
+        mReaderStack.setAllocator(NULL);
+
+        if (this->mStackAllocatorNeedFree) {
+            if (this->mStackAllocator) {
+                delete this->mStackAllocator;
+                this->mStackAllocator = NULL;
+            }
+        }
         if (this->mPoolAllocatorNeedFree) {
             if (this->mPoolAllocator) {
                 delete this->mPoolAllocator;
@@ -107,6 +162,79 @@ private:
         }
     }
 
+    void initStackAllocator() {
+        if (internal::IsSame<StackAllocatorType, PoolAllocatorType>::Value) {
+            // Draw the stack memory from the document's pool allocator.
+            mStackAllocator = reinterpret_cast<StackAllocatorType *>(mPoolAllocator);
+            mStackAllocatorNeedFree = false;
+        }
+        else {
+            StackAllocatorType * newStackAllocator = new StackAllocatorType();
+            jimi_assert(newStackAllocator != NULL);
+            if (newStackAllocator != NULL) {
+                mStackAllocator = newStackAllocator;
+                mStackAllocatorNeedFree = true;
+            }
+        }
+        mStack.setAllocator(mStackAllocator);
+        mReaderStack.setAllocator(mStackAllocator);
+    }
+
+    void prepareParse() {
+        // Remove existing root if exist
+        if (PoolAllocatorType::kNeedFree)
+            ValueType::release();
+        ValueType::setNull();
+        mParseResult.clear();
+
+        if (StackAllocatorType::kNeedFree) {
+            // Keep the stack buffers for reuse.
+            mStack.clear();
+            mReaderStack.clear();
+        }
+        else if (mStackAllocatorNeedFree) {
+            // The own stack allocator only serves the stacks, it's reset with
+            // them, so its chunks are reused.
+            mStack.reset();
+            mReaderStack.reset();
+            resetStackAllocator(internal::BoolType<StackAllocatorType::kNeedFree>());
+        }
+        else if (mPoolAllocatorNeedFree) {
+            // The stacks draw from the own pool allocator, it's only reset by
+            // reset() which forgets the stack buffers too, so they are reused.
+            mStack.clear();
+            mReaderStack.clear();
+        }
+        else {
+            // The stack buffers draw from the shared pool allocator maybe has
+            // been released by PoolAllocator::reset(), so they can't be reused.
+            mStack.reset();
+            mReaderStack.reset();
+        }
+    }
+
+    // Only the pool allocators (!kNeedFree) can be reset.
+    void resetStackAllocator(internal::FalseType /* kNeedFree */) { mStackAllocator->reset(); }
+    void resetStackAllocator(internal::TrueType  /* kNeedFree */) {}
+
+    void finishParse() {
+        if (!mParseResult.hasError()) {
+            // The root value is the only one value left in the stack.
+            jimi_assert(mStack.getSize() == sizeof(ValueType));
+            ValueType::moveRaw(*mStack.template pop<ValueType>(1));
+        }
+        else if (PoolAllocatorType::kNeedFree) {
+            // The pool allocator frees the blocks one by one, so the values
+            // of a failed parse must be released before they are discarded.
+            ValueType * values = mStack.template Bottom<ValueType>();
+            size_t count = mStack.getSize() / sizeof(ValueType);
+            for (size_t i = 0; i < count; ++i)
+                values[i].release();
+        }
+        // Discard the values of a failed parse.
+        mStack.clear();
+    }
+
 public:
     // Implementation of ReaderHandler
     bool saxNull()             { new (mStack.template push<ValueType>()) ValueType();  return true; }
@@ -119,9 +247,9 @@ public:
 
     bool saxString(const CharType * str, SizeType length, bool copy) { 
         if (copy) 
-            new (mStack.template push<ValueType>()) ValueType(str, length, this->getAllocator());
+            new (mStack.template push<ValueType>()) ValueType(str, static_cast<typename ValueType::SizeType>(length), mPoolAllocator);
         else
-            new (mStack.template push<ValueType>()) ValueType(str, length);
+            new (mStack.template push<ValueType>()) ValueType(str, static_cast<typename ValueType::SizeType>(length));
         return true;
     }
 
@@ -129,9 +257,23 @@ public:
     
     bool saxKey(const CharType * str, SizeType length, bool copy) { return saxString(str, length, copy); }
 
+    // The member names keep the hash code for findMember().
+    typedef internal::TrueType HashedKeyTag;
+
+    // The short strings are copied into the values (see BasicValue), so
+    // the reader needn't keep them in the pool allocator.
+    typedef internal::TrueType InlineStringTag;
+    static const size_t kMaxInlineStringLength = ValueType::kMaxShortStringLength;
+
+    bool saxHashedKey(const CharType * str, SizeType length, uint32_t hash, bool copy) {
+        saxString(str, length, copy);
+        mStack.template Top<ValueType>()->setStringHashRaw(hash);
+        return true;
+    }
+
     bool saxEndObject(SizeType memberCount) {
         typename ValueType::MemberType * members = mStack.template pop<typename ValueType::MemberType>(memberCount);
-        mStack.template Top<ValueType>()->setObjectRaw(members, (SizeType)memberCount, this->getAllocator());
+        mStack.template Top<ValueType>()->setObjectRaw(members, static_cast<typename ValueType::SizeType>(memberCount), mPoolAllocator);
         return true;
     }
 
@@ -139,7 +281,7 @@ public:
     
     bool saxEndArray(SizeType elementCount) {
         ValueType * elements = mStack.template pop<ValueType>(elementCount);
-        mStack.template Top<ValueType>()->setArrayRaw(elements, elementCount, this->getAllocator());
+        mStack.template Top<ValueType>()->setArrayRaw(elements, static_cast<typename ValueType::SizeType>(elementCount), mPoolAllocator);
         return true;
     }
     // End of implementation of ReaderHandler
@@ -149,17 +291,13 @@ public:
     //
     template <size_t parseFlags, typename SourceEncodingT, typename InuptStreamT>
     BasicDocument & parseStream(const InuptStreamT & is) {
-        // Remove existing root if exist
-        ValueType::setNull();
+        prepareParse();
         BasicReader<parseFlags, SourceEncodingT, EncodingT, PoolAllocatorT, AllocatorT>
-            reader(this->getPoolAllocator(), false, this->getPoolAllocator());
+            reader(this->getPoolAllocator(), false, &mReaderStack);
 
         // Parse the stream use SAX mode in Reader class.
         mParseResult = reader.parseStream(const_cast<InuptStreamT &>(is), *this);
-        if (mParseResult.hasError()) {
-            // Get the error code.
-            mParseResult.getError();
-        }
+        finishParse();
         return *this;
     }
 
@@ -227,17 +365,13 @@ public:
     //
     template <size_t parseFlags, typename SourceEncodingT, typename InuptStreamT>
     BasicDocument & parse(const InuptStreamT & is) {
-        // Remove existing root if exist
-        ValueType::setNull();
+        prepareParse();
         BasicReader<parseFlags, SourceEncodingT, EncodingT, PoolAllocatorT, AllocatorT>
-            reader(this->getPoolAllocator(), false, this->getPoolAllocator());
+            reader(this->getPoolAllocator(), false, &mReaderStack);
 
         // Parse the stream use SAX mode in Reader class.
         mParseResult = reader.parse(const_cast<InuptStreamT &>(is), *this);
-        if (mParseResult.hasError()) {
-            // Get the error code.
-            mParseResult.getError();
-        }
+        finishParse();
         return *this;
     }
 
@@ -299,10 +433,67 @@ public:
     BasicDocument & parse(const CharType * text) {
         return parse<kDefaultParseFlags>(text);
     }
-};
 
-// Recover the packing alignment
-#pragma pack(pop)
+    //
+    // BasicDocument::parse<parseFlags, SourceEncodingT, InuptStreamT>(is, projection);
+    //
+    // Parse only the values on the paths of projection (see "JsonFx/Projection.h"),
+    // the others are skipped without building the values, so they cost neither
+    // the pool memory nor the parsing of strings and numbers.
+    //
+    template <size_t parseFlags, typename SourceEncodingT, typename InuptStreamT>
+    BasicDocument & parse(const InuptStreamT & is, const ProjectionType & projection) {
+        prepareParse();
+        BasicReader<parseFlags, SourceEncodingT, EncodingT, PoolAllocatorT, AllocatorT>
+            reader(this->getPoolAllocator(), false, &mReaderStack);
+
+        mParseResult = reader.parse(const_cast<InuptStreamT &>(is), *this, projection);
+        finishParse();
+        return *this;
+    }
+
+    //
+    // BasicDocument::parse(const CharType * text, projection);
+    //
+    template <size_t parseFlags>
+    BasicDocument & parse(const CharType * text, const ProjectionType & projection) {
+        jimi_assert(text != NULL);
+        StringInputStreamType inputStream(text);
+        return parse<parseFlags, EncodingT, StringInputStreamType>(inputStream, projection);
+    }
+
+    BasicDocument & parse(const CharType * text, const ProjectionType & projection) {
+        return parse<kDefaultParseFlags>(text, projection);
+    }
+
+    //
+    // BasicDocument::parseInsitu(CharType * text);
+    //
+    // Parse the mutable text in-situ (zero-copy): the strings are unescaped
+    // in the text buffer, and the string values reference it by kConstStringFlags,
+    // so there is no pool allocation for the string bodies.
+    //
+    // Lifetime: the text buffer is modified by the parsing, and it must be kept
+    // alive and unchanged as long as the values of this document are used, that is
+    // until the next parse() or the document is destroyed. The objects and arrays
+    // are still allocated in the pool allocator.
+    //
+    template <size_t parseFlags, typename SourceEncodingT>
+    BasicDocument & parseInsitu(CharType * text) {
+        jimi_assert(text != NULL);
+        StringInputStreamType inputStream(text);
+        return parse<parseFlags | kInsituParseFlag, SourceEncodingT, StringInputStreamType>(inputStream);
+    }
+
+    template <size_t parseFlags>
+    BasicDocument & parseInsitu(CharType * text) {
+        return parseInsitu<parseFlags, EncodingT>(text);
+    }
+
+    BasicDocument & parseInsitu(CharType * text) {
+        return parseInsitu<kDefaultParseFlags>(text);
+    }
+};
 
 template <typename EncodingT, typename PoolAllocatorT, typename AllocatorT>
 void BasicDocument<EncodingT, PoolAllocatorT, AllocatorT>::visit()
@@ -0,0 +1,167 @@
+
+#ifndef _JSONFX_INTERNAL_ARRAYSPLITTER_H_
+#define _JSONFX_INTERNAL_ARRAYSPLITTER_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Internal/CpuFeatures.h"
+#include "JsonFx/Internal/StructuralIndex.h"
+#include "JsonFx/Internal/ValueSkipper.h"
+#include "JsonFx/Internal/SkipWhiteSpaces.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+
+//
+// Split a large top level array to the segments for the parallel parsing:
+//
+//   1. The quote pre-pass: the text is cut into the chunks, the parity of
+//      the unescaped quotes in each chunk is counted independently (the
+//      escape state of a chunk is known from the backslashes before it),
+//      so the prefix parity tells whether a chunk begins in a string.
+//
+//   2. The guess: from the beginning of a chunk, the first ',' outside the
+//      strings which is like a separator of the elements (see below) is
+//      guessed as a boundary. A guess may be in a nested container, it's
+//      validated by the parsing of the previous segment.
+//
+
+namespace JsonFx {
+
+namespace internal {
+
+// Return true if the char at p is escaped by an odd count of backslashes before it.
+template <typename CharT>
+static inline
+bool IsEscapedChar(const CharT * text, const CharT * p) {
+    size_t count = 0;
+    while (p > text && *(p - 1) == '\\') {
+        --p;
+        ++count;
+    }
+    return ((count & 1) != 0);
+}
+
+//
+// Return true if the count of the unescaped quotes in [begin, end) is odd,
+// escaped is true if the first char is escaped, and it returns the escape
+// state of the char at end.
+//
+template <typename CharT>
+static inline
+bool QuoteParityScalar(const CharT * begin, const CharT * end, bool & escaped) {
+    bool odd = false;
+    bool isEscaped = escaped;
+    for (const CharT * p = begin; p < end; ++p) {
+        if (isEscaped)
+            isEscaped = false;
+        else if (*p == '\\')
+            isEscaped = true;
+        else if (*p == '"')
+            odd = !odd;
+    }
+    escaped = isEscaped;
+    return odd;
+}
+
+template <typename CharT>
+static inline
+bool QuoteParity(const CharT * begin, const CharT * end, bool escaped) {
+    // The SIMD kernels only support the single byte chars.
+    return QuoteParityScalar(begin, end, escaped);
+}
+
+#if defined(JSONFX_SIMD_X86)
+
+// The p is aligned to 64 bytes, the chars at or after end are masked out.
+static inline
+bool QuoteParityBlocks(const char * p, const char * end, bool escaped,
+                       ClassifyBracketsFunc classifyBrackets) {
+    QuoteMaskScanner scanner(escaped);
+    for (; p < end; p += 64) {
+        BracketBitmaps bm;
+        classifyBrackets(p, bm);
+        size_t remain = static_cast<size_t>(end - p);
+        uint64_t valid = (remain >= 64) ? ~UINT64_C(0) : ((UINT64_C(1) << remain) - 1);
+        uint64_t quote = bm.quote & valid;
+        scanner.next(bm.backslash & valid, quote);
+    }
+    return scanner.isInsideQuote();
+}
+
+#endif  /* JSONFX_SIMD_X86 */
+
+static inline
+bool QuoteParity(const char * begin, const char * end, bool escaped) {
+#if defined(JSONFX_SIMD_X86)
+    const ClassifyBracketsFunc classifyBracketsFunc = gClassifyBracketsFunc;
+    if (classifyBracketsFunc != NULL) {
+        // The head to the 64 bytes boundary is counted by scalar.
+        const char * aligned = reinterpret_cast<const char *>(
+            (reinterpret_cast<uintptr_t>(begin) + 63) & ~static_cast<uintptr_t>(63));
+        if (aligned >= end)
+            return QuoteParityScalar(begin, end, escaped);
+        bool odd = QuoteParityScalar(begin, aligned, escaped);
+        return (odd != QuoteParityBlocks(aligned, end, escaped, classifyBracketsFunc));
+    }
+#endif
+    return QuoteParityScalar(begin, end, escaped);
+}
+
+//
+// Return the first char of the guessed element from p, it's after a ','
+// outside the strings, and the chars around the ',' are like the end and
+// the beginning of an element, such as "} , {" if the first element of the
+// array is an object. Return NULL if there is no guess before end.
+// The inString and escaped are the states at p.
+//
+template <typename CharT>
+static inline
+const CharT * FindElementBoundary(const CharT * p, const CharT * end,
+                                  bool inString, bool escaped, CharT first) {
+    CharT closer = 0;
+    if (first == '{')
+        closer = '}';
+    else if (first == '[')
+        closer = ']';
+    else if (first == '"')
+        closer = '"';
+
+    for (; p < end && *p != '\0'; ++p) {
+        CharT ch = *p;
+        if (inString) {
+            if (escaped)
+                escaped = false;
+            else if (ch == '\\')
+                escaped = true;
+            else if (ch == '"')
+                inString = false;
+        }
+        else if (ch == '"') {
+            inString = true;
+        }
+        else if (ch == ',') {
+            const CharT * next = SkipWhiteSpaces(p + 1);
+            if (closer == 0)
+                return (*next != '\0') ? next : NULL;
+            if (*next == first) {
+                const CharT * prev = p - 1;
+                while (IsWhiteSpace(*prev)) {
+                    --prev;
+                }
+                if (*prev == closer)
+                    return next;
+            }
+        }
+    }
+    return NULL;
+}
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_ARRAYSPLITTER_H_ */
@@ -0,0 +1,138 @@
+
+#ifndef _JSONFX_INTERNAL_BIGINTEGER_H_
+#define _JSONFX_INTERNAL_BIGINTEGER_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/stdsize.h"
+#include "jimi/basic/assert.h"
+
+namespace JsonFx {
+
+namespace internal {
+
+//
+// A fixed capacity unsigned big integer, it's only used by the slow path of
+// the number parsing (see "JsonFx/Internal/Strtod.h"), so it's simple rather than fast.
+//
+// The capacity is enough for comparing 800 significant decimal digits with
+// a halfway point of the doubles, the values never exceed about 2800 bits.
+//
+class BigInteger {
+public:
+    typedef uint32_t    WordType;
+
+    static const size_t kWordBits = 32;
+    static const size_t kCapacity = 128;    // 4096 bits
+
+private:
+    WordType    mWords[kCapacity];      // Little-endian words
+    size_t      mCount;
+
+public:
+    explicit BigInteger(uint64_t u) : mCount(0) {
+        while (u != 0) {
+            mWords[mCount++] = static_cast<WordType>(u);
+            u >>= kWordBits;
+        }
+    }
+
+    bool isZero() const { return (mCount == 0); }
+
+    BigInteger & multiplySmall(WordType m) {
+        uint64_t carry = 0;
+        for (size_t i = 0; i < mCount; ++i) {
+            uint64_t product = static_cast<uint64_t>(mWords[i]) * m + carry;
+            mWords[i] = static_cast<WordType>(product);
+            carry = product >> kWordBits;
+        }
+        if (carry != 0)
+            pushWord(static_cast<WordType>(carry));
+        return *this;
+    }
+
+    BigInteger & addSmall(WordType a) {
+        uint64_t carry = a;
+        for (size_t i = 0; i < mCount && carry != 0; ++i) {
+            uint64_t sum = static_cast<uint64_t>(mWords[i]) + carry;
+            mWords[i] = static_cast<WordType>(sum);
+            carry = sum >> kWordBits;
+        }
+        if (carry != 0)
+            pushWord(static_cast<WordType>(carry));
+        return *this;
+    }
+
+    BigInteger & multiplyPow5(unsigned exp) {
+        // 5^13 is the max power of five fits in 32 bits.
+        static const WordType kPow5_13 = 1220703125U;
+        static const WordType kPow5[] = {
+            1U, 5U, 25U, 125U, 625U, 3125U, 15625U, 78125U, 390625U,
+            1953125U, 9765625U, 48828125U, 244140625U
+        };
+        while (exp >= 13) {
+            multiplySmall(kPow5_13);
+            exp -= 13;
+        }
+        if (exp != 0)
+            multiplySmall(kPow5[exp]);
+        return *this;
+    }
+
+    BigInteger & shiftLeft(size_t shift) {
+        if (isZero() || shift == 0)
+            return *this;
+
+        size_t wordShift = shift / kWordBits;
+        size_t bitShift  = shift % kWordBits;
+        jimi_assert(mCount + wordShift + 1 <= kCapacity);
+
+        if (bitShift == 0) {
+            for (size_t i = mCount; i > 0; --i)
+                mWords[i - 1 + wordShift] = mWords[i - 1];
+        }
+        else {
+            mWords[mCount + wordShift] = 0;
+            for (size_t i = mCount; i > 0; --i) {
+                mWords[i + wordShift]     |= mWords[i - 1] >> (kWordBits - bitShift);
+                mWords[i - 1 + wordShift]  = mWords[i - 1] << bitShift;
+            }
+        }
+        for (size_t i = 0; i < wordShift; ++i)
+            mWords[i] = 0;
+
+        mCount += wordShift;
+        if (bitShift != 0 && mWords[mCount] != 0)
+            ++mCount;
+        return *this;
+    }
+
+    // Return -1, 0 or 1 if this is less than, equal to or greater than rhs.
+    int compare(const BigInteger & rhs) const {
+        if (mCount != rhs.mCount)
+            return (mCount < rhs.mCount) ? -1 : 1;
+        for (size_t i = mCount; i > 0; --i) {
+            if (mWords[i - 1] != rhs.mWords[i - 1])
+                return (mWords[i - 1] < rhs.mWords[i - 1]) ? -1 : 1;
+        }
+        return 0;
+    }
+
+private:
+    void pushWord(WordType w) {
+        jimi_assert(mCount < kCapacity);
+        if (mCount < kCapacity)
+            mWords[mCount++] = w;
+    }
+};
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_BIGINTEGER_H_ */
@@ -0,0 +1,177 @@
+
+#ifndef _JSONFX_INTERNAL_CPUFEATURES_H_
+#define _JSONFX_INTERNAL_CPUFEATURES_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+
+#include "jimi/basic/archdef.h"
+#include "jimi/basic/stdint.h"
+
+//
+// The x86 SIMD kernels (SSE2 / AVX2) are compiled when JSONFX_USE_SIMD is
+// not 0 and the target is x86 or x64, they are selected at runtime by the
+// CPU features, so the binary still runs on the CPU without AVX2.
+//
+#if defined(JSONFX_USE_SIMD) && (JSONFX_USE_SIMD != 0) \
+    && (defined(JIMI_ARCH_X86) || defined(JIMI_ARCH_X64))
+  #define JSONFX_SIMD_X86       1
+#endif
+
+#if defined(JSONFX_SIMD_X86)
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+  #else
+    #include <cpuid.h>
+  #endif
+  #include <emmintrin.h>    // SSE2
+  #include <immintrin.h>    // AVX2
+#endif  /* JSONFX_SIMD_X86 */
+
+//
+// The function uses the AVX2 intrinsics must be declared with JSONFX_TARGET_AVX2,
+// GCC and Clang don't allow the AVX2 intrinsics without -mavx2 otherwise. The
+// compiler may emit all the enabled instructions, so the callers must check
+// kCpuFeatureAVX2Kernels, not only kCpuFeatureAVX2.
+//
+#if defined(JSONFX_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+  #define JSONFX_TARGET_AVX2    __attribute__((target("avx2,bmi,bmi2,popcnt")))
+#else
+  #define JSONFX_TARGET_AVX2
+#endif
+
+//
+// The SIMD kernels read the whole aligned blocks, it's safe (never crosses a page),
+// but maybe read the bytes out of a object, so don't let AddressSanitizer check them.
+//
+#if defined(__clang__)
+  #if defined(__has_feature)
+    #if __has_feature(address_sanitizer)
+      #define JSONFX_NO_SANITIZE_ADDRESS    __attribute__((no_sanitize("address")))
+    #endif
+  #endif
+#elif defined(__GNUC__) && defined(__SANITIZE_ADDRESS__)
+  #define JSONFX_NO_SANITIZE_ADDRESS    __attribute__((no_sanitize_address))
+#endif
+#ifndef JSONFX_NO_SANITIZE_ADDRESS
+  #define JSONFX_NO_SANITIZE_ADDRESS
+#endif
+
+namespace JsonFx {
+
+namespace internal {
+
+enum CpuFeature {
+    kCpuFeatureNone     = 0,
+    kCpuFeatureSSE2     = 1 << 0,
+    kCpuFeatureSSSE3    = 1 << 1,
+    kCpuFeatureSSE42    = 1 << 2,
+    kCpuFeaturePOPCNT   = 1 << 3,
+    kCpuFeaturePCLMUL   = 1 << 4,
+    kCpuFeatureAVX      = 1 << 5,
+    kCpuFeatureAVX2     = 1 << 6,
+    kCpuFeatureBMI1     = 1 << 7,
+    kCpuFeatureBMI2     = 1 << 8,
+
+    // All the features enabled by JSONFX_TARGET_AVX2.
+    kCpuFeatureAVX2Kernels = kCpuFeatureAVX2 | kCpuFeatureBMI1 | kCpuFeatureBMI2 | kCpuFeaturePOPCNT
+};
+
+#if defined(JSONFX_SIMD_X86)
+
+static inline
+void CpuId(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+    regs[0] = static_cast<uint32_t>(info[0]);
+    regs[1] = static_cast<uint32_t>(info[1]);
+    regs[2] = static_cast<uint32_t>(info[2]);
+    regs[3] = static_cast<uint32_t>(info[3]);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Read the XCR0 register, it tells which register states are saved by the OS.
+static inline
+uint64_t ReadXCR0() {
+#if defined(_MSC_VER)
+    return static_cast<uint64_t>(_xgetbv(0));
+#else
+    uint32_t eax, edx;
+    __asm__ __volatile__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+    return ((static_cast<uint64_t>(edx) << 32) | eax);
+#endif
+}
+
+static inline
+uint32_t DetectCpuFeatures() {
+    uint32_t features = kCpuFeatureNone;
+    uint32_t regs[4];
+
+    CpuId(0, 0, regs);
+    uint32_t maxLeaf = regs[0];
+    if (maxLeaf < 1)
+        return features;
+
+    CpuId(1, 0, regs);
+    if (regs[3] & (1U << 26)) features |= kCpuFeatureSSE2;
+    if (regs[2] & (1U << 9))  features |= kCpuFeatureSSSE3;
+    if (regs[2] & (1U << 20)) features |= kCpuFeatureSSE42;
+    if (regs[2] & (1U << 23)) features |= kCpuFeaturePOPCNT;
+    if (regs[2] & (1U << 1))  features |= kCpuFeaturePCLMUL;
+
+    // The AVX registers can be used only if the OS saves the XMM and YMM states.
+    bool osSaveYmm = false;
+    if ((regs[2] & (1U << 27)) && (regs[2] & (1U << 28))) {
+        osSaveYmm = ((ReadXCR0() & 0x06) == 0x06);
+        if (osSaveYmm)
+            features |= kCpuFeatureAVX;
+    }
+
+    if (maxLeaf >= 7) {
+        CpuId(7, 0, regs);
+        if (osSaveYmm && (regs[1] & (1U << 5)))
+            features |= kCpuFeatureAVX2;
+        if (regs[1] & (1U << 3)) features |= kCpuFeatureBMI1;
+        if (regs[1] & (1U << 8)) features |= kCpuFeatureBMI2;
+    }
+    return features;
+}
+
+#else  /* !JSONFX_SIMD_X86 */
+
+static inline
+uint32_t DetectCpuFeatures() {
+    return kCpuFeatureNone;
+}
+
+#endif  /* JSONFX_SIMD_X86 */
+
+//
+// The CPU features are detected only once, by the static initialization
+// before main(), as well as the kernels selected by them (see ScanString()
+// and the other dispatchers). The function local statics are not thread
+// safe before VC2015, the threads may race on their first calls.
+//
+static const uint32_t gCpuFeatures = DetectCpuFeatures();
+
+static inline
+uint32_t GetCpuFeatures() {
+    return gCpuFeatures;
+}
+
+static inline
+bool HasCpuFeatures(uint32_t features) {
+    return ((GetCpuFeatures() & features) == features);
+}
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_CPUFEATURES_H_ */
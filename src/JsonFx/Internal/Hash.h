@@ -0,0 +1,53 @@
+
+#ifndef _JSONFX_INTERNAL_HASH_H_
+#define _JSONFX_INTERNAL_HASH_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+
+//
+// The hash code of the member names (FNV-1a, 32 bits), the reader computes
+// it while copying the chars of a name, and the BasicValue uses it to find
+// the members. A finished hash code is never 0, 0 means it's not computed.
+//
+
+namespace JsonFx {
+
+namespace internal {
+
+static const uint32_t kHashSeed  = 2166136261U;
+static const uint32_t kHashPrime = 16777619U;
+
+// Continue the hash with the chars in [begin, end).
+template <typename CharT>
+static inline
+uint32_t HashChars(uint32_t hash, const CharT * begin, const CharT * end) {
+    for (; begin < end; ++begin) {
+        hash ^= static_cast<uint32_t>(*begin);
+        hash *= kHashPrime;
+    }
+    return hash;
+}
+
+static inline
+uint32_t HashFinish(uint32_t hash) {
+    return ((hash != 0) ? hash : 1);
+}
+
+template <typename CharT>
+static inline
+uint32_t HashString(const CharT * str, size_t length) {
+    return HashFinish(HashChars(kHashSeed, str, str + length));
+}
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_HASH_H_ */
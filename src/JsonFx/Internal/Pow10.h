@@ -0,0 +1,37 @@
+
+#ifndef _JSONFX_INTERNAL_POW10_H_
+#define _JSONFX_INTERNAL_POW10_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/assert.h"
+
+namespace JsonFx {
+
+namespace internal {
+
+//
+// Return 10.0^n, n must be in range [0, 22], all of them are exactly
+// representable in the double.
+//
+static inline
+double Pow10(int n) {
+    static const double kPow10[] = {
+        1e+0,  1e+1,  1e+2,  1e+3,  1e+4,  1e+5,  1e+6,  1e+7,
+        1e+8,  1e+9,  1e+10, 1e+11, 1e+12, 1e+13, 1e+14, 1e+15,
+        1e+16, 1e+17, 1e+18, 1e+19, 1e+20, 1e+21, 1e+22
+    };
+    jimi_assert(n >= 0 && n <= 22);
+    return kPow10[n];
+}
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_POW10_H_ */
@@ -0,0 +1,141 @@
+
+#ifndef _JSONFX_INTERNAL_SKIPWHITESPACES_H_
+#define _JSONFX_INTERNAL_SKIPWHITESPACES_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Internal/CpuFeatures.h"
+#include "JsonFx/Internal/Utils.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+
+//
+// Input padding guarantee:
+//
+//   The input must be terminated by '\0' (it's not a whitespace, so all the
+//   kernels stop at it). The SIMD kernels only use the aligned loads, an aligned
+//   16 or 32 bytes block never crosses the page boundary, so reading the bytes
+//   before the src and after the '\0' in the same block is always safe, the input
+//   buffer needn't any extra padding bytes.
+//
+
+namespace JsonFx {
+
+namespace internal {
+
+// The whitespace chars including " \t\n\r"
+template <typename CharT>
+static inline
+bool IsWhiteSpace(CharT ch) {
+    return (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r');
+}
+
+template <typename CharT>
+static inline
+const CharT * SkipWhiteSpacesScalar(const CharT * src) {
+    while (IsWhiteSpace(*src)) {
+        ++src;
+    }
+    return src;
+}
+
+#if defined(JSONFX_SIMD_X86)
+
+JSONFX_NO_SANITIZE_ADDRESS
+static inline
+const char * SkipWhiteSpacesSSE2(const char * src) {
+    const __m128i kSpace = _mm_set1_epi8(' ');
+    const __m128i kTab   = _mm_set1_epi8('\t');
+    const __m128i kLF    = _mm_set1_epi8('\n');
+    const __m128i kCR    = _mm_set1_epi8('\r');
+
+    // Align down to 16 bytes, the bytes before src are masked out.
+    const char * p = reinterpret_cast<const char *>(reinterpret_cast<uintptr_t>(src) & ~static_cast<uintptr_t>(15));
+    uint32_t shift = static_cast<uint32_t>(src - p);
+    for (;;) {
+        __m128i s = _mm_load_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(s, kSpace), _mm_cmpeq_epi8(s, kTab)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(s, kLF),    _mm_cmpeq_epi8(s, kCR)));
+        // The bit is 1 if the char is not a whitespace.
+        uint32_t mask = (~static_cast<uint32_t>(_mm_movemask_epi8(ws)) & 0xFFFFU) >> shift;
+        if (mask != 0)
+            return (p + shift + CountTrailingZeros(mask));
+        p += 16;
+        shift = 0;
+    }
+}
+
+JSONFX_TARGET_AVX2 JSONFX_NO_SANITIZE_ADDRESS
+static inline
+const char * SkipWhiteSpacesAVX2(const char * src) {
+    // Lookup by the low nibble: ' ' = 0x20, '\t' = 0x09, '\n' = 0x0A, '\r' = 0x0D,
+    // the other entries never match a char with the same low nibble, and the
+    // chars >= 0x80 are shuffled to 0, so they never match too.
+    const __m256i kWhiteSpaces = _mm256_setr_epi8(
+        ' ', 0, 0, 0, 0, 0, 0, 0, 0, '\t', '\n', 0, 0, '\r', 0, 0,
+        ' ', 0, 0, 0, 0, 0, 0, 0, 0, '\t', '\n', 0, 0, '\r', 0, 0);
+
+    // Align down to 32 bytes, the bytes before src are masked out.
+    const char * p = reinterpret_cast<const char *>(reinterpret_cast<uintptr_t>(src) & ~static_cast<uintptr_t>(31));
+    uint32_t shift = static_cast<uint32_t>(src - p);
+    for (;;) {
+        __m256i s = _mm256_load_si256(reinterpret_cast<const __m256i *>(p));
+        __m256i ws = _mm256_cmpeq_epi8(_mm256_shuffle_epi8(kWhiteSpaces, s), s);
+        // The bit is 1 if the char is not a whitespace.
+        uint32_t mask = (~static_cast<uint32_t>(_mm256_movemask_epi8(ws))) >> shift;
+        if (mask != 0)
+            return (p + shift + CountTrailingZeros(mask));
+        p += 32;
+        shift = 0;
+    }
+}
+
+#endif  /* JSONFX_SIMD_X86 */
+
+typedef const char * (*SkipWhiteSpacesFunc)(const char * src);
+
+static inline
+SkipWhiteSpacesFunc SelectSkipWhiteSpaces() {
+#if defined(JSONFX_SIMD_X86)
+    if (HasCpuFeatures(kCpuFeatureAVX2Kernels))
+        return &SkipWhiteSpacesAVX2;
+    if (HasCpuFeatures(kCpuFeatureSSE2))
+        return &SkipWhiteSpacesSSE2;
+#endif
+    return &SkipWhiteSpacesScalar<char>;
+}
+
+static const SkipWhiteSpacesFunc gSkipWhiteSpacesFunc = SelectSkipWhiteSpaces();
+
+//
+// Skip the whitespaces, the kernel is selected by the CPU features before main().
+//
+template <typename CharT>
+static inline
+const CharT * SkipWhiteSpaces(const CharT * src) {
+    // The SIMD kernels only support the single byte chars.
+    return SkipWhiteSpacesScalar(src);
+}
+
+static inline
+const char * SkipWhiteSpaces(const char * src) {
+    // Most of the tokens are separated by zero or one whitespace, only
+    // the long runs (newlines and indents) are worth to dispatch to the kernel.
+    if (!IsWhiteSpace(*src))
+        return src;
+    ++src;
+    if (!IsWhiteSpace(*src))
+        return src;
+
+    return gSkipWhiteSpacesFunc(src + 1);
+}
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_SKIPWHITESPACES_H_ */
@@ -0,0 +1,217 @@
+
+#ifndef _JSONFX_INTERNAL_STRINGSCANNER_H_
+#define _JSONFX_INTERNAL_STRINGSCANNER_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Internal/CpuFeatures.h"
+#include "JsonFx/Internal/Utils.h"
+#include "JsonFx/Internal/Utf8Validator.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+
+//
+// Find the next special char of a string token: the quote, the backslash or
+// a control char (less than 0x20, including the '\0' terminator). The chars
+// before it are the plain chars, they can be copied as a whole run.
+//
+// The SIMD kernels only use the aligned loads, they never read across a page
+// boundary, see the padding guarantee in "JsonFx/Internal/SkipWhiteSpaces.h".
+//
+// ScanStringValidate() also validates the plain chars run as UTF-8 in the
+// same pass (see "JsonFx/Internal/Utf8Validator.h"). A multi-bytes sequence
+// can't contain the special chars, so each run is validated independently.
+//
+
+namespace JsonFx {
+
+namespace internal {
+
+template <typename CharT>
+static inline
+bool IsStringSpecialChar(CharT ch, CharT quote) {
+    return (ch == quote || ch == '\\' || static_cast<unsigned>(ch) < 0x20U);
+}
+
+template <typename CharT>
+static inline
+const CharT * ScanStringScalar(const CharT * src, CharT quote) {
+    while (!IsStringSpecialChar(*src, quote)) {
+        ++src;
+    }
+    return src;
+}
+
+#if defined(JSONFX_SIMD_X86)
+
+JSONFX_NO_SANITIZE_ADDRESS
+static inline
+const char * ScanStringSSE2(const char * src, char quote) {
+    const __m128i kQuote     = _mm_set1_epi8(quote);
+    const __m128i kBackslash = _mm_set1_epi8('\\');
+    const __m128i kCtrlMax   = _mm_set1_epi8(0x1F);
+
+    // Align down to 16 bytes, the bytes before src are masked out.
+    const char * p = reinterpret_cast<const char *>(reinterpret_cast<uintptr_t>(src) & ~static_cast<uintptr_t>(15));
+    uint32_t shift = static_cast<uint32_t>(src - p);
+    for (;;) {
+        __m128i s = _mm_load_si128(reinterpret_cast<const __m128i *>(p));
+        // (s <= 0x1F) is equal to (max(s, 0x1F) == 0x1F) for the unsigned bytes.
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(s, kQuote), _mm_cmpeq_epi8(s, kBackslash)),
+                                       _mm_cmpeq_epi8(_mm_max_epu8(s, kCtrlMax), kCtrlMax));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(special)) >> shift;
+        if (mask != 0)
+            return (p + shift + CountTrailingZeros(mask));
+        p += 16;
+        shift = 0;
+    }
+}
+
+JSONFX_TARGET_AVX2 JSONFX_NO_SANITIZE_ADDRESS
+static inline
+const char * ScanStringAVX2(const char * src, char quote) {
+    const __m256i kQuote     = _mm256_set1_epi8(quote);
+    const __m256i kBackslash = _mm256_set1_epi8('\\');
+    const __m256i kCtrlMax   = _mm256_set1_epi8(0x1F);
+
+    // Align down to 32 bytes, the bytes before src are masked out.
+    const char * p = reinterpret_cast<const char *>(reinterpret_cast<uintptr_t>(src) & ~static_cast<uintptr_t>(31));
+    uint32_t shift = static_cast<uint32_t>(src - p);
+    for (;;) {
+        __m256i s = _mm256_load_si256(reinterpret_cast<const __m256i *>(p));
+        // (s <= 0x1F) is equal to (max(s, 0x1F) == 0x1F) for the unsigned bytes.
+        __m256i special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(s, kQuote), _mm256_cmpeq_epi8(s, kBackslash)),
+                                          _mm256_cmpeq_epi8(_mm256_max_epu8(s, kCtrlMax), kCtrlMax));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(special)) >> shift;
+        if (mask != 0)
+            return (p + shift + CountTrailingZeros(mask));
+        p += 32;
+        shift = 0;
+    }
+}
+
+JSONFX_TARGET_AVX2 JSONFX_NO_SANITIZE_ADDRESS
+static inline
+const char * ScanStringValidateAVX2(const char * src, char quote, bool & valid) {
+    // The sliding window of the byte masks: loadu(kByteMasks + 32 - n) keeps
+    // the bytes from n, and loadu(kByteMasks + 64 - n) keeps the bytes before n.
+    static const char kByteMasks[96] = {
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+         0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
+    };
+    const __m256i kQuote     = _mm256_set1_epi8(quote);
+    const __m256i kBackslash = _mm256_set1_epi8('\\');
+    const __m256i kCtrlMax   = _mm256_set1_epi8(0x1F);
+
+    Utf8CheckerAVX2 checker;
+    InitUtf8CheckerAVX2(checker);
+
+    // Align down to 32 bytes, the bytes before src are masked out (as '\0'
+    // for the validator, it's ASCII).
+    const char * p = reinterpret_cast<const char *>(reinterpret_cast<uintptr_t>(src) & ~static_cast<uintptr_t>(31));
+    uint32_t shift = static_cast<uint32_t>(src - p);
+    __m256i keep = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(kByteMasks + 32 - shift));
+    for (;;) {
+        __m256i s = _mm256_load_si256(reinterpret_cast<const __m256i *>(p));
+        // (s <= 0x1F) is equal to (max(s, 0x1F) == 0x1F) for the unsigned bytes.
+        __m256i special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(s, kQuote), _mm256_cmpeq_epi8(s, kBackslash)),
+                                          _mm256_cmpeq_epi8(_mm256_max_epu8(s, kCtrlMax), kCtrlMax));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(special)) >> shift;
+        if (mask != 0) {
+            // The run ends at the special char, a sequence cut by it is incomplete.
+            uint32_t end = shift + CountTrailingZeros(mask);
+            keep = _mm256_and_si256(keep, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(kByteMasks + 64 - end)));
+            CheckUtf8BlockAVX2(checker, _mm256_and_si256(s, keep));
+            valid = IsUtf8ValidAVX2(checker);
+            return (p + end);
+        }
+        CheckUtf8BlockAVX2(checker, _mm256_and_si256(s, keep));
+        p += 32;
+        shift = 0;
+        keep = _mm256_set1_epi8(-1);
+    }
+}
+
+#endif  /* JSONFX_SIMD_X86 */
+
+typedef const char * (*ScanStringFunc)(const char * src, char quote);
+
+static inline
+ScanStringFunc SelectScanString() {
+#if defined(JSONFX_SIMD_X86)
+    if (HasCpuFeatures(kCpuFeatureAVX2Kernels))
+        return &ScanStringAVX2;
+    if (HasCpuFeatures(kCpuFeatureSSE2))
+        return &ScanStringSSE2;
+#endif
+    return &ScanStringScalar<char>;
+}
+
+static const ScanStringFunc gScanStringFunc = SelectScanString();
+
+//
+// Return the position of the first special char from src, the kernel is
+// selected by the CPU features before main().
+//
+template <typename CharT>
+static inline
+const CharT * ScanString(const CharT * src, CharT quote) {
+    // The SIMD kernels only support the single byte chars.
+    return ScanStringScalar(src, quote);
+}
+
+static inline
+const char * ScanString(const char * src, char quote) {
+    return gScanStringFunc(src, quote);
+}
+
+// Scan the string and validate the run, it's two passes, but the run is hot in the cache.
+template <typename CharT>
+static inline
+const CharT * ScanStringValidateScalar(const CharT * src, CharT quote, bool & valid) {
+    const CharT * special = ScanString(src, quote);
+    valid = (FindInvalidUtf8(src, special) == special);
+    return special;
+}
+
+typedef const char * (*ScanStringValidateFunc)(const char * src, char quote, bool & valid);
+
+static inline
+ScanStringValidateFunc SelectScanStringValidate() {
+#if defined(JSONFX_SIMD_X86)
+    if (HasCpuFeatures(kCpuFeatureAVX2Kernels))
+        return &ScanStringValidateAVX2;
+#endif
+    return &ScanStringValidateScalar<char>;
+}
+
+static const ScanStringValidateFunc gScanStringValidateFunc = SelectScanStringValidate();
+
+//
+// Same as ScanString(), and set valid to false if the chars before the
+// special char are not a valid UTF-8 string.
+//
+template <typename CharT>
+static inline
+const CharT * ScanStringValidate(const CharT * src, CharT quote, bool & valid) {
+    return ScanStringValidateScalar(src, quote, valid);
+}
+
+static inline
+const char * ScanStringValidate(const char * src, char quote, bool & valid) {
+    return gScanStringValidateFunc(src, quote, valid);
+}
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_STRINGSCANNER_H_ */
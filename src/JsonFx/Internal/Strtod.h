@@ -0,0 +1,376 @@
+
+#ifndef _JSONFX_INTERNAL_STRTOD_H_
+#define _JSONFX_INTERNAL_STRTOD_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include <string.h>
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Internal/CpuFeatures.h"
+#include "JsonFx/Internal/Pow10.h"
+#include "JsonFx/Internal/Pow5Table.h"
+#include "JsonFx/Internal/BigInteger.h"
+#include "JsonFx/Internal/Unicode.h"
+
+#include "jimi/basic/archdef.h"
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/stdsize.h"
+#include "jimi/basic/assert.h"
+
+#if defined(_MSC_VER) && (defined(JIMI_ARCH_X64) || defined(JIMI_ARCH_IA64))
+#include <intrin.h>     // For _umul128(), _BitScanReverse64()
+#endif
+
+//
+// The number engine, a decimal w * 10^q is converted to the nearest double by:
+//
+//   1. Clinger's fast path: w and 10^q are both exact doubles, so one IEEE
+//      multiplication or division gives the correctly rounded result.
+//   2. Eisel-Lemire: w (up to 19 digits) is multiplied by the 128-bit
+//      approximation of 5^q, it's exact for all the non-truncated w.
+//   3. Big integer: if the significand has more than 19 digits and the
+//      truncated w and w + 1 round differently, the exact decimal is
+//      compared with the halfway point of the two candidates.
+//
+
+namespace JsonFx {
+
+namespace internal {
+
+//
+// SWAR (SIMD within a register): test and parse 8 decimal digits at a time.
+//
+
+// Load 8 chars, return false if it may cross a page boundary, then the
+// caller must parse the digits one by one (see the padding guarantee in
+// "JsonFx/Internal/SkipWhiteSpaces.h").
+template <typename CharT>
+static inline
+bool LoadEightChars(const CharT * src, uint64_t & val) {
+    // The SWAR parsing only supports the single byte chars.
+    (void)src; (void)val;
+    return false;
+}
+
+JSONFX_NO_SANITIZE_ADDRESS
+static inline
+bool LoadEightChars(const char * src, uint64_t & val) {
+#if defined(JSONFX_LITTLE_ENDIAN)
+    // The SWAR digits parsing loads 8 chars as a little-endian uint64.
+    if ((reinterpret_cast<uintptr_t>(src) & (JSONFX_DEFAULT_PAGESIZE - 1)) > (JSONFX_DEFAULT_PAGESIZE - 8))
+        return false;
+    ::memcpy(&val, src, sizeof(val));
+    return true;
+#else
+    (void)src; (void)val;
+    return false;
+#endif
+}
+
+static inline
+bool IsEightDigits(uint64_t val) {
+    return (((val & UINT64_C(0xF0F0F0F0F0F0F0F0))
+            | (((val + UINT64_C(0x0606060606060606)) & UINT64_C(0xF0F0F0F0F0F0F0F0)) >> 4))
+            == UINT64_C(0x3333333333333333));
+}
+
+static inline
+uint32_t ParseEightDigits(uint64_t val) {
+    static const uint64_t kMask = UINT64_C(0x000000FF000000FF);
+    static const uint64_t kMul1 = UINT64_C(0x000F424000000064);     // 100 + (1000000ULL << 32)
+    static const uint64_t kMul2 = UINT64_C(0x0000271000000001);     // 1 + (10000ULL << 32)
+    val -= UINT64_C(0x3030303030303030);
+    val = (val * 10) + (val >> 8);      // val = (val * 2561) >> 8;
+    val = (((val & kMask) * kMul1) + (((val >> 16) & kMask) * kMul2)) >> 32;
+    return static_cast<uint32_t>(val);
+}
+
+//
+// 64 x 64 -> 128 bits multiplication.
+//
+struct UInt128 {
+    uint64_t low;
+    uint64_t high;
+};
+
+static inline
+UInt128 FullMultiply(uint64_t a, uint64_t b) {
+    UInt128 result;
+#if defined(_MSC_VER) && defined(JIMI_ARCH_X64)
+    result.low = _umul128(a, b, &result.high);
+#elif defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    result.low  = static_cast<uint64_t>(product);
+    result.high = static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t aLow = static_cast<uint32_t>(a), aHigh = a >> 32;
+    uint64_t bLow = static_cast<uint32_t>(b), bHigh = b >> 32;
+    uint64_t ll = aLow * bLow, lh = aLow * bHigh;
+    uint64_t hl = aHigh * bLow, hh = aHigh * bHigh;
+    uint64_t mid = (ll >> 32) + static_cast<uint32_t>(lh) + static_cast<uint32_t>(hl);
+    result.low  = (mid << 32) | static_cast<uint32_t>(ll);
+    result.high = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+#endif
+    return result;
+}
+
+static inline
+int CountLeadingZeros64(uint64_t x) {
+    jimi_assert(x != 0);
+#if defined(_MSC_VER) && defined(JIMI_ARCH_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return static_cast<int>(63 - index);
+#elif defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(x);
+#else
+    int n = 0;
+    while ((x & UINT64_C(0x8000000000000000)) == 0) {
+        x <<= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+//
+// The IEEE 754 binary64 fields: mantissa without the hidden bit, and the biased exponent.
+//
+struct AdjustedMantissa {
+    uint64_t    mantissa;
+    int32_t     power2;
+
+    bool operator == (const AdjustedMantissa & rhs) const {
+        return (mantissa == rhs.mantissa && power2 == rhs.power2);
+    }
+    bool operator != (const AdjustedMantissa & rhs) const {
+        return !(*this == rhs);
+    }
+};
+
+static const int      kMantissaExplicitBits = 52;
+static const int      kMinimumExponent      = -1023;
+static const int32_t  kInfinitePower        = 0x7FF;
+static const int      kMinExponentRoundToEven = -4;
+static const int      kMaxExponentRoundToEven = 23;
+
+static inline
+double ToDouble(bool negative, const AdjustedMantissa & am) {
+    uint64_t bits = am.mantissa | (static_cast<uint64_t>(am.power2) << kMantissaExplicitBits);
+    if (negative)
+        bits |= UINT64_C(0x8000000000000000);
+    double d;
+    ::memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+//
+// Clinger's fast path, return false if it can't be used.
+//
+static inline
+bool StrtodFastPath(uint64_t w, int q, double & result) {
+    static const uint64_t kMaxExactInteger = UINT64_C(1) << 53;
+    if (w > kMaxExactInteger || q < -22 || q > 22 + 15)
+        return false;
+
+    double d = static_cast<double>(w);
+    if (q < 0) {
+        result = d / Pow10(-q);
+    }
+    else if (q <= 22) {
+        result = d * Pow10(q);
+    }
+    else {
+        // Disguised fast path: move the exceeded exponent into the mantissa if it's still exact.
+        static const uint64_t kPow10Int[] = {
+            UINT64_C(1), UINT64_C(10), UINT64_C(100), UINT64_C(1000), UINT64_C(10000),
+            UINT64_C(100000), UINT64_C(1000000), UINT64_C(10000000), UINT64_C(100000000),
+            UINT64_C(1000000000), UINT64_C(10000000000), UINT64_C(100000000000),
+            UINT64_C(1000000000000), UINT64_C(10000000000000), UINT64_C(100000000000000),
+            UINT64_C(1000000000000000)
+        };
+        uint64_t scale = kPow10Int[q - 22];
+        if (w > kMaxExactInteger / scale)
+            return false;
+        result = static_cast<double>(w * scale) * Pow10(22);
+    }
+    return true;
+}
+
+//
+// Eisel-Lemire algorithm: compute the nearest double of w * 10^q, w can not be 0.
+// If power2 is kInfinitePower, it's overflow.
+//
+static inline
+AdjustedMantissa ComputeFloat(uint64_t w, int q) {
+    AdjustedMantissa answer;
+    if (w == 0 || q < kMinPow5Exponent) {
+        answer.mantissa = 0;
+        answer.power2   = 0;
+        return answer;
+    }
+    if (q > kMaxPow5Exponent) {
+        answer.mantissa = 0;
+        answer.power2   = kInfinitePower;
+        return answer;
+    }
+
+    int lz = CountLeadingZeros64(w);
+    w <<= lz;
+
+    // Compute the 128-bit product of w and 5^q, the second word is needed only
+    // if the low bits of the high word are all ones (it may carry).
+    static const int kBitPrecision = kMantissaExplicitBits + 3;
+    static const uint64_t kPrecisionMask = UINT64_C(0xFFFFFFFFFFFFFFFF) >> kBitPrecision;
+    const int index = 2 * (q - kMinPow5Exponent);
+    UInt128 product = FullMultiply(w, kPow5Table128[index]);
+    if ((product.high & kPrecisionMask) == kPrecisionMask) {
+        UInt128 second = FullMultiply(w, kPow5Table128[index + 1]);
+        product.low += second.high;
+        if (second.high > product.low)
+            product.high++;
+    }
+
+    int upperbit = static_cast<int>(product.high >> 63);
+    int shift = upperbit + 64 - kMantissaExplicitBits - 3;
+    answer.mantissa = product.high >> shift;
+    // power(q) = floor(q * log2(10)) + 63
+    int power = (((152170 + 65536) * q) >> 16) + 63;
+    answer.power2 = static_cast<int32_t>(power + upperbit - lz - kMinimumExponent);
+
+    if (answer.power2 <= 0) {
+        // It's a subnormal number.
+        if (-answer.power2 + 1 >= 64) {
+            answer.mantissa = 0;
+            answer.power2   = 0;
+            return answer;
+        }
+        answer.mantissa >>= -answer.power2 + 1;
+        answer.mantissa += (answer.mantissa & 1);
+        answer.mantissa >>= 1;
+        // It maybe become a normal number after rounding.
+        answer.power2 = (answer.mantissa < (UINT64_C(1) << kMantissaExplicitBits)) ? 0 : 1;
+        return answer;
+    }
+
+    // It's exactly halfway between two doubles, round to even.
+    if ((product.low <= 1) && (q >= kMinExponentRoundToEven) && (q <= kMaxExponentRoundToEven)
+        && ((answer.mantissa & 3) == 1)) {
+        if ((answer.mantissa << shift) == product.high)
+            answer.mantissa &= ~UINT64_C(1);
+    }
+
+    answer.mantissa += (answer.mantissa & 1);
+    answer.mantissa >>= 1;
+    if (answer.mantissa >= (UINT64_C(2) << kMantissaExplicitBits)) {
+        answer.mantissa = (UINT64_C(1) << kMantissaExplicitBits);
+        answer.power2++;
+    }
+    answer.mantissa &= ~(UINT64_C(1) << kMantissaExplicitBits);
+    if (answer.power2 >= kInfinitePower) {
+        answer.mantissa = 0;
+        answer.power2   = kInfinitePower;
+    }
+    return answer;
+}
+
+//
+// The slow path: compare the exact decimal with the halfway point between
+// the lower candidate and the next double, and return the correct one.
+//
+// The decimal is the digits of [intBegin, intEnd) and [fracBegin, fracEnd)
+// multiplied by 10^exp10 (the explicit exponent part).
+//
+template <typename CharT>
+static inline
+AdjustedMantissa DigitCompare(const CharT * intBegin, const CharT * intEnd,
+                              const CharT * fracBegin, const CharT * fracEnd,
+                              int exp10, AdjustedMantissa lower) {
+    // The max significant digits need to decide the rounding is 767,
+    // the dropped digits only affect the exact halfway case.
+    static const int kMaxDigits = 800;
+
+    BigInteger digits(0);
+    int numDigits = 0;
+    int scale = exp10;
+    bool sticky = false;
+    for (int part = 0; part < 2; ++part) {
+        const CharT * p   = (part == 0) ? intBegin : fracBegin;
+        const CharT * end = (part == 0) ? intEnd   : fracEnd;
+        for (; p < end; ++p) {
+            unsigned d = static_cast<unsigned>(*p - '0');
+            if (part == 1)
+                --scale;
+            if (numDigits == 0 && d == 0)
+                continue;   // Skip the leading zeros.
+            if (numDigits < kMaxDigits) {
+                digits.multiplySmall(10).addSmall(d);
+                ++numDigits;
+            }
+            else {
+                // The dropped digit, it's scale is compensated.
+                ++scale;
+                if (d != 0)
+                    sticky = true;
+            }
+        }
+    }
+
+    // The halfway point is (2 * m + 1) * 2^(e2 - 1).
+    uint64_t m;
+    int e2;
+    if (lower.power2 == 0) {
+        m  = lower.mantissa;
+        e2 = 1 - 1023 - kMantissaExplicitBits;
+    }
+    else {
+        m  = lower.mantissa | (UINT64_C(1) << kMantissaExplicitBits);
+        e2 = lower.power2 - 1023 - kMantissaExplicitBits;
+    }
+    BigInteger halfway(2 * m + 1);
+
+    // Compare digits * 5^scale * 2^scale with halfway * 2^(e2 - 1).
+    int digitsBin, halfwayBin;
+    if (scale >= 0) {
+        digits.multiplyPow5(static_cast<unsigned>(scale));
+        digitsBin  = scale;
+        halfwayBin = e2 - 1;
+    }
+    else {
+        halfway.multiplyPow5(static_cast<unsigned>(-scale));
+        digitsBin  = 0;
+        halfwayBin = e2 - 1 - scale;
+    }
+    if (digitsBin > halfwayBin)
+        digits.shiftLeft(static_cast<size_t>(digitsBin - halfwayBin));
+    else if (halfwayBin > digitsBin)
+        halfway.shiftLeft(static_cast<size_t>(halfwayBin - digitsBin));
+
+    int cmp = digits.compare(halfway);
+    bool roundUp;
+    if (cmp > 0)
+        roundUp = true;
+    else if (cmp < 0)
+        roundUp = false;
+    else
+        roundUp = (sticky || (m & 1) != 0);
+
+    if (roundUp) {
+        // The carry of mantissa increases the exponent, it's also right
+        // for the subnormal to normal and the max double to infinity.
+        uint64_t bits = lower.mantissa | (static_cast<uint64_t>(lower.power2) << kMantissaExplicitBits);
+        ++bits;
+        lower.mantissa = bits & ((UINT64_C(1) << kMantissaExplicitBits) - 1);
+        lower.power2   = static_cast<int32_t>(bits >> kMantissaExplicitBits);
+    }
+    return lower;
+}
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_STRTOD_H_ */
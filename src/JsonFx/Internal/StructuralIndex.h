@@ -0,0 +1,357 @@
+
+#ifndef _JSONFX_INTERNAL_STRUCTURALINDEX_H_
+#define _JSONFX_INTERNAL_STRUCTURALINDEX_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Internal/CpuFeatures.h"
+#include "JsonFx/Internal/Utils.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/stdsize.h"
+
+//
+// The stage 1 of the two-stage parsing (see kStructuralIndexParseFlag):
+//
+//   The whole buffer is classified by 64 chars blocks, and the offsets of
+//   all the tokens are written to an index:
+//
+//     - the structural chars "{}[]:," out of the strings,
+//     - the opening quotes of the strings,
+//     - the first char of the other tokens (numbers, literals or the invalid
+//       chars), it's the char after a whitespace or a structural char.
+//
+//   The escaped quotes are found by the odd backslash sequences, and the
+//   chars in the strings are masked out by the prefix xor of the quotes.
+//   The last offset of the index is always the '\0' terminator.
+//
+// The SIMD kernels only use the aligned loads, a 64 bytes aligned block never
+// crosses a page boundary, see the padding guarantee in "JsonFx/Internal/SkipWhiteSpaces.h".
+//
+
+namespace JsonFx {
+
+namespace internal {
+
+// The classified bitmaps of a block, the bit i is for the char i of the block.
+struct BlockBitmaps {
+    uint64_t    quote;
+    uint64_t    backslash;
+    uint64_t    op;             // The structural chars "{}[]:,"
+    uint64_t    whitespace;
+    uint64_t    terminator;     // The '\0' chars
+};
+
+// The bit i of result is the xor of the bits [0, i], it's 1 if the char i is in a string.
+static inline
+uint64_t PrefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+//
+// Find the chars in the strings from the quotes and backslashes bitmaps block
+// by block, the states of the previous block are carried to the next block.
+//
+class QuoteMaskScanner {
+private:
+    uint64_t    mPrevEndsOddBackslash;
+    uint64_t    mPrevInsideQuote;
+
+public:
+    QuoteMaskScanner() : mPrevEndsOddBackslash(0), mPrevInsideQuote(0) {}
+
+    // Start from a block whose first char is escaped by the previous backslashes.
+    QuoteMaskScanner(bool escaped) : mPrevEndsOddBackslash(escaped ? 1 : 0), mPrevInsideQuote(0) {}
+
+    // The count of the unescaped quotes scanned is odd.
+    bool isInsideQuote() const { return (mPrevInsideQuote != 0); }
+
+    //
+    // Return the quote mask, it includes the opening quote, but not the closing quote.
+    // The unescaped quotes are returned by quote.
+    //
+    uint64_t next(uint64_t backslash, uint64_t & quote) {
+        // Find the chars escaped by the odd length backslash sequences.
+        static const uint64_t kEvenBits = UINT64_C(0x5555555555555555);
+        static const uint64_t kOddBits  = ~kEvenBits;
+
+        uint64_t startEdges = backslash & ~(backslash << 1);
+        uint64_t evenStartMask = kEvenBits ^ mPrevEndsOddBackslash;
+        uint64_t evenStarts = startEdges & evenStartMask;
+        uint64_t oddStarts  = startEdges & ~evenStartMask;
+        uint64_t evenCarries = backslash + evenStarts;
+        uint64_t oddCarries  = backslash + oddStarts;
+        // The odd sequence continues to the next block if it's overflow.
+        bool endsOddBackslash = (oddCarries < backslash);
+        oddCarries |= mPrevEndsOddBackslash;
+        mPrevEndsOddBackslash = endsOddBackslash ? 1 : 0;
+        uint64_t evenCarryEnds = evenCarries & ~backslash;
+        uint64_t oddCarryEnds  = oddCarries & ~backslash;
+        uint64_t oddEnds = (evenCarryEnds & kOddBits) | (oddCarryEnds & kEvenBits);
+
+        quote &= ~oddEnds;
+        uint64_t quoteMask = PrefixXor(quote) ^ mPrevInsideQuote;
+        mPrevInsideQuote = static_cast<uint64_t>(static_cast<int64_t>(quoteMask) >> 63);
+        return quoteMask;
+    }
+};
+
+//
+// Find the structural chars from the classified bitmaps block by block,
+// the states of the previous block are carried to the next block.
+//
+class StructuralScanner {
+private:
+    QuoteMaskScanner    mQuoteScanner;
+    uint64_t            mPrevEndsPseudoPred;
+
+public:
+    StructuralScanner() : mQuoteScanner(), mPrevEndsPseudoPred(1) {}
+
+    uint64_t next(const BlockBitmaps & bm) {
+        uint64_t quote = bm.quote;
+        uint64_t quoteMask = mQuoteScanner.next(bm.backslash, quote);
+
+        uint64_t structurals = (bm.op & ~quoteMask) | quote;
+        // The char after a structural char or a whitespace starts a token.
+        uint64_t pseudoPred = structurals | bm.whitespace;
+        uint64_t shiftedPseudoPred = (pseudoPred << 1) | mPrevEndsPseudoPred;
+        mPrevEndsPseudoPred = pseudoPred >> 63;
+        uint64_t pseudoStructurals = shiftedPseudoPred & ~bm.whitespace & ~quoteMask;
+        structurals |= pseudoStructurals;
+        // Remove the closing quotes.
+        structurals &= ~(quote & ~quoteMask);
+        return structurals;
+    }
+};
+
+template <typename CharT>
+static inline
+void ClassifyChar(CharT ch, uint64_t bit, BlockBitmaps & bm) {
+    switch (ch) {
+    case '"':
+        bm.quote |= bit;
+        break;
+    case '\\':
+        bm.backslash |= bit;
+        break;
+    case '{': case '}': case '[': case ']': case ':': case ',':
+        bm.op |= bit;
+        break;
+    case ' ': case '\t': case '\n': case '\r':
+        bm.whitespace |= bit;
+        break;
+    case '\0':
+        bm.terminator |= bit;
+        break;
+    default:
+        break;
+    }
+}
+
+#if defined(JSONFX_SIMD_X86)
+
+JSONFX_NO_SANITIZE_ADDRESS
+static inline
+void ClassifyBlockSSE2(const char * block, BlockBitmaps & bm) {
+    const __m128i kQuote     = _mm_set1_epi8('"');
+    const __m128i kBackslash = _mm_set1_epi8('\\');
+    const __m128i kLowerCase = _mm_set1_epi8(0x20);
+    // '[' | 0x20 = '{', ']' | 0x20 = '}'
+    const __m128i kOpenBrace  = _mm_set1_epi8('{');
+    const __m128i kCloseBrace = _mm_set1_epi8('}');
+    const __m128i kColon     = _mm_set1_epi8(':');
+    const __m128i kComma     = _mm_set1_epi8(',');
+    const __m128i kSpace     = _mm_set1_epi8(' ');
+    const __m128i kTab       = _mm_set1_epi8('\t');
+    const __m128i kLF        = _mm_set1_epi8('\n');
+    const __m128i kCR        = _mm_set1_epi8('\r');
+    const __m128i kZero      = _mm_setzero_si128();
+
+    bm.quote = bm.backslash = bm.op = bm.whitespace = bm.terminator = 0;
+    for (int i = 0; i < 4; ++i) {
+        __m128i s = _mm_load_si128(reinterpret_cast<const __m128i *>(block + i * 16));
+        __m128i lower = _mm_or_si128(s, kLowerCase);
+        __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(lower, kOpenBrace), _mm_cmpeq_epi8(lower, kCloseBrace)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(s, kColon),         _mm_cmpeq_epi8(s, kComma)));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(s, kSpace), _mm_cmpeq_epi8(s, kTab)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(s, kLF),    _mm_cmpeq_epi8(s, kCR)));
+        int shift = i * 16;
+        bm.quote      |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(s, kQuote))) << shift;
+        bm.backslash  |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(s, kBackslash))) << shift;
+        bm.op         |= static_cast<uint64_t>(_mm_movemask_epi8(op)) << shift;
+        bm.whitespace |= static_cast<uint64_t>(_mm_movemask_epi8(ws)) << shift;
+        bm.terminator |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(s, kZero))) << shift;
+    }
+}
+
+JSONFX_TARGET_AVX2 JSONFX_NO_SANITIZE_ADDRESS
+static inline
+void ClassifyBlockAVX2(const char * block, BlockBitmaps & bm) {
+    const __m256i kQuote     = _mm256_set1_epi8('"');
+    const __m256i kBackslash = _mm256_set1_epi8('\\');
+    const __m256i kLowerCase = _mm256_set1_epi8(0x20);
+    // '[' | 0x20 = '{', ']' | 0x20 = '}'
+    const __m256i kOpenBrace  = _mm256_set1_epi8('{');
+    const __m256i kCloseBrace = _mm256_set1_epi8('}');
+    const __m256i kColon     = _mm256_set1_epi8(':');
+    const __m256i kComma     = _mm256_set1_epi8(',');
+    const __m256i kZero      = _mm256_setzero_si256();
+    // Lookup the whitespaces by the low nibble, see SkipWhiteSpacesAVX2().
+    const __m256i kWhiteSpaces = _mm256_setr_epi8(
+        ' ', 0, 0, 0, 0, 0, 0, 0, 0, '\t', '\n', 0, 0, '\r', 0, 0,
+        ' ', 0, 0, 0, 0, 0, 0, 0, 0, '\t', '\n', 0, 0, '\r', 0, 0);
+
+    bm.quote = bm.backslash = bm.op = bm.whitespace = bm.terminator = 0;
+    for (int i = 0; i < 2; ++i) {
+        __m256i s = _mm256_load_si256(reinterpret_cast<const __m256i *>(block + i * 32));
+        __m256i lower = _mm256_or_si256(s, kLowerCase);
+        __m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(lower, kOpenBrace), _mm256_cmpeq_epi8(lower, kCloseBrace)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(s, kColon),         _mm256_cmpeq_epi8(s, kComma)));
+        __m256i ws = _mm256_cmpeq_epi8(_mm256_shuffle_epi8(kWhiteSpaces, s), s);
+        int shift = i * 32;
+        bm.quote      |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(s, kQuote)))) << shift;
+        bm.backslash  |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(s, kBackslash)))) << shift;
+        bm.op         |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(op))) << shift;
+        bm.whitespace |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(ws))) << shift;
+        bm.terminator |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(s, kZero)))) << shift;
+    }
+}
+
+#endif  /* JSONFX_SIMD_X86 */
+
+//
+// Write the offsets of the set bits, the stack must have 64 free items.
+//
+static inline
+uint32_t * FlattenBits(uint32_t * out, uint32_t offset, uint64_t bits) {
+    while (bits != 0) {
+        *out++ = offset + CountTrailingZeros64(bits);
+        bits &= bits - 1;
+    }
+    return out;
+}
+
+template <typename StackT>
+static inline
+void AppendIndexes(StackT & indexes, uint32_t offset, uint64_t bits) {
+    uint32_t * out = indexes.template push<uint32_t>(64);
+    uint32_t * last = FlattenBits(out, offset, bits);
+    indexes.template pop<uint32_t>(64 - static_cast<size_t>(last - out));
+}
+
+// The max offset can be stored in the uint32_t index.
+static const size_t kMaxStructuralOffset = 0xFFFFFFC0UL;
+
+//
+// Build the structural index of the '\0' terminated string from begin,
+// the offsets are relative to begin. Return false if the string is too
+// long (more than 4 GB) for the index.
+//
+template <typename CharT, typename StackT>
+static inline
+bool BuildStructuralIndex(const CharT * begin, StackT & indexes) {
+    // The scalar classifier, it never reads over the '\0' terminator.
+    StructuralScanner scanner;
+    const CharT * p = begin;
+    for (;;) {
+        BlockBitmaps bm = { 0, 0, 0, 0, 0 };
+        for (int i = 0; i < 64; ++i) {
+            ClassifyChar(p[i], UINT64_C(1) << i, bm);
+            if (p[i] == '\0')
+                break;
+        }
+
+        size_t offset = static_cast<size_t>(p - begin);
+        if (offset > kMaxStructuralOffset)
+            return false;
+
+        uint64_t structurals = scanner.next(bm);
+        if (bm.terminator != 0) {
+            uint32_t last = CountTrailingZeros64(bm.terminator);
+            // The chars after the terminator are not the part of string.
+            structurals &= ((bm.terminator & (0 - bm.terminator)) - 1);
+            AppendIndexes(indexes, static_cast<uint32_t>(offset), structurals);
+            *indexes.template push<uint32_t>() = static_cast<uint32_t>(offset + last);
+            return true;
+        }
+        AppendIndexes(indexes, static_cast<uint32_t>(offset), structurals);
+        p += 64;
+    }
+}
+
+#if defined(JSONFX_SIMD_X86)
+
+typedef void (*ClassifyBlockFunc)(const char * block, BlockBitmaps & bm);
+
+static inline
+ClassifyBlockFunc SelectClassifyBlock() {
+    if (HasCpuFeatures(kCpuFeatureAVX2Kernels))
+        return &ClassifyBlockAVX2;
+    if (HasCpuFeatures(kCpuFeatureSSE2))
+        return &ClassifyBlockSSE2;
+    return NULL;
+}
+
+static const ClassifyBlockFunc gClassifyBlockFunc = SelectClassifyBlock();
+
+template <typename StackT>
+static inline
+bool BuildStructuralIndex(const char * begin, StackT & indexes) {
+    const ClassifyBlockFunc classifyBlockFunc = gClassifyBlockFunc;
+    if (classifyBlockFunc == NULL)
+        return BuildStructuralIndex<char, StackT>(begin, indexes);
+
+    // Align down to 64 bytes, the chars before begin are treated as the whitespaces.
+    const char * p = reinterpret_cast<const char *>(reinterpret_cast<uintptr_t>(begin) & ~static_cast<uintptr_t>(63));
+    uint32_t shift = static_cast<uint32_t>(begin - p);
+    uint64_t leadingMask = (UINT64_C(1) << shift) - 1;
+
+    StructuralScanner scanner;
+    for (;;) {
+        BlockBitmaps bm;
+        classifyBlockFunc(p, bm);
+        bm.quote      &= ~leadingMask;
+        bm.backslash  &= ~leadingMask;
+        bm.op         &= ~leadingMask;
+        bm.terminator &= ~leadingMask;
+        bm.whitespace |= leadingMask;
+
+        // The offset of the block can be negative (a little before begin),
+        // but the offsets of the structural chars never.
+        size_t offset = static_cast<size_t>(p - begin);
+        if (p >= begin && offset > kMaxStructuralOffset)
+            return false;
+
+        uint64_t structurals = scanner.next(bm);
+        if (bm.terminator != 0) {
+            uint32_t last = CountTrailingZeros64(bm.terminator);
+            // The chars after the terminator are not the part of string.
+            structurals &= ((bm.terminator & (0 - bm.terminator)) - 1);
+            AppendIndexes(indexes, static_cast<uint32_t>(offset), structurals);
+            *indexes.template push<uint32_t>() = static_cast<uint32_t>(offset + last);
+            return true;
+        }
+        AppendIndexes(indexes, static_cast<uint32_t>(offset), structurals);
+        p += 64;
+        leadingMask = 0;
+    }
+}
+
+#endif  /* JSONFX_SIMD_X86 */
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_STRUCTURALINDEX_H_ */
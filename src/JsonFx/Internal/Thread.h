@@ -0,0 +1,399 @@
+
+#ifndef _JSONFX_INTERNAL_THREAD_H_
+#define _JSONFX_INTERNAL_THREAD_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/assert.h"
+
+#if defined(_WIN32) || defined(WIN32) || defined(__WIN32__)
+  #define JSONFX_THREAD_WIN32   1
+#endif
+
+#if defined(JSONFX_THREAD_WIN32)
+  #define JSONFX_THREAD_CALLBACK    WINAPI
+#else
+  #define JSONFX_THREAD_CALLBACK
+#endif
+
+#if defined(JSONFX_THREAD_WIN32)
+  #ifndef WIN32_LEAN_AND_MEAN
+  #define WIN32_LEAN_AND_MEAN
+  #endif
+  #include <windows.h>
+  #include <process.h>      // For _beginthreadex()
+#else
+  #include <pthread.h>
+  #include <unistd.h>       // For sysconf()
+#endif
+
+//
+// The minimal threads for the parallel parsing, only start and join, the
+// atomic flag, the atomic counter and pointer, the thread local pointer, the
+// mutex and the condition (Windows Vista or later, or pthread).
+// The jimi::Thread is not used, it's a heavy class with the logging.
+//
+
+namespace JsonFx {
+
+namespace internal {
+
+// Return the count of the online logical processors, at least 1.
+static inline
+size_t GetProcessorCount() {
+#if defined(JSONFX_THREAD_WIN32)
+    SYSTEM_INFO info;
+    ::GetSystemInfo(&info);
+    size_t count = static_cast<size_t>(info.dwNumberOfProcessors);
+#else
+    long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+    size_t count = (n > 0) ? static_cast<size_t>(n) : 1;
+#endif
+    return (count != 0) ? count : 1;
+}
+
+// A flag can be read without the lock, with the acquire and release order.
+class AtomicFlag {
+private:
+    volatile long   mValue;
+
+public:
+    AtomicFlag() : mValue(0) {}
+
+    bool get() const {
+#if defined(_MSC_VER)
+        // The volatile access has the acquire semantics on MSVC.
+        return (mValue != 0);
+#else
+        return (__atomic_load_n(&mValue, __ATOMIC_ACQUIRE) != 0);
+#endif
+    }
+
+    void set(bool value) {
+#if defined(JSONFX_THREAD_WIN32)
+        ::InterlockedExchange(&mValue, value ? 1 : 0);
+#else
+        __atomic_store_n(&mValue, value ? 1 : 0, __ATOMIC_RELEASE);
+#endif
+    }
+
+private:
+    //! Prohibit copying
+    AtomicFlag(const AtomicFlag &);
+    //! Prohibit assignment
+    AtomicFlag & operator =(const AtomicFlag &);
+};
+
+// The reference counter, the changes have the full barrier.
+class AtomicCounter {
+private:
+    volatile long   mValue;
+
+public:
+    AtomicCounter(long value = 0) : mValue(value) {}
+
+    // Return the new value.
+    long increment() {
+#if defined(JSONFX_THREAD_WIN32)
+        return ::InterlockedIncrement(&mValue);
+#else
+        return __atomic_add_fetch(&mValue, 1, __ATOMIC_SEQ_CST);
+#endif
+    }
+
+    // Return the new value.
+    long decrement() {
+#if defined(JSONFX_THREAD_WIN32)
+        return ::InterlockedDecrement(&mValue);
+#else
+        return __atomic_sub_fetch(&mValue, 1, __ATOMIC_SEQ_CST);
+#endif
+    }
+
+private:
+    //! Prohibit copying
+    AtomicCounter(const AtomicCounter &);
+    //! Prohibit assignment
+    AtomicCounter & operator =(const AtomicCounter &);
+};
+
+// Read the pointer with the acquire order.
+static inline
+void * AtomicLoadPointer(void * volatile const * target) {
+#if defined(_MSC_VER)
+    // The volatile access has the acquire semantics on MSVC.
+    return *target;
+#else
+    return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Return the old value, with the full barrier.
+static inline
+void * AtomicExchangePointer(void * volatile * target, void * value) {
+#if defined(JSONFX_THREAD_WIN32)
+    return ::InterlockedExchangePointer(target, value);
+#else
+    return __atomic_exchange_n(target, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Return true if the target was expected and it's changed to value, with the full barrier.
+static inline
+bool AtomicCompareExchangePointer(void * volatile * target, void * expected, void * value) {
+#if defined(JSONFX_THREAD_WIN32)
+    return (::InterlockedCompareExchangePointer(target, value, expected) == expected);
+#else
+    return __atomic_compare_exchange_n(target, &expected, value, false,
+                                       __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+//
+// A pointer for each thread, the destructor is called with the non-null
+// pointer when a thread exits (FLS on Windows, the pthread key otherwise).
+//
+class ThreadLocalPtr {
+public:
+    typedef void (JSONFX_THREAD_CALLBACK * DestructorFunc)(void * ptr);
+
+private:
+#if defined(JSONFX_THREAD_WIN32)
+    DWORD           mKey;
+#else
+    pthread_key_t   mKey;
+#endif
+
+public:
+    ThreadLocalPtr(DestructorFunc destructor = NULL) {
+#if defined(JSONFX_THREAD_WIN32)
+        mKey = ::FlsAlloc(destructor);
+        jimi_assert(mKey != FLS_OUT_OF_INDEXES);
+#else
+        int result = ::pthread_key_create(&mKey, destructor);
+        jimi_assert(result == 0);
+        (void)result;
+#endif
+    }
+
+    ~ThreadLocalPtr() {
+#if defined(JSONFX_THREAD_WIN32)
+        ::FlsFree(mKey);
+#else
+        ::pthread_key_delete(mKey);
+#endif
+    }
+
+private:
+    //! Prohibit copying
+    ThreadLocalPtr(const ThreadLocalPtr &);
+    //! Prohibit assignment
+    ThreadLocalPtr & operator =(const ThreadLocalPtr &);
+
+public:
+    void * get() const {
+#if defined(JSONFX_THREAD_WIN32)
+        return ::FlsGetValue(mKey);
+#else
+        return ::pthread_getspecific(mKey);
+#endif
+    }
+
+    void set(void * ptr) {
+#if defined(JSONFX_THREAD_WIN32)
+        ::FlsSetValue(mKey, ptr);
+#else
+        ::pthread_setspecific(mKey, ptr);
+#endif
+    }
+};
+
+class Mutex {
+private:
+#if defined(JSONFX_THREAD_WIN32)
+    CRITICAL_SECTION    mMutex;
+#else
+    pthread_mutex_t     mMutex;
+#endif
+    friend class Condition;
+
+public:
+    Mutex() {
+#if defined(JSONFX_THREAD_WIN32)
+        ::InitializeCriticalSection(&mMutex);
+#else
+        ::pthread_mutex_init(&mMutex, NULL);
+#endif
+    }
+
+    ~Mutex() {
+#if defined(JSONFX_THREAD_WIN32)
+        ::DeleteCriticalSection(&mMutex);
+#else
+        ::pthread_mutex_destroy(&mMutex);
+#endif
+    }
+
+private:
+    //! Prohibit copying
+    Mutex(const Mutex &);
+    //! Prohibit assignment
+    Mutex & operator =(const Mutex &);
+
+public:
+    void lock() {
+#if defined(JSONFX_THREAD_WIN32)
+        ::EnterCriticalSection(&mMutex);
+#else
+        ::pthread_mutex_lock(&mMutex);
+#endif
+    }
+
+    void unlock() {
+#if defined(JSONFX_THREAD_WIN32)
+        ::LeaveCriticalSection(&mMutex);
+#else
+        ::pthread_mutex_unlock(&mMutex);
+#endif
+    }
+};
+
+// Lock the mutex in the scope.
+class ScopedLock {
+private:
+    Mutex & mMutex;
+
+public:
+    ScopedLock(Mutex & mutex) : mMutex(mutex) { mMutex.lock(); }
+    ~ScopedLock() { mMutex.unlock(); }
+
+private:
+    //! Prohibit copying
+    ScopedLock(const ScopedLock &);
+    //! Prohibit assignment
+    ScopedLock & operator =(const ScopedLock &);
+};
+
+class Condition {
+private:
+#if defined(JSONFX_THREAD_WIN32)
+    CONDITION_VARIABLE  mCond;
+#else
+    pthread_cond_t      mCond;
+#endif
+
+public:
+    Condition() {
+#if defined(JSONFX_THREAD_WIN32)
+        ::InitializeConditionVariable(&mCond);
+#else
+        ::pthread_cond_init(&mCond, NULL);
+#endif
+    }
+
+    ~Condition() {
+#if !defined(JSONFX_THREAD_WIN32)
+        ::pthread_cond_destroy(&mCond);
+#endif
+    }
+
+private:
+    //! Prohibit copying
+    Condition(const Condition &);
+    //! Prohibit assignment
+    Condition & operator =(const Condition &);
+
+public:
+    // The mutex must be locked, maybe wake up spuriously.
+    void wait(Mutex & mutex) {
+#if defined(JSONFX_THREAD_WIN32)
+        ::SleepConditionVariableCS(&mCond, &mutex.mMutex, INFINITE);
+#else
+        ::pthread_cond_wait(&mCond, &mutex.mMutex);
+#endif
+    }
+
+    void notifyAll() {
+#if defined(JSONFX_THREAD_WIN32)
+        ::WakeAllConditionVariable(&mCond);
+#else
+        ::pthread_cond_broadcast(&mCond);
+#endif
+    }
+};
+
+//
+// Run the run() method of a RunnableT object in a new thread,
+// the thread must be joined before the object is destroyed.
+//
+class Thread {
+private:
+#if defined(JSONFX_THREAD_WIN32)
+    HANDLE      mHandle;
+#else
+    pthread_t   mHandle;
+#endif
+    bool        mStarted;
+
+public:
+    Thread() : mHandle(), mStarted(false) {}
+    ~Thread() { jimi_assert(!mStarted); }
+
+private:
+    //! Prohibit copying
+    Thread(const Thread &);
+    //! Prohibit assignment
+    Thread & operator =(const Thread &);
+
+    template <typename RunnableT>
+#if defined(JSONFX_THREAD_WIN32)
+    static unsigned __stdcall threadProc(void * runnable) {
+        static_cast<RunnableT *>(runnable)->run();
+        return 0;
+    }
+#else
+    static void * threadProc(void * runnable) {
+        static_cast<RunnableT *>(runnable)->run();
+        return NULL;
+    }
+#endif
+
+public:
+    // Return false if the thread can't be created.
+    template <typename RunnableT>
+    bool start(RunnableT * runnable) {
+        jimi_assert(!mStarted);
+#if defined(JSONFX_THREAD_WIN32)
+        mHandle = reinterpret_cast<HANDLE>(::_beginthreadex(NULL, 0,
+            &Thread::threadProc<RunnableT>, runnable, 0, NULL));
+        mStarted = (mHandle != NULL);
+#else
+        mStarted = (::pthread_create(&mHandle, NULL,
+            &Thread::threadProc<RunnableT>, runnable) == 0);
+#endif
+        return mStarted;
+    }
+
+    void join() {
+        if (mStarted) {
+#if defined(JSONFX_THREAD_WIN32)
+            ::WaitForSingleObject(mHandle, INFINITE);
+            ::CloseHandle(mHandle);
+#else
+            ::pthread_join(mHandle, NULL);
+#endif
+            mStarted = false;
+        }
+    }
+};
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_THREAD_H_ */
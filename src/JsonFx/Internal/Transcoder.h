@@ -0,0 +1,246 @@
+
+#ifndef _JSONFX_INTERNAL_TRANSCODER_H_
+#define _JSONFX_INTERNAL_TRANSCODER_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include <string.h>
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Internal/CpuFeatures.h"
+#include "JsonFx/Internal/Traits.h"
+#include "JsonFx/Internal/Unicode.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/stdsize.h"
+
+//
+// Transcode the plain chars runs of the strings from the source encoding to
+// the target encoding. The same encodings are copied by memcpy(), otherwise
+// the leading ASCII blocks are widened or narrowed by the SSE2 kernels, and
+// the rest are decoded and encoded one code point by one code point, an
+// invalid sequence is replaced by U+FFFD.
+//
+// The runs are bounded (the end is known), so the kernels only use the
+// unaligned loads and never read beyond the end.
+//
+
+namespace JsonFx {
+
+namespace internal {
+
+//
+// The ASCII kernels of the (SourceUnitSize, TargetUnitSize) pair, they advance
+// dest and src over the leading 16 chars ASCII blocks. If NeedSwap is true,
+// the units of the wide side are stored in the non-host byte order.
+//
+template <size_t SourceUnitSize, size_t TargetUnitSize>
+struct AsciiTranscoder {
+    template <bool NeedSwap, typename TargetCharT, typename SourceCharT>
+    static void transcode(TargetCharT *& dest, const SourceCharT *& src, const SourceCharT * end) {
+        // No kernel, all the chars are transcoded by the scalar loop.
+        (void)dest; (void)src; (void)end;
+    }
+};
+
+#if defined(JSONFX_SIMD_X86)
+
+static const bool gHasAsciiTranscoderSSE2 = HasCpuFeatures(kCpuFeatureSSE2);
+
+static inline
+bool HasAsciiTranscoderSSE2() {
+    return gHasAsciiTranscoderSSE2;
+}
+
+// UTF-8 to UTF-16: unpack the bytes with the zeros.
+template <>
+struct AsciiTranscoder<1, 2> {
+    template <bool NeedSwap, typename TargetCharT, typename SourceCharT>
+    static void transcode(TargetCharT *& dest, const SourceCharT *& src, const SourceCharT * end) {
+        if (!HasAsciiTranscoderSSE2())
+            return;
+        const __m128i kZero = _mm_setzero_si128();
+        while (end - src >= 16) {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+            if (_mm_movemask_epi8(s) != 0)
+                break;
+            __m128i lo = NeedSwap ? _mm_unpacklo_epi8(kZero, s) : _mm_unpacklo_epi8(s, kZero);
+            __m128i hi = NeedSwap ? _mm_unpackhi_epi8(kZero, s) : _mm_unpackhi_epi8(s, kZero);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), lo);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + 8), hi);
+            src += 16;
+            dest += 16;
+        }
+    }
+};
+
+// UTF-8 to UTF-32: unpack the bytes with the zeros twice.
+template <>
+struct AsciiTranscoder<1, 4> {
+    template <bool NeedSwap, typename TargetCharT, typename SourceCharT>
+    static void transcode(TargetCharT *& dest, const SourceCharT *& src, const SourceCharT * end) {
+        if (!HasAsciiTranscoderSSE2())
+            return;
+        const __m128i kZero = _mm_setzero_si128();
+        while (end - src >= 16) {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+            if (_mm_movemask_epi8(s) != 0)
+                break;
+            __m128i lo = NeedSwap ? _mm_unpacklo_epi8(kZero, s) : _mm_unpacklo_epi8(s, kZero);
+            __m128i hi = NeedSwap ? _mm_unpackhi_epi8(kZero, s) : _mm_unpackhi_epi8(s, kZero);
+            __m128i u0 = NeedSwap ? _mm_unpacklo_epi16(kZero, lo) : _mm_unpacklo_epi16(lo, kZero);
+            __m128i u1 = NeedSwap ? _mm_unpackhi_epi16(kZero, lo) : _mm_unpackhi_epi16(lo, kZero);
+            __m128i u2 = NeedSwap ? _mm_unpacklo_epi16(kZero, hi) : _mm_unpacklo_epi16(hi, kZero);
+            __m128i u3 = NeedSwap ? _mm_unpackhi_epi16(kZero, hi) : _mm_unpackhi_epi16(hi, kZero);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest),      u0);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + 4),  u1);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + 8),  u2);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest + 12), u3);
+            src += 16;
+            dest += 16;
+        }
+    }
+};
+
+// UTF-16 to UTF-8: all the units are less than 0x80, pack them with the saturation.
+template <>
+struct AsciiTranscoder<2, 1> {
+    template <bool NeedSwap, typename TargetCharT, typename SourceCharT>
+    static void transcode(TargetCharT *& dest, const SourceCharT *& src, const SourceCharT * end) {
+        if (!HasAsciiTranscoderSSE2())
+            return;
+        const __m128i kZero    = _mm_setzero_si128();
+        const __m128i kNonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+        while (end - src >= 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 8));
+            if (NeedSwap) {
+                a = _mm_or_si128(_mm_slli_epi16(a, 8), _mm_srli_epi16(a, 8));
+                b = _mm_or_si128(_mm_slli_epi16(b, 8), _mm_srli_epi16(b, 8));
+            }
+            __m128i nonAscii = _mm_and_si128(_mm_or_si128(a, b), kNonAscii);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonAscii, kZero)) != 0xFFFF)
+                break;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), _mm_packus_epi16(a, b));
+            src += 16;
+            dest += 16;
+        }
+    }
+};
+
+// UTF-32 to UTF-8: all the units are less than 0x80, pack them twice.
+template <>
+struct AsciiTranscoder<4, 1> {
+    static inline
+    __m128i byteSwap32(__m128i v) {
+        __m128i kMask = _mm_set1_epi32(0x0000FF00);
+        return _mm_or_si128(_mm_or_si128(_mm_slli_epi32(v, 24), _mm_srli_epi32(v, 24)),
+                            _mm_or_si128(_mm_slli_epi32(_mm_and_si128(v, kMask), 8),
+                                         _mm_and_si128(_mm_srli_epi32(v, 8), kMask)));
+    }
+
+    template <bool NeedSwap, typename TargetCharT, typename SourceCharT>
+    static void transcode(TargetCharT *& dest, const SourceCharT *& src, const SourceCharT * end) {
+        if (!HasAsciiTranscoderSSE2())
+            return;
+        const __m128i kZero     = _mm_setzero_si128();
+        const __m128i kNonAscii = _mm_set1_epi32(static_cast<int>(0xFFFFFF80U));
+        while (end - src >= 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 4));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 8));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 12));
+            if (NeedSwap) {
+                a = byteSwap32(a);
+                b = byteSwap32(b);
+                c = byteSwap32(c);
+                d = byteSwap32(d);
+            }
+            __m128i nonAscii = _mm_and_si128(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)), kNonAscii);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(nonAscii, kZero)) != 0xFFFF)
+                break;
+            // The units are less than 0x80, so the signed saturation is harmless.
+            __m128i ab = _mm_packs_epi32(a, b);
+            __m128i cd = _mm_packs_epi32(c, d);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), _mm_packus_epi16(ab, cd));
+            src += 16;
+            dest += 16;
+        }
+    }
+};
+
+#endif  /* JSONFX_SIMD_X86 */
+
+//
+// The transcoder from SourceEncodingT to TargetEncodingT, the encodings are
+// the BasicEncoding<CharT, EncodingType> (see "JsonFx/CharSet.h").
+//
+template <typename SourceEncodingT, typename TargetEncodingT>
+struct Transcoder {
+    typedef typename SourceEncodingT::CharType  SourceCharType;
+    typedef typename TargetEncodingT::CharType  TargetCharType;
+
+    // The source chars can be copied as they are.
+    static const bool kTransparent = (SourceEncodingT::kUnitSize == TargetEncodingT::kUnitSize)
+                                  && (SourceEncodingT::kBigEndian == TargetEncodingT::kBigEndian)
+                                  && (sizeof(SourceCharType) == sizeof(TargetCharType));
+
+    // The source chars can be used as the target chars in place (kInsituParseFlag).
+    static const bool kInsitu = kTransparent && IsSame<SourceCharType, TargetCharType>::Value;
+
+    //
+    // The max target units of a source unit: a UTF-16 unit (a BMP char or
+    // an invalid surrogate) is 3 bytes in UTF-8, and a UTF-32 unit is 4
+    // bytes in UTF-8 or 2 units in UTF-16, the others are 1 unit at most.
+    //
+    static const size_t kMaxExpansion =
+        (TargetEncodingT::kUnitSize == 1) ? ((SourceEncodingT::kUnitSize == 1) ? 1 :
+                                            ((SourceEncodingT::kUnitSize == 2) ? 3 : 4)) :
+        (TargetEncodingT::kUnitSize == 2) ? ((SourceEncodingT::kUnitSize == 4) ? 2 : 1) : 1;
+
+private:
+    // The ASCII kernels need the chars have the same size as the code units.
+    static const size_t kSourceKernelSize = (sizeof(SourceCharType) == SourceEncodingT::kUnitSize)
+                                          ? SourceEncodingT::kUnitSize : 0;
+    static const size_t kTargetKernelSize = (sizeof(TargetCharType) == TargetEncodingT::kUnitSize)
+                                          ? TargetEncodingT::kUnitSize : 0;
+    static const bool   kKernelNeedSwap   = SourceEncodingT::kNeedSwap || TargetEncodingT::kNeedSwap;
+
+    static TargetCharType * transcodeRunImpl(TargetCharType * dest, const SourceCharType * src,
+                                             const SourceCharType * end, TrueType /* kTransparent */) {
+        size_t len = static_cast<size_t>(end - src);
+        ::memcpy(dest, src, len * sizeof(TargetCharType));
+        return (dest + len);
+    }
+
+    static TargetCharType * transcodeRunImpl(TargetCharType * dest, const SourceCharType * src,
+                                             const SourceCharType * end, FalseType /* kTransparent */) {
+        AsciiTranscoder<kSourceKernelSize, kTargetKernelSize>::template transcode<kKernelNeedSwap>(dest, src, end);
+        while (src < end) {
+            unsigned codepoint;
+            if (!SourceEncodingT::decode(src, end, codepoint))
+                codepoint = kReplacementCodePoint;
+            TargetEncodingT::encode(dest, codepoint);
+        }
+        return dest;
+    }
+
+public:
+    //
+    // Transcode the chars in [src, end) to dest, return the end of dest.
+    // The dest must have (end - src) * kMaxExpansion units at least.
+    //
+    static TargetCharType * transcodeRun(TargetCharType * dest, const SourceCharType * src,
+                                         const SourceCharType * end) {
+        return transcodeRunImpl(dest, src, end, BoolType<kTransparent>());
+    }
+};
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_TRANSCODER_H_ */
@@ -0,0 +1,257 @@
+
+#ifndef _JSONFX_INTERNAL_UNICODE_H_
+#define _JSONFX_INTERNAL_UNICODE_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "jimi/basic/archdef.h"
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/stdsize.h"
+
+//
+// The byte order of the host, the code units of UTF-16 and UTF-32 without
+// the LE / BE suffix are stored in the host byte order.
+//
+#if defined(JIMI_ARCH_X86) || defined(JIMI_ARCH_X64) || defined(_MSC_VER) \
+    || (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__))
+  #define JSONFX_LITTLE_ENDIAN      1
+#endif
+
+namespace JsonFx {
+
+namespace internal {
+
+static inline
+uint16_t ByteSwap16(uint16_t x) {
+    return static_cast<uint16_t>((x << 8) | (x >> 8));
+}
+
+static inline
+uint32_t ByteSwap32(uint32_t x) {
+    return ((x << 24) | ((x & 0x0000FF00U) << 8) | ((x & 0x00FF0000U) >> 8) | (x >> 24));
+}
+
+// The replacement char for the invalid sequences.
+static const unsigned kReplacementCodePoint = 0xFFFDU;
+
+//
+// The encoder and decoder of a Unicode transformation format, the size of
+// code unit is 1 (UTF-8), 2 (UTF-16) or 4 (UTF-32) bytes, and the code units
+// are stored in the big-endian order if the BigEndian is true.
+//
+//   encode(dest, codepoint): write the code point, the dest is advanced.
+//   decode(src, end, codepoint): read a code point from [src, end), return
+//                                false and skip one code unit if it's invalid.
+//
+template <size_t UnitSize, bool BigEndian>
+struct UnicodeCodec;
+
+// UTF-8
+template <bool BigEndian>
+struct UnicodeCodec<1, BigEndian> {
+    static const size_t kUnitSize = 1;
+    static const bool   kBigEndian = false;
+    static const bool   kNeedSwap = false;
+    // The max code units of a code point.
+    static const size_t kMaxUnits = 4;
+
+    template <typename CharT>
+    static unsigned load(CharT ch) {
+        return static_cast<unsigned>(static_cast<uint8_t>(ch));
+    }
+
+    template <typename CharT>
+    static CharT store(unsigned unit) {
+        return static_cast<CharT>(unit);
+    }
+
+    template <typename CharT>
+    static void encode(CharT *& dest, unsigned codepoint) {
+        if (codepoint < 0x80U) {
+            *dest++ = static_cast<CharT>(codepoint);
+        }
+        else if (codepoint < 0x800U) {
+            *dest++ = static_cast<CharT>(0xC0U | (codepoint >> 6));
+            *dest++ = static_cast<CharT>(0x80U | (codepoint & 0x3FU));
+        }
+        else if (codepoint < 0x10000U) {
+            *dest++ = static_cast<CharT>(0xE0U | (codepoint >> 12));
+            *dest++ = static_cast<CharT>(0x80U | ((codepoint >> 6) & 0x3FU));
+            *dest++ = static_cast<CharT>(0x80U | (codepoint & 0x3FU));
+        }
+        else {
+            *dest++ = static_cast<CharT>(0xF0U | (codepoint >> 18));
+            *dest++ = static_cast<CharT>(0x80U | ((codepoint >> 12) & 0x3FU));
+            *dest++ = static_cast<CharT>(0x80U | ((codepoint >> 6) & 0x3FU));
+            *dest++ = static_cast<CharT>(0x80U | (codepoint & 0x3FU));
+        }
+    }
+
+    template <typename CharT>
+    static bool decode(const CharT *& src, const CharT * end, unsigned & codepoint) {
+        unsigned lead = load(*src);
+        if (lead < 0x80U) {
+            codepoint = lead;
+            ++src;
+            return true;
+        }
+
+        // The range of the second byte, it excludes the overlong forms,
+        // the surrogates and the code points above U+10FFFF.
+        unsigned low = 0x80U, high = 0xBFU;
+        ptrdiff_t count;
+        if (lead >= 0xC2U && lead <= 0xDFU) {
+            count = 1;
+            codepoint = lead & 0x1FU;
+        }
+        else if (lead >= 0xE0U && lead <= 0xEFU) {
+            count = 2;
+            codepoint = lead & 0x0FU;
+            if (lead == 0xE0U)
+                low = 0xA0U;
+            else if (lead == 0xEDU)
+                high = 0x9FU;
+        }
+        else if (lead >= 0xF0U && lead <= 0xF4U) {
+            count = 3;
+            codepoint = lead & 0x07U;
+            if (lead == 0xF0U)
+                low = 0x90U;
+            else if (lead == 0xF4U)
+                high = 0x8FU;
+        }
+        else {
+            ++src;
+            return false;
+        }
+
+        if (end - src <= count) {
+            ++src;
+            return false;
+        }
+        unsigned second = load(src[1]);
+        if (second < low || second > high) {
+            ++src;
+            return false;
+        }
+        codepoint = (codepoint << 6) | (second & 0x3FU);
+        for (ptrdiff_t i = 2; i <= count; ++i) {
+            unsigned unit = load(src[i]);
+            if ((unit & 0xC0U) != 0x80U) {
+                ++src;
+                return false;
+            }
+            codepoint = (codepoint << 6) | (unit & 0x3FU);
+        }
+        src += count + 1;
+        return true;
+    }
+};
+
+// UTF-16
+template <bool BigEndian>
+struct UnicodeCodec<2, BigEndian> {
+    static const size_t kUnitSize = 2;
+    static const bool   kBigEndian = BigEndian;
+    static const size_t kMaxUnits = 2;
+
+#if defined(JSONFX_LITTLE_ENDIAN)
+    static const bool kNeedSwap = BigEndian;
+#else
+    static const bool kNeedSwap = !BigEndian;
+#endif
+
+    template <typename CharT>
+    static unsigned load(CharT ch) {
+        uint16_t unit = static_cast<uint16_t>(ch);
+        return (kNeedSwap ? ByteSwap16(unit) : unit);
+    }
+
+    template <typename CharT>
+    static CharT store(unsigned unit) {
+        return static_cast<CharT>(kNeedSwap ? ByteSwap16(static_cast<uint16_t>(unit)) : unit);
+    }
+
+    template <typename CharT>
+    static void encode(CharT *& dest, unsigned codepoint) {
+        if (codepoint < 0x10000U) {
+            *dest++ = store<CharT>(codepoint);
+        }
+        else {
+            codepoint -= 0x10000U;
+            *dest++ = store<CharT>(0xD800U | (codepoint >> 10));
+            *dest++ = store<CharT>(0xDC00U | (codepoint & 0x3FFU));
+        }
+    }
+
+    template <typename CharT>
+    static bool decode(const CharT *& src, const CharT * end, unsigned & codepoint) {
+        unsigned unit = load(*src++);
+        if (unit < 0xD800U || unit > 0xDFFFU) {
+            codepoint = unit;
+            return true;
+        }
+        // A high surrogate must be followed by a low surrogate.
+        if (unit <= 0xDBFFU && src < end) {
+            unsigned unit2 = load(*src);
+            if (unit2 >= 0xDC00U && unit2 <= 0xDFFFU) {
+                codepoint = (((unit - 0xD800U) << 10) | (unit2 - 0xDC00U)) + 0x10000U;
+                ++src;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// UTF-32
+template <bool BigEndian>
+struct UnicodeCodec<4, BigEndian> {
+    static const size_t kUnitSize = 4;
+    static const bool   kBigEndian = BigEndian;
+    static const size_t kMaxUnits = 1;
+
+#if defined(JSONFX_LITTLE_ENDIAN)
+    static const bool kNeedSwap = BigEndian;
+#else
+    static const bool kNeedSwap = !BigEndian;
+#endif
+
+    template <typename CharT>
+    static unsigned load(CharT ch) {
+        uint32_t unit = static_cast<uint32_t>(ch);
+        return (kNeedSwap ? ByteSwap32(unit) : unit);
+    }
+
+    template <typename CharT>
+    static CharT store(unsigned unit) {
+        return static_cast<CharT>(kNeedSwap ? ByteSwap32(unit) : unit);
+    }
+
+    template <typename CharT>
+    static void encode(CharT *& dest, unsigned codepoint) {
+        *dest++ = store<CharT>(codepoint);
+    }
+
+    template <typename CharT>
+    static bool decode(const CharT *& src, const CharT * end, unsigned & codepoint) {
+        (void)end;
+        codepoint = load(*src++);
+        return (codepoint <= 0x10FFFFU && (codepoint < 0xD800U || codepoint > 0xDFFFU));
+    }
+};
+
+#if defined(JSONFX_LITTLE_ENDIAN)
+static const bool kHostBigEndian = false;
+#else
+static const bool kHostBigEndian = true;
+#endif
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_UNICODE_H_ */
@@ -0,0 +1,248 @@
+
+#ifndef _JSONFX_INTERNAL_UTF8VALIDATOR_H_
+#define _JSONFX_INTERNAL_UTF8VALIDATOR_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Internal/CpuFeatures.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+
+//
+// The UTF-8 validation (RFC 3629): the overlong forms, the surrogates
+// (U+D800 to U+DFFF) and the code points above U+10FFFF are invalid.
+//
+// The vectorized validator is the lookup algorithm of John Keiser and
+// Daniel Lemire ("Validating UTF-8 In Less Than One Instruction Per Byte"):
+// the errors of the first two bytes of a sequence are found by three 16
+// entries nibble tables, and the third and fourth bytes by the saturating
+// subtractions, so a 32 bytes block needs no branches.
+//
+
+namespace JsonFx {
+
+namespace internal {
+
+//
+// Return the first invalid sequence in [src, end), or end if it's all valid.
+// A sequence cut by the end is invalid.
+//
+template <typename CharT>
+static inline
+const CharT * FindInvalidUtf8(const CharT * src, const CharT * end) {
+    // Only the single byte chars are UTF-8.
+    (void)src;
+    return end;
+}
+
+static inline
+const char * FindInvalidUtf8(const char * src, const char * end) {
+    while (src < end) {
+        unsigned lead = static_cast<unsigned char>(*src);
+        if (lead < 0x80U) {
+            ++src;
+            continue;
+        }
+
+        // The range of the second byte and the number of continuation bytes.
+        unsigned low = 0x80U, high = 0xBFU;
+        ptrdiff_t count;
+        if (lead >= 0xC2U && lead <= 0xDFU) {
+            count = 1;
+        }
+        else if (lead >= 0xE0U && lead <= 0xEFU) {
+            count = 2;
+            if (lead == 0xE0U)
+                low = 0xA0U;        // Overlong
+            else if (lead == 0xEDU)
+                high = 0x9FU;       // Surrogates
+        }
+        else if (lead >= 0xF0U && lead <= 0xF4U) {
+            count = 3;
+            if (lead == 0xF0U)
+                low = 0x90U;        // Overlong
+            else if (lead == 0xF4U)
+                high = 0x8FU;       // Above U+10FFFF
+        }
+        else {
+            return src;
+        }
+
+        if (end - src <= count)
+            return src;
+        unsigned second = static_cast<unsigned char>(src[1]);
+        if (second < low || second > high)
+            return src;
+        for (ptrdiff_t i = 2; i <= count; ++i) {
+            if ((static_cast<unsigned char>(src[i]) & 0xC0U) != 0x80U)
+                return src;
+        }
+        src += count + 1;
+    }
+    return end;
+}
+
+#if defined(JSONFX_SIMD_X86)
+
+//
+// The states of AVX2 UTF-8 validator, the blocks must be checked in order.
+//
+struct Utf8CheckerAVX2 {
+    __m256i     error;
+    __m256i     prevInput;
+    __m256i     prevIncomplete;
+};
+
+JSONFX_TARGET_AVX2
+static inline
+void InitUtf8CheckerAVX2(Utf8CheckerAVX2 & checker) {
+    checker.error          = _mm256_setzero_si256();
+    checker.prevInput      = _mm256_setzero_si256();
+    checker.prevIncomplete = _mm256_setzero_si256();
+}
+
+// Return the input shifted by N bytes, the first N bytes come from the previous input.
+template <int N>
+JSONFX_TARGET_AVX2
+static inline
+__m256i PrevBytesAVX2(__m256i input, __m256i prevInput) {
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prevInput, input, 0x21), 16 - N);
+}
+
+JSONFX_TARGET_AVX2
+static inline
+__m256i HighNibblesAVX2(__m256i input) {
+    return _mm256_and_si256(_mm256_srli_epi16(input, 4), _mm256_set1_epi8(0x0F));
+}
+
+JSONFX_TARGET_AVX2
+static inline
+void CheckUtf8BlockAVX2(Utf8CheckerAVX2 & checker, __m256i input) {
+    // The ASCII block only needs to check the sequence cut by the previous block.
+    if (_mm256_movemask_epi8(input) == 0) {
+        checker.error = _mm256_or_si256(checker.error, checker.prevIncomplete);
+        checker.prevInput      = input;
+        checker.prevIncomplete = _mm256_setzero_si256();
+        return;
+    }
+
+    // The error bits of the first two bytes of a sequence.
+    enum {
+        kTooShort   = 1 << 0,   // 11______ 0_______ or 11______ 11______
+        kTooLong    = 1 << 1,   // 0_______ 10______
+        kOverlong3  = 1 << 2,   // 11100000 100_____
+        kTooLarge   = 1 << 3,   // 11110100 1001____ or 11110100 101_____ or 11110101+
+        kSurrogate  = 1 << 4,   // 11101101 101_____
+        kOverlong2  = 1 << 5,   // 1100000_ 10______
+        kTooLarge1000 = 1 << 6, // 11110101+ 1000____
+        kOverlong4  = 1 << 6,   // 11110000 1000____
+        kTwoConts   = 1 << 7,   // 10______ 10______
+        kCarry      = kTooShort | kTooLong | kTwoConts
+    };
+
+    const __m256i kByte1High = _mm256_setr_epi8(
+        kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+        kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+        kTooShort | kOverlong2,
+        kTooShort,
+        kTooShort | kOverlong3 | kSurrogate,
+        kTooShort | kTooLarge | kTooLarge1000 | kOverlong4,
+        kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+        kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+        kTooShort | kOverlong2,
+        kTooShort,
+        kTooShort | kOverlong3 | kSurrogate,
+        kTooShort | kTooLarge | kTooLarge1000 | kOverlong4);
+
+    const __m256i kByte1Low = _mm256_setr_epi8(
+        kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+        kCarry | kOverlong2,
+        kCarry,
+        kCarry,
+        kCarry | kTooLarge,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+        kCarry | kOverlong2,
+        kCarry,
+        kCarry,
+        kCarry | kTooLarge,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+        kCarry | kTooLarge | kTooLarge1000,
+        kCarry | kTooLarge | kTooLarge1000);
+
+    const __m256i kByte2High = _mm256_setr_epi8(
+        kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4,
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge,
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+        kTooShort, kTooShort, kTooShort, kTooShort,
+        kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4,
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge,
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+        kTooShort, kTooShort, kTooShort, kTooShort);
+
+    __m256i prev1 = PrevBytesAVX2<1>(input, checker.prevInput);
+    __m256i specialCases = _mm256_and_si256(
+        _mm256_and_si256(_mm256_shuffle_epi8(kByte1High, HighNibblesAVX2(prev1)),
+                         _mm256_shuffle_epi8(kByte1Low, _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)))),
+        _mm256_shuffle_epi8(kByte2High, HighNibblesAVX2(input)));
+
+    // The third and fourth bytes of a sequence must be continuation bytes, it's
+    // the only case that two continuation bytes in a row (kTwoConts) are valid.
+    __m256i prev2 = PrevBytesAVX2<2>(input, checker.prevInput);
+    __m256i prev3 = PrevBytesAVX2<3>(input, checker.prevInput);
+    __m256i isThirdByte  = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+    __m256i isFourthByte = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(isThirdByte, isFourthByte),
+                                      _mm256_set1_epi8(static_cast<char>(0x80)));
+    checker.error = _mm256_or_si256(checker.error, _mm256_xor_si256(must23, specialCases));
+
+    // The sequence at the end of block is incomplete if it needs more bytes.
+    const __m256i kMaxValue = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+    checker.prevIncomplete = _mm256_subs_epu8(input, kMaxValue);
+    checker.prevInput      = input;
+}
+
+// Return true if all the checked blocks are valid, and the last sequence is complete.
+JSONFX_TARGET_AVX2
+static inline
+bool IsUtf8ValidAVX2(const Utf8CheckerAVX2 & checker) {
+    __m256i error = _mm256_or_si256(checker.error, checker.prevIncomplete);
+    return (_mm256_testz_si256(error, error) != 0);
+}
+
+#endif  /* JSONFX_SIMD_X86 */
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_UTF8VALIDATOR_H_ */
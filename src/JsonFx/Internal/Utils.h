@@ -12,6 +12,10 @@
 #include "jimi/basic/stdint.h"
 #include "jimi/basic/assert.h"
 
+#if defined(_MSC_VER)
+#include <intrin.h>     // For _BitScanForward(), _BitScanForward64()
+#endif
+
 namespace JsonFx {
 
 namespace internal {
@@ -43,6 +47,58 @@ size_t RoundToPowerOf2(size_t n) {
 #endif
 }
 
+// Count the trailing zero bits, x can not be 0.
+static inline
+uint32_t CountTrailingZeros(uint32_t x) {
+    jimi_assert(x != 0);
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return static_cast<uint32_t>(index);
+#elif defined(__GNUC__) || defined(__clang__)
+    return static_cast<uint32_t>(__builtin_ctz(x));
+#else
+    uint32_t n = 0;
+    while ((x & 1U) == 0) {
+        x >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+// Count the trailing zero bits, x can not be 0.
+static inline
+uint32_t CountTrailingZeros64(uint64_t x) {
+    jimi_assert(x != 0);
+#if defined(_MSC_VER) && (defined(JIMI_ARCH_X64) || defined(JIMI_ARCH_IA64))
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<uint32_t>(index);
+#elif defined(__GNUC__) || defined(__clang__)
+    return static_cast<uint32_t>(__builtin_ctzll(x));
+#else
+    uint32_t low = static_cast<uint32_t>(x);
+    if (low != 0)
+        return CountTrailingZeros(low);
+    else
+        return CountTrailingZeros(static_cast<uint32_t>(x >> 32)) + 32;
+#endif
+}
+
+// Count the set bits, the POPCNT instruction is not required.
+static inline
+uint32_t PopCount64(uint64_t x) {
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(_MSC_VER)
+    return static_cast<uint32_t>(__builtin_popcountll(x));
+#else
+    x = x - ((x >> 1) & UINT64_C(0x5555555555555555));
+    x = (x & UINT64_C(0x3333333333333333)) + ((x >> 2) & UINT64_C(0x3333333333333333));
+    x = (x + (x >> 4)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+    return static_cast<uint32_t>((x * UINT64_C(0x0101010101010101)) >> 56);
+#endif
+}
+
 }  // namespace internal
 
 }  // namespace jimi
@@ -0,0 +1,262 @@
+
+#ifndef _JSONFX_INTERNAL_VALUESKIPPER_H_
+#define _JSONFX_INTERNAL_VALUESKIPPER_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Internal/CpuFeatures.h"
+#include "JsonFx/Internal/Utils.h"
+#include "JsonFx/Internal/StringScanner.h"
+#include "JsonFx/Internal/StructuralIndex.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/stdsize.h"
+
+//
+// Skip a value without parsing it, only the brackets are counted:
+//
+//   The strings are skipped by ScanString(), the escaped char is stepped over,
+//   and the nested objects and arrays are matched by the depth of brackets,
+//   the brackets in the strings are not counted.
+//
+//   The SIMD kernels classify the 64 chars blocks to the quotes, backslashes
+//   and brackets bitmaps, the chars in the strings are masked out by the
+//   quote mask (see StructuralScanner), so a block is counted by popcount
+//   unless the depth can reach zero in it.
+//
+// The skipped values are not validated, the mismatched brackets (such as
+// "[1}") and the invalid tokens are skipped as well as the valid ones.
+//
+
+namespace JsonFx {
+
+namespace internal {
+
+//
+// Return the closing quote of the string from src (after the opening quote),
+// or the '\0' terminator if the string is not closed.
+//
+template <typename CharT>
+static inline
+const CharT * SkipString(const CharT * src, CharT quote) {
+    for (;;) {
+        src = ScanString(src, quote);
+        if (*src == quote || *src == '\0')
+            return src;
+        if (*src == '\\') {
+            ++src;
+            if (*src == '\0')
+                return src;
+        }
+        // The escaped char, or a control char.
+        ++src;
+    }
+}
+
+//
+// Return the end of a number or literal token from src, it's the first
+// whitespace, structural char, quote or the '\0' terminator.
+//
+template <typename CharT>
+static inline
+const CharT * SkipScalarToken(const CharT * src) {
+    for (;;) {
+        switch (*src) {
+        case ' ': case '\t': case '\n': case '\r':
+        case '{': case '}': case '[': case ']': case ':': case ',':
+        case '"': case '\'': case '\0':
+            return src;
+        default:
+            ++src;
+            break;
+        }
+    }
+}
+
+template <typename CharT>
+static inline
+const CharT * SkipContainerScalar(const CharT * src, size_t & depth, bool allowSingleQuotes) {
+    for (;;) {
+        CharT ch = *src;
+        if (ch == '{' || ch == '[') {
+            ++depth;
+        }
+        else if (ch == '}' || ch == ']') {
+            if (--depth == 0)
+                return src;
+        }
+        else if (ch == '"' || (allowSingleQuotes && ch == '\'')) {
+            src = SkipString(src + 1, ch);
+            if (*src == '\0')
+                return src;
+        }
+        else if (ch == '\0') {
+            return src;
+        }
+        ++src;
+    }
+}
+
+#if defined(JSONFX_SIMD_X86)
+
+// The classified bitmaps of a block for skipping, the bit i is for the char i of the block.
+struct BracketBitmaps {
+    uint64_t    quote;
+    uint64_t    backslash;
+    uint64_t    open;           // The '{' and '['
+    uint64_t    close;          // The '}' and ']'
+    uint64_t    terminator;     // The '\0' chars
+};
+
+JSONFX_NO_SANITIZE_ADDRESS
+static inline
+void ClassifyBracketsSSE2(const char * block, BracketBitmaps & bm) {
+    const __m128i kQuote      = _mm_set1_epi8('"');
+    const __m128i kBackslash  = _mm_set1_epi8('\\');
+    const __m128i kLowerCase  = _mm_set1_epi8(0x20);
+    // '[' | 0x20 = '{', ']' | 0x20 = '}'
+    const __m128i kOpenBrace  = _mm_set1_epi8('{');
+    const __m128i kCloseBrace = _mm_set1_epi8('}');
+    const __m128i kZero       = _mm_setzero_si128();
+
+    bm.quote = bm.backslash = bm.open = bm.close = bm.terminator = 0;
+    for (int i = 0; i < 4; ++i) {
+        __m128i s = _mm_load_si128(reinterpret_cast<const __m128i *>(block + i * 16));
+        __m128i lower = _mm_or_si128(s, kLowerCase);
+        int shift = i * 16;
+        bm.quote      |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(s, kQuote))) << shift;
+        bm.backslash  |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(s, kBackslash))) << shift;
+        bm.open       |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(lower, kOpenBrace))) << shift;
+        bm.close      |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(lower, kCloseBrace))) << shift;
+        bm.terminator |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(s, kZero))) << shift;
+    }
+}
+
+JSONFX_TARGET_AVX2 JSONFX_NO_SANITIZE_ADDRESS
+static inline
+void ClassifyBracketsAVX2(const char * block, BracketBitmaps & bm) {
+    const __m256i kQuote      = _mm256_set1_epi8('"');
+    const __m256i kBackslash  = _mm256_set1_epi8('\\');
+    const __m256i kLowerCase  = _mm256_set1_epi8(0x20);
+    // '[' | 0x20 = '{', ']' | 0x20 = '}'
+    const __m256i kOpenBrace  = _mm256_set1_epi8('{');
+    const __m256i kCloseBrace = _mm256_set1_epi8('}');
+    const __m256i kZero       = _mm256_setzero_si256();
+
+    bm.quote = bm.backslash = bm.open = bm.close = bm.terminator = 0;
+    for (int i = 0; i < 2; ++i) {
+        __m256i s = _mm256_load_si256(reinterpret_cast<const __m256i *>(block + i * 32));
+        __m256i lower = _mm256_or_si256(s, kLowerCase);
+        int shift = i * 32;
+        bm.quote      |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(s, kQuote)))) << shift;
+        bm.backslash  |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(s, kBackslash)))) << shift;
+        bm.open       |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lower, kOpenBrace)))) << shift;
+        bm.close      |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lower, kCloseBrace)))) << shift;
+        bm.terminator |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(s, kZero)))) << shift;
+    }
+}
+
+typedef void (*ClassifyBracketsFunc)(const char * block, BracketBitmaps & bm);
+
+static inline
+ClassifyBracketsFunc SelectClassifyBrackets() {
+    if (HasCpuFeatures(kCpuFeatureAVX2Kernels))
+        return &ClassifyBracketsAVX2;
+    if (HasCpuFeatures(kCpuFeatureSSE2))
+        return &ClassifyBracketsSSE2;
+    return NULL;
+}
+
+static const ClassifyBracketsFunc gClassifyBracketsFunc = SelectClassifyBrackets();
+
+static inline
+const char * SkipContainerBlocks(const char * src, size_t & depth, ClassifyBracketsFunc classifyBrackets) {
+    // Align down to 64 bytes, the chars before src are masked out.
+    const char * p = reinterpret_cast<const char *>(reinterpret_cast<uintptr_t>(src) & ~static_cast<uintptr_t>(63));
+    uint32_t shift = static_cast<uint32_t>(src - p);
+    uint64_t leadingMask = (UINT64_C(1) << shift) - 1;
+
+    QuoteMaskScanner scanner;
+    for (;;) {
+        BracketBitmaps bm;
+        classifyBrackets(p, bm);
+        bm.quote      &= ~leadingMask;
+        bm.backslash  &= ~leadingMask;
+        bm.terminator &= ~leadingMask;
+
+        uint64_t quote = bm.quote;
+        uint64_t quoteMask = scanner.next(bm.backslash, quote);
+        uint64_t open  = bm.open  & ~quoteMask & ~leadingMask;
+        uint64_t close = bm.close & ~quoteMask & ~leadingMask;
+        // A backslash out of the strings is a plain char for SkipContainerScalar(),
+        // but the quote mask takes it as an escape, so the chars from the first
+        // one are left to the scalar path, like the chars after the terminator.
+        uint64_t stop = bm.terminator | (bm.backslash & ~quoteMask);
+        if (stop != 0) {
+            uint64_t valid = (stop & (0 - stop)) - 1;
+            open  &= valid;
+            close &= valid;
+        }
+
+        uint32_t closeCount = PopCount64(close);
+        if (closeCount < depth) {
+            // The depth can't reach zero in this block.
+            depth = depth + PopCount64(open) - closeCount;
+        }
+        else {
+            uint64_t brackets = open | close;
+            while (brackets != 0) {
+                uint64_t bit = brackets & (0 - brackets);
+                if ((open & bit) != 0) {
+                    ++depth;
+                }
+                else if (--depth == 0) {
+                    return (p + CountTrailingZeros64(bit));
+                }
+                brackets ^= bit;
+            }
+        }
+
+        if (stop != 0) {
+            const char * end = p + CountTrailingZeros64(stop);
+            return ((*end == '\\') ? SkipContainerScalar(end, depth, false) : end);
+        }
+        p += 64;
+        leadingMask = 0;
+    }
+}
+
+#endif  /* JSONFX_SIMD_X86 */
+
+//
+// Skip the chars of the objects and arrays from src until the depth reaches
+// zero, return the bracket which closes the outermost container, or the '\0'
+// terminator if it's not closed (the depth is not zero). The depth is the
+// count of the containers opened before src.
+//
+template <typename CharT>
+static inline
+const CharT * SkipContainer(const CharT * src, size_t & depth, bool allowSingleQuotes) {
+    // The SIMD kernels only support the single byte chars.
+    return SkipContainerScalar(src, depth, allowSingleQuotes);
+}
+
+static inline
+const char * SkipContainer(const char * src, size_t & depth, bool allowSingleQuotes) {
+#if defined(JSONFX_SIMD_X86)
+    // The quote mask only knows the double quotes.
+    if (gClassifyBracketsFunc != NULL && !allowSingleQuotes)
+        return SkipContainerBlocks(src, depth, gClassifyBracketsFunc);
+#endif
+    return SkipContainerScalar(src, depth, allowSingleQuotes);
+}
+
+}  // namespace internal
+
+}  // namespace JsonFx
+
+#endif  /* _JSONFX_INTERNAL_VALUESKIPPER_H_ */
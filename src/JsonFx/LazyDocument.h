@@ -0,0 +1,478 @@
+
+#ifndef _JSONFX_LAZYDOCUMENT_H_
+#define _JSONFX_LAZYDOCUMENT_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include <new>
+#include <string.h>
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Allocator.h"
+#include "JsonFx/Stack.h"
+#include "JsonFx/ParseResult.h"
+#include "JsonFx/Value.h"
+#include "JsonFx/Reader.h"
+#include "JsonFx/Internal/String.h"
+#include "JsonFx/Stream/StringInputStream.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/assert.h"
+
+namespace JsonFx {
+
+// Forward declaration.
+template <size_t parseFlags = kDefaultParseFlags,
+          typename EncodingT = JSONFX_DEFAULT_ENCODING,
+          typename PoolAllocatorT = DefaultPoolAllocator,
+          typename AllocatorT = DefaultAllocator>
+class BasicLazyDocument;
+
+template <size_t parseFlags, typename EncodingT, typename PoolAllocatorT, typename AllocatorT>
+class BasicLazyValue;
+
+// Define default LazyDocument class type
+typedef BasicLazyDocument<>     LazyDocument;
+
+template <size_t parseFlags, typename EncodingT, typename PoolAllocatorT, typename AllocatorT>
+struct BasicLazyMember {
+    BasicValue<EncodingT, PoolAllocatorT>                               name;
+    BasicLazyValue<parseFlags, EncodingT, PoolAllocatorT, AllocatorT>   value;
+};
+
+//
+// The value of the lazy document, it has the same accessors as BasicValue.
+// A object or array only knows its text until the children are touched
+// (findMember(), operator[], getMemberBegin(), getSize(), ...), then its
+// direct children are found, the names of members are parsed, and the
+// children are still lazy. A scalar value is converted (the string is
+// unescaped) at the first time it's touched.
+//
+// The lazy values are materialized in place, so they are not thread safe,
+// even the const accessors.
+//
+template <size_t parseFlags, typename EncodingT, typename PoolAllocatorT, typename AllocatorT>
+class BasicLazyValue {
+public:
+    typedef typename EncodingT::CharType                                            CharType;
+    typedef uint32_t                                                                SizeType;
+    typedef BasicValue<EncodingT, PoolAllocatorT>                                   ValueType;
+    typedef BasicLazyMember<parseFlags, EncodingT, PoolAllocatorT, AllocatorT>      MemberType;
+    typedef BasicLazyDocument<parseFlags, EncodingT, PoolAllocatorT, AllocatorT>    DocumentType;
+    typedef MemberType *                                                            MemberIterator;
+    typedef const MemberType *                                                      ConstMemberIterator;
+
+private:
+    friend class BasicLazyDocument<parseFlags, EncodingT, PoolAllocatorT, AllocatorT>;
+
+    const CharType *    mSource;        // The first char of the value in the text.
+    DocumentType *      mDocument;
+    uint32_t            mResolved;
+    SizeType            mSize;          // The count of members or elements.
+    void *              mChildren;      // The members or elements.
+    ValueType           mValue;         // The scalar value, or the type of container.
+
+public:
+    BasicLazyValue() : mSource(NULL), mDocument(NULL), mResolved(1), mSize(0), mChildren(NULL), mValue() {}
+    ~BasicLazyValue() {}
+
+private:
+    //! Prohibit copying
+    BasicLazyValue(const BasicLazyValue &);
+    //! Prohibit assignment
+    BasicLazyValue & operator =(const BasicLazyValue &);
+
+    // A unresolved value from src, the type of container is known by the first char.
+    void init(const CharType * src, DocumentType * document) {
+        mSource   = src;
+        mDocument = document;
+        mResolved = 0;
+        mSize     = 0;
+        mChildren = NULL;
+        if (*src == '{')
+            new (&mValue) ValueType(kObjectType);
+        else if (*src == '[')
+            new (&mValue) ValueType(kArrayType);
+        else
+            mValue.setNull();
+    }
+
+    BasicLazyValue & resolve() {
+        if (mResolved == 0)
+            mDocument->resolve(*this);
+        return *this;
+    }
+
+    BasicLazyValue & resolve() const {
+        return const_cast<BasicLazyValue *>(this)->resolve();
+    }
+
+public:
+    // The resolved scalar value, or a empty container of the same type.
+    const ValueType & getValue() const { return resolve().mValue; }
+
+    // The beginning of the value in the text.
+    const CharType * getSource() const { return mSource; }
+
+    bool isNull()   const { return getValue().isNull();   }
+    bool isFalse()  const { return getValue().isFalse();  }
+    bool isTrue()   const { return getValue().isTrue();   }
+    bool isBool()   const { return getValue().isBool();   }
+    bool isNumber() const { return getValue().isNumber(); }
+    bool isInt()    const { return getValue().isInt();    }
+    bool isUint()   const { return getValue().isUint();   }
+    bool isInt64()  const { return getValue().isInt64();  }
+    bool isUint64() const { return getValue().isUint64(); }
+    bool isFloat()  const { return getValue().isFloat();  }
+    bool isDouble() const { return getValue().isDouble(); }
+    bool isString() const { return getValue().isString(); }
+
+    // The containers are known without touching the children.
+    bool isObject() const { return mValue.isObject(); }
+    bool isArray()  const { return mValue.isArray();  }
+
+    const CharType * getString() const      { return getValue().getString();       }
+    SizeType         getStringLength() const { return getValue().getStringLength(); }
+
+    // The scalars are converted at the first access too.
+    int64_t  getInt64() const  { return getValue().getInt64();  }
+    uint64_t getUint64() const { return getValue().getUint64(); }
+    double   getDouble() const { return getValue().getDouble(); }
+    bool     getBool() const   { jimi_assert(isBool()); return getValue().isTrue(); }
+
+    // The count of members or elements.
+    SizeType getSize() const {
+        jimi_assert(isObject() || isArray());
+        return resolve().mSize;
+    }
+
+    MemberIterator getMemberBegin() {
+        jimi_assert(isObject());
+        return static_cast<MemberIterator>(resolve().mChildren);
+    }
+    MemberIterator getMemberEnd() {
+        jimi_assert(isObject());
+        return (static_cast<MemberIterator>(resolve().mChildren) + mSize);
+    }
+
+    ConstMemberIterator getMemberBegin() const {
+        return const_cast<BasicLazyValue *>(this)->getMemberBegin();
+    }
+    ConstMemberIterator getMemberEnd() const {
+        return const_cast<BasicLazyValue *>(this)->getMemberEnd();
+    }
+
+    MemberIterator findMember(const CharType * name) {
+        jimi_assert(name != NULL);
+        size_t length = internal::StrLen(name);
+        MemberIterator member = getMemberBegin();
+        MemberIterator end = getMemberEnd();
+        for (; member != end; ++member) {
+            if (member->name.getStringLength() == length
+                && ::memcmp(member->name.getString(), name, sizeof(CharType) * length) == 0)
+                break;
+        }
+        return member;
+    }
+
+    ConstMemberIterator findMember(const CharType * name) const {
+        return const_cast<BasicLazyValue &>(*this).findMember(name);
+    }
+
+    bool hasMember(const CharType * name) const {
+        return (findMember(name) != getMemberEnd());
+    }
+
+    BasicLazyValue & operator[] (const CharType * name) {
+        MemberIterator member = findMember(name);
+        if (member != getMemberEnd()) {
+            return member->value;
+        }
+        else {
+            jimi_assert(false);
+            static BasicLazyValue nullValue;
+            return nullValue;
+        }
+    }
+
+    const BasicLazyValue & operator[] (const CharType * name) const {
+        return const_cast<BasicLazyValue &>(*this)[name];
+    }
+
+    BasicLazyValue & operator[] (SizeType index) {
+        jimi_assert(isArray());
+        jimi_assert(index < getSize());
+        return static_cast<BasicLazyValue *>(resolve().mChildren)[index];
+    }
+
+    const BasicLazyValue & operator[] (SizeType index) const {
+        return const_cast<BasicLazyValue &>(*this)[index];
+    }
+};
+
+//
+// The lazy document (parse on access): the parse only checks the brackets
+// of the root are matched (see BasicReader::skipValue()), and the values
+// are materialized when they are touched (see BasicLazyValue), so the cost
+// is paid only for the touched part of a large document:
+//
+//   LazyDocument document;
+//   document.parse(json);
+//   const char * path = document["request"]["path"].getString();
+//
+// The text must be alive while the document is used. The errors of the
+// values found at access are also reported by getParseResult() (the first
+// one), the bad scalar is read as null, and the bad container is read as
+// the children before the error.
+//
+template <size_t parseFlags /* = kDefaultParseFlags */,
+          typename EncodingT /* = JSONFX_DEFAULT_ENCODING */,
+          typename PoolAllocatorT /* = DefaultPoolAllocator */,
+          typename AllocatorT /* = DefaultAllocator */>
+class BasicLazyDocument : public BasicLazyValue<parseFlags, EncodingT, PoolAllocatorT, AllocatorT>
+{
+public:
+    typedef typename EncodingT::CharType                                        CharType;
+    typedef size_t                                                              SizeType;
+    typedef BasicLazyValue<parseFlags, EncodingT, PoolAllocatorT, AllocatorT>   LazyValueType;
+    typedef typename LazyValueType::MemberType                                  MemberType;
+    typedef BasicValue<EncodingT, PoolAllocatorT>                               ValueType;
+    typedef PoolAllocatorT                                                      PoolAllocatorType;
+    typedef BasicStack<AllocatorT>                                              StackType;
+    typedef BasicParseResult<EncodingT>                                         ParseResultType;
+
+    // The token parsers of the reader, the text is const.
+    typedef BasicReader<(parseFlags & ~static_cast<size_t>(kInsituParseFlag | kStructuralIndexParseFlag)),
+                        EncodingT, EncodingT, PoolAllocatorT, AllocatorT>       ReaderType;
+    typedef typename ReaderType::StringInputStreamType                          StringInputStreamType;
+
+private:
+    friend class BasicLazyValue<parseFlags, EncodingT, PoolAllocatorT, AllocatorT>;
+
+    // The SAX handler for the token parsers, it saves the value to a cell.
+    struct ValueHandler {
+        ValueType *             value;
+        PoolAllocatorType *     poolAllocator;
+
+        bool saxNull()             { new (value) ValueType();  return true; }
+        bool saxBool(bool b)       { new (value) ValueType(b); return true; }
+        bool saxInt(int i)         { new (value) ValueType(i); return true; }
+        bool saxUint(unsigned u)   { new (value) ValueType(u); return true; }
+        bool saxInt64(int64_t i)   { new (value) ValueType(i); return true; }
+        bool saxUint64(uint64_t u) { new (value) ValueType(u); return true; }
+        bool saxDouble(double d)   { new (value) ValueType(d); return true; }
+        bool saxString(const CharType * str, size_t length, bool copy) {
+            if (copy)
+                new (value) ValueType(str, static_cast<typename ValueType::SizeType>(length), poolAllocator);
+            else
+                new (value) ValueType(str, static_cast<typename ValueType::SizeType>(length));
+            return true;
+        }
+        bool saxKey(const CharType * str, size_t length, bool copy) {
+            return saxString(str, length, copy);
+        }
+    };
+
+    PoolAllocatorType *     mPoolAllocator;
+    bool                    mPoolAllocatorNeedFree;
+    ReaderType              mReader;
+    StringInputStreamType   mInputStream;
+    StackType               mChildren;      // The children of the container being resolved.
+    ValueHandler            mHandler;
+    ParseResultType         mParseResult;
+
+public:
+    BasicLazyDocument(const PoolAllocatorType * poolAllocator = NULL)
+        : LazyValueType(),
+          mPoolAllocator((poolAllocator != NULL) ? const_cast<PoolAllocatorType *>(poolAllocator)
+                                                 : new PoolAllocatorType()),
+          mPoolAllocatorNeedFree(poolAllocator == NULL),
+          // The strings are parsed into the document's pool allocator.
+          mReader(mPoolAllocator), mInputStream(static_cast<const CharType *>(NULL)),
+          mChildren(), mParseResult()
+    {
+        jimi_assert(mPoolAllocator != NULL);
+        mHandler.value = NULL;
+        mHandler.poolAllocator = mPoolAllocator;
+    }
+
+    ~BasicLazyDocument() {
+        if (mPoolAllocatorNeedFree && mPoolAllocator != NULL) {
+            delete mPoolAllocator;
+            mPoolAllocator = NULL;
+        }
+    }
+
+private:
+    //! Prohibit copying
+    BasicLazyDocument(const BasicLazyDocument &);
+    //! Prohibit assignment
+    BasicLazyDocument & operator =(const BasicLazyDocument &);
+
+public:
+    const PoolAllocatorType * getPoolAllocator() const { return mPoolAllocator; }
+
+    const ParseResultType & getParseResult() const { return mParseResult; }
+    bool hasParseError() const { return mParseResult.hasError(); }
+
+    //
+    // Release all the values and reset the pool allocator, the values of other
+    // documents which share the pool allocator are also released.
+    //
+    void reset() {
+        LazyValueType::mResolved = 1;
+        LazyValueType::mSize = 0;
+        LazyValueType::mChildren = NULL;
+        LazyValueType::mValue.setNull();
+        mParseResult.clear();
+        mPoolAllocator->reset();
+    }
+
+    // Parse the '\0' terminated text, only the brackets of the root are matched.
+    BasicLazyDocument & parse(const CharType * text) {
+        jimi_assert(text != NULL);
+        mParseResult.clear();
+        mInputStream = StringInputStreamType(text);
+        mReader.attachInputStream(&mInputStream);
+        mReader.clearParseError();
+
+        const CharType * src = internal::SkipWhiteSpaces(text);
+        if (*src == '\0') {
+            setError(kDocumentEmptyError, static_cast<size_t>(src - text));
+            return *this;
+        }
+        LazyValueType::init(src, this);
+        const CharType * end = mReader.skipValue(src);
+        if (mReader.hasParseError()) {
+            mParseResult = mReader.getParseResult();
+        }
+        else {
+            end = internal::SkipWhiteSpaces(end);
+            if (*end != '\0')
+                setError(kDocumentRootNotSingularError, static_cast<size_t>(end - text));
+        }
+        if (mParseResult.hasError()) {
+            LazyValueType::mResolved = 1;
+            LazyValueType::mValue.setNull();
+        }
+        return *this;
+    }
+
+private:
+    void setError(ParseErrorCode code, size_t offset) {
+        // Only keep the first error.
+        if (!mParseResult.hasError())
+            mParseResult.setError(code, offset);
+    }
+
+    void setReaderError() {
+        if (!mParseResult.hasError())
+            mParseResult = mReader.getParseResult();
+        mReader.clearParseError();
+    }
+
+    void * allocate(size_t size) {
+        // The large block is allocated alone, don't waste the remain space of chunk.
+        if (size <= PoolAllocatorType::kChunkCapacity / 2)
+            return mPoolAllocator->allocate(size);
+        else
+            return mPoolAllocator->allocateLarge(size);
+    }
+
+    void resolve(LazyValueType & value) {
+        value.mResolved = 1;
+        if (value.mValue.isObject())
+            resolveContainer<MemberType>(value, true);
+        else if (value.mValue.isArray())
+            resolveContainer<LazyValueType>(value, false);
+        else
+            resolveScalar(value);
+    }
+
+    void resolveScalar(LazyValueType & value) {
+        mHandler.value = &value.mValue;
+        const CharType * src = value.mSource;
+        const CharType * end = mReader.parseScalar(src, mHandler);
+        if (mReader.hasParseError()) {
+            value.mValue.setNull();
+            setReaderError();
+        }
+        else if (*src != '"' && *src != '\'' && end != internal::SkipScalarToken(src)) {
+            // The number or literal must be the whole token skipped by skipValue(),
+            // such as "106n9" or "nullx" is invalid.
+            value.mValue.setNull();
+            setError(kValueInvalidError, static_cast<size_t>(end - mInputStream.getBegin()));
+        }
+    }
+
+    LazyValueType & pushChild(MemberType *) {
+        return (new (mChildren.template push<MemberType>()) MemberType())->value;
+    }
+
+    LazyValueType & pushChild(LazyValueType *) {
+        return *(new (mChildren.template push<LazyValueType>()) LazyValueType());
+    }
+
+    // Find the direct children of the container, the children are still lazy.
+    template <typename ChildT>
+    void resolveContainer(LazyValueType & value, bool isObject) {
+        const CharType closer = isObject ? '}' : ']';
+        const CharType * src = internal::SkipWhiteSpaces(value.mSource + 1);
+        mChildren.clear();
+        if (*src != closer) {
+            for (;;) {
+                LazyValueType * child = &pushChild(static_cast<ChildT *>(NULL));
+                if (isObject) {
+                    ChildT * children = mChildren.template Top<ChildT>();
+                    mHandler.value = &reinterpret_cast<MemberType *>(children)->name;
+                    src = mReader.parseMemberName(src, mHandler);
+                    if (mReader.hasParseError()) {
+                        mChildren.template pop<ChildT>(1);
+                        setReaderError();
+                        break;
+                    }
+                }
+                src = internal::SkipWhiteSpaces(src);
+                child->init(src, this);
+                src = mReader.skipValue(src);
+                if (mReader.hasParseError()) {
+                    mChildren.template pop<ChildT>(1);
+                    setReaderError();
+                    break;
+                }
+
+                src = internal::SkipWhiteSpaces(src);
+                if (*src == ',') {
+                    src = internal::SkipWhiteSpaces(src + 1);
+                }
+                else {
+                    if (*src != closer) {
+                        setError(isObject ? kObjectMissCommaOrCurlyBracketError
+                                          : kArrayMissCommaOrSquareBracketError,
+                                 static_cast<size_t>(src - mInputStream.getBegin()));
+                    }
+                    break;
+                }
+            }
+        }
+
+        // Move the children to the pool allocator.
+        size_t size = mChildren.getSize();
+        value.mSize = static_cast<typename LazyValueType::SizeType>(size / sizeof(ChildT));
+        if (size != 0) {
+            value.mChildren = allocate(size);
+            ::memcpy(value.mChildren, mChildren.template Bottom<ChildT>(), size);
+        }
+        mChildren.clear();
+    }
+};
+
+}  // namespace JsonFx
+
+// Define default LazyDocument class type
+typedef JsonFx::BasicLazyDocument<>     jfxLazyDocument;
+
+#endif  /* !_JSONFX_LAZYDOCUMENT_H_ */
@@ -0,0 +1,309 @@
+
+#ifndef _JSONFX_NDJSONREADER_H_
+#define _JSONFX_NDJSONREADER_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include <string.h>
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Allocator.h"
+#include "JsonFx/ParseResult.h"
+#include "JsonFx/Reader.h"
+#include "JsonFx/Document.h"
+#include "JsonFx/Stack.h"
+#include "JsonFx/Stream/StringInputStream.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/assert.h"
+
+namespace JsonFx {
+
+namespace internal {
+
+// Return the first '\n' from src, or the '\0' terminator.
+template <typename CharT>
+static inline
+const CharT * FindLineEnd(const CharT * src) {
+    while (*src != '\n' && *src != '\0') {
+        ++src;
+    }
+    return src;
+}
+
+static inline
+const char * FindLineEnd(const char * src) {
+    const char * lf = ::strchr(src, '\n');
+    return (lf != NULL) ? lf : (src + ::strlen(src));
+}
+
+// Count the '\n' chars in [src, end).
+template <typename CharT>
+static inline
+size_t CountLineFeeds(const CharT * src, const CharT * end) {
+    size_t count = 0;
+    for (; src < end; ++src) {
+        if (*src == '\n')
+            ++count;
+    }
+    return count;
+}
+
+static inline
+size_t CountLineFeeds(const char * src, const char * end) {
+    size_t count = 0;
+    while (src < end) {
+        src = reinterpret_cast<const char *>(::memchr(src, '\n', static_cast<size_t>(end - src)));
+        if (src == NULL)
+            break;
+        ++src;
+        ++count;
+    }
+    return count;
+}
+
+}  // namespace internal
+
+// Forward declaration.
+template <typename EncodingT = JSONFX_DEFAULT_ENCODING,
+          typename PoolAllocatorT = DefaultPoolAllocator,
+          typename AllocatorT = DefaultAllocator>
+class BasicNdjsonReader;
+
+// Define default NdjsonReader class type
+typedef BasicNdjsonReader<>     NdjsonReader;
+
+//
+// The reader of the newline delimited JSON (NDJSON, JSON Lines), a record
+// per line, the blank lines are ignored:
+//
+//   NdjsonReader reader(text);
+//   while (reader.next()) {
+//       if (!reader.hasParseError())
+//           process(reader.getDocument());
+//   }
+//
+// All the records are parsed into the same document, it's reset (with its
+// pool allocator, see BasicDocument::reset()) before each record, so the
+// values of a record are valid until the next record is read.
+//
+// A invalid record doesn't stop the reading, the error offset is relative to
+// the record (see getRecordOffset()), and the reader continues from the next
+// line. A record must be one line, the line feeds in the strings must be
+// escaped, and the record which runs over its line is invalid (it's a
+// kValueInvalidError at the line feed), so the records are the same as the
+// ones read by ParallelNdjsonReader from the shards of lines. A record is
+// parsed from a '\0' terminated copy of its line, so a broken record never
+// makes the parser read the rest of the text.
+//
+template <typename EncodingT /* = JSONFX_DEFAULT_ENCODING */,
+          typename PoolAllocatorT /* = DefaultPoolAllocator */,
+          typename AllocatorT /* = DefaultAllocator */>
+class BasicNdjsonReader {
+public:
+    typedef typename EncodingT::CharType                        CharType;
+    typedef size_t                                              SizeType;
+    typedef PoolAllocatorT                                      PoolAllocatorType;
+    typedef BasicDocument<EncodingT, PoolAllocatorT, AllocatorT> DocumentType;
+    typedef typename DocumentType::ValueType                    ValueType;
+    typedef typename DocumentType::StringInputStreamType        StringInputStreamType;
+    typedef typename DocumentType::ParseResultType              ParseResultType;
+    typedef BasicStack<AllocatorT>                              StackType;
+
+private:
+    DocumentType        mDocument;
+    const CharType *    mText;
+    const CharType *    mEnd;           // The records begin at or after it are not read, or NULL.
+    const CharType *    mCursor;        // The beginning of the next line.
+    const CharType *    mRecord;        // The beginning of the current record.
+    size_t              mLine;          // The line number of the current record, 1 based.
+    size_t              mNextLine;      // The line number of mCursor.
+    ParseResultType     mParseResult;
+    StackType           mLineBuffer;    // The copy of the current line, it's reused.
+
+public:
+    BasicNdjsonReader(const PoolAllocatorType * poolAllocator = NULL)
+        : mDocument(poolAllocator), mText(NULL), mEnd(NULL), mCursor(NULL), mRecord(NULL),
+          mLine(0), mNextLine(1), mParseResult(), mLineBuffer()
+    {
+        /* Do nothing! */
+    }
+
+    BasicNdjsonReader(const CharType * text, const PoolAllocatorType * poolAllocator = NULL)
+        : mDocument(poolAllocator), mText(NULL), mEnd(NULL), mCursor(NULL), mRecord(NULL),
+          mLine(0), mNextLine(1), mParseResult(), mLineBuffer()
+    {
+        open(text);
+    }
+
+    ~BasicNdjsonReader() {}
+
+private:
+    //! Prohibit copying
+    BasicNdjsonReader(const BasicNdjsonReader &);
+    //! Prohibit assignment
+    BasicNdjsonReader & operator =(const BasicNdjsonReader &);
+
+public:
+    // Start reading the '\0' terminated text, it must be alive while reading.
+    void open(const CharType * text) {
+        open(text, text, NULL);
+    }
+
+    //
+    // Only read the records begin in [begin, end) of the '\0' terminated text,
+    // the begin must be the beginning of a line, the end is NULL or the
+    // beginning of a line (or the terminator). The line numbers are counted
+    // from begin, the record offsets are still relative to the text.
+    //
+    void open(const CharType * text, const CharType * begin, const CharType * end) {
+        jimi_assert(text != NULL);
+        jimi_assert(begin >= text);
+        jimi_assert(end == NULL || end >= begin);
+        mText     = text;
+        mEnd      = end;
+        mCursor   = begin;
+        mRecord   = begin;
+        mLine     = 0;
+        mNextLine = 1;
+        mParseResult.clear();
+    }
+
+    DocumentType & getDocument()             { return mDocument; }
+    const DocumentType & getDocument() const { return mDocument; }
+
+    bool hasParseError() const { return mParseResult.hasError(); }
+    const ParseResultType & getParseResult() const { return mParseResult; }
+
+    // The line number (1 based) and the offset in the text of the current record.
+    size_t getLine() const         { return mLine; }
+    size_t getRecordOffset() const { return static_cast<size_t>(mRecord - mText); }
+
+    //
+    // Read the next record into the document, return false if there is no
+    // more records. The record maybe invalid, see hasParseError().
+    //
+    template <size_t parseFlags>
+    bool next() {
+        mDocument.reset();
+        return readRecord<parseFlags>();
+    }
+
+    bool next() {
+        return next<kDefaultParseFlags>();
+    }
+
+    //
+    // Read the next record and move its root to the record value, the pool
+    // allocator of document is not reset, so the values of all the records
+    // read by this way are valid until getDocument().reset() is called.
+    //
+    template <size_t parseFlags>
+    bool next(ValueType & record) {
+        if (!readRecord<parseFlags>())
+            return false;
+        record.moveRaw(mDocument);
+        return true;
+    }
+
+    bool next(ValueType & record) {
+        return next<kDefaultParseFlags>(record);
+    }
+
+    //
+    // Read all the records, the callback is called for each record with this
+    // reader: bool callback(BasicNdjsonReader & reader), return false to stop.
+    // Return the count of records have been read.
+    //
+    template <size_t parseFlags, typename CallbackT>
+    size_t forEach(CallbackT & callback) {
+        size_t count = 0;
+        while (next<parseFlags>()) {
+            ++count;
+            if (!callback(*this))
+                break;
+        }
+        return count;
+    }
+
+    template <typename CallbackT>
+    size_t forEach(CallbackT & callback) {
+        return forEach<kDefaultParseFlags>(callback);
+    }
+
+private:
+    template <size_t parseFlags>
+    bool readRecord() {
+        // The records are parsed from the const text one by one.
+        static const size_t kRecordParseFlags = (parseFlags | kStopWhenDoneParseFlag)
+            & ~static_cast<size_t>(kInsituParseFlag | kStructuralIndexParseFlag);
+
+        if (mCursor == NULL)
+            return false;
+
+        // Skip the blank lines.
+        const CharType * src = mCursor;
+        size_t line = mNextLine;
+        for (;;) {
+            while (*src == ' ' || *src == '\t' || *src == '\r') {
+                ++src;
+            }
+            if (*src != '\n')
+                break;
+            ++src;
+            ++line;
+        }
+        mDocument.setNull();
+        mParseResult.clear();
+        if (*src == '\0' || (mEnd != NULL && src >= mEnd)) {
+            mCursor = src;
+            mNextLine = line;
+            return false;
+        }
+
+        mRecord = src;
+        mLine = line;
+
+        // The record ends at the first line feed, even if it's in a string or
+        // in the whitespaces of a container, so the record is parsed from a
+        // '\0' terminated copy of its line, the parser never runs over it.
+        const CharType * lineEnd = internal::FindLineEnd(src);
+        size_t lineLength = static_cast<size_t>(lineEnd - src);
+        mLineBuffer.clear();
+        CharType * lineText = mLineBuffer.template push<CharType>(lineLength + 1);
+        ::memcpy(lineText, src, lineLength * sizeof(CharType));
+        lineText[lineLength] = '\0';
+
+        StringInputStreamType is(lineText);
+        mDocument.template parse<kRecordParseFlags, EncodingT, StringInputStreamType>(is);
+        const CharType * end = is.getCurrent();
+
+        if (!mDocument.hasParseError()) {
+            // Only the whitespaces can follow the record in the line.
+            while (*end == ' ' || *end == '\t' || *end == '\r') {
+                ++end;
+            }
+            if (end < lineText + lineLength)
+                mParseResult.setError(kDocumentRootNotSingularError, static_cast<size_t>(end - lineText));
+        }
+        else {
+            // The record which runs over its line feed is invalid.
+            mParseResult = mDocument.getParseResult();
+            if (*lineEnd == '\n' && mParseResult.getErrorOffset() >= lineLength)
+                mParseResult.setError(kValueInvalidError, lineLength);
+        }
+
+        mCursor = (*lineEnd == '\n') ? (lineEnd + 1) : lineEnd;
+        mNextLine = line + 1;
+        return true;
+    }
+};
+
+}  // namespace JsonFx
+
+// Define default NdjsonReader class type
+typedef JsonFx::BasicNdjsonReader<>     jfxNdjsonReader;
+
+#endif  /* !_JSONFX_NDJSONREADER_H_ */
@@ -0,0 +1,425 @@
+
+#ifndef _JSONFX_PARALLELDOCUMENT_H_
+#define _JSONFX_PARALLELDOCUMENT_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Allocator.h"
+#include "JsonFx/Stack.h"
+#include "JsonFx/ParseResult.h"
+#include "JsonFx/Value.h"
+#include "JsonFx/Reader.h"
+#include "JsonFx/Document.h"
+#include "JsonFx/Internal/String.h"
+#include "JsonFx/Internal/Thread.h"
+#include "JsonFx/Internal/SkipWhiteSpaces.h"
+#include "JsonFx/Internal/ArraySplitter.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/assert.h"
+
+namespace JsonFx {
+
+// Forward declaration.
+template <typename EncodingT = JSONFX_DEFAULT_ENCODING,
+          typename PoolAllocatorT = DefaultPoolAllocator,
+          typename AllocatorT = DefaultAllocator>
+class BasicParallelDocument;
+
+// Define default ParallelDocument class type
+typedef BasicParallelDocument<>     ParallelDocument;
+
+//
+// The document parses a huge top level array on the threads:
+//
+//   ParallelDocument document;        // A thread per logical processor.
+//   document.parse(text, length);
+//
+// The text is split to the segments at the guessed element boundaries (see
+// "JsonFx/Internal/ArraySplitter.h"), and each segment is parsed by a thread
+// into its own document (the arena), then the elements are stitched into
+// the root array, their values are still owned by the arenas.
+//
+// A segment is right if the previous segment stops exactly at its beginning,
+// the first segment is always right, so a wrong guess is detected by the
+// previous segment, and the elements from there to the next right segment
+// are parsed again by the calling thread.
+//
+// The other documents (not an array, or smaller than a segment) are parsed
+// by the calling thread. The values are valid until the next parse.
+//
+template <typename EncodingT /* = JSONFX_DEFAULT_ENCODING */,
+          typename PoolAllocatorT /* = DefaultPoolAllocator */,
+          typename AllocatorT /* = DefaultAllocator */>
+class BasicParallelDocument : public BasicValue<EncodingT, PoolAllocatorT>
+{
+public:
+    typedef typename EncodingT::CharType                            CharType;
+    typedef size_t                                                  SizeType;
+    typedef BasicValue<EncodingT, PoolAllocatorT>                   ValueType;
+    typedef PoolAllocatorT                                          PoolAllocatorType;
+    typedef BasicDocument<EncodingT, PoolAllocatorT, AllocatorT>    DocumentType;
+    typedef typename DocumentType::StringInputStreamType            StringInputStreamType;
+    typedef typename DocumentType::ParseResultType                  ParseResultType;
+    typedef BasicStack<AllocatorT>                                  StackType;
+
+    // The text smaller than a segment per thread is parsed by less threads.
+    static const size_t kMinSegmentSize = 1024 * 1024;
+    static const size_t kMaxThreadCount = 64;
+
+private:
+    enum SegmentState {
+        kSegmentReachedStop,        // Stopped at the first element at or after the stop.
+        kSegmentClosed,             // Stopped at the ']' of the root array.
+        kSegmentError
+    };
+
+    // A thread parses the segment into its own document.
+    struct SegmentContext {
+        DocumentType        document;
+        StackType           elements;
+        const CharType *    begin;
+        const CharType *    stop;
+        const CharType *    end;
+        SegmentState        state;
+        ParseResultType     parseResult;
+    };
+
+    // A run of the stitched elements in a context.
+    struct Piece {
+        size_t  context;
+        size_t  first;
+        size_t  last;
+    };
+
+    struct QuoteParityTask {
+        const CharType *    begin;
+        const CharType *    end;
+        bool                escaped;
+        bool                odd;
+
+        void run() {
+            odd = internal::QuoteParity(begin, end, escaped);
+        }
+    };
+
+    template <size_t parseFlags>
+    struct SegmentTask {
+        BasicParallelDocument * owner;
+        SegmentContext *        context;
+
+        void run() {
+            owner->template parseSegment<parseFlags>(*context, context->begin, context->stop);
+        }
+    };
+
+    size_t                  mThreadCount;
+    SegmentContext *        mContexts;
+    PoolAllocatorType *     mPoolAllocator;     // For the root array.
+    StackType               mPieces;
+    StackType               mElements;
+    const CharType *        mText;
+    ParseResultType         mParseResult;
+    size_t                  mSegmentCount;
+    size_t                  mMisguessCount;
+
+public:
+    // Use a thread per logical processor if threadCount is 0.
+    BasicParallelDocument(size_t threadCount = 0)
+        : ValueType(),
+          mThreadCount((threadCount != 0) ? threadCount : internal::GetProcessorCount()),
+          mContexts(NULL), mPoolAllocator(NULL), mPieces(), mElements(),
+          mText(NULL), mParseResult(), mSegmentCount(0), mMisguessCount(0)
+    {
+        mContexts = new SegmentContext[mThreadCount];
+        mPoolAllocator = new PoolAllocatorType();
+        jimi_assert(mContexts != NULL && mPoolAllocator != NULL);
+    }
+
+    ~BasicParallelDocument() {
+        // The values are released with the pools.
+        ValueType::setNull();
+        delete[] mContexts;
+        delete mPoolAllocator;
+    }
+
+private:
+    //! Prohibit copying
+    BasicParallelDocument(const BasicParallelDocument &);
+    //! Prohibit assignment
+    BasicParallelDocument & operator =(const BasicParallelDocument &);
+
+public:
+    size_t getThreadCount() const { return mThreadCount; }
+
+    const ParseResultType & getParseResult() const { return mParseResult; }
+    bool hasParseError() const { return mParseResult.hasError(); }
+
+    // The count of segments parsed by the threads and the wrong guesses of the last parse.
+    size_t getSegmentCount() const  { return mSegmentCount; }
+    size_t getMisguessCount() const { return mMisguessCount; }
+
+    //
+    // Parse the '\0' terminated text (text[length] == '\0'), the text must
+    // be alive while the document is used. The kInsituParseFlag is ignored.
+    //
+    template <size_t parseFlags>
+    BasicParallelDocument & parse(const CharType * text, size_t length) {
+        static const size_t kFlags = parseFlags & ~static_cast<size_t>(kInsituParseFlag);
+
+        jimi_assert(text != NULL);
+        jimi_assert(text[length] == '\0');
+        prepareParse(text);
+
+        size_t segmentCount = length / kMinSegmentSize;
+        if (segmentCount > mThreadCount)
+            segmentCount = mThreadCount;
+        if (segmentCount > kMaxThreadCount)
+            segmentCount = kMaxThreadCount;
+        const CharType * first = internal::SkipWhiteSpaces(text);
+        if (segmentCount < 2 || *first != '[')
+            return parseSerial<kFlags>(text);
+        first = internal::SkipWhiteSpaces(first + 1);
+        if (*first == ']' || *first == '\0')
+            return parseSerial<kFlags>(text);
+
+        const CharType * splits[kMaxThreadCount];
+        segmentCount = guessSplits(text, length, first, splits, segmentCount);
+        if (segmentCount < 2)
+            return parseSerial<kFlags>(text);
+
+        // Parse the segments, the last one is not stopped.
+        SegmentTask<kFlags> tasks[kMaxThreadCount];
+        for (size_t i = 0; i < segmentCount; ++i) {
+            mContexts[i].begin = splits[i];
+            mContexts[i].stop  = (i + 1 < segmentCount) ? splits[i + 1] : NULL;
+            tasks[i].owner   = this;
+            tasks[i].context = &mContexts[i];
+        }
+        runTasks(tasks, segmentCount);
+        mSegmentCount = segmentCount;
+
+        stitch<kFlags>(splits, segmentCount);
+        return *this;
+    }
+
+    BasicParallelDocument & parse(const CharType * text, size_t length) {
+        return parse<kDefaultParseFlags>(text, length);
+    }
+
+    BasicParallelDocument & parse(const CharType * text) {
+        jimi_assert(text != NULL);
+        return parse<kDefaultParseFlags>(text, internal::StrLen(text));
+    }
+
+private:
+    void prepareParse(const CharType * text) {
+        ValueType::setNull();
+        mParseResult.clear();
+        for (size_t i = 0; i < mThreadCount; ++i) {
+            mContexts[i].document.reset();
+            mContexts[i].elements.clear();
+            mContexts[i].parseResult.clear();
+        }
+        mPieces.clear();
+        mElements.clear();
+        mPoolAllocator->reset();
+        mText = text;
+        mSegmentCount = 0;
+        mMisguessCount = 0;
+    }
+
+    template <size_t parseFlags>
+    BasicParallelDocument & parseSerial(const CharType * text) {
+        DocumentType & document = mContexts[0].document;
+        document.template parse<parseFlags>(text);
+        mParseResult = document.getParseResult();
+        if (!mParseResult.hasError())
+            ValueType::moveRaw(document);
+        return *this;
+    }
+
+    template <typename TaskT>
+    void runTasks(TaskT * tasks, size_t count) {
+        internal::Thread threads[kMaxThreadCount];
+        // The calling thread runs the first task, and the tasks of the
+        // threads can't be started.
+        for (size_t i = 1; i < count; ++i) {
+            if (!threads[i].start(&tasks[i]))
+                tasks[i].run();
+        }
+        tasks[0].run();
+        for (size_t i = 1; i < count; ++i) {
+            threads[i].join();
+        }
+    }
+
+    //
+    // Guess the beginnings of the segments, the first one is the first element.
+    // Return the count of segments.
+    //
+    size_t guessSplits(const CharType * text, size_t length, const CharType * first,
+                       const CharType ** splits, size_t segmentCount) {
+        // The quote pre-pass, the chunks (except the first) begin at the
+        // 64 bytes boundaries.
+        const CharType * textEnd = text + length;
+        QuoteParityTask tasks[kMaxThreadCount];
+        size_t chunkCount = 0;
+        for (size_t i = 0; i < segmentCount; ++i) {
+            const CharType * begin = first;
+            if (i > 0) {
+                begin = text + (length / segmentCount) * i;
+                begin = reinterpret_cast<const CharType *>(
+                    reinterpret_cast<uintptr_t>(begin) & ~static_cast<uintptr_t>(63));
+                if (begin <= tasks[chunkCount - 1].begin)
+                    continue;
+            }
+            tasks[chunkCount].begin   = begin;
+            tasks[chunkCount].escaped = internal::IsEscapedChar(text, begin);
+            tasks[chunkCount].odd     = false;
+            if (chunkCount > 0)
+                tasks[chunkCount - 1].end = begin;
+            ++chunkCount;
+        }
+        tasks[chunkCount - 1].end = textEnd;
+        runTasks(tasks, chunkCount);
+
+        // Guess a boundary from the beginning of each chunk.
+        size_t count = 1;
+        splits[0] = first;
+        bool inString = tasks[0].odd;
+        for (size_t i = 1; i < chunkCount; ++i) {
+            const CharType * guess = internal::FindElementBoundary(tasks[i].begin, tasks[i].end,
+                inString, tasks[i].escaped, *first);
+            if (guess != NULL && guess > splits[count - 1])
+                splits[count++] = guess;
+            inString = (inString != tasks[i].odd);
+        }
+        return count;
+    }
+
+    //
+    // Parse the elements from src until the first one at or after stop (if
+    // stop is not NULL), or the end of array.
+    //
+    template <size_t parseFlags>
+    void parseSegment(SegmentContext & context, const CharType * src, const CharType * stop) {
+        static const size_t kElementParseFlags = (parseFlags | kStopWhenDoneParseFlag)
+            & ~static_cast<size_t>(kInsituParseFlag | kStructuralIndexParseFlag);
+
+        DocumentType & document = context.document;
+        for (;;) {
+            if (stop != NULL && src >= stop) {
+                context.state = kSegmentReachedStop;
+                break;
+            }
+            StringInputStreamType is(src);
+            document.template parse<kElementParseFlags, EncodingT, StringInputStreamType>(is);
+            if (document.hasParseError()) {
+                context.parseResult.setError(document.getParseResult().getError(),
+                    static_cast<size_t>(src - mText) + document.getParseResult().getErrorOffset());
+                context.state = kSegmentError;
+                break;
+            }
+            context.elements.template push<ValueType>()->moveRaw(document);
+
+            src = internal::SkipWhiteSpaces(is.getCurrent());
+            if (*src == ',') {
+                src = internal::SkipWhiteSpaces(src + 1);
+            }
+            else if (*src == ']') {
+                context.state = kSegmentClosed;
+                break;
+            }
+            else {
+                context.parseResult.setError(kArrayMissCommaOrSquareBracketError,
+                    static_cast<size_t>(src - mText));
+                context.state = kSegmentError;
+                break;
+            }
+        }
+        context.end = src;
+    }
+
+    void addPiece(size_t context, size_t first) {
+        Piece * piece = mPieces.template push<Piece>();
+        piece->context = context;
+        piece->first   = first;
+        piece->last    = mContexts[context].elements.getSize() / sizeof(ValueType);
+    }
+
+    // Link the right segments, and parse the elements between them again.
+    template <size_t parseFlags>
+    void stitch(const CharType ** splits, size_t segmentCount) {
+        SegmentContext & fixup = mContexts[0];
+        size_t segment = 0;
+        SegmentContext * context = &mContexts[0];
+        addPiece(0, 0);
+        for (;;) {
+            if (context->state == kSegmentError) {
+                mParseResult = context->parseResult;
+                return;
+            }
+            if (context->state == kSegmentClosed)
+                break;
+
+            // Find the next segment begins at the stop point.
+            const CharType * src = context->end;
+            size_t next = segment + 1;
+            while (next < segmentCount && splits[next] < src) {
+                // The guess is in an element.
+                ++next;
+                ++mMisguessCount;
+            }
+            if (next < segmentCount && splits[next] == src) {
+                segment = next;
+                context = &mContexts[segment];
+                addPiece(segment, 0);
+            }
+            else {
+                // Parse the elements from src to the next guess again.
+                size_t first = fixup.elements.getSize() / sizeof(ValueType);
+                parseSegment<parseFlags>(fixup, src,
+                    (next < segmentCount) ? splits[next] : NULL);
+                addPiece(0, first);
+                segment = next - 1;
+                context = &fixup;
+            }
+        }
+
+        // Only the whitespaces can follow the root array.
+        const CharType * end = internal::SkipWhiteSpaces(context->end + 1);
+        if (*end != '\0') {
+            mParseResult.setError(kDocumentRootNotSingularError, static_cast<size_t>(end - mText));
+            return;
+        }
+
+        // Move the elements of pieces to the root array.
+        const Piece * pieces = mPieces.template Bottom<Piece>();
+        size_t pieceCount = mPieces.getSize() / sizeof(Piece);
+        size_t count = 0;
+        for (size_t i = 0; i < pieceCount; ++i) {
+            count += pieces[i].last - pieces[i].first;
+        }
+        ValueType * elements = mElements.template push<ValueType>(count);
+        for (size_t i = 0; i < pieceCount; ++i) {
+            size_t size = pieces[i].last - pieces[i].first;
+            internal::CopyRaw(elements, mContexts[pieces[i].context].elements.template Bottom<ValueType>()
+                              + pieces[i].first, size);
+            elements += size;
+        }
+        ValueType::setArrayRaw(mElements.template Bottom<ValueType>(),
+            static_cast<typename ValueType::SizeType>(count), mPoolAllocator);
+        mElements.reset();
+    }
+};
+
+}  // namespace JsonFx
+
+// Define default ParallelDocument class type
+typedef JsonFx::BasicParallelDocument<>     jfxParallelDocument;
+
+#endif  /* !_JSONFX_PARALLELDOCUMENT_H_ */
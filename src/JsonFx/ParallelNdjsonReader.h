@@ -0,0 +1,377 @@
+
+#ifndef _JSONFX_PARALLELNDJSONREADER_H_
+#define _JSONFX_PARALLELNDJSONREADER_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include <new>
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Allocator.h"
+#include "JsonFx/Stack.h"
+#include "JsonFx/ParseResult.h"
+#include "JsonFx/NdjsonReader.h"
+#include "JsonFx/Internal/Thread.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/assert.h"
+
+namespace JsonFx {
+
+// Forward declaration.
+template <typename EncodingT = JSONFX_DEFAULT_ENCODING,
+          typename PoolAllocatorT = DefaultPoolAllocator,
+          typename AllocatorT = DefaultAllocator>
+class BasicParallelNdjsonReader;
+
+// Define default ParallelNdjsonReader class type
+typedef BasicParallelNdjsonReader<>     ParallelNdjsonReader;
+
+//
+// Parse a large NDJSON text with the threads, the text is split into the
+// shards at the line boundaries, and each worker thread parses the shards
+// with its own reader (the document and pool allocator), so the workers
+// share nothing but the shard cursor:
+//
+//   ParallelNdjsonReader reader;      // A worker per logical processor.
+//   reader.forEach(text, length, callback);
+//
+// The callback is called for each record: bool callback(const Record & record),
+// return false to stop all the workers. The values of a record are valid
+// until the callback returns.
+//
+//   forEach():          the records are delivered in the order of text, the
+//                       callback is called by the workers one at a time, a
+//                       worker parses a whole shard before its turn.
+//   forEachUnordered(): the callback is called by the workers concurrently
+//                       as soon as the records are parsed, it must be thread
+//                       safe, the Record::getWorker() is the index of worker
+//                       for the per-thread results without locking.
+//
+// The text must be '\0' terminated (text[length] == '\0'), and a record can't
+// span the lines, since a shard may begin in the middle of such a record.
+// The line numbers are not counted, the record offsets are relative to the
+// text.
+//
+template <typename EncodingT /* = JSONFX_DEFAULT_ENCODING */,
+          typename PoolAllocatorT /* = DefaultPoolAllocator */,
+          typename AllocatorT /* = DefaultAllocator */>
+class BasicParallelNdjsonReader {
+public:
+    typedef BasicNdjsonReader<EncodingT, PoolAllocatorT, AllocatorT>  ReaderType;
+    typedef typename ReaderType::CharType                           CharType;
+    typedef size_t                                                  SizeType;
+    typedef typename ReaderType::ValueType                          ValueType;
+    typedef typename ReaderType::ParseResultType                    ParseResultType;
+    typedef BasicStack<AllocatorT>                                  StackType;
+
+    // The shard size is about (length / (threads * kShardsPerThread)), it's
+    // small enough to balance the workers, and bounds the records buffered
+    // by a worker in order.
+    static const size_t kShardsPerThread = 4;
+    static const size_t kMinShardSize    = 64 * 1024;
+    static const size_t kMaxShardSize    = 4 * 1024 * 1024;
+
+    // The record delivered to the callback.
+    class Record {
+    private:
+        ValueType           mValue;
+        ParseResultType     mParseResult;
+        size_t              mOffset;
+        size_t              mWorker;
+
+        friend class BasicParallelNdjsonReader;
+
+    public:
+        Record(size_t worker) : mValue(), mParseResult(), mOffset(0), mWorker(worker) {}
+        ~Record() {}
+
+    private:
+        //! Prohibit copying
+        Record(const Record &);
+        //! Prohibit assignment
+        Record & operator =(const Record &);
+
+    public:
+        // The root of record, it's null if the record is invalid.
+        const ValueType & getValue() const { return mValue; }
+
+        bool hasParseError() const { return mParseResult.hasError(); }
+        const ParseResultType & getParseResult() const { return mParseResult; }
+
+        size_t getOffset() const { return mOffset; }
+        size_t getWorker() const { return mWorker; }
+    };
+
+private:
+    // The state of a worker kept across the parses, the pools are reused.
+    struct WorkerContext {
+        ReaderType  reader;
+        StackType   records;        // The records of a shard waiting for its turn.
+        size_t      count;
+    };
+
+    template <size_t parseFlags, typename CallbackT>
+    class Worker {
+    private:
+        BasicParallelNdjsonReader * mOwner;
+        CallbackT *                 mCallback;
+        size_t                      mIndex;
+
+    public:
+        Worker() : mOwner(NULL), mCallback(NULL), mIndex(0) {}
+
+        void init(BasicParallelNdjsonReader * owner, CallbackT * callback, size_t index) {
+            mOwner    = owner;
+            mCallback = callback;
+            mIndex    = index;
+        }
+
+        void run() {
+            mOwner->template work<parseFlags, CallbackT>(mIndex, *mCallback);
+        }
+    };
+
+    size_t              mThreadCount;
+    WorkerContext *     mContexts;
+
+    // The shared state of a parse, guarded by mMutex.
+    const CharType *    mText;
+    const CharType *    mTextEnd;
+    const CharType *    mNextShard;
+    size_t              mShardSize;
+    size_t              mShardCount;    // The count of the shards have been taken.
+    size_t              mTurn;          // The shard whose records are delivered now.
+    bool                mOrdered;
+    internal::AtomicFlag mStopped;  // It's also read without the lock.
+
+    internal::Mutex     mMutex;
+    internal::Condition mTurnChanged;
+
+public:
+    // Use a worker per logical processor if threadCount is 0.
+    BasicParallelNdjsonReader(size_t threadCount = 0)
+        : mThreadCount((threadCount != 0) ? threadCount : internal::GetProcessorCount()),
+          mContexts(NULL), mText(NULL), mTextEnd(NULL), mNextShard(NULL),
+          mShardSize(0), mShardCount(0), mTurn(0), mOrdered(true), mStopped()
+    {
+        mContexts = new WorkerContext[mThreadCount];
+        jimi_assert(mContexts != NULL);
+    }
+
+    ~BasicParallelNdjsonReader() {
+        delete[] mContexts;
+    }
+
+private:
+    //! Prohibit copying
+    BasicParallelNdjsonReader(const BasicParallelNdjsonReader &);
+    //! Prohibit assignment
+    BasicParallelNdjsonReader & operator =(const BasicParallelNdjsonReader &);
+
+public:
+    size_t getThreadCount() const { return mThreadCount; }
+
+    //
+    // Read all the records in the order of text, return the count of records
+    // have been delivered.
+    //
+    template <size_t parseFlags, typename CallbackT>
+    size_t forEach(const CharType * text, size_t length, CallbackT & callback) {
+        return parse<parseFlags, CallbackT>(text, length, callback, true);
+    }
+
+    template <typename CallbackT>
+    size_t forEach(const CharType * text, size_t length, CallbackT & callback) {
+        return forEach<kDefaultParseFlags>(text, length, callback);
+    }
+
+    //
+    // Read all the records in any order, the callback is called concurrently,
+    // return the count of records have been delivered.
+    //
+    template <size_t parseFlags, typename CallbackT>
+    size_t forEachUnordered(const CharType * text, size_t length, CallbackT & callback) {
+        return parse<parseFlags, CallbackT>(text, length, callback, false);
+    }
+
+    template <typename CallbackT>
+    size_t forEachUnordered(const CharType * text, size_t length, CallbackT & callback) {
+        return forEachUnordered<kDefaultParseFlags>(text, length, callback);
+    }
+
+private:
+    template <size_t parseFlags, typename CallbackT>
+    size_t parse(const CharType * text, size_t length, CallbackT & callback, bool ordered) {
+        typedef Worker<parseFlags, CallbackT> WorkerType;
+
+        jimi_assert(text != NULL);
+        jimi_assert(text[length] == '\0');
+
+        size_t shardSize = length / (mThreadCount * kShardsPerThread);
+        if (shardSize < kMinShardSize)
+            shardSize = kMinShardSize;
+        else if (shardSize > kMaxShardSize)
+            shardSize = kMaxShardSize;
+
+        mText       = text;
+        mTextEnd    = text + length;
+        mNextShard  = text;
+        mShardSize  = shardSize;
+        mShardCount = 0;
+        mTurn       = 0;
+        mOrdered    = ordered;
+        mStopped.set(false);
+
+        // Don't start the threads which have no shard.
+        size_t threadCount = (length + shardSize - 1) / shardSize;
+        if (threadCount > mThreadCount)
+            threadCount = mThreadCount;
+        if (threadCount == 0)
+            threadCount = 1;
+
+        WorkerType * workers = new WorkerType[threadCount];
+        internal::Thread * threads = new internal::Thread[threadCount];
+        jimi_assert(workers != NULL && threads != NULL);
+        for (size_t i = 0; i < threadCount; ++i) {
+            mContexts[i].count = 0;
+            workers[i].init(this, &callback, i);
+        }
+
+        // The calling thread is the first worker, the shards are taken on
+        // demand, so it's fine if a thread can't be started.
+        for (size_t i = 1; i < threadCount; ++i) {
+            threads[i].start(&workers[i]);
+        }
+        workers[0].run();
+
+        size_t count = mContexts[0].count;
+        for (size_t i = 1; i < threadCount; ++i) {
+            threads[i].join();
+            count += mContexts[i].count;
+        }
+        delete[] threads;
+        delete[] workers;
+
+        mText = mTextEnd = mNextShard = NULL;
+        return count;
+    }
+
+    // Take the next shard, return false if no more shards or stopped.
+    bool nextShard(const CharType * & begin, const CharType * & end, size_t & shard) {
+        internal::ScopedLock lock(mMutex);
+        if (mStopped.get() || mNextShard >= mTextEnd)
+            return false;
+
+        begin = mNextShard;
+        if (static_cast<size_t>(mTextEnd - begin) > mShardSize) {
+            // Cut the shard after the next line feed.
+            const CharType * lineEnd = internal::FindLineEnd(begin + mShardSize);
+            end = (*lineEnd == '\n') ? (lineEnd + 1) : mTextEnd;
+        }
+        else {
+            end = mTextEnd;
+        }
+        mNextShard = end;
+        shard = mShardCount++;
+        return true;
+    }
+
+    void stop() {
+        internal::ScopedLock lock(mMutex);
+        mStopped.set(true);
+        mTurnChanged.notifyAll();
+    }
+
+    // Wait for the turn of shard, return false if stopped.
+    bool waitTurn(size_t shard) {
+        internal::ScopedLock lock(mMutex);
+        while (mTurn != shard && !mStopped.get()) {
+            mTurnChanged.wait(mMutex);
+        }
+        return !mStopped.get();
+    }
+
+    void finishTurn() {
+        internal::ScopedLock lock(mMutex);
+        ++mTurn;
+        mTurnChanged.notifyAll();
+    }
+
+    template <size_t parseFlags>
+    Record * readRecord(WorkerContext & context, size_t worker) {
+        Record * record = new (context.records.template push<Record>()) Record(worker);
+        if (!context.reader.template next<parseFlags>(record->mValue)) {
+            record->~Record();
+            context.records.template pop<Record>(1);
+            return NULL;
+        }
+        record->mParseResult = context.reader.getParseResult();
+        record->mOffset = context.reader.getRecordOffset();
+        return record;
+    }
+
+    // Release the records and reset the pool allocator of worker.
+    void releaseRecords(WorkerContext & context) {
+        Record * begin = context.records.template Bottom<Record>();
+        Record * end = begin + context.records.getSize() / sizeof(Record);
+        for (Record * record = begin; record != end; ++record) {
+            record->~Record();
+        }
+        context.records.clear();
+        context.reader.getDocument().reset();
+    }
+
+    template <size_t parseFlags, typename CallbackT>
+    void work(size_t worker, CallbackT & callback) {
+        WorkerContext & context = mContexts[worker];
+        const CharType * begin;
+        const CharType * end;
+        size_t shard;
+        while (nextShard(begin, end, shard)) {
+            context.reader.open(mText, begin, end);
+            bool proceed = true;
+            if (mOrdered) {
+                // Parse the whole shard before its turn.
+                while (readRecord<parseFlags>(context, worker) != NULL && !mStopped.get()) {
+                    /* Do nothing! */
+                }
+                if (waitTurn(shard)) {
+                    Record * record = context.records.template Bottom<Record>();
+                    Record * last = record + context.records.getSize() / sizeof(Record);
+                    for (; record != last && proceed; ++record) {
+                        ++context.count;
+                        proceed = callback(static_cast<const Record &>(*record));
+                    }
+                    if (proceed)
+                        finishTurn();
+                }
+                else {
+                    proceed = false;
+                }
+                releaseRecords(context);
+            }
+            else {
+                Record * record;
+                while (proceed && !mStopped.get() && (record = readRecord<parseFlags>(context, worker)) != NULL) {
+                    ++context.count;
+                    proceed = callback(static_cast<const Record &>(*record));
+                    releaseRecords(context);
+                }
+            }
+            if (!proceed) {
+                stop();
+                break;
+            }
+        }
+    }
+};
+
+}  // namespace JsonFx
+
+// Define default ParallelNdjsonReader class type
+typedef JsonFx::BasicParallelNdjsonReader<>     jfxParallelNdjsonReader;
+
+#endif  /* !_JSONFX_PARALLELNDJSONREADER_H_ */
@@ -19,7 +19,19 @@ enum ParseErrorCode {
     kValueStringMissQuoteError,
     kStringUnicodeSurrogateInvalidError,
     kStringUnicodeEscapeInvalidHexError,
+    kStringInvalidEncodingError,
     kStringUnknownEscapeCharsWarnning,
+    kDocumentEmptyError,
+    kDocumentRootNotSingularError,
+    kValueInvalidError,
+    kObjectMissNameError,
+    kObjectMissColonError,
+    kObjectMissCommaOrCurlyBracketError,
+    kArrayMissCommaOrSquareBracketError,
+    kNumberMissFractionError,
+    kNumberMissExponentError,
+    kNumberTooBigError,
+    kTerminationError,
     kLastParseError
 };
 
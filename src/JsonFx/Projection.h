@@ -0,0 +1,253 @@
+
+#ifndef _JSONFX_PROJECTION_H_
+#define _JSONFX_PROJECTION_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Allocator.h"
+#include "JsonFx/CharSet.h"
+#include "JsonFx/Stack.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/assert.h"
+
+namespace JsonFx {
+
+// Forward declaration.
+template <typename EncodingT = DefaultEncoding,
+          typename AllocatorT = DefaultAllocator>
+class BasicProjection;
+
+// Define default Projection class type
+typedef BasicProjection<>   Projection;
+
+//
+// The compiled set of paths for the projected parsing, only the values on
+// the paths are built, the others are skipped (see BasicReader::parse(is,
+// handler, projection) and BasicDocument::parse(text, projection)):
+//
+//   Projection projection;
+//   projection.addPointer("/user/name");       // JSON Pointer (RFC 6901)
+//   projection.addKeyPath("items.*.id");       // The dot separated keys
+//   document.parse(json, projection);
+//
+// A step matches a member by the name, or a element by the decimal index.
+// The "*" step matches all the members and elements which have no exact step
+// in the same place. The empty path selects the whole document.
+//
+// The root and the objects and arrays on the way to a selected value are
+// kept (maybe empty), the arrays only keep the selected elements in order.
+// A path which is cut by a scalar value selects nothing, a scalar root which
+// is not selected is replaced by a null.
+//
+template <typename EncodingT /* = DefaultEncoding */,
+          typename AllocatorT /* = DefaultAllocator */>
+class BasicProjection {
+public:
+    typedef typename EncodingT::CharType    CharType;
+    typedef size_t                          SizeType;
+    typedef AllocatorT                      AllocatorType;
+    typedef BasicStack<AllocatorT>          StackType;
+
+    static const uint32_t kRootNode = 0;
+    static const uint32_t kNoNode   = 0xFFFFFFFFU;
+
+private:
+    static const uint32_t kNoIndex  = 0xFFFFFFFFU;
+
+    // The node of the paths tree, a node is a step of the paths.
+    struct Node {
+        uint32_t    keyOffset;      // The offset of the name in the keys stack.
+        uint32_t    keyLength;
+        uint32_t    index;          // The element index, or kNoIndex if the name is not a index.
+        uint32_t    firstChild;
+        uint32_t    nextSibling;
+        uint32_t    wildcard;       // The "*" step.
+        uint32_t    selected;       // The whole value is selected, the children are ignored.
+    };
+
+    StackType   mNodes;
+    StackType   mKeys;
+
+public:
+    BasicProjection(const AllocatorType * allocator = NULL)
+        : mNodes(allocator), mKeys(allocator)
+    {
+        clear();
+    }
+
+    ~BasicProjection() {}
+
+private:
+    //! Prohibit copying
+    BasicProjection(const BasicProjection &);
+    //! Prohibit assignment
+    BasicProjection & operator =(const BasicProjection &);
+
+public:
+    // Remove all the paths, the projection selects nothing.
+    void clear() {
+        mNodes.clear();
+        mKeys.clear();
+        Node * root = mNodes.template push<Node>();
+        root->keyOffset   = 0;
+        root->keyLength   = 0;
+        root->index       = kNoIndex;
+        root->firstChild  = kNoNode;
+        root->nextSibling = kNoNode;
+        root->wildcard    = 0;
+        root->selected    = 0;
+    }
+
+    //
+    // Add a JSON Pointer (RFC 6901) path, such as "/a/b~1c/0", the "~0" and "~1"
+    // are unescaped to '~' and '/'. Return false if the pointer is invalid.
+    //
+    bool addPointer(const CharType * pointer) {
+        jimi_assert(pointer != NULL);
+        if (*pointer == '\0')
+            return addSteps(pointer, false, '/');
+        if (*pointer != '/')
+            return false;
+        // Check the escapes before any change.
+        for (const CharType * p = pointer; *p != '\0'; ++p) {
+            if (*p == '~' && *(p + 1) != '0' && *(p + 1) != '1')
+                return false;
+        }
+        return addSteps(pointer + 1, true, '/');
+    }
+
+    // Add a path of the dot separated keys, such as "a.b.0", the keys can't contain '.'.
+    bool addKeyPath(const CharType * path) {
+        jimi_assert(path != NULL);
+        return addSteps(path, (*path != '\0'), '.');
+    }
+
+    bool isSelected(uint32_t node) const {
+        return (getNode(node).selected != 0);
+    }
+
+    // Return the child of node which matches the member name, or kNoNode.
+    template <typename KeyCharT>
+    uint32_t findMember(uint32_t node, const KeyCharT * key, SizeType length) const {
+        uint32_t wildcard = kNoNode;
+        for (uint32_t child = getNode(node).firstChild; child != kNoNode; child = getNode(child).nextSibling) {
+            const Node & step = getNode(child);
+            if (step.keyLength == length && isSameKey(step, key))
+                return child;
+            if (step.wildcard != 0)
+                wildcard = child;
+        }
+        return wildcard;
+    }
+
+    // Return the child of node which matches the element index, or kNoNode.
+    uint32_t findElement(uint32_t node, uint32_t index) const {
+        uint32_t wildcard = kNoNode;
+        for (uint32_t child = getNode(node).firstChild; child != kNoNode; child = getNode(child).nextSibling) {
+            const Node & step = getNode(child);
+            if (step.index == index)
+                return child;
+            if (step.wildcard != 0)
+                wildcard = child;
+        }
+        return wildcard;
+    }
+
+private:
+    const Node & getNode(uint32_t node) const {
+        return mNodes.template Bottom<Node>()[node];
+    }
+
+    Node & getNode(uint32_t node) {
+        return mNodes.template Bottom<Node>()[node];
+    }
+
+    template <typename KeyCharT>
+    bool isSameKey(const Node & step, const KeyCharT * key) const {
+        const CharType * name = mKeys.template Bottom<CharType>() + step.keyOffset;
+        for (uint32_t i = 0; i < step.keyLength; ++i) {
+            if (name[i] != static_cast<CharType>(key[i]))
+                return false;
+        }
+        return true;
+    }
+
+    //
+    // Add the steps separated by the separator, hasSteps is false for the
+    // empty path. The pointer escapes are unescaped if the separator is '/'.
+    //
+    bool addSteps(const CharType * path, bool hasSteps, CharType separator) {
+        uint32_t node = kRootNode;
+        while (hasSteps && !getNode(node).selected) {
+            // Copy the name of the step to the keys stack.
+            uint32_t keyOffset = static_cast<uint32_t>(mKeys.getSize() / sizeof(CharType));
+            uint32_t index = 0;
+            bool isIndex = (*path >= '0' && *path <= '9');
+            const CharType * p = path;
+            while (*p != '\0' && *p != separator) {
+                CharType ch = *p++;
+                if (separator == '/' && ch == '~') {
+                    ch = (*p == '0') ? CharType('~') : CharType('/');
+                    ++p;
+                }
+                if (ch >= '0' && ch <= '9' && index <= (kNoIndex - 10) / 10)
+                    index = index * 10 + static_cast<uint32_t>(ch - '0');
+                else
+                    isIndex = false;
+                *mKeys.template push<CharType>() = ch;
+            }
+            uint32_t keyLength = static_cast<uint32_t>(mKeys.getSize() / sizeof(CharType)) - keyOffset;
+            // The leading zeros are not a index, such as "01".
+            if (isIndex && keyLength > 1 && *path == '0')
+                isIndex = false;
+            bool wildcard = (keyLength == 1 && *path == '*');
+
+            uint32_t child = findStep(node, keyOffset, keyLength);
+            if (child != kNoNode) {
+                // Reuse the existing step.
+                mKeys.template pop<CharType>(keyLength);
+            }
+            else {
+                child = static_cast<uint32_t>(mNodes.getSize() / sizeof(Node));
+                Node * step = mNodes.template push<Node>();
+                step->keyOffset   = keyOffset;
+                step->keyLength   = keyLength;
+                step->index       = isIndex ? index : kNoIndex;
+                step->firstChild  = kNoNode;
+                step->nextSibling = getNode(node).firstChild;
+                step->wildcard    = wildcard ? 1 : 0;
+                step->selected    = 0;
+                getNode(node).firstChild = child;
+            }
+
+            node = child;
+            if (*p == '\0')
+                break;
+            path = p + 1;
+        }
+        getNode(node).selected = 1;
+        return true;
+    }
+
+    uint32_t findStep(uint32_t node, uint32_t keyOffset, uint32_t keyLength) const {
+        const CharType * key = mKeys.template Bottom<CharType>() + keyOffset;
+        for (uint32_t child = getNode(node).firstChild; child != kNoNode; child = getNode(child).nextSibling) {
+            const Node & step = getNode(child);
+            if (step.keyLength == keyLength && isSameKey(step, key))
+                return child;
+        }
+        return kNoNode;
+    }
+};
+
+}  // namespace JsonFx
+
+// Define default Projection class type
+typedef JsonFx::BasicProjection<>   jfxProjection;
+
+#endif  /* !_JSONFX_PROJECTION_H_ */
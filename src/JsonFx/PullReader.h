@@ -0,0 +1,479 @@
+
+#ifndef _JSONFX_PULLREADER_H_
+#define _JSONFX_PULLREADER_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Allocator.h"
+#include "JsonFx/Stack.h"
+#include "JsonFx/ParseResult.h"
+#include "JsonFx/Reader.h"
+#include "JsonFx/Stream/StringInputStream.h"
+#include "JsonFx/Internal/ValueSkipper.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/assert.h"
+
+namespace JsonFx {
+
+enum TokenKind {
+    kTokenNone,             // Not started, or the end of document.
+    kTokenNull,
+    kTokenFalse,
+    kTokenTrue,
+    kTokenInt,
+    kTokenUint,
+    kTokenInt64,
+    kTokenUint64,
+    kTokenDouble,
+    kTokenString,
+    kTokenKey,              // The member name of a object.
+    kTokenStartObject,
+    kTokenEndObject,
+    kTokenStartArray,
+    kTokenEndArray,
+    kTokenError             // See BasicPullReader::getParseResult().
+};
+
+//
+// The token of BasicPullReader, the string is stored in the pool allocator
+// (or in the source buffer for in-situ mode), it's '\0' terminated and valid
+// until the pool allocator is reset.
+//
+template <typename EncodingT = DefaultEncoding>
+class BasicToken {
+public:
+    typedef typename EncodingT::CharType    CharType;
+    typedef size_t                          SizeType;
+
+private:
+    TokenKind           mKind;
+    const CharType *    mStr;
+    SizeType            mLength;    // The length of string, or the count of the ended container.
+    union {
+        int             i;
+        unsigned        u;
+        int64_t         i64;
+        uint64_t        u64;
+        double          d;
+    } mNumber;
+
+public:
+    BasicToken() : mKind(kTokenNone), mStr(NULL), mLength(0) { mNumber.u64 = 0; }
+
+    TokenKind getKind() const { return mKind; }
+
+    bool isNull()   const { return (mKind == kTokenNull); }
+    bool isBool()   const { return (mKind == kTokenFalse || mKind == kTokenTrue); }
+    bool isNumber() const { return (mKind >= kTokenInt && mKind <= kTokenDouble); }
+    bool isString() const { return (mKind == kTokenString || mKind == kTokenKey); }
+    bool isKey()    const { return (mKind == kTokenKey); }
+
+    bool getBool() const { return (mKind == kTokenTrue); }
+
+    int      getInt()    const { jimi_assert(mKind == kTokenInt);    return mNumber.i;   }
+    unsigned getUint()   const { jimi_assert(mKind == kTokenUint);   return mNumber.u;   }
+    int64_t  getInt64()  const { jimi_assert(mKind == kTokenInt64);  return mNumber.i64; }
+    uint64_t getUint64() const { jimi_assert(mKind == kTokenUint64); return mNumber.u64; }
+
+    // Any number token can be read as a double.
+    double getDouble() const {
+        jimi_assert(isNumber());
+        switch (mKind) {
+        case kTokenInt:     return static_cast<double>(mNumber.i);
+        case kTokenUint:    return static_cast<double>(mNumber.u);
+        case kTokenInt64:   return static_cast<double>(mNumber.i64);
+        case kTokenUint64:  return static_cast<double>(mNumber.u64);
+        default:            return mNumber.d;
+        }
+    }
+
+    const CharType * getString() const       { jimi_assert(isString()); return mStr;    }
+    SizeType         getStringLength() const { jimi_assert(isString()); return mLength; }
+
+    // The member count of kTokenEndObject, or the element count of kTokenEndArray.
+    SizeType getCount() const { return mLength; }
+
+    void setKind(TokenKind kind)                    { mKind = kind; }
+    void setInt(int i)                              { mKind = kTokenInt;    mNumber.i = i;   }
+    void setUint(unsigned u)                        { mKind = kTokenUint;   mNumber.u = u;   }
+    void setInt64(int64_t i64)                      { mKind = kTokenInt64;  mNumber.i64 = i64; }
+    void setUint64(uint64_t u64)                    { mKind = kTokenUint64; mNumber.u64 = u64; }
+    void setDouble(double d)                        { mKind = kTokenDouble; mNumber.d = d;   }
+    void setCount(TokenKind kind, SizeType count)   { mKind = kind; mLength = count; }
+    void setString(TokenKind kind, const CharType * str, SizeType length) {
+        mKind = kind;
+        mStr = str;
+        mLength = length;
+    }
+};
+
+// Forward declaration.
+template <size_t parseFlags = kDefaultParseFlags,
+          typename SourceEncodingT = DefaultEncoding,
+          typename TargetEncodingT = DefaultEncoding,
+          typename PoolAllocatorT = DefaultPoolAllocator,
+          typename StackAllocatorT = DefaultAllocator>
+class BasicPullReader;
+
+// Define default PullReader class type
+typedef BasicPullReader<>   PullReader;
+
+//
+// The pull reader, the application drives the parsing token by token:
+//
+//   StringInputStream is(json);
+//   PullReader reader(is);
+//   while (reader.next() == kTokenKey) {
+//       if (wanted(reader.getToken()))
+//           reader.next();          // Read the value
+//       else
+//           reader.skipValue();     // Don't care the value
+//   }
+//
+// The tokens are parsed by the same token parsers of BasicReader, so the
+// values and errors are the same as BasicReader::parse(), the reader can stop
+// at any token, the rest of document is left unparsed.
+//
+template <size_t parseFlags /* = kDefaultParseFlags */,
+          typename SourceEncodingT /* = DefaultEncoding */,
+          typename TargetEncodingT /* = DefaultEncoding */,
+          typename PoolAllocatorT /* = DefaultPoolAllocator */,
+          typename StackAllocatorT /* = DefaultAllocator */>
+class BasicPullReader {
+public:
+    typedef typename SourceEncodingT::CharType  CharType;
+    typedef size_t                              SizeType;
+    typedef PoolAllocatorT                      PoolAllocatorType;
+    typedef StackAllocatorT                     StackAllocatorType;
+    typedef BasicStack<StackAllocatorT>         StackType;
+    typedef BasicParseResult<SourceEncodingT>   ParseResultType;
+    typedef BasicToken<TargetEncodingT>         TokenType;
+
+    // The token parsers of the reader, the structural index is not used.
+    typedef BasicReader<(parseFlags & ~static_cast<size_t>(kStructuralIndexParseFlag)),
+                        SourceEncodingT, TargetEncodingT, PoolAllocatorT, StackAllocatorT>  ReaderType;
+    typedef typename ReaderType::StringInputStreamType  StringInputStreamType;
+
+private:
+    // The container frame, one frame per nesting level.
+    struct ContainerFrame {
+        uint32_t    isObject;
+        uint32_t    count;
+    };
+
+    // The expected token of the grammar.
+    enum State {
+        kStateRoot,         // The root value, or the end of a empty document.
+        kStateValue,        // A value after the ':' or ','.
+        kStateFirstValue,   // The first value or the ']' of a array.
+        kStateFirstName,    // The first member name or the '}' of a object.
+        kStateCommaOrEnd,   // The ',' or the end of a object or array.
+        kStateDone          // The root value is finished, only the whitespaces are allowed.
+    };
+
+    // The SAX handler for the token parsers, it saves the value to the token.
+    struct TokenHandler {
+        typedef typename TargetEncodingT::CharType  TargetCharType;
+
+        TokenType * token;
+
+        bool saxNull()             { token->setKind(kTokenNull); return true; }
+        bool saxBool(bool b)       { token->setKind(b ? kTokenTrue : kTokenFalse); return true; }
+        bool saxInt(int i)         { token->setInt(i);    return true; }
+        bool saxUint(unsigned u)   { token->setUint(u);   return true; }
+        bool saxInt64(int64_t i)   { token->setInt64(i);  return true; }
+        bool saxUint64(uint64_t u) { token->setUint64(u); return true; }
+        bool saxDouble(double d)   { token->setDouble(d); return true; }
+        bool saxString(const TargetCharType * str, SizeType length, bool) {
+            token->setString(kTokenString, str, length);
+            return true;
+        }
+        bool saxKey(const TargetCharType * str, SizeType length, bool) {
+            token->setString(kTokenKey, str, length);
+            return true;
+        }
+    };
+
+    ReaderType                  mReader;
+    StackType                   mStack;         // The container frames stack.
+    StringInputStreamType *     mInputStream;
+    const CharType *            mCursor;
+    State                       mState;
+    TokenType                   mToken;
+    TokenHandler                mHandler;
+    ParseResultType             mParseResult;
+
+public:
+    BasicPullReader(const PoolAllocatorType * poolAllocator = NULL,
+                    bool poolAllocatorNeedFree = false)
+        : mReader(poolAllocator, poolAllocatorNeedFree), mStack(),
+          mInputStream(NULL), mCursor(NULL), mState(kStateDone), mToken(), mParseResult()
+    {
+        mHandler.token = &mToken;
+    }
+
+    BasicPullReader(StringInputStreamType & is,
+                    const PoolAllocatorType * poolAllocator = NULL,
+                    bool poolAllocatorNeedFree = false)
+        : mReader(poolAllocator, poolAllocatorNeedFree), mStack(),
+          mInputStream(NULL), mCursor(NULL), mState(kStateDone), mToken(), mParseResult()
+    {
+        mHandler.token = &mToken;
+        open(is);
+    }
+
+    ~BasicPullReader() {}
+
+private:
+    //! Prohibit copying
+    BasicPullReader(const BasicPullReader &);
+    //! Prohibit assignment
+    BasicPullReader & operator =(const BasicPullReader &);
+
+public:
+    // Start reading a document, the stream must be alive while reading.
+    void open(StringInputStreamType & is) {
+        mStack.clear();
+        mParseResult.clear();
+        mReader.clearParseError();
+        mReader.attachInputStream(&is);
+        mInputStream = &is;
+        mCursor = is.getCurrent();
+        mState = kStateRoot;
+        mToken = TokenType();
+    }
+
+    bool hasParseError() const { return mParseResult.hasError(); }
+    const ParseResultType & getParseResult() const { return mParseResult; }
+
+    const TokenType & getToken() const { return mToken; }
+    TokenKind getTokenKind() const { return mToken.getKind(); }
+
+    // The nesting level of the current position, 0 is the root.
+    size_t getDepth() const { return (mStack.getSize() / sizeof(ContainerFrame)); }
+
+    //
+    // Read the next token, return kTokenNone at the end of document, or
+    // kTokenError if the document is invalid.
+    //
+    TokenKind next() {
+        if (this->hasParseError())
+            return kTokenError;
+        if (mInputStream == NULL)
+            return kTokenNone;
+
+        const CharType * src = mReader.skipWhiteSpaces(mCursor);
+        switch (mState) {
+        case kStateRoot:
+            if (*src == '\0') {
+                this->setParseError(kDocumentEmptyError, src);
+                return kTokenError;
+            }
+            src = this->parseValueToken(src);
+            break;
+
+        case kStateValue:
+            src = this->parseValueToken(src);
+            break;
+
+        case kStateFirstValue:
+            if (*src == ']') {
+                src = this->parseEndToken(src + 1);
+                break;
+            }
+            src = this->parseValueToken(src);
+            break;
+
+        case kStateFirstName:
+            if (*src == '}') {
+                src = this->parseEndToken(src + 1);
+                break;
+            }
+            src = this->parseKeyToken(src);
+            break;
+
+        case kStateCommaOrEnd: {
+            ContainerFrame * frame = mStack.template Top<ContainerFrame>();
+            if (*src == ',') {
+                ++src;
+                if (frame->isObject)
+                    src = this->parseKeyToken(src);
+                else
+                    src = this->parseValueToken(mReader.skipWhiteSpaces(src));
+            }
+            else if (*src == (frame->isObject ? '}' : ']')) {
+                src = this->parseEndToken(src + 1);
+            }
+            else {
+                if (frame->isObject)
+                    this->setParseError(kObjectMissCommaOrCurlyBracketError, src);
+                else
+                    this->setParseError(kArrayMissCommaOrSquareBracketError, src);
+            }
+            break;
+        }
+
+        default:
+            jimi_assert(mState == kStateDone);
+            if (*src != '\0')
+                this->setParseError(kDocumentRootNotSingularError, src);
+            else
+                mToken.setKind(kTokenNone);
+            break;
+        }
+
+        mCursor = src;
+        mInputStream->setCurrent(const_cast<CharType *>(src));
+        if (this->hasParseError())
+            mToken.setKind(kTokenError);
+        return mToken.getKind();
+    }
+
+    //
+    // Skip the value which next() would read, include all its children.
+    // Return false if there is no value (at the end of a array, or before
+    // a member name), or the document is invalid.
+    //
+    // The value is skipped by BasicReader::skipValue(), it's not parsed, so
+    // the token is not changed, and only the unclosed strings and containers
+    // are the errors in the skipped value.
+    //
+    bool skipValue() {
+        if (this->hasParseError())
+            return false;
+        const CharType * src = mReader.skipWhiteSpaces(mCursor);
+        if (mState == kStateFirstValue || mState == kStateCommaOrEnd) {
+            // Find the beginning of the next value.
+            if (mState == kStateFirstValue) {
+                if (*src == ']')
+                    return false;
+            }
+            else {
+                if (mStack.template Top<ContainerFrame>()->isObject || *src != ',')
+                    return false;
+                ++src;
+            }
+        }
+        else if (mState == kStateRoot) {
+            if (*src == '\0') {
+                this->setParseError(kDocumentEmptyError, src);
+                mToken.setKind(kTokenError);
+                return false;
+            }
+        }
+        else if (mState != kStateValue) {
+            return false;
+        }
+
+        src = mReader.skipValue(src);
+        if (!this->finishSkip(src))
+            return false;
+        mState = finishValue();
+        return true;
+    }
+
+    //
+    // Skip the rest of the current object or array, include its end token.
+    // Return false if it's at the root, or the document is invalid. The token
+    // is the end token, its count only includes the values before skipping.
+    //
+    bool skipContainer() {
+        if (this->hasParseError() || mStack.empty())
+            return false;
+        ContainerFrame * frame = mStack.template Top<ContainerFrame>();
+        uint32_t isObject = frame->isObject;
+        size_t depth = 1;
+        const CharType * src = internal::SkipContainer(mCursor, depth,
+                                   ((parseFlags & kAllowSingleQuotesParseFlag) != 0));
+        if (depth != 0) {
+            this->setParseError(isObject ? kObjectMissCommaOrCurlyBracketError
+                                         : kArrayMissCommaOrSquareBracketError, src);
+        }
+        else {
+            ++src;
+        }
+        if (!this->finishSkip(src))
+            return false;
+        this->parseEndToken(src);
+        return true;
+    }
+
+private:
+    void setParseError(ParseErrorCode code, const CharType * src) {
+        mParseResult.setError(code, mReader.tell(src));
+    }
+
+    // Move the cursor after the skipped chars, return false if there is a error.
+    bool finishSkip(const CharType * src) {
+        if (mReader.hasParseError())
+            mParseResult = mReader.getParseResult();
+        mCursor = src;
+        mInputStream->setCurrent(const_cast<CharType *>(src));
+        if (this->hasParseError()) {
+            mToken.setKind(kTokenError);
+            return false;
+        }
+        return true;
+    }
+
+    // A value is finished, return the next state.
+    State finishValue() {
+        if (mStack.empty())
+            return kStateDone;
+        mStack.template Top<ContainerFrame>()->count++;
+        return kStateCommaOrEnd;
+    }
+
+    const CharType * parseValueToken(const CharType * src) {
+        if (*src == '{' || *src == '[') {
+            uint32_t isObject = (*src == '{');
+            ContainerFrame * frame = mStack.template push<ContainerFrame>();
+            frame->isObject = isObject;
+            frame->count    = 0;
+            mToken.setKind(isObject ? kTokenStartObject : kTokenStartArray);
+            mState = isObject ? kStateFirstName : kStateFirstValue;
+            return (src + 1);
+        }
+        src = mReader.parseScalar(src, mHandler);
+        if (mReader.hasParseError()) {
+            mParseResult = mReader.getParseResult();
+            return src;
+        }
+        mState = finishValue();
+        return src;
+    }
+
+    // Read the member name and the ':' after it.
+    const CharType * parseKeyToken(const CharType * src) {
+        src = mReader.parseMemberName(src, mHandler);
+        if (mReader.hasParseError()) {
+            mParseResult = mReader.getParseResult();
+            return src;
+        }
+        mState = kStateValue;
+        return src;
+    }
+
+    // The '}' or ']' has been taken.
+    const CharType * parseEndToken(const CharType * src) {
+        ContainerFrame * frame = mStack.template Top<ContainerFrame>();
+        uint32_t isObject = frame->isObject;
+        SizeType count = static_cast<SizeType>(frame->count);
+        mStack.template pop<ContainerFrame>(1);
+        mToken.setCount(isObject ? kTokenEndObject : kTokenEndArray, count);
+        mState = finishValue();
+        return src;
+    }
+};
+
+}  // namespace JsonFx
+
+// Define default PullReader class type
+typedef JsonFx::BasicPullReader<>   jfxPullReader;
+
+#endif  /* !_JSONFX_PULLREADER_H_ */
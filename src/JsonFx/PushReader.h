@@ -0,0 +1,392 @@
+
+#ifndef _JSONFX_PUSHREADER_H_
+#define _JSONFX_PUSHREADER_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include <string.h>
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Allocator.h"
+#include "JsonFx/Stack.h"
+#include "JsonFx/ParseResult.h"
+#include "JsonFx/Reader.h"
+#include "JsonFx/Stream/StringInputStream.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/assert.h"
+
+namespace JsonFx {
+
+// Forward declaration.
+template <typename ReaderHandlerT,
+          size_t parseFlags = kDefaultParseFlags,
+          typename SourceEncodingT = DefaultEncoding,
+          typename TargetEncodingT = DefaultEncoding,
+          typename PoolAllocatorT = DefaultPoolAllocator,
+          typename StackAllocatorT = DefaultAllocator>
+class BasicPushReader;
+
+//
+// The resumable reader, the document is pushed chunk by chunk (like the
+// TCP / HTTP chunks), and the handler receives the same SAX events as
+// BasicReader::parse() on the whole document:
+//
+//   BasicPushReader<MyHandler> reader(handler);
+//   while (recv(chunk, length))
+//       reader.feed(chunk, length);
+//   ParseResult result = reader.finish();
+//
+// The container frames stay in the stack across the chunks. A string, number
+// or literal token cut by the end of chunk is kept in the buffer (with the
+// scanned position of the string), and parsed when the rest of it arrives,
+// so only the incomplete tail token is buffered, not the whole document.
+//
+// The strings are always copied to the pool allocator (kInsituParseFlag is
+// ignored), because the chunk buffer is reused after feed() returns.
+//
+template <typename ReaderHandlerT,
+          size_t parseFlags /* = kDefaultParseFlags */,
+          typename SourceEncodingT /* = DefaultEncoding */,
+          typename TargetEncodingT /* = DefaultEncoding */,
+          typename PoolAllocatorT /* = DefaultPoolAllocator */,
+          typename StackAllocatorT /* = DefaultAllocator */>
+class BasicPushReader {
+public:
+    typedef typename SourceEncodingT::CharType  CharType;
+    typedef size_t                              SizeType;
+    typedef ReaderHandlerT                      ReaderHandlerType;
+    typedef PoolAllocatorT                      PoolAllocatorType;
+    typedef StackAllocatorT                     StackAllocatorType;
+    typedef BasicStack<StackAllocatorT>         StackType;
+    typedef BasicParseResult<SourceEncodingT>   ParseResultType;
+
+    // The token parsers of the reader parse the complete tokens in the buffer.
+    typedef BasicReader<(parseFlags & ~static_cast<size_t>(kInsituParseFlag | kStructuralIndexParseFlag)),
+                        SourceEncodingT, TargetEncodingT, PoolAllocatorT, StackAllocatorT>  ReaderType;
+    typedef typename ReaderType::StringInputStreamType  StringInputStreamType;
+
+private:
+    // The container frame, one frame per nesting level.
+    struct ContainerFrame {
+        uint32_t    isObject;
+        uint32_t    count;
+    };
+
+    // The expected token of the grammar.
+    enum State {
+        kStateRoot,         // The root value, or the end of a empty document.
+        kStateValue,        // A value after the ':' or ','.
+        kStateFirstValue,   // The first value or the ']' of a array.
+        kStateFirstName,    // The first member name or the '}' of a object.
+        kStateName,         // A member name after the ','.
+        kStateColon,        // The ':' after a member name.
+        kStateCommaOrEnd,   // The ',' or the end of a object or array.
+        kStateDone          // The root value is finished, only the whitespaces are allowed.
+    };
+
+    ReaderHandlerType &     mHandler;
+    ReaderType              mReader;
+    StackType               mStack;         // The container frames stack.
+    StackType               mBuffer;        // The unparsed chars, it's the incomplete token.
+    State                   mState;
+    size_t                  mOffset;        // The offset of mBuffer in the whole document.
+    size_t                  mTokenScanned;  // The scanned chars of the incomplete string token.
+    ParseResultType         mParseResult;
+
+public:
+    BasicPushReader(ReaderHandlerType & handler,
+                    const PoolAllocatorType * poolAllocator = NULL,
+                    bool poolAllocatorNeedFree = false)
+        : mHandler(handler), mReader(poolAllocator, poolAllocatorNeedFree),
+          mStack(), mBuffer(), mState(kStateRoot), mOffset(0), mTokenScanned(0),
+          mParseResult()
+    {
+        /* Do nothing! */
+    }
+
+    ~BasicPushReader() {}
+
+private:
+    //! Prohibit copying
+    BasicPushReader(const BasicPushReader &);
+    //! Prohibit assignment
+    BasicPushReader & operator =(const BasicPushReader &);
+
+public:
+    bool hasParseError() const { return mParseResult.hasError(); }
+    const ParseResultType & getParseResult() const { return mParseResult; }
+
+    // The root value has been finished.
+    bool isDone() const { return (mState == kStateDone); }
+
+    // Start a new document, the buffers are kept for reuse.
+    void reset() {
+        mStack.clear();
+        mBuffer.clear();
+        mState = kStateRoot;
+        mOffset = 0;
+        mTokenScanned = 0;
+        mParseResult.clear();
+        mReader.clearParseError();
+    }
+
+    //
+    // Push a chunk of the document, the complete tokens are parsed at once,
+    // return the error if the document is invalid (the following chunks are
+    // ignored), the offset of error is the offset in the whole document.
+    //
+    ParseResultType feed(const CharType * data, size_t length) {
+        if (!this->hasParseError() && length != 0) {
+            jimi_assert(data != NULL);
+            CharType * dest = mBuffer.template push<CharType>(length);
+            ::memcpy(dest, data, length * sizeof(CharType));
+            this->parseBuffer(false);
+        }
+        return mParseResult;
+    }
+
+    //
+    // The end of document, the incomplete token is parsed as the last token,
+    // return the same result as BasicReader::parse() on the whole document.
+    //
+    ParseResultType finish() {
+        if (!this->hasParseError())
+            this->parseBuffer(true);
+        return mParseResult;
+    }
+
+private:
+    void setParseError(ParseErrorCode code, const CharType * begin, const CharType * src) {
+        mParseResult.setError(code, mOffset + static_cast<size_t>(src - begin));
+    }
+
+    // Move the error of the token parsers, their offsets are relative to mBuffer.
+    void takeReaderError() {
+        const ParseResultType & result = mReader.getParseResult();
+        mParseResult.setError(result.getError(), mOffset + result.getErrorOffset());
+    }
+
+    static bool isNumberChar(CharType c) {
+        return ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E');
+    }
+
+    // The number and literal tokens are complete if a other char follows them.
+    static bool isNumberComplete(const CharType * src, const CharType * end) {
+        while (src < end && isNumberChar(*src))
+            ++src;
+        return (src < end);
+    }
+
+    static bool isLiteralComplete(const CharType * src, const CharType * end) {
+        while (src < end && (*src >= 'a' && *src <= 'z'))
+            ++src;
+        return (src < end);
+    }
+
+    //
+    // The string token is complete if the closing quote is found. If it's not,
+    // save the scanned length, the next time the scanning starts from there,
+    // so the long string cut by many chunks is only scanned once.
+    //
+    bool isStringComplete(const CharType * src, const CharType * begin, const CharType * end) {
+        CharType quote = *src;
+        const CharType * cur = (src == begin && mTokenScanned != 0) ? (src + mTokenScanned) : (src + 1);
+        for (;;) {
+            cur = internal::ScanString(cur, quote);
+            if (*cur == quote)
+                break;
+            if (*cur == '\\') {
+                // The escape chars can't be cut.
+                if (cur + 1 >= end) {
+                    mTokenScanned = static_cast<size_t>(cur - src);
+                    return false;
+                }
+                cur += 2;
+            }
+            else if (*cur == '\0') {
+                if (cur >= end) {
+                    mTokenScanned = static_cast<size_t>(cur - src);
+                    return false;
+                }
+                // The '\0' in the chunk, let the string parser report the error.
+                break;
+            }
+            else {
+                // The control chars.
+                ++cur;
+            }
+        }
+        mTokenScanned = 0;
+        return true;
+    }
+
+    bool isScalarComplete(const CharType * src, const CharType * begin, const CharType * end) {
+        if (*src == '"' || ((parseFlags & kAllowSingleQuotesParseFlag) && *src == '\''))
+            return isStringComplete(src, begin, end);
+        else if (*src == '-' || (*src >= '0' && *src <= '9'))
+            return isNumberComplete(src, end);
+        else if (*src >= 'a' && *src <= 'z')
+            return isLiteralComplete(src, end);
+        // The invalid char, let the scalar parser report the error.
+        return true;
+    }
+
+    // A value is finished, return the next state.
+    State finishValue() {
+        if (mStack.empty())
+            return kStateDone;
+        mStack.template Top<ContainerFrame>()->count++;
+        return kStateCommaOrEnd;
+    }
+
+    //
+    // Parse the tokens in mBuffer, the loop is the same as BasicReader::parseValue(),
+    // but it's driven by mState. If isFinal is false, it stops at the incomplete
+    // token (or the end of buffer), the unparsed chars are kept in mBuffer.
+    //
+    void parseBuffer(bool isFinal) {
+        size_t size = mBuffer.getSize() / sizeof(CharType);
+        // The token parsers need the '\0' terminator.
+        *mBuffer.template push<CharType>() = '\0';
+        const CharType * const begin = mBuffer.template Bottom<CharType>();
+        const CharType * const end   = begin + size;
+
+        StringInputStreamType is(begin);
+        mReader.attachInputStream(&is);
+
+        ReaderHandlerType & handler = mHandler;
+        const CharType * src = begin;
+        for (;;) {
+            src = mReader.skipWhiteSpaces(src);
+            if (src >= end && !isFinal)
+                break;
+
+            if (mState == kStateValue || mState == kStateFirstValue || mState == kStateRoot) {
+                if (mState == kStateRoot && src >= end) {
+                    this->setParseError(kDocumentEmptyError, begin, src);
+                    break;
+                }
+                if (*src == '{' || *src == '[') {
+                    uint32_t isObject = (*src == '{');
+                    ++src;
+                    if (!(isObject ? handler.saxStartObject() : handler.saxStartArray())) {
+                        this->setParseError(kTerminationError, begin, src);
+                        break;
+                    }
+                    ContainerFrame * frame = mStack.template push<ContainerFrame>();
+                    frame->isObject = isObject;
+                    frame->count    = 0;
+                    mState = isObject ? kStateFirstName : kStateFirstValue;
+                    continue;
+                }
+                if (mState == kStateFirstValue && *src == ']') {
+                    // It's a empty array.
+                    ++src;
+                    mStack.template pop<ContainerFrame>(1);
+                    if (!handler.saxEndArray(0)) {
+                        this->setParseError(kTerminationError, begin, src);
+                        break;
+                    }
+                    mState = finishValue();
+                    continue;
+                }
+                if (!isFinal && !isScalarComplete(src, begin, end))
+                    break;
+                src = mReader.parseScalar(src, handler);
+                if (mReader.hasParseError()) {
+                    this->takeReaderError();
+                    break;
+                }
+                mState = finishValue();
+            }
+            else if (mState == kStateFirstName || mState == kStateName) {
+                if (mState == kStateFirstName && *src == '}') {
+                    // It's a empty object.
+                    ++src;
+                    mStack.template pop<ContainerFrame>(1);
+                    if (!handler.saxEndObject(0)) {
+                        this->setParseError(kTerminationError, begin, src);
+                        break;
+                    }
+                    mState = finishValue();
+                    continue;
+                }
+                if (*src == '"' || ((parseFlags & kAllowSingleQuotesParseFlag) && *src == '\'')) {
+                    if (!isFinal && !isStringComplete(src, begin, end))
+                        break;
+                    src = mReader.parseStringToken(src, handler, true);
+                    if (mReader.hasParseError()) {
+                        this->takeReaderError();
+                        break;
+                    }
+                    mState = kStateColon;
+                }
+                else {
+                    this->setParseError(kObjectMissNameError, begin, src);
+                    break;
+                }
+            }
+            else if (mState == kStateColon) {
+                if (*src == ':') {
+                    ++src;
+                    mState = kStateValue;
+                }
+                else {
+                    this->setParseError(kObjectMissColonError, begin, src);
+                    break;
+                }
+            }
+            else if (mState == kStateCommaOrEnd) {
+                ContainerFrame * frame = mStack.template Top<ContainerFrame>();
+                if (*src == ',') {
+                    ++src;
+                    mState = frame->isObject ? kStateName : kStateValue;
+                }
+                else if (*src == (frame->isObject ? '}' : ']')) {
+                    ++src;
+                    uint32_t isObject = frame->isObject;
+                    SizeType count = static_cast<SizeType>(frame->count);
+                    mStack.template pop<ContainerFrame>(1);
+                    if (!(isObject ? handler.saxEndObject(count) : handler.saxEndArray(count))) {
+                        this->setParseError(kTerminationError, begin, src);
+                        break;
+                    }
+                    mState = finishValue();
+                }
+                else {
+                    if (frame->isObject)
+                        this->setParseError(kObjectMissCommaOrCurlyBracketError, begin, src);
+                    else
+                        this->setParseError(kArrayMissCommaOrSquareBracketError, begin, src);
+                    break;
+                }
+            }
+            else {
+                jimi_assert(mState == kStateDone);
+                if (src < end)
+                    this->setParseError(kDocumentRootNotSingularError, begin, src);
+                break;
+            }
+        }
+
+        // Remove the '\0' terminator and the parsed chars, keep the incomplete token.
+        mBuffer.template pop<CharType>(1);
+        size_t parsed = static_cast<size_t>(src - begin);
+        if (parsed > size)
+            parsed = size;
+        if (parsed != 0) {
+            CharType * bottom = mBuffer.template Bottom<CharType>();
+            ::memmove(bottom, bottom + parsed, (size - parsed) * sizeof(CharType));
+            mBuffer.template pop<CharType>(parsed);
+            mOffset += parsed;
+        }
+    }
+};
+
+}  // namespace JsonFx
+
+#endif  /* !_JSONFX_PUSHREADER_H_ */
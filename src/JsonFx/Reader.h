@@ -7,12 +7,21 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 
 #include "JsonFx/Allocator.h"
 #include "JsonFx/Stack.h"
+#include "JsonFx/Value.h"
 #include "JsonFx/ParseResult.h"
 #include "JsonFx/Stream/StringInputStream.h"
 #include "JsonFx/Internal/Traits.h"
+#include "JsonFx/Internal/Hash.h"
+#include "JsonFx/Internal/Strtod.h"
+#include "JsonFx/Internal/SkipWhiteSpaces.h"
+#include "JsonFx/Internal/StringScanner.h"
+#include "JsonFx/Internal/StructuralIndex.h"
+#include "JsonFx/Internal/Transcoder.h"
+#include "JsonFx/Internal/ValueSkipper.h"
 
 #define JSONFX_DEFAULT_PARSE_FLAGS      (kNoneParseFlag)
 
@@ -20,7 +29,10 @@ namespace JsonFx {
 
 enum ParseFlags {
     kNoneParseFlag                  = 0,
-    kInsituParseFlag                = 1 << 0,
+    kInsituParseFlag                = 1 << 0,   // Unescape the strings in the source buffer, see BasicDocument::parseInsitu().
+    kStructuralIndexParseFlag       = 1 << 1,   // Index the tokens of the whole buffer first, then parse by the index.
+    kValidateEncodingParseFlag      = 1 << 2,   // Validate the strings are UTF-8 (for the single byte source chars).
+    kStopWhenDoneParseFlag          = 1 << 3,   // Stop after the root value, the rest of the stream is left unread.
     kNoStringEscapeParseFlags       = 1 << 8,
     kAllowSingleQuotesParseFlag     = 1 << 9,
     kMaxParseFlags                  = 0x80000000U,
@@ -63,6 +75,37 @@ struct BasicReaderHandler {
     bool saxEndArray(SizeType)  { return static_cast<Override &>(*this).saxDefault(); }
 };
 
+namespace internal {
+
+//
+// A handler which declares "typedef internal::TrueType HashedKeyTag;" gets
+// the member names by saxHashedKey(str, length, hash, copy) instead of saxKey(),
+// the hash is internal::HashString() of the name.
+//
+template <typename HandlerT, typename Enable = void>
+struct HasHashedKey : FalseType {};
+
+template <typename HandlerT>
+struct HasHashedKey<HandlerT, typename Void<typename HandlerT::HashedKeyTag>::Type> : TrueType {};
+
+//
+// A handler which declares "typedef internal::TrueType InlineStringTag;" and
+// "static const size_t kMaxInlineStringLength = N;" copies the strings of N
+// chars or less when copy is true, so the reader sends them from the scratch
+// space of the pool allocator without allocating them.
+//
+template <typename HandlerT, typename Enable = void>
+struct InlineStringLength {
+    static const size_t Value = 0;
+};
+
+template <typename HandlerT>
+struct InlineStringLength<HandlerT, typename Void<typename HandlerT::InlineStringTag>::Type> {
+    static const size_t Value = HandlerT::kMaxInlineStringLength;
+};
+
+}  // namespace internal
+
 template <size_t parseFlags,
           typename SourceEncodingT,
           typename TargetEncodingT,
@@ -71,32 +114,81 @@ template <size_t parseFlags,
 class BasicReader {
 public:
     typedef typename SourceEncodingT::CharType  CharType;			//!< SourceEncoding character type
+    typedef typename TargetEncodingT::CharType  TargetCharType;     //!< TargetEncoding character type
+    typedef size_t                              SizeType;
     typedef BasicStringInputStream<CharType>    StringInputStreamType;
     typedef PoolAllocatorT                      PoolAllocatorType;  //!< Pool allocator type from template parameter.
     typedef StackAllocatorT                     StackAllocatorType; //!< Stack allocator type from template parameter.
-    typedef BasicStack<PoolAllocatorT>          StackType;
+    typedef BasicStack<StackAllocatorT>         StackType;
     typedef BasicParseResult<SourceEncodingT>   ParseResultType;
 
     static const size_t kDefaultStackCapacity = 256;
 
 private:
+    typedef internal::Transcoder<SourceEncodingT, TargetEncodingT> TranscoderType;
+
+    // The container frame of iterative parser, one frame per nesting level.
+    struct ContainerFrame {
+        uint32_t    isObject;
+        uint32_t    count;
+    };
+
+    // The container frame of projected parser (see parseProjected()).
+    struct ProjectionFrame {
+        uint32_t    isObject;
+        uint32_t    count;      // The count of values on the paths.
+        uint32_t    index;      // The index of next element of array.
+        uint32_t    node;       // The node of the container in the projection.
+    };
+
+    //
+    // The SAX handler which only captures the member name, it's used in the
+    // in-situ mode, the name is unescaped in the source buffer (it's only
+    // compared), so the skipped names are never allocated.
+    //
+    struct KeyCaptureHandler {
+        typedef internal::TrueType InlineStringTag;
+        static const size_t kMaxInlineStringLength = static_cast<size_t>(-1);
+
+        const TargetCharType *  str;
+        SizeType                length;
+
+        bool saxKey(const TargetCharType * s, SizeType len, bool) {
+            str = s;
+            length = len;
+            return true;
+        }
+        bool saxString(const TargetCharType * s, SizeType len, bool copy) {
+            return saxKey(s, len, copy);
+        }
+    };
+
     StringInputStreamType * mInputStream;
     PoolAllocatorType *     mPoolAllocator;
     bool                    mPoolAllocatorNeedFree;
-    StackType               mStack;
+    StackType *             mStack;
+    StackType               mInnerStack;
+    StackType               mIndexStack;
+    StackType               mNameBuffer;    // The unescaped member names to match.
     ParseResultType         mParseResult;
 
 public:
+    //
+    // If the stack is not NULL, the reader uses it as the container frames stack
+    // instead of the inner stack, so the owner (like BasicDocument) can reuse
+    // the stack buffer across the readers and parses.
+    //
     BasicReader(const PoolAllocatorType * poolAllocator = NULL,
                 bool poolAllocatorNeedFree = false,
-                const PoolAllocatorType * stackAllocator = NULL,
+                StackType * stack = NULL,
                 size_t stackCapacity = kDefaultStackCapacity)
         : mInputStream(NULL), mPoolAllocator(const_cast<PoolAllocatorType *>(poolAllocator)),
           mPoolAllocatorNeedFree(poolAllocatorNeedFree),
-          mStack(poolAllocator, stackCapacity), mParseResult()
+          mStack((stack != NULL) ? stack : &mInnerStack),
+          mInnerStack(NULL, stackCapacity), mIndexStack(), mNameBuffer(), mParseResult()
     {
         /* Do nothing! */
-        initPoolAllocator(poolAllocator, poolAllocatorNeedFree);
+        initPoolAllocator(poolAllocator);
     }
 
     ~BasicReader() {
@@ -113,13 +205,13 @@ private:
         }
     }
 
-    void initPoolAllocator(const PoolAllocatorType * poolAllocator, bool poolAllocatorNeedFree) {
+    void initPoolAllocator(const PoolAllocatorType * poolAllocator) {
         if (poolAllocator == NULL) {
             PoolAllocatorType * newPoolAllocator = new PoolAllocatorType();
             jimi_assert(newPoolAllocator != NULL);
             if (newPoolAllocator != NULL) {
                 mPoolAllocator = newPoolAllocator;
-                mPoolAllocatorNeedFree = poolAllocatorNeedFree;
+                mPoolAllocatorNeedFree = true;
             }
         }
     }
@@ -139,6 +231,17 @@ public:
         mParseResult.setError(code, offset);
     }
 
+    const ParseResultType & getParseResult() const { return mParseResult; }
+
+    void clearParseError() { mParseResult.clear(); }
+
+    //
+    // Attach the input stream for the token parsers (parseValue(), parseScalar(), ...)
+    // which are driven by the caller directly (like BasicPushReader), the error
+    // offsets are relative to the beginning of the stream.
+    //
+    void attachInputStream(StringInputStreamType * is) { mInputStream = is; }
+
     // The whitespace chars including " \t\n\r"
     template <typename InuptStreamT>
     JIMI_FORCEINLINE
@@ -170,6 +273,13 @@ public:
 #endif
     }
 
+    // The string input stream can be skipped by the SIMD kernels directly.
+    JIMI_FORCEINLINE
+    void skipWhiteSpaces(StringInputStreamType & is) {
+        is.setCurrent(const_cast<CharType *>(internal::SkipWhiteSpaces(
+                      const_cast<const CharType *>(is.getCurrent()))));
+    }
+
     // The whitespace chars including " \t\n\r"
     JIMI_FORCEINLINE
     bool isWhiteSpaces(const CharType * src) const {
@@ -183,209 +293,70 @@ public:
 
     JIMI_FORCEINLINE
     const CharType * skipWhiteSpaces(const CharType * src) {
-        // '\t' = 0x07, '\n' = 0x0A, '\r' = 0x0D
-#if 0
-        while ((*src == ' ') || (*src >= '\t' && *src <= '\r')) {
-            ++src;
-        }
-#else
-        while (*src == ' ' || *src == '\t' || *src == '\r' || *src == '\n') {
-            ++src;
-        }
-#endif
-        return src;
-    }
-
-    template <typename InputStreamT, typename ReaderHandlerT>
-    void parseObject(InputStreamT & is, ReaderHandlerT & handler) {
-        //
+        // Use the SSE2 / AVX2 kernels if the CharType is single byte,
+        // see "JsonFx/Internal/SkipWhiteSpaces.h".
+        return internal::SkipWhiteSpaces(src);
     }
 
+    //
+    // The stream API is driven by the same iterative parser as parse(), the
+    // stream must be a buffered string stream (see getCurrent()/setCurrent()).
+    //
     template <typename InputStreamT, typename ReaderHandlerT>
-    void parseArray(InputStreamT & is, ReaderHandlerT & handler) {
-        //
-    }
-
-    template <CharType beginToken, typename InputStreamT, typename ReaderHandlerT>
-    void parseInsituString(InputStreamT & is, ReaderHandlerT & handler, bool isKey = true) {
-        //
+    ParseResultType parseStream(InputStreamT & is, ReaderHandlerT & handler) {
+        return this->parse(is, handler);
     }
 
-    template <CharType quoteToken, typename InputStreamT, typename ReaderHandlerT>
-    void parseString(InputStreamT & is, ReaderHandlerT & handler, bool isKey = true) {
-        jimi_assert(mPoolAllocator != NULL);
-        // The size of string length field
-        static const size_t kSizeOfHeadField = sizeof(uint32_t) + sizeof(uint32_t);
-        // Reserve string size
-        static const size_t kReserveStringSize = 8;
-        CharType * cursor = (CharType *)mPoolAllocator->skip(kSizeOfHeadField, kReserveStringSize);
-        jimi_assert(cursor != NULL);
-        CharType * begin  = cursor;
-        CharType * bottom = (CharType *)mPoolAllocator->getChunkBottom();
-
-        while (is.peek() != quoteToken && is.peek() != '\0') {
-            if (cursor < bottom) {
-                *cursor++ = is.take();
+    //
+    // Unescape the string in place: the unescaped chars never longer than the
+    // escaped chars, so the writing cursor never passes the reading cursor.
+    // The '\0' terminator is written over the closing quote (or before it),
+    // and the handler receives a pointer into the source buffer.
+    //
+    template <CharType quoteToken, typename ReaderHandlerT>
+    const CharType * parseInsituString(const CharType * src, ReaderHandlerT & handler, bool isKey = true) {
+        CharType * begin  = const_cast<CharType *>(src);
+        CharType * cursor = begin;
+
+        for (;;) {
+            // Find the next quote, backslash or control char.
+            const CharType * special = this->scanString(src, quoteToken);
+            if ((parseFlags & kValidateEncodingParseFlag) && this->hasParseError())
+                return special;
+            size_t runLength = special - src;
+            // The plain chars needn't move until the first escape char.
+            if (cursor != src)
+                ::memmove(cursor, src, runLength * sizeof(CharType));
+            cursor += runLength;
+            src = special;
+
+            if (*src == '\\') {
+                this->unescapeChars(cursor, src);
+                if (this->hasParseError())
+                    return src;
+            }
+            else if (*src == quoteToken || *src == '\0') {
+                break;
             }
             else {
-                // The remain space in the active chunk is not enough to store the string's
-                // characters, so we allocate a new chunk to store it.
-                CharType * newCursor = (CharType *)mPoolAllocator->addNewChunkAndSkip(kSizeOfHeadField, kReserveStringSize);
-                CharType * newBegin  = newCursor;
-                jimi_assert(newCursor != NULL);
-                while (begin != cursor) {
-                    *newCursor++ = *begin++;
-                }
-                cursor = newCursor;
-                begin  = newBegin;
-                bottom = (CharType *)mPoolAllocator->getChunkBottom();
-
-                while (is.peek() != quoteToken && is.peek() != '\0') {
-                    if (cursor < bottom) {
-                        *cursor++ = is.take();
-                    }
-                    else {
-                        // If it need allocate memory second time, mean the string's length
-                        // is more than PoolAllocator's kChunkCapacoty bytes, so we find
-                        // out the string's length first, and allocate the enough memory
-                        // to fill the string's characters.
-                        size_t lenScanned = cursor - begin;
-                        this->parseLargeString<quoteToken>(is, handler, isKey, lenScanned);
-                    }
-                }
+                // The other control chars are kept as the plain chars.
+                *cursor++ = *src++;
             }
         }
+
         // It's the ending of string token.
-        if (is.peek() == quoteToken) {
-            is.next();
+        if (*src == quoteToken) {
+            ++src;
             *cursor = '\0';
-            ++cursor;
-            jimi_assert(cursor >= begin);
-            size_t length = cursor - begin;
-            uint32_t * pHeadInfo = reinterpret_cast<uint32_t *>(reinterpret_cast<char *>(begin) - kSizeOfHeadField);
-            jimi_assert(pHeadInfo != NULL);
-            *pHeadInfo = static_cast<uint32_t>(kConstStringFlags);
-            pHeadInfo++;
-            *pHeadInfo = static_cast<uint32_t>(length);
-            mPoolAllocator->allocate(kSizeOfHeadField + length * sizeof(CharType));
+            this->handleString(handler, begin, static_cast<SizeType>(cursor - begin), isKey, src);
         }
         else {
             // Error: The tail token is not match.
             if (isKey)
-                this->setParseError(kKeyStringMissQuoteError);
+                this->setParseError(kKeyStringMissQuoteError, this->tell(src));
             else
-                this->setParseError(kValueStringMissQuoteError);
-        }
-    }
-
-    template <CharType quoteToken, typename InputStreamT, typename ReaderHandlerT>
-    JIMI_NOINLINE_DECLARE(void) parseLargeString(InputStreamT & is, ReaderHandlerT & handler,
-                                                 bool isKey, size_t lenScanned) {
-        // The size of string length field
-        static const size_t kSizeOfHeadField = sizeof(uint32_t) + sizeof(uint32_t);
-
-        size_t lenTail, lenTotal;
-        CharType * origPtr, * savePtr;
-
-        // Get the original begin address of p.
-        origPtr = is.getCurrent() - lenScanned;
-        savePtr = is.getCurrent();
-
-        // Find the full length of string
-        while (is.peek() != quoteToken && is.peek() != '\0') {
-            is.next();
-        }
-
-        // The length of tail characters of string.
-        lenTail = is.getCurrent() - savePtr;
-        // Get the full length
-        lenTotal = lenScanned + lenTail + 1;
-
-        // Allocate the large chunk, and insert it to last.
-        jimi_assert(mPoolAllocator != NULL);
-        CharType * newCursor = (CharType *)mPoolAllocator->allocateLarge(kSizeOfHeadField + lenTotal * sizeof(CharType));
-        jimi_assert(newCursor != NULL);
-
-        uint32_t * pHeadInfo = reinterpret_cast<uint32_t *>(newCursor);
-        *pHeadInfo = static_cast<uint32_t>(kConstStringFlags);
-        pHeadInfo++;
-        *pHeadInfo = static_cast<uint32_t>(lenTotal);
-
-        // Start copy the string's characters.
-        newCursor = reinterpret_cast<CharType *>(pHeadInfo);
-        if (is.peek() == quoteToken) {
-            while (*origPtr != quoteToken) {
-                *newCursor++ = *origPtr++;
-            }
-            *newCursor = '\0';
-            is.next();
-        }
-        else {
-            // Error: The tail token is not match, miss quote.
-            if (is.peek() == '\0') {
-                while (*origPtr != '\0') {
-                    *newCursor++ = *origPtr++;
-                }
-                *newCursor = '\0';
-            }
-            if (isKey)
-                this->setParseError(kKeyStringMissQuoteError);
-            else
-                this->setParseError(kValueStringMissQuoteError);
-        }
-    }
-
-    template <typename InputStreamT, typename ReaderHandlerT>
-    ParseResultType parseStream(InputStreamT & is, ReaderHandlerT & handler) {
-        mParseResult.clear();
-
-        jimi_assert(is.peek() != NULL);
-        //printf("JsonFx::BasicDocument::parse(const InuptStreamT &) visited.\n\n");
-        //setObject();
-
-        while (is.peek() != '\0') {
-            // Skip the whitespace chars
-            skipWhiteSpaces(is);
-
-            if (is.peek() == '"') {
-                // Parse a string begin from token ["]
-                is.next();
-                if (parseFlags & kInsituParseFlag)
-                    parseInsituString<'"'>(is, handler);
-                else
-                    parseString<'"'>(is, handler);
-            }
-            else if (is.peek() == '\'') {
-                // Allow use the single quotes [\']
-                if (parseFlags & kAllowSingleQuotesParseFlag) {
-                    // Parse a string begin from token \'
-                    is.next();
-                    if (parseFlags & kInsituParseFlag)
-                        parseInsituString<'\''>(is, handler);
-                    else
-                        parseString<'\''>(is, handler);
-                }
-            }
-            else if (is.peek() == '{') {
-                // Parse a object
-                is.next();
-                parseObject(is, handler);
-            }
-            else if (is.peek() == '[') {
-                // Parse a array
-                is.next();
-                parseArray(is, handler);
-            }
-            else {
-                // Other chars
-                is.next();
-            }
+                this->setParseError(kValueStringMissQuoteError, this->tell(src));
         }
-        return mParseResult;
-    }
-
-    template <CharType quoteToken, typename ReaderHandlerT>
-    const CharType * parseInsituString(const CharType * src, ReaderHandlerT & handler, bool isKey = true) {
         return src;
     }
 
@@ -450,35 +421,49 @@ public:
     }
 #endif
 
+    // Write an ASCII char (the unescaped char or control char) in the target encoding.
+    JIMI_FORCEINLINE
+    void putChar(TargetCharType * &dest, unsigned ch) {
+        *dest++ = TargetEncodingT::template store<TargetCharType>(ch);
+    }
+
+    //
+    // Unescape the '\uXXXX' or the surrogate pair '\uD83D\uDE00', the code
+    // point is written in the target encoding, it's kMaxUnits at most.
+    //
     JIMI_FORCEINLINE
-    void unescapeUnicode(CharType * &dest, const CharType * &src) {
+    void unescapeUnicode(TargetCharType * &dest, const CharType * &src) {
+        // Skip the 'u' char.
         ++src;
         unsigned codepoint = parseHex4(src);
+        if (this->hasParseError())
+            return;
         if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
             // Handle UTF-16 surrogate pair.
-            if (*src++ != '\\' || *src++ != 'u') {
-                this->setParseError(kStringUnicodeSurrogateInvalidError, this->tell(src) - 2);
+            if (*src != '\\' || *(src + 1) != 'u') {
+                this->setParseError(kStringUnicodeSurrogateInvalidError, this->tell(src));
+                return;
             }
+            src += 2;
             unsigned codepoint2 = parseHex4(src);
-            if (codepoint2 < 0xDC00 || codepoint2 > 0xDFFF)
-                this->setParseError(kStringUnicodeSurrogateInvalidError, this->tell(src) - 2);
+            if (this->hasParseError())
+                return;
+            if (codepoint2 < 0xDC00 || codepoint2 > 0xDFFF) {
+                this->setParseError(kStringUnicodeSurrogateInvalidError, this->tell(src) - 6);
+                return;
+            }
             codepoint = (((codepoint - 0xD800) << 10) | (codepoint2 - 0xDC00)) + 0x10000;
         }
-		// TODO:
-        // TargetEncodingT::encode(dest, codepoint);                    
-        *dest++ = 'X';
-        *dest++ = 'X';
-        *dest++ = 'X';
-#if 0
-        static int count = 0;
-        if (count == 0)
-            printf("codepoint = 0x%08X\n", codepoint);
-        count++;
-#endif
+        else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+            // A low surrogate without the high surrogate.
+            this->setParseError(kStringUnicodeSurrogateInvalidError, this->tell(src) - 6);
+            return;
+        }
+        TargetEncodingT::encode(dest, codepoint);
     }
 
     JIMI_FORCEINLINE
-    void unescapeChars(CharType * &dest, const CharType * &src) {
+    void unescapeChars(TargetCharType * &dest, const CharType * &src) {
         // Skip the '\\' char.
         ++src;
 
@@ -486,21 +471,21 @@ public:
             // Unescape the '\r', '\n', '\t', '\b', '\f', '/', '\\', '"' chars.
             if (*src <= 't' && *src >= '"') {
                 if (*src == 't')
-                    *dest++ = '\t';
+                    putChar(dest, '\t');
                 else if (*src == '"')
-                    *dest++ = '"';
+                    putChar(dest, '"');
                 else if (*src == 'n')
-                    *dest++ = '\n';
+                    putChar(dest, '\n');
                 else if (*src == 'r')
-                    *dest++ = '\r';
+                    putChar(dest, '\r');
                 else if (*src == '\\')
-                    *dest++ = '\\';
+                    putChar(dest, '\\');
                 else if (*src == '/')
-                    *dest++ = '/';
+                    putChar(dest, '/');
                 else if (*src == 'b')
-                    *dest++ = '\b';
+                    putChar(dest, '\b');
                 else if (*src == 'f')
-                    *dest++ = '\f';
+                    putChar(dest, '\f');
                 else {
                     // Unknown escape chars, do nothing.
                     --src;
@@ -510,33 +495,7 @@ public:
             }
             else if (*src == 'u') {
                 // '\uXXXX'
-#if 0
                 unescapeUnicode(dest, src);
-#else
-                ++src;
-                unsigned codepoint = parseHex4(src);
-                if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
-                    // Handle UTF-16 surrogate pair.
-                    if (*src++ != '\\' || *src++ != 'u') {
-                        this->setParseError(kStringUnicodeSurrogateInvalidError, this->tell(src) - 2);
-                    }
-                    unsigned codepoint2 = parseHex4(src);
-                    if (codepoint2 < 0xDC00 || codepoint2 > 0xDFFF)
-                        this->setParseError(kStringUnicodeSurrogateInvalidError, this->tell(src) - 2);
-                    codepoint = (((codepoint - 0xD800) << 10) | (codepoint2 - 0xDC00)) + 0x10000;
-                }
-				// TODO:
-                // TargetEncodingT::encode(dest, codepoint);                    
-                *dest++ = 'X';
-                *dest++ = 'X';
-                *dest++ = 'X';
-#if 0
-                static int count = 0;
-                if (count == 0)
-                    printf("codepoint = 0x%08X\n", codepoint);
-                count++;
-#endif
-#endif
             }
             else {
                 // Unknown escape chars, do nothing.
@@ -574,84 +533,220 @@ public:
         }
     }
 
+    //
+    // Find the next quote, backslash or control char of the string. If the
+    // kValidateEncodingParseFlag is set, the plain chars before it are also
+    // validated in the same pass, and the error is set on the first invalid char.
+    //
+    JIMI_FORCEINLINE
+    const CharType * scanString(const CharType * src, CharType quote) {
+        if (parseFlags & kValidateEncodingParseFlag) {
+            bool valid;
+            const CharType * special = internal::ScanStringValidate(src, quote, valid);
+            if (!valid)
+                this->setParseError(kStringInvalidEncodingError,
+                                    this->tell(internal::FindInvalidUtf8(src, special)));
+            return special;
+        }
+        else {
+            return internal::ScanString(src, quote);
+        }
+    }
+
+    template <typename ReaderHandlerT>
+    JIMI_FORCEINLINE
+    bool handleKey(ReaderHandlerT & handler, const TargetCharType * str, SizeType length,
+                   bool copy, uint32_t hash, internal::TrueType /* hashed key */) {
+        // The hash is 0 if it's not computed while copying.
+        if (hash == 0)
+            hash = internal::HashString(str, length);
+        return handler.saxHashedKey(str, length, hash, copy);
+    }
+
+    template <typename ReaderHandlerT>
+    JIMI_FORCEINLINE
+    bool handleKey(ReaderHandlerT & handler, const TargetCharType * str, SizeType length,
+                   bool copy, uint32_t hash, internal::FalseType /* hashed key */) {
+        (void)hash;
+        return handler.saxKey(str, length, copy);
+    }
+
+    template <typename ReaderHandlerT>
+    JIMI_FORCEINLINE
+    void handleString(ReaderHandlerT & handler, const TargetCharType * str, SizeType length,
+                      bool isKey, const CharType * src, bool copy = false, uint32_t hash = 0) {
+        // The string's characters have been stored in the pool allocator (or
+        // in the source buffer for in-situ mode), so the handler needn't copy it
+        // again, unless it's a short string in the scratch space (copy is true).
+        bool success;
+        if (isKey)
+            success = handleKey(handler, str, length, copy, hash, internal::HasHashedKey<ReaderHandlerT>());
+        else
+            success = handler.saxString(str, length, copy);
+        if (!success)
+            this->setParseError(kTerminationError, this->tell(src));
+    }
+
     template <CharType quoteToken, typename ReaderHandlerT>
     const CharType * parseString(const CharType * src, ReaderHandlerT & handler, bool isKey = true) {
         jimi_assert(mPoolAllocator != NULL);
         // The size of string length field
         static const size_t kSizeOfHeadField = sizeof(uint32_t) + sizeof(uint32_t);
+        // The max chars of a unescape chars writing and the '\0' terminator.
+        static const size_t kReserveTailSize = TargetEncodingT::kMaxUnits + 1;
         // Reserve string size
-        static const size_t kReserveStringSize = 8;
-        CharType * cursor = (CharType *)mPoolAllocator->skip(kSizeOfHeadField, kReserveStringSize);
+        static const size_t kReserveStringSize = kReserveTailSize * sizeof(TargetCharType);
+        const CharType * srcBegin = src;
+        TargetCharType * cursor = (TargetCharType *)mPoolAllocator->skip(kSizeOfHeadField, kReserveStringSize);
         jimi_assert(cursor != NULL);
-        CharType * begin  = cursor;
-        CharType * bottom = (CharType *)mPoolAllocator->getChunkBottom();
-
-        while (*src != quoteToken && *src != '\0') {
-            if (cursor < bottom) {
-                if (*src != '\\')
-                    *cursor++ = *src++;
-                else
-                    this->unescapeChars(cursor, src);
+        TargetCharType * begin  = cursor;
+        TargetCharType * bottom = (TargetCharType *)mPoolAllocator->getChunkBottom() - kReserveTailSize;
+        bool isNewChunk = false;
+        // The hash of member name is computed on the chars just written.
+        const bool needHash = (isKey && internal::HasHashedKey<ReaderHandlerT>::Value);
+        uint32_t hash = internal::kHashSeed;
+        TargetCharType * hashFrom;
+
+        for (;;) {
+            // Find the next quote, backslash or control char, the plain chars
+            // before it are copied as a whole run.
+            const CharType * special = this->scanString(src, quoteToken);
+            if ((parseFlags & kValidateEncodingParseFlag) && this->hasParseError())
+                return special;
+            size_t runLength = special - src;
+            // The unescape chars may write over the bottom (into the reserved
+            // tail), so the remain space must be compared as a signed value.
+            ptrdiff_t runSize = static_cast<ptrdiff_t>(runLength * TranscoderType::kMaxExpansion);
+            if (runSize >= bottom - cursor) {
+                if (!isNewChunk) {
+                    // The remain space in the active chunk is not enough to store the string's
+                    // characters, so we allocate a new chunk to store it.
+                    TargetCharType * newCursor = (TargetCharType *)mPoolAllocator->addNewChunkAndSkip(kSizeOfHeadField, kReserveStringSize);
+                    jimi_assert(newCursor != NULL);
+                    // Copy previous parse strings.
+                    size_t lenParsed = cursor - begin;
+                    ::memcpy(newCursor, begin, lenParsed * sizeof(TargetCharType));
+                    begin  = newCursor;
+                    cursor = newCursor + lenParsed;
+                    bottom = (TargetCharType *)mPoolAllocator->getChunkBottom() - kReserveTailSize;
+                    isNewChunk = true;
+                }
+                if (runSize >= bottom - cursor) {
+                    // If it need allocate memory second time, mean the string's length
+                    // is more than PoolAllocator's kChunkCapacoty bytes, so we find
+                    // out the string's length first, and allocate the enough memory
+                    // to fill the string's characters.
+                    size_t lenScanned = src - srcBegin;
+                    return this->parseLargeString<quoteToken>(src, handler, isKey, lenScanned);
+                }
+            }
+            hashFrom = cursor;
+            cursor = TranscoderType::transcodeRun(cursor, src, special);
+            src = special;
+
+            // Here always (cursor < bottom).
+            if (*src == '\\') {
+                this->unescapeChars(cursor, src);
+                if (this->hasParseError())
+                    return src;
+            }
+            else if (*src == quoteToken || *src == '\0') {
+                if (needHash)
+                    hash = internal::HashChars(hash, hashFrom, cursor);
+                break;
             }
             else {
-                // The remain space in the active chunk is not enough to store the string's
-                // characters, so we allocate a new chunk to store it.
-                CharType * newCursor = (CharType *)mPoolAllocator->addNewChunkAndSkip(kSizeOfHeadField, kReserveStringSize);
-                CharType * newBegin  = newCursor;
-                jimi_assert(newCursor != NULL);
-                // Copy previous parse strings.
-                while (begin != cursor) {
-                    *newCursor++ = *begin++;
-                }
-                cursor = newCursor;
-                begin  = newBegin;
-                bottom = (CharType *)mPoolAllocator->getChunkBottom();
-
-                while (*src != quoteToken && *src != '\0') {
-                    if (cursor < bottom) {
-                        if (*src != '\\')
-                            *cursor++ = *src++;
-                        else
-                            this->unescapeChars(cursor, src);
-                    }
-                    else {
-                        // If it need allocate memory second time, mean the string's length
-                        // is more than PoolAllocator's kChunkCapacoty bytes, so we find
-                        // out the string's length first, and allocate the enough memory
-                        // to fill the string's characters.
-                        size_t lenScanned = cursor - begin;
-                        src = this->parseLargeString<quoteToken>(src, handler, isKey, lenScanned);
-                        return src;
-                    }
-                }
+                // The other control chars are kept as the plain chars.
+                putChar(cursor, static_cast<unsigned>(*src++));
             }
+            if (needHash)
+                hash = internal::HashChars(hash, hashFrom, cursor);
         }
 
         // It's the ending of string token.
         if (*src == quoteToken) {
             ++src;
             *cursor = '\0';
-            ++cursor;
             jimi_assert(cursor >= begin);
+            if (static_cast<size_t>(cursor - begin) <= internal::InlineStringLength<ReaderHandlerT>::Value) {
+                // The handler copies the short string, it isn't allocated in the pool.
+                this->handleString(handler, begin, static_cast<SizeType>(cursor - begin), isKey, src,
+                                   true, needHash ? internal::HashFinish(hash) : 0);
+                return src;
+            }
+            ++cursor;
             size_t length = cursor - begin;
             uint32_t * pHeadInfo = reinterpret_cast<uint32_t *>(reinterpret_cast<char *>(begin) - kSizeOfHeadField);
             jimi_assert(pHeadInfo != NULL);
             *pHeadInfo = static_cast<uint32_t>(kConstStringFlags);
             pHeadInfo++;
             *pHeadInfo = static_cast<uint32_t>(length);
-            mPoolAllocator->allocate(kSizeOfHeadField + length * sizeof(CharType));
+            // If the pool allocator frees the blocks one by one, the string stays
+            // in its scratch buffer, and the handler copies it.
+            if (!PoolAllocatorType::kNeedFree)
+                mPoolAllocator->allocate(kSizeOfHeadField + length * sizeof(TargetCharType));
+            this->handleString(handler, begin, length - 1, isKey, src,
+                               PoolAllocatorType::kNeedFree, needHash ? internal::HashFinish(hash) : 0);
             return src;
         }
         else {
             // Error: The tail token is not match.
             if (isKey)
-                this->setParseError(kKeyStringMissQuoteError);
+                this->setParseError(kKeyStringMissQuoteError, this->tell(src));
             else
-                this->setParseError(kValueStringMissQuoteError);
+                this->setParseError(kValueStringMissQuoteError, this->tell(src));
             return src;
         }
     }
 
+    //
+    // Find the end of string (the closing quote or the '\0' terminator), the
+    // escaped chars must be skipped, otherwise a escaped quote will be regarded
+    // as the end of string.
+    //
+    template <CharType quoteToken>
+    const CharType * scanStringEnd(const CharType * src) {
+        for (;;) {
+            src = this->scanString(src, quoteToken);
+            if ((parseFlags & kValidateEncodingParseFlag) && this->hasParseError())
+                return src;
+            if (*src == quoteToken || *src == '\0')
+                break;
+            if (*src == '\\' && *(src + 1) != '\0')
+                src += 2;
+            else
+                ++src;
+        }
+        return src;
+    }
+
+    //
+    // Unescape (and transcode) the chars of string in [src, end) to the cursor,
+    // the end is found by scanStringEnd(), and the cursor has the space of
+    // ((end - src) * kMaxExpansion) chars. Return false if a escape is invalid.
+    //
+    template <CharType quoteToken>
+    bool unescapeScanned(TargetCharType *& cursor, const CharType * src, const CharType * end) {
+        while (src < end) {
+            // Copy the plain chars as a whole run.
+            const CharType * special = internal::ScanString(src, quoteToken);
+            cursor = TranscoderType::transcodeRun(cursor, src, special);
+            src = special;
+            if (src >= end)
+                break;
+
+            if (*src == '\\') {
+                this->unescapeChars(cursor, src);
+                if (this->hasParseError())
+                    return false;
+            }
+            else {
+                putChar(cursor, static_cast<unsigned>(*src++));
+            }
+        }
+        return true;
+    }
+
     template <CharType quoteToken, typename ReaderHandlerT>
     JIMI_NOINLINE_DECLARE(const CharType *)
     parseLargeString(const CharType * src, ReaderHandlerT & handler,
@@ -660,40 +755,29 @@ public:
         static const size_t kSizeOfHeadField = sizeof(uint32_t) + sizeof(uint32_t);
 
         size_t lenTail, lenTotal;
-        int lenAdditive;
         const CharType * origPtr, * savePtr;
 
-        // Get the original begin address of p.
+        // Get the original begin address of p, lenScanned is the scanned length of source.
         origPtr = src - lenScanned;
         savePtr = src;
 
-        // The escape chars additive length.
-        lenAdditive = 0;
-
-        // Find the full length of string
-        while (*src != quoteToken && *src != '\0') {
-#if 1
-            ++src;
-#else
-            if (*src != '\\')
-                ++src;
-            else
-                this->calcUnescapeCharBytes(src, lenAdditive);
-#endif
-        }
-
-        // lenAdditive must be <= 0.
-        jimi_assert(lenAdditive <= 0);
+        // Find the full length of string.
+        src = this->scanStringEnd<quoteToken>(src);
+        if ((parseFlags & kValidateEncodingParseFlag) && this->hasParseError())
+            return src;
 
         // The length of tail characters of string.
         lenTail = src - savePtr;
-        // Get the full length
-        lenTotal = lenScanned + lenTail + lenAdditive + 1;
+        // Get the full length, unescape chars never longer than the escaped chars,
+        // so it's large enough to store the unescaped and transcoded string.
+        lenTotal = (lenScanned + lenTail) * TranscoderType::kMaxExpansion + 1;
 
         // Allocate the large chunk, and insert it to last.
         jimi_assert(mPoolAllocator != NULL);
-        CharType * newCursor = (CharType *)mPoolAllocator->allocateLarge(kSizeOfHeadField + lenTotal * sizeof(CharType));
+        TargetCharType * newCursor = (TargetCharType *)mPoolAllocator->allocateLarge(kSizeOfHeadField + lenTotal * sizeof(TargetCharType));
         jimi_assert(newCursor != NULL);
+        // It's freed after the handler copies the string, if the pool allocator need free.
+        void * largeBlock = reinterpret_cast<void *>(newCursor);
 
         uint32_t * pHeadInfo = reinterpret_cast<uint32_t *>(newCursor);
         *pHeadInfo = static_cast<uint32_t>(kConstStringFlags);
@@ -701,37 +785,798 @@ public:
         *pHeadInfo = static_cast<uint32_t>(lenTotal);
 
         // Start copy the string's characters.
-        newCursor = reinterpret_cast<CharType *>(pHeadInfo);
+        newCursor = reinterpret_cast<TargetCharType *>(pHeadInfo + 1);
+        TargetCharType * newBegin = newCursor;
         if (*src == quoteToken) {
-            while (*origPtr != quoteToken) {
-                if (*origPtr != '\\')
-                    *newCursor++ = *origPtr++;
-                else
-                    this->unescapeChars(newCursor, origPtr);
+            if (!this->unescapeScanned<quoteToken>(newCursor, origPtr, src)) {
+                if (PoolAllocatorType::kNeedFree)
+                    PoolAllocatorType::deallocate(largeBlock);
+                return src;
             }
             *newCursor = '\0';
+            ++newCursor;
+            // Save the real length of string.
+            size_t length = newCursor - newBegin;
+            *pHeadInfo = static_cast<uint32_t>(length);
             ++src;
+            this->handleString(handler, newBegin, length - 1, isKey, src, PoolAllocatorType::kNeedFree);
+            if (PoolAllocatorType::kNeedFree)
+                PoolAllocatorType::deallocate(largeBlock);
             return src;
         }
         else {
             // Error: The tail token is not match, miss quote.
             if (*src == '\0') {
-                while (*origPtr != '\0') {
-                    *newCursor++ = *origPtr++;
-                }
+                newCursor = TranscoderType::transcodeRun(newCursor, origPtr, src);
                 *newCursor = '\0';
             }
+            if (PoolAllocatorType::kNeedFree)
+                PoolAllocatorType::deallocate(largeBlock);
             if (isKey)
-                this->setParseError(kKeyStringMissQuoteError);
+                this->setParseError(kKeyStringMissQuoteError, this->tell(src));
             else
-                this->setParseError(kValueStringMissQuoteError);
+                this->setParseError(kValueStringMissQuoteError, this->tell(src));
             return src;
         }
     }
 
+    //
+    // The in-situ parsing only works if the source chars can be used as the
+    // target chars, otherwise the strings are always copied to the pool.
+    //
+    typedef internal::BoolType<((parseFlags & kInsituParseFlag) != 0)
+                               && TranscoderType::kInsitu> InsituStringType;
+
+    template <CharType quoteToken, typename ReaderHandlerT>
+    JIMI_FORCEINLINE
+    const CharType * parseStringImpl(const CharType * src, ReaderHandlerT & handler,
+                                     bool isKey, internal::TrueType /* insitu */) {
+        return parseInsituString<quoteToken>(src, handler, isKey);
+    }
+
+    template <CharType quoteToken, typename ReaderHandlerT>
+    JIMI_FORCEINLINE
+    const CharType * parseStringImpl(const CharType * src, ReaderHandlerT & handler,
+                                     bool isKey, internal::FalseType /* insitu */) {
+        return parseString<quoteToken>(src, handler, isKey);
+    }
+
+    template <typename ReaderHandlerT>
+    JIMI_FORCEINLINE
+    const CharType * parseStringToken(const CharType * src, ReaderHandlerT & handler, bool isKey) {
+        if (*src == '"') {
+            // Parse a string begin from token ["]
+            ++src;
+            return parseStringImpl<'"'>(src, handler, isKey, InsituStringType());
+        }
+        else {
+            jimi_assert(*src == '\'');
+            // Parse a string begin from token [\']
+            ++src;
+            return parseStringImpl<'\''>(src, handler, isKey, InsituStringType());
+        }
+    }
+
+    template <typename ReaderHandlerT>
+    JIMI_FORCEINLINE
+    const CharType * parseMemberName(const CharType * src, ReaderHandlerT & handler) {
+        src = skipWhiteSpaces(src);
+        if (*src == '"' || ((parseFlags & kAllowSingleQuotesParseFlag) && *src == '\'')) {
+            src = parseStringToken(src, handler, true);
+            if (this->hasParseError())
+                return src;
+
+            src = skipWhiteSpaces(src);
+            if (*src == ':') {
+                ++src;
+            }
+            else {
+                this->setParseError(kObjectMissColonError, this->tell(src));
+            }
+        }
+        else {
+            this->setParseError(kObjectMissNameError, this->tell(src));
+        }
+        return src;
+    }
+
+    template <typename ReaderHandlerT>
+    JIMI_FORCEINLINE
+    const CharType * parseLiteral(const CharType * src, ReaderHandlerT & handler) {
+        bool success;
+        // The string is terminated by '\0', so the short-circuit compares
+        // never read over the end of the string.
+        if (*src == 'n' && *(src + 1) == 'u' && *(src + 2) == 'l' && *(src + 3) == 'l') {
+            src += 4;
+            success = handler.saxNull();
+        }
+        else if (*src == 't' && *(src + 1) == 'r' && *(src + 2) == 'u' && *(src + 3) == 'e') {
+            src += 4;
+            success = handler.saxBool(true);
+        }
+        else if (*src == 'f' && *(src + 1) == 'a' && *(src + 2) == 'l' && *(src + 3) == 's'
+                 && *(src + 4) == 'e') {
+            src += 5;
+            success = handler.saxBool(false);
+        }
+        else {
+            this->setParseError(kValueInvalidError, this->tell(src));
+            return src;
+        }
+        if (!success)
+            this->setParseError(kTerminationError, this->tell(src));
+        return src;
+    }
+
+    JIMI_FORCEINLINE
+    static bool isDigit(CharType c) {
+        return (static_cast<unsigned>(c) - static_cast<unsigned>('0') <= 9U);
+    }
+
+    // Accumulate 8 digits at a time while w can hold them, return the number of digits.
+    JIMI_FORCEINLINE
+    static int parseEightDigitsRun(const CharType *& src, uint64_t & w, int numDigits) {
+        int count = 0;
+        uint64_t val;
+        while ((numDigits + count + 8 <= 19) && internal::LoadEightChars(src, val)
+               && internal::IsEightDigits(val)) {
+            w = w * UINT64_C(100000000) + internal::ParseEightDigits(val);
+            src += 8;
+            count += 8;
+        }
+        return count;
+    }
+
+    template <typename ReaderHandlerT>
+    const CharType * parseNumber(const CharType * src, ReaderHandlerT & handler) {
+        const CharType * numBegin = src;
+        bool negative = false;
+        if (*src == '-') {
+            negative = true;
+            ++src;
+        }
+
+        // Parse the integral part, the first 19 significant digits (or 20 digits if
+        // it's not overflow) are accumulated in w, the rest are truncated.
+        static const int kMaxDigits = 19;
+        static const uint64_t kMaxUInt64Div10 = UINT64_C(0x1999999999999999);
+
+        const CharType * intBegin = src;
+        uint64_t w = 0;
+        int numDigits = 0;
+        int exp10 = 0;
+        bool truncated = false;
+        if (*src == '0') {
+            ++src;
+        }
+        else if (*src >= '1' && *src <= '9') {
+            w = static_cast<unsigned>(*src - '0');
+            numDigits = 1;
+            ++src;
+            numDigits += parseEightDigitsRun(src, w, numDigits);
+            while (isDigit(*src)) {
+                unsigned digit = static_cast<unsigned>(*src - '0');
+                if (numDigits < kMaxDigits
+                    || (numDigits == kMaxDigits && (w < kMaxUInt64Div10 || (w == kMaxUInt64Div10 && digit <= 5)))) {
+                    w = w * 10 + digit;
+                    ++numDigits;
+                }
+                else {
+                    ++exp10;
+                    if (digit != 0)
+                        truncated = true;
+                }
+                ++src;
+            }
+        }
+        else {
+            this->setParseError(kValueInvalidError, this->tell(numBegin));
+            return src;
+        }
+        const CharType * intEnd = src;
+
+        // Parse the fraction part.
+        bool isInteger = true;
+        const CharType * fracBegin = src;
+        const CharType * fracEnd = src;
+        if (*src == '.') {
+            isInteger = false;
+            ++src;
+            if (!isDigit(*src)) {
+                this->setParseError(kNumberMissFractionError, this->tell(src));
+                return src;
+            }
+            fracBegin = src;
+            if (w == 0) {
+                // The leading zeros are not the significant digits.
+                while (*src == '0') {
+                    --exp10;
+                    ++src;
+                }
+            }
+            int count = parseEightDigitsRun(src, w, numDigits);
+            numDigits += count;
+            exp10 -= count;
+            while (isDigit(*src)) {
+                unsigned digit = static_cast<unsigned>(*src - '0');
+                if (numDigits < kMaxDigits) {
+                    w = w * 10 + digit;
+                    ++numDigits;
+                    --exp10;
+                }
+                else if (digit != 0) {
+                    truncated = true;
+                }
+                ++src;
+            }
+            fracEnd = src;
+        }
+
+        // Parse the exponent part.
+        int expPart = 0;
+        if (*src == 'e' || *src == 'E') {
+            isInteger = false;
+            ++src;
+            bool expNegative = false;
+            if (*src == '+') {
+                ++src;
+            }
+            else if (*src == '-') {
+                expNegative = true;
+                ++src;
+            }
+            if (!isDigit(*src)) {
+                this->setParseError(kNumberMissExponentError, this->tell(src));
+                return src;
+            }
+            do {
+                if (expPart < 100000)
+                    expPart = expPart * 10 + static_cast<int>(*src - '0');
+                ++src;
+            } while (isDigit(*src));
+            if (expNegative)
+                expPart = -expPart;
+            exp10 += expPart;
+        }
+
+        bool success;
+        if (isInteger && exp10 == 0) {
+            if (negative) {
+                if (w <= UINT64_C(0x80000000))
+                    success = handler.saxInt(static_cast<int>(0 - static_cast<unsigned>(w)));
+                else if (w <= UINT64_C(0x8000000000000000))
+                    success = handler.saxInt64(static_cast<int64_t>(0 - w));
+                else
+                    success = handler.saxDouble(-static_cast<double>(w));
+            }
+            else {
+                if (w <= UINT64_C(0x7FFFFFFF))
+                    success = handler.saxInt(static_cast<int>(w));
+                else if (w <= UINT64_C(0xFFFFFFFF))
+                    success = handler.saxUint(static_cast<unsigned>(w));
+                else if (w <= UINT64_C(0x7FFFFFFFFFFFFFFF))
+                    success = handler.saxInt64(static_cast<int64_t>(w));
+                else
+                    success = handler.saxUint64(w);
+            }
+        }
+        else {
+            double d;
+            if (w == 0) {
+                d = 0.0;
+            }
+            else if (truncated || !internal::StrtodFastPath(w, exp10, d)) {
+                internal::AdjustedMantissa am = internal::ComputeFloat(w, exp10);
+                if (truncated) {
+                    // The exact value is in (w, w + 1) * 10^exp10, if both of them
+                    // round to the same double, it's the answer, else compare the digits.
+                    if (w == UINT64_C(0xFFFFFFFFFFFFFFFF) || am != internal::ComputeFloat(w + 1, exp10))
+                        am = internal::DigitCompare(intBegin, intEnd, fracBegin, fracEnd, expPart, am);
+                }
+                if (am.power2 == internal::kInfinitePower) {
+                    this->setParseError(kNumberTooBigError, this->tell(numBegin));
+                    return src;
+                }
+                d = internal::ToDouble(false, am);
+            }
+            success = handler.saxDouble(negative ? -d : d);
+        }
+        if (!success)
+            this->setParseError(kTerminationError, this->tell(src));
+        return src;
+    }
+
+    template <typename ReaderHandlerT>
+    JIMI_FORCEINLINE
+    const CharType * parseScalar(const CharType * src, ReaderHandlerT & handler) {
+        switch (*src) {
+        case '"':
+            return parseStringToken(src, handler, false);
+
+        case '\'':
+            // Allow use the single quotes [\']
+            if (parseFlags & kAllowSingleQuotesParseFlag)
+                return parseStringToken(src, handler, false);
+            break;
+
+        case 'n':
+        case 't':
+        case 'f':
+            return parseLiteral(src, handler);
+
+        case '-':
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            return parseNumber(src, handler);
+
+        default:
+            break;
+        }
+        this->setParseError(kValueInvalidError, this->tell(src));
+        return src;
+    }
+
+    //
+    // Skip a value without parsing it, return the char after the value. The
+    // strings are not unescaped and the numbers are not converted, only the
+    // brackets are counted (see "JsonFx/Internal/ValueSkipper.h"), so the
+    // content of the skipped value is not validated, but an unclosed string
+    // or container is still an error.
+    //
+    const CharType * skipValue(const CharType * src) {
+        static const bool kAllowSingleQuotes = ((parseFlags & kAllowSingleQuotesParseFlag) != 0);
+        src = skipWhiteSpaces(src);
+        if (*src == '{' || *src == '[') {
+            bool isObject = (*src == '{');
+            size_t depth = 1;
+            const CharType * end = internal::SkipContainer(src + 1, depth, kAllowSingleQuotes);
+            if (depth != 0) {
+                this->setParseError(isObject ? kObjectMissCommaOrCurlyBracketError
+                                             : kArrayMissCommaOrSquareBracketError, this->tell(end));
+                return end;
+            }
+            return (end + 1);
+        }
+        else if (*src == '"' || (kAllowSingleQuotes && *src == '\'')) {
+            const CharType * end = internal::SkipString(src + 1, *src);
+            if (*end == '\0') {
+                this->setParseError(kValueStringMissQuoteError, this->tell(end));
+                return end;
+            }
+            return (end + 1);
+        }
+        else {
+            const CharType * end = internal::SkipScalarToken(src);
+            if (end == src)
+                this->setParseError(kValueInvalidError, this->tell(src));
+            return end;
+        }
+    }
+
+    //
+    // Parse a value iteratively, the nested objects and arrays are pushed to
+    // the container frames stack instead of recursive calls, so the depth of
+    // nesting is only limited by the memory, not by the C stack.
+    //
+    template <typename ReaderHandlerT>
+    const CharType * parseValue(const CharType * src, ReaderHandlerT & handler) {
+        const size_t stackBase = mStack->getSize();
+
+        for (;;) {
+            // Parse a value, or the beginning of a object or array.
+            src = skipWhiteSpaces(src);
+            if (*src == '{' || *src == '[') {
+                uint32_t isObject = (*src == '{');
+                ++src;
+                if (!(isObject ? handler.saxStartObject() : handler.saxStartArray())) {
+                    this->setParseError(kTerminationError, this->tell(src));
+                    return src;
+                }
+                src = skipWhiteSpaces(src);
+                if (*src != (isObject ? '}' : ']')) {
+                    ContainerFrame * frame = mStack->template push<ContainerFrame>();
+                    frame->isObject = isObject;
+                    frame->count    = 0;
+                    if (isObject) {
+                        src = parseMemberName(src, handler);
+                        if (this->hasParseError())
+                            return src;
+                    }
+                    // Parse the first value of the container.
+                    continue;
+                }
+                // It's a empty object or array.
+                ++src;
+                if (!(isObject ? handler.saxEndObject(0) : handler.saxEndArray(0))) {
+                    this->setParseError(kTerminationError, this->tell(src));
+                    return src;
+                }
+            }
+            else {
+                src = parseScalar(src, handler);
+                if (this->hasParseError())
+                    return src;
+            }
+
+            // A value is finished, close all the containers which end here.
+            for (;;) {
+                if (mStack->getSize() == stackBase)
+                    return src;
+
+                ContainerFrame * frame = mStack->template Top<ContainerFrame>();
+                frame->count++;
+                src = skipWhiteSpaces(src);
+                if (*src == ',') {
+                    ++src;
+                    if (frame->isObject) {
+                        src = parseMemberName(src, handler);
+                        if (this->hasParseError())
+                            return src;
+                    }
+                    // Parse the next value of the container.
+                    break;
+                }
+                else if (*src == (frame->isObject ? '}' : ']')) {
+                    ++src;
+                    uint32_t isObject = frame->isObject;
+                    SizeType count = static_cast<SizeType>(frame->count);
+                    mStack->template pop<ContainerFrame>(1);
+                    if (!(isObject ? handler.saxEndObject(count) : handler.saxEndArray(count))) {
+                        this->setParseError(kTerminationError, this->tell(src));
+                        return src;
+                    }
+                }
+                else {
+                    if (frame->isObject)
+                        this->setParseError(kObjectMissCommaOrCurlyBracketError, this->tell(src));
+                    else
+                        this->setParseError(kArrayMissCommaOrSquareBracketError, this->tell(src));
+                    return src;
+                }
+            }
+        }
+    }
+
+    //
+    // Read the member name and the ':' after it, child is the matched node of
+    // the projection. The plain names are matched in the source directly, the
+    // others are unescaped to the capture (its str is NULL for the plain names),
+    // in the source buffer for the in-situ mode, or in the name buffer of reader
+    // which is only valid until the next name.
+    //
+    template <typename ProjectionT>
+    JIMI_FORCEINLINE
+    const CharType * matchMemberName(const CharType * src, const ProjectionT & projection,
+                                     uint32_t node, uint32_t & child, KeyCaptureHandler & capture) {
+        capture.str = NULL;
+        capture.length = 0;
+        src = skipWhiteSpaces(src);
+        if (TranscoderType::kTransparent && *src == '"') {
+            const CharType * end = scanString(src + 1, '"');
+            if (this->hasParseError())
+                return end;
+            if (*end == '"') {
+                child = projection.findMember(node, src + 1, static_cast<SizeType>(end - (src + 1)));
+                src = skipWhiteSpaces(end + 1);
+                if (*src == ':')
+                    ++src;
+                else
+                    this->setParseError(kObjectMissColonError, this->tell(src));
+                return src;
+            }
+        }
+        // The escaped or transcoded names are matched after unescaping.
+        if (InsituStringType::Value)
+            src = parseMemberName(src, capture);
+        else
+            src = captureMemberName(src, capture);
+        if (!this->hasParseError())
+            child = projection.findMember(node, capture.str, capture.length);
+        return src;
+    }
+
+    //
+    // Unescape the member name to the name buffer of reader, so the names
+    // which are skipped never take the space of pool allocator, even if they
+    // are too long for the scratch space of it (see parseLargeString()).
+    //
+    template <CharType quoteToken>
+    const CharType * captureString(const CharType * src, KeyCaptureHandler & capture) {
+        const CharType * end = this->scanStringEnd<quoteToken>(src);
+        if (this->hasParseError())
+            return end;
+        if (*end != quoteToken) {
+            this->setParseError(kKeyStringMissQuoteError, this->tell(end));
+            return end;
+        }
+        mNameBuffer.clear();
+        TargetCharType * begin = mNameBuffer.template push<TargetCharType>(
+            static_cast<size_t>(end - src) * TranscoderType::kMaxExpansion + 1);
+        TargetCharType * cursor = begin;
+        if (!this->unescapeScanned<quoteToken>(cursor, src, end))
+            return end;
+        *cursor = '\0';
+        capture.str    = begin;
+        capture.length = static_cast<SizeType>(cursor - begin);
+        return (end + 1);
+    }
+
+    const CharType * captureMemberName(const CharType * src, KeyCaptureHandler & capture) {
+        src = skipWhiteSpaces(src);
+        if (*src == '"')
+            src = captureString<'"'>(src + 1, capture);
+        else if ((parseFlags & kAllowSingleQuotesParseFlag) && *src == '\'')
+            src = captureString<'\''>(src + 1, capture);
+        else
+            this->setParseError(kObjectMissNameError, this->tell(src));
+        if (this->hasParseError())
+            return src;
+
+        src = skipWhiteSpaces(src);
+        if (*src == ':')
+            ++src;
+        else
+            this->setParseError(kObjectMissColonError, this->tell(src));
+        return src;
+    }
+
+    //
+    // Parse a value with the projection (see "JsonFx/Projection.h"), only the
+    // values on the paths are sent to the handler, the others are skipped by
+    // skipValue(). The selected values are parsed by parseValue(), and the
+    // containers on the way to them are parsed iteratively here.
+    //
+    template <typename ReaderHandlerT, typename ProjectionT>
+    const CharType * parseProjected(const CharType * src, ReaderHandlerT & handler,
+                                    const ProjectionT & projection) {
+        const size_t stackBase = mStack->getSize();
+        uint32_t node = ProjectionT::kRootNode;
+
+        src = skipWhiteSpaces(src);
+        if (projection.isSelected(node))
+            return parseValue(src, handler);
+        if (*src != '{' && *src != '[') {
+            // The root is not on the paths, it's replaced by a null.
+            src = skipValue(src);
+            if (!this->hasParseError() && !handler.saxNull())
+                this->setParseError(kTerminationError, this->tell(src));
+            return src;
+        }
+
+        for (;;) {
+            // Begin a object or array on the paths.
+            uint32_t isObject = (*src == '{');
+            ++src;
+            if (!(isObject ? handler.saxStartObject() : handler.saxStartArray())) {
+                this->setParseError(kTerminationError, this->tell(src));
+                return src;
+            }
+            ProjectionFrame * frame = mStack->template push<ProjectionFrame>();
+            frame->isObject = isObject;
+            frame->count    = 0;
+            frame->index    = 0;
+            frame->node     = node;
+            src = skipWhiteSpaces(src);
+            bool hasNext = (*src != (isObject ? '}' : ']'));
+            if (!hasNext)
+                ++src;
+
+            for (;;) {
+                if (hasNext) {
+                    // Match the next member or element.
+                    const CharType * name = src;
+                    KeyCaptureHandler capture;
+                    uint32_t child;
+                    if (frame->isObject) {
+                        src = matchMemberName(src, projection, frame->node, child, capture);
+                        if (this->hasParseError())
+                            return src;
+                    }
+                    else {
+                        child = projection.findElement(frame->node, frame->index++);
+                    }
+
+                    src = skipWhiteSpaces(src);
+                    if (child != ProjectionT::kNoNode
+                        && (projection.isSelected(child) || *src == '{' || *src == '[')) {
+                        if (frame->isObject) {
+                            // Send the matched name to the handler, the name is parsed again,
+                            // unless it has been unescaped in the source buffer (in-situ),
+                            // the capture in the name buffer is never sent.
+                            if (capture.str == NULL || !InsituStringType::Value)
+                                parseMemberName(name, handler);
+                            else
+                                this->handleString(handler, capture.str, capture.length, true, src);
+                            if (this->hasParseError())
+                                return src;
+                        }
+                        if (!projection.isSelected(child)) {
+                            // Go into the container on the paths.
+                            node = child;
+                            break;
+                        }
+                        src = parseValue(src, handler);
+                        if (this->hasParseError())
+                            return src;
+                        frame = mStack->template Top<ProjectionFrame>();
+                        frame->count++;
+                    }
+                    else {
+                        src = skipValue(src);
+                        if (this->hasParseError())
+                            return src;
+                    }
+                }
+                else {
+                    // The container is ended.
+                    SizeType count = static_cast<SizeType>(frame->count);
+                    mStack->template pop<ProjectionFrame>(1);
+                    if (!(isObject ? handler.saxEndObject(count) : handler.saxEndArray(count))) {
+                        this->setParseError(kTerminationError, this->tell(src));
+                        return src;
+                    }
+                    if (mStack->getSize() == stackBase)
+                        return src;
+                    frame = mStack->template Top<ProjectionFrame>();
+                    frame->count++;
+                }
+
+                // The ',' or the end of the container.
+                isObject = frame->isObject;
+                src = skipWhiteSpaces(src);
+                if (*src == ',') {
+                    ++src;
+                    hasNext = true;
+                }
+                else if (*src == (isObject ? '}' : ']')) {
+                    ++src;
+                    hasNext = false;
+                }
+                else {
+                    if (isObject)
+                        this->setParseError(kObjectMissCommaOrCurlyBracketError, this->tell(src));
+                    else
+                        this->setParseError(kArrayMissCommaOrSquareBracketError, this->tell(src));
+                    return src;
+                }
+            }
+        }
+    }
+
+    template <typename ReaderHandlerT>
+    JIMI_FORCEINLINE
+    const CharType * parseIndexedMemberName(const CharType * base, const uint32_t *& index,
+                                            ReaderHandlerT & handler) {
+        const CharType * src = base + *index++;
+        if (*src == '"') {
+            src = parseStringToken(src, handler, true);
+            if (this->hasParseError())
+                return src;
+
+            src = base + *index++;
+            if (*src == ':') {
+                ++src;
+            }
+            else {
+                this->setParseError(kObjectMissColonError, this->tell(src));
+            }
+        }
+        else {
+            this->setParseError(kObjectMissNameError, this->tell(src));
+        }
+        return src;
+    }
+
+    //
+    // The two-stage parsing: the stage 1 builds the structural index of the whole
+    // buffer (see "JsonFx/Internal/StructuralIndex.h"), and the stage 2 walks the
+    // index instead of skipping the whitespaces and finding the tokens char by char.
+    // The handler receives the same events (and errors) as parseValue().
+    //
+    template <typename ReaderHandlerT>
+    const CharType * parseIndexed(const CharType * src, ReaderHandlerT & handler) {
+        // Stage 1: build the index, fallback to the single-pass parsing if it's too long.
+        mIndexStack.clear();
+        if (!internal::BuildStructuralIndex(src, mIndexStack))
+            return parseValue(src, handler);
+
+        // Stage 2: walk the index.
+        const CharType * const base = src;
+        const uint32_t * index = mIndexStack.template Bottom<uint32_t>();
+        const size_t stackBase = mStack->getSize();
+
+        for (;;) {
+            // Parse a value, or the beginning of a object or array.
+            src = base + *index++;
+            if (*src == '{' || *src == '[') {
+                uint32_t isObject = (*src == '{');
+                ++src;
+                if (!(isObject ? handler.saxStartObject() : handler.saxStartArray())) {
+                    this->setParseError(kTerminationError, this->tell(src));
+                    return src;
+                }
+                if (base[*index] != (isObject ? '}' : ']')) {
+                    ContainerFrame * frame = mStack->template push<ContainerFrame>();
+                    frame->isObject = isObject;
+                    frame->count    = 0;
+                    if (isObject) {
+                        src = parseIndexedMemberName(base, index, handler);
+                        if (this->hasParseError())
+                            return src;
+                    }
+                    // Parse the first value of the container.
+                    continue;
+                }
+                // It's a empty object or array.
+                src = base + *index++ + 1;
+                if (!(isObject ? handler.saxEndObject(0) : handler.saxEndArray(0))) {
+                    this->setParseError(kTerminationError, this->tell(src));
+                    return src;
+                }
+            }
+            else {
+                src = parseScalar(src, handler);
+                if (this->hasParseError())
+                    return src;
+                // The number and literal tokens are not ended by the index, the
+                // chars after them must be the whitespaces until the next token.
+                if (src != base + *index) {
+                    const CharType * next = skipWhiteSpaces(src);
+                    if (next != base + *index) {
+                        if (mStack->getSize() != stackBase) {
+                            if (mStack->template Top<ContainerFrame>()->isObject)
+                                this->setParseError(kObjectMissCommaOrCurlyBracketError, this->tell(next));
+                            else
+                                this->setParseError(kArrayMissCommaOrSquareBracketError, this->tell(next));
+                        }
+                        return next;
+                    }
+                }
+            }
+
+            // A value is finished, close all the containers which end here.
+            for (;;) {
+                if (mStack->getSize() == stackBase)
+                    return src;
+
+                ContainerFrame * frame = mStack->template Top<ContainerFrame>();
+                frame->count++;
+                src = base + *index++;
+                if (*src == ',') {
+                    ++src;
+                    if (frame->isObject) {
+                        src = parseIndexedMemberName(base, index, handler);
+                        if (this->hasParseError())
+                            return src;
+                    }
+                    // Parse the next value of the container.
+                    break;
+                }
+                else if (*src == (frame->isObject ? '}' : ']')) {
+                    ++src;
+                    uint32_t isObject = frame->isObject;
+                    SizeType count = static_cast<SizeType>(frame->count);
+                    mStack->template pop<ContainerFrame>(1);
+                    if (!(isObject ? handler.saxEndObject(count) : handler.saxEndArray(count))) {
+                        this->setParseError(kTerminationError, this->tell(src));
+                        return src;
+                    }
+                }
+                else {
+                    if (frame->isObject)
+                        this->setParseError(kObjectMissCommaOrCurlyBracketError, this->tell(src));
+                    else
+                        this->setParseError(kArrayMissCommaOrSquareBracketError, this->tell(src));
+                    return src;
+                }
+            }
+        }
+    }
+
     template <typename InputStreamT, typename ReaderHandlerT>
-    ParseResultType parse(const InputStreamT & is, const ReaderHandlerT & handler) {
+    ParseResultType parse(const InputStreamT & is, ReaderHandlerT & handler) {
         mParseResult.clear();
+        mStack->clear();
 
         jimi_assert(is.peek() != NULL);
         //printf("JsonFx::BasicDocument::parse(const InuptStreamT &) visited.\n\n");
@@ -740,45 +1585,57 @@ public:
         mInputStream = &(const_cast<InputStreamT &>(is));
 
         const CharType * cur = is.getCurrent();
-        while (*cur != '\0') {
-            // Skip the whitespace chars
-            cur = skipWhiteSpaces(cur);
-            //skipWhiteSpaces(is);
-
-            if (*cur == '"') {
-                // Parse a string begin from token ["]
-                ++cur;
-                if (!(parseFlags & kInsituParseFlag))
-                    cur = parseString<'"'>(cur, handler);
-                else
-                    cur = parseInsituString<'"'>(cur, handler);
-            }
-            else if (*cur == '\'') {
-                // Allow use the single quotes [\']
-                if (parseFlags & kAllowSingleQuotesParseFlag) {
-                    // Parse a string begin from token [\']
-                    ++cur;
-                    if (!(parseFlags & kInsituParseFlag))
-                        parseString<'\''>(cur, handler);
-                    else
-                        parseInsituString<'\''>(cur, handler);
-                }
-            }
-            else if (*cur == '{') {
-                // Parse a object
-                ++cur;
-                parseObject(is, handler);
-            }
-            else if (*cur == '[') {
-                // Parse a array
-                ++cur;
-                parseArray(is, handler);
+        // Skip the whitespace chars
+        cur = skipWhiteSpaces(cur);
+        if (*cur != '\0') {
+            // The structural index only knows the double quotes strings, and it
+            // indexes the whole buffer, it doesn't pay when only a value is parsed.
+            if ((parseFlags & kStructuralIndexParseFlag) && !(parseFlags & kAllowSingleQuotesParseFlag)
+                && !(parseFlags & kStopWhenDoneParseFlag))
+                cur = parseIndexed(cur, handler);
+            else
+                cur = parseValue(cur, handler);
+            // The stream is left at the char after the root value.
+            if (!this->hasParseError() && !(parseFlags & kStopWhenDoneParseFlag)) {
+                cur = skipWhiteSpaces(cur);
+                if (*cur != '\0')
+                    this->setParseError(kDocumentRootNotSingularError, this->tell(cur));
             }
-            else {
-                // Other chars
-                ++cur;
+        }
+        else {
+            this->setParseError(kDocumentEmptyError, this->tell(cur));
+        }
+        mInputStream->setCurrent(const_cast<CharType *>(cur));
+        return mParseResult;
+    }
+
+    //
+    // Parse the document with the projection, only the values on the paths
+    // are sent to the handler (see parseProjected()).
+    //
+    template <typename InputStreamT, typename ReaderHandlerT, typename ProjectionT>
+    ParseResultType parse(const InputStreamT & is, ReaderHandlerT & handler,
+                          const ProjectionT & projection) {
+        mParseResult.clear();
+        mStack->clear();
+
+        jimi_assert(is.peek() != NULL);
+        mInputStream = &(const_cast<InputStreamT &>(is));
+
+        const CharType * cur = is.getCurrent();
+        cur = skipWhiteSpaces(cur);
+        if (*cur != '\0') {
+            cur = parseProjected(cur, handler, projection);
+            if (!this->hasParseError() && !(parseFlags & kStopWhenDoneParseFlag)) {
+                cur = skipWhiteSpaces(cur);
+                if (*cur != '\0')
+                    this->setParseError(kDocumentRootNotSingularError, this->tell(cur));
             }
         }
+        else {
+            this->setParseError(kDocumentEmptyError, this->tell(cur));
+        }
+        mInputStream->setCurrent(const_cast<CharType *>(cur));
         return mParseResult;
     }
 };
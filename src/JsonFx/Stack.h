@@ -10,35 +10,196 @@
 
 #include "JsonFx/Allocator.h"
 
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/assert.h"
+
 namespace JsonFx {
 
 // Forward declaration.
-template <typename PoolAllocatorT = DefaultPoolAllocator>
+template <typename AllocatorT = DefaultAllocator>
 class BasicStack;
 
 // Define default Stack class type
 typedef BasicStack<>    Stack;
 
-template <typename PoolAllocatorT /* = DefaultPoolAllocator */>
+//
+// A contiguous typed stack, the buffer grows geometrically (1.5x).
+//
+// The AllocatorT can be a heap allocator (like TrivialAllocator) or a pool
+// allocator (like FastPoolAllocator):
+//
+//   Heap allocator: the buffer is kept by clear(), so it's reused across
+//                   parses, and freed when the stack is destroyed.
+//   Pool allocator: the buffer grows by PoolAllocator::reallocate(), it's
+//                   never freed by the stack, call reset() to forget it
+//                   when the pool allocator has been reset.
+//
+template <typename AllocatorT /* = DefaultAllocator */>
 class BasicStack {
+public:
+    typedef AllocatorT  AllocatorType;
+
+    static const size_t kDefaultCapacity = 256;
 
 private:
-    PoolAllocatorT *    mAllocator;
-    size_t              mCapacity;
+    AllocatorType *     mAllocator;
+    bool                mAllocatorNeedFree;
+    char *              mStack;
+    char *              mStackTop;
+    char *              mStackEnd;
+    size_t              mInitCapacity;
 
 public:
-    BasicStack(const PoolAllocatorT * allocator, size_t capacity)
-        : mAllocator(const_cast<PoolAllocatorT *>(allocator)), mCapacity(capacity)
+    BasicStack(const AllocatorType * allocator = NULL, size_t capacity = kDefaultCapacity)
+        : mAllocator(const_cast<AllocatorType *>(allocator)), mAllocatorNeedFree(false),
+          mStack(NULL), mStackTop(NULL), mStackEnd(NULL),
+          mInitCapacity((capacity != 0) ? capacity : kDefaultCapacity)
     {
         /* Do nothing! */
     }
 
-    ~BasicStack() {}
+    ~BasicStack() {
+        destroy();
+    }
+
+private:
+    //! Copy constructor is not permitted.
+    BasicStack(const BasicStack & rhs);                 /* = delete */
+    //! Copy assignment operator is not permitted.
+    BasicStack & operator =(const BasicStack & rhs);    /* = delete */
+
+    void destroy() {
+        freeBuffer();
+        if (mAllocatorNeedFree) {
+            if (mAllocator != NULL) {
+                delete mAllocator;
+                mAllocator = NULL;
+            }
+            mAllocatorNeedFree = false;
+        }
+    }
+
+    void freeBuffer() {
+        if (mStack != NULL) {
+            // The memory of pool allocator can not be freed one by one.
+            if (AllocatorType::kNeedFree) {
+                jimi_assert(mAllocator != NULL);
+                mAllocator->deallocate(mStack);
+            }
+            mStack = NULL;
+        }
+        mStackTop = NULL;
+        mStackEnd = NULL;
+    }
+
+    void initAllocator() {
+        if (mAllocator == NULL) {
+            AllocatorType * newAllocator = new AllocatorType();
+            jimi_assert(newAllocator != NULL);
+            if (newAllocator != NULL) {
+                mAllocator = newAllocator;
+                mAllocatorNeedFree = true;
+            }
+        }
+    }
+
+    JIMI_NOINLINE_DECLARE(void) expand(size_t size) {
+        size_t used = getSize();
+        size_t capacity = getCapacity();
+        size_t newCapacity;
+        if (mStack == NULL)
+            newCapacity = mInitCapacity;
+        else
+            newCapacity = capacity + (capacity + 1) / 2;
+        if (newCapacity < used + size)
+            newCapacity = used + size;
+
+        if (mAllocator == NULL)
+            initAllocator();
+
+        // The first buffer is allocated, the allocators copy the old buffer
+        // in reallocate() without checking it.
+        if (mStack == NULL)
+            mStack = reinterpret_cast<char *>(mAllocator->allocate(newCapacity));
+        else
+            mStack = reinterpret_cast<char *>(mAllocator->reallocate(mStack, capacity, newCapacity));
+        jimi_assert(mStack != NULL);    // Do not handle out-of-memory explicitly.
+        mStackTop = mStack + used;
+        mStackEnd = mStack + newCapacity;
+    }
+
+public:
+    const AllocatorType * getAllocator() const { return mAllocator; }
+
+    // Change the allocator, the buffer allocated by old allocator will be released.
+    void setAllocator(const AllocatorType * allocator) {
+        destroy();
+        mAllocator = const_cast<AllocatorType *>(allocator);
+        mAllocatorNeedFree = false;
+    }
+
+    size_t getSize() const      { return static_cast<size_t>(mStackTop - mStack); }
+    size_t getCapacity() const  { return static_cast<size_t>(mStackEnd - mStack); }
+
+    bool empty() const { return (mStackTop == mStack); }
+
+    // Pop all the items, but keep the buffer for reuse.
+    void clear() { mStackTop = mStack; }
+
+    // Forget the buffer, it's must be called after the pool allocator reset.
+    void reset() { freeBuffer(); }
+
+    void reserve(size_t capacity) {
+        if (capacity > getCapacity())
+            expand(capacity - getSize());
+    }
+
+    template <typename T>
+    JIMI_FORCEINLINE
+    T * push(size_t count = 1) {
+        // Expand the stack if the remain space is not enough.
+        if (mStackTop + sizeof(T) * count > mStackEnd)
+            expand(sizeof(T) * count);
+
+        T * top = reinterpret_cast<T *>(mStackTop);
+        mStackTop += sizeof(T) * count;
+        return top;
+    }
+
+    template <typename T>
+    JIMI_FORCEINLINE
+    T * pop(size_t count) {
+        jimi_assert(getSize() >= sizeof(T) * count);
+        mStackTop -= sizeof(T) * count;
+        return reinterpret_cast<T *>(mStackTop);
+    }
+
+    template <typename T>
+    JIMI_FORCEINLINE
+    T * Top() {
+        jimi_assert(getSize() >= sizeof(T));
+        return reinterpret_cast<T *>(mStackTop - sizeof(T));
+    }
+
+    template <typename T>
+    JIMI_FORCEINLINE
+    const T * Top() const {
+        jimi_assert(getSize() >= sizeof(T));
+        return reinterpret_cast<const T *>(mStackTop - sizeof(T));
+    }
+
+    template <typename T>
+    JIMI_FORCEINLINE
+    T * Bottom() { return reinterpret_cast<T *>(mStack); }
+
+    template <typename T>
+    JIMI_FORCEINLINE
+    const T * Bottom() const { return reinterpret_cast<const T *>(mStack); }
 };
 
 }  // namespace JsonFx
 
 // Define default Stack class type
-typedef JsonFx::BasicStack<JsonFx::DefaultPoolAllocator>    jfxStack;
+typedef JsonFx::BasicStack<JsonFx::DefaultAllocator>    jfxStack;
 
 #endif  /* !_JSONFX_INTERNAL_STACK_H_ */
@@ -0,0 +1,484 @@
+
+#ifndef _JSONFX_TAPEDOCUMENT_H_
+#define _JSONFX_TAPEDOCUMENT_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include <string.h>
+
+#include "JsonFx/Config.h"
+#include "JsonFx/Allocator.h"
+#include "JsonFx/Stack.h"
+#include "JsonFx/ParseResult.h"
+#include "JsonFx/Reader.h"
+#include "JsonFx/Internal/String.h"
+#include "JsonFx/Stream/StringInputStream.h"
+
+#include "jimi/basic/stddef.h"
+#include "jimi/basic/stdint.h"
+#include "jimi/basic/assert.h"
+
+//
+// The tape is a flat array of 64-bit words in the order of the text, the
+// high 8 bits of a word is the type tag, the low 56 bits is the payload:
+//
+//   'n', 't', 'f'      null, true, false, the payload is 0.
+//   'l', 'u', 'd'      int64, uint64, double, the number is in the next word.
+//   '"'                string, the payload is the byte offset of it in the
+//                      string buffer: uint32_t length, the chars, a '\0'.
+//   '{', '['           the payload is the index after the matched '}' or ']'
+//                      (the low 32 bits) and the count of members or elements
+//                      (the high 24 bits, kTapeCountOverflow if it overflows).
+//   '}', ']'           the payload is the index of the matched '{' or '['.
+//
+// The members of object are the key string word followed by the value words.
+// A container is skipped in O(1) by its end index, and the tape and the string
+// buffer have no pointer, so they can be copied by memcpy() or saved to file.
+//
+
+namespace JsonFx {
+
+enum TapeType {
+    kTapeNullType           = 'n',
+    kTapeTrueType           = 't',
+    kTapeFalseType          = 'f',
+    kTapeInt64Type          = 'l',
+    kTapeUint64Type         = 'u',
+    kTapeDoubleType         = 'd',
+    kTapeStringType         = '"',
+    kTapeStartObjectType    = '{',
+    kTapeEndObjectType      = '}',
+    kTapeStartArrayType     = '[',
+    kTapeEndArrayType       = ']'
+};
+
+static const uint64_t kTapePayloadMask  = (UINT64_C(1) << 56) - 1;
+static const uint32_t kTapeCountOverflow = 0x00FFFFFFU;
+
+// Forward declaration.
+template <typename EncodingT = JSONFX_DEFAULT_ENCODING,
+          typename PoolAllocatorT = DefaultPoolAllocator,
+          typename AllocatorT = DefaultAllocator>
+class BasicTapeDocument;
+
+template <typename EncodingT = JSONFX_DEFAULT_ENCODING>
+class BasicTapeValue;
+
+// Define default TapeDocument and TapeValue class type
+typedef BasicTapeDocument<>     TapeDocument;
+typedef BasicTapeValue<>        TapeValue;
+
+//
+// A read only view of a value in the tape, it's a pointer to the tape and
+// the string buffer and a index, so it's cheap to copy. It's invalid after
+// the document is parsed again or destroyed.
+//
+template <typename EncodingT /* = JSONFX_DEFAULT_ENCODING */>
+class BasicTapeValue {
+public:
+    typedef typename EncodingT::CharType    CharType;
+    typedef uint32_t                        SizeType;
+
+private:
+    const uint64_t *    mTape;
+    const char *        mStrings;
+    size_t              mIndex;
+
+public:
+    BasicTapeValue() : mTape(NULL), mStrings(NULL), mIndex(0) {}
+    BasicTapeValue(const uint64_t * tape, const char * strings, size_t index)
+        : mTape(tape), mStrings(strings), mIndex(index) {}
+
+private:
+    uint64_t getWord() const { return mTape[mIndex]; }
+    uint64_t getPayload() const { return (getWord() & kTapePayloadMask); }
+
+    BasicTapeValue at(size_t index) const {
+        return BasicTapeValue(mTape, mStrings, index);
+    }
+
+public:
+    // The invalid value is returned for the missing member or element.
+    bool isValid() const { return (mTape != NULL); }
+
+    size_t getIndex() const { return mIndex; }
+
+    TapeType getType() const {
+        jimi_assert(isValid());
+        return static_cast<TapeType>(getWord() >> 56);
+    }
+
+    bool isNull()   const { return (getType() == kTapeNullType);        }
+    bool isFalse()  const { return (getType() == kTapeFalseType);       }
+    bool isTrue()   const { return (getType() == kTapeTrueType);        }
+    bool isBool()   const { return (isTrue() || isFalse());             }
+    bool isObject() const { return (getType() == kTapeStartObjectType); }
+    bool isArray()  const { return (getType() == kTapeStartArrayType);  }
+    bool isInt64()  const { return (getType() == kTapeInt64Type);       }
+    bool isUint64() const { return (getType() == kTapeUint64Type);      }
+    bool isDouble() const { return (getType() == kTapeDoubleType);      }
+    bool isNumber() const { return (isInt64() || isUint64() || isDouble()); }
+    bool isString() const { return (getType() == kTapeStringType);      }
+
+    bool getBool() const {
+        jimi_assert(isBool());
+        return isTrue();
+    }
+
+    int64_t getInt64() const {
+        jimi_assert(isNumber());
+        if (isDouble())
+            return static_cast<int64_t>(getDouble());
+        return static_cast<int64_t>(mTape[mIndex + 1]);
+    }
+
+    uint64_t getUint64() const {
+        jimi_assert(isNumber());
+        if (isDouble())
+            return static_cast<uint64_t>(getDouble());
+        return mTape[mIndex + 1];
+    }
+
+    double getDouble() const {
+        jimi_assert(isNumber());
+        if (isInt64())
+            return static_cast<double>(static_cast<int64_t>(mTape[mIndex + 1]));
+        else if (isUint64())
+            return static_cast<double>(mTape[mIndex + 1]);
+        double d;
+        ::memcpy(&d, &mTape[mIndex + 1], sizeof(double));
+        return d;
+    }
+
+    const CharType * getString() const {
+        jimi_assert(isString());
+        return reinterpret_cast<const CharType *>(mStrings + getPayload() + sizeof(uint32_t));
+    }
+
+    SizeType getStringLength() const {
+        jimi_assert(isString());
+        uint32_t length;
+        ::memcpy(&length, mStrings + getPayload(), sizeof(uint32_t));
+        return length;
+    }
+
+    // The index after this value, the containers are skipped in O(1).
+    size_t getNextIndex() const {
+        TapeType type = getType();
+        if (type == kTapeStartObjectType || type == kTapeStartArrayType)
+            return static_cast<size_t>(getPayload() & 0xFFFFFFFFU);
+        else if (type == kTapeInt64Type || type == kTapeUint64Type || type == kTapeDoubleType)
+            return (mIndex + 2);
+        else
+            return (mIndex + 1);
+    }
+
+    // The count of members or elements.
+    SizeType getSize() const {
+        jimi_assert(isObject() || isArray());
+        uint32_t count = static_cast<uint32_t>(getPayload() >> 32);
+        if (count != kTapeCountOverflow)
+            return count;
+        // Too many to be saved in the payload, count them by skipping.
+        count = 0;
+        size_t end = getNextIndex() - 1;
+        bool isObj = isObject();
+        for (size_t index = mIndex + 1; index < end; ++count) {
+            if (isObj)
+                ++index;    // The key string.
+            index = at(index).getNextIndex();
+        }
+        return count;
+    }
+
+    //
+    // The children are walked by getFirstChild() and getNextSibling() (the
+    // elements of array) or getNextMember() (the names of members), it's not
+    // valid after the last child. The value of a member is getMemberValue().
+    //
+    BasicTapeValue getFirstChild() const {
+        jimi_assert(isObject() || isArray());
+        return at(mIndex + 1).asChild();
+    }
+
+    BasicTapeValue getNextSibling() const {
+        return at(getNextIndex()).asChild();
+    }
+
+    BasicTapeValue getNextMember() const {
+        jimi_assert(isString());
+        return at(getMemberValue().getNextIndex()).asChild();
+    }
+
+    BasicTapeValue getMemberValue() const {
+        jimi_assert(isString());
+        return at(mIndex + 1);
+    }
+
+    BasicTapeValue findMember(const CharType * name) const {
+        jimi_assert(isObject());
+        jimi_assert(name != NULL);
+        size_t length = internal::StrLen(name);
+        size_t end = getNextIndex() - 1;
+        for (size_t index = mIndex + 1; index < end; ) {
+            BasicTapeValue key = at(index);
+            if (key.getStringLength() == length
+                && ::memcmp(key.getString(), name, sizeof(CharType) * length) == 0)
+                return at(index + 1);
+            index = at(index + 1).getNextIndex();
+        }
+        return BasicTapeValue();
+    }
+
+    bool hasMember(const CharType * name) const {
+        return findMember(name).isValid();
+    }
+
+    BasicTapeValue operator[] (const CharType * name) const {
+        BasicTapeValue member = findMember(name);
+        jimi_assert(member.isValid());
+        return member;
+    }
+
+    // Walk to the element, the elements before it are skipped in O(1) each.
+    BasicTapeValue operator[] (SizeType index) const {
+        jimi_assert(isArray());
+        size_t end = getNextIndex() - 1;
+        size_t cur = mIndex + 1;
+        for (; index > 0 && cur < end; --index) {
+            cur = at(cur).getNextIndex();
+        }
+        jimi_assert(cur < end);
+        return (cur < end) ? at(cur) : BasicTapeValue();
+    }
+
+private:
+    // The end word of the container means there is no more child.
+    BasicTapeValue asChild() const {
+        TapeType type = getType();
+        if (type == kTapeEndObjectType || type == kTapeEndArrayType)
+            return BasicTapeValue();
+        return *this;
+    }
+};
+
+//
+// A document saved as the tape (see above), the strings are copied to a
+// separate string buffer. Compared with the BasicDocument, the members and
+// the numbers take less memory, and the traversal is linear in the memory.
+//
+// The PoolAllocatorT is the scratch pool of the reader, it's reset after
+// each parse. The tape and the string buffer are grown by AllocatorT.
+//
+template <typename EncodingT /* = JSONFX_DEFAULT_ENCODING */,
+          typename PoolAllocatorT /* = DefaultPoolAllocator */,
+          typename AllocatorT /* = DefaultAllocator */>
+class BasicTapeDocument
+{
+public:
+    typedef typename EncodingT::CharType            CharType;
+    typedef size_t                                  SizeType;
+    typedef EncodingT                               EncodingType;
+    typedef PoolAllocatorT                          PoolAllocatorType;
+    typedef AllocatorT                              StackAllocatorType;
+    typedef BasicTapeValue<EncodingT>               ValueType;
+    typedef BasicStringInputStream<CharType>        StringInputStreamType;
+    typedef BasicStack<StackAllocatorType>          StackType;
+    typedef BasicParseResult<EncodingT>             ParseResultType;
+
+private:
+    PoolAllocatorType       mPoolAllocator; // The scratch pool of the reader's strings.
+    StackType               mTape;          // The tape words.
+    StackType               mStrings;       // The string buffer.
+    StackType               mOpenStack;     // The indexes of the open containers.
+    StackType               mReaderStack;   // The container frames stack of reader.
+    ParseResultType         mParseResult;
+
+public:
+    BasicTapeDocument()
+        : mPoolAllocator(), mTape(), mStrings(), mOpenStack(), mReaderStack(),
+          mParseResult() {}
+
+    ~BasicTapeDocument() {}
+
+private:
+    //! Prohibit copying
+    BasicTapeDocument(const BasicTapeDocument &);
+    //! Prohibit assignment
+    BasicTapeDocument & operator =(const BasicTapeDocument &);
+
+public:
+    const ParseResultType & getParseResult() const { return mParseResult; }
+    bool hasParseError() const { return mParseResult.hasError(); }
+
+    // The root value, it's invalid if the parse failed.
+    ValueType getRoot() const {
+        if (mTape.empty() || hasParseError())
+            return ValueType();
+        return ValueType(getTape(), getStrings(), 0);
+    }
+
+    const uint64_t * getTape() const { return mTape.template Bottom<uint64_t>(); }
+    size_t getTapeSize() const { return (mTape.getSize() / sizeof(uint64_t)); }
+
+    const char * getStrings() const { return mStrings.template Bottom<char>(); }
+    size_t getStringsSize() const { return mStrings.getSize(); }
+
+    // The bytes of the tape and the string buffer.
+    size_t getMemoryUsage() const { return (mTape.getSize() + mStrings.getSize()); }
+
+    void reset() {
+        clear();
+        mPoolAllocator.reset();
+    }
+
+    //
+    // Load the tape and the string buffer which are copied from a
+    // document (getTape() and getStrings()), like from a file.
+    //
+    void assign(const uint64_t * tape, size_t tapeSize, const char * strings, size_t stringsSize) {
+        jimi_assert(tape != NULL || tapeSize == 0);
+        jimi_assert(strings != NULL || stringsSize == 0);
+        clear();
+        if (tapeSize != 0)
+            ::memcpy(mTape.template push<uint64_t>(tapeSize), tape, tapeSize * sizeof(uint64_t));
+        if (stringsSize != 0)
+            ::memcpy(mStrings.template push<char>(stringsSize), strings, stringsSize);
+    }
+
+private:
+    void clear() {
+        mParseResult.clear();
+        if (StackAllocatorType::kNeedFree) {
+            // Keep the buffers for reuse.
+            mTape.clear();
+            mStrings.clear();
+            mOpenStack.clear();
+            mReaderStack.clear();
+        }
+        else {
+            mTape.reset();
+            mStrings.reset();
+            mOpenStack.reset();
+            mReaderStack.reset();
+        }
+    }
+
+    void pushWord(TapeType type, uint64_t payload) {
+        jimi_assert((payload & ~kTapePayloadMask) == 0);
+        *mTape.template push<uint64_t>() = (static_cast<uint64_t>(type) << 56) | payload;
+    }
+
+    void pushNumber(TapeType type, uint64_t bits) {
+        uint64_t * words = mTape.template push<uint64_t>(2);
+        words[0] = (static_cast<uint64_t>(type) << 56);
+        words[1] = bits;
+    }
+
+    bool startContainer(TapeType type) {
+        *mOpenStack.template push<uint64_t>() = getTapeSize();
+        pushWord(type, 0);
+        return true;
+    }
+
+    bool endContainer(TapeType type, SizeType count) {
+        uint64_t start = *mOpenStack.template pop<uint64_t>(1);
+        pushWord(type, start);
+        uint64_t end = getTapeSize();
+        // The tape index is limited to 32 bits.
+        jimi_assert(end <= 0xFFFFFFFFU);
+        uint64_t savedCount = (count < kTapeCountOverflow) ? count : kTapeCountOverflow;
+        uint64_t * tape = mTape.template Bottom<uint64_t>();
+        tape[start] |= (savedCount << 32) | end;
+        return true;
+    }
+
+public:
+    // The handlers for the reader.
+    bool saxNull()             { pushWord(kTapeNullType, 0); return true; }
+    bool saxBool(bool b)       { pushWord(b ? kTapeTrueType : kTapeFalseType, 0); return true; }
+    bool saxInt(int i)         { pushNumber(kTapeInt64Type, static_cast<uint64_t>(static_cast<int64_t>(i))); return true; }
+    bool saxUint(unsigned i)   { pushNumber(kTapeInt64Type, static_cast<uint64_t>(i)); return true; }
+    bool saxInt64(int64_t i)   { pushNumber(kTapeInt64Type, static_cast<uint64_t>(i)); return true; }
+    bool saxUint64(uint64_t i) {
+        // Only the values above INT64_MAX need the unsigned type.
+        pushNumber((i <= static_cast<uint64_t>(INT64_MAX)) ? kTapeInt64Type : kTapeUint64Type, i);
+        return true;
+    }
+    bool saxDouble(double d) {
+        uint64_t bits;
+        ::memcpy(&bits, &d, sizeof(double));
+        pushNumber(kTapeDoubleType, bits);
+        return true;
+    }
+
+    bool saxString(const CharType * str, SizeType length, bool copy) {
+        (void)copy;
+        uint64_t offset = mStrings.getSize();
+        uint32_t length32 = static_cast<uint32_t>(length);
+        jimi_assert(length32 == length);
+        size_t bytes = sizeof(uint32_t) + (length + 1) * sizeof(CharType);
+        char * dest = mStrings.template push<char>(bytes);
+        ::memcpy(dest, &length32, sizeof(uint32_t));
+        ::memcpy(dest + sizeof(uint32_t), str, length * sizeof(CharType));
+        ::memset(dest + sizeof(uint32_t) + length * sizeof(CharType), 0, sizeof(CharType));
+        pushWord(kTapeStringType, offset);
+        return true;
+    }
+
+    bool saxKey(const CharType * str, SizeType length, bool copy) { return saxString(str, length, copy); }
+
+    bool saxStartObject() { return startContainer(kTapeStartObjectType); }
+    bool saxEndObject(SizeType memberCount) { return endContainer(kTapeEndObjectType, memberCount); }
+    bool saxStartArray()  { return startContainer(kTapeStartArrayType); }
+    bool saxEndArray(SizeType elementCount) { return endContainer(kTapeEndArrayType, elementCount); }
+
+    //
+    // BasicTapeDocument::parse<parseFlags, SourceEncodingT, InuptStreamT>(is);
+    //
+    template <size_t parseFlags, typename SourceEncodingT, typename InuptStreamT>
+    BasicTapeDocument & parse(const InuptStreamT & is) {
+        clear();
+        {
+            BasicReader<parseFlags, SourceEncodingT, EncodingT, PoolAllocatorT, AllocatorT>
+                reader(&mPoolAllocator, false, &mReaderStack);
+            mParseResult = reader.parse(const_cast<InuptStreamT &>(is), *this);
+        }
+        // The strings have been copied to the string buffer.
+        mPoolAllocator.reset();
+        if (mParseResult.hasError()) {
+            mTape.clear();
+            mStrings.clear();
+        }
+        return *this;
+    }
+
+    //
+    // BasicTapeDocument::parse(const CharType * text);
+    //
+    template <size_t parseFlags, typename SourceEncodingT>
+    BasicTapeDocument & parse(const CharType * text) {
+        jimi_assert(text != NULL);
+        StringInputStreamType inputStream(text);
+        return parse<parseFlags, SourceEncodingT, StringInputStreamType>(inputStream);
+    }
+
+    template <size_t parseFlags>
+    BasicTapeDocument & parse(const CharType * text) {
+        return parse<parseFlags, EncodingT>(text);
+    }
+
+    BasicTapeDocument & parse(const CharType * text) {
+        return parse<kDefaultParseFlags>(text);
+    }
+};
+
+}  // namespace JsonFx
+
+// Define default TapeDocument and TapeValue class type
+typedef JsonFx::BasicTapeDocument<>     jfxTapeDocument;
+typedef JsonFx::BasicTapeValue<>        jfxTapeValue;
+
+#endif  /* !_JSONFX_TAPEDOCUMENT_H_ */
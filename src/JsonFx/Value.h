@@ -7,6 +7,8 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "jimi/basic/stdint.h"
 #include "jimi/basic/stdsize.h"
@@ -17,6 +19,8 @@
 #include "JsonFx/Member.h"
 
 #include "JsonFx/Internal/Traits.h"
+#include "JsonFx/Internal/Hash.h"
+#include "JsonFx/Internal/String.h"
 
 // Just for temporary test!
 #ifdef  jimi_assert
@@ -49,24 +53,20 @@ enum ValueType {
 };
 
 enum ValueTypeMask {
-    kBoolMask           = 0x00000100,
-    kInt8Mask           = 0x00000200,
-    kUInt8Mask          = 0x00000400,
-    kInt16Mask          = 0x00000800,
-    kUInt16Mask         = 0x00001000,
-    kInt32Mask          = 0x00002000,
-    kUInt32Mask         = 0x00004000,
-    kInt64Mask          = 0x00008000,
-    kUInt64Mask         = 0x00010000,
-
-    kIntegerMask        = 0x00020000,
-    kFloatMask          = 0x00040000,
-    kDoubleMask         = 0x00080000,
-    kNumberMask         = 0x00100000,
-
-    kStringMask         = 0x00200000,
-    kCopyStringMask     = 0x00400000,
-    kInlineStringMask   = 0x00800000,
+    kBoolMask           = 0x0010,
+    kInt32Mask          = 0x0020,
+    kUInt32Mask         = 0x0040,
+    kInt64Mask          = 0x0080,
+    kUInt64Mask         = 0x0100,
+
+    kIntegerMask        = 0x0200,
+    kFloatMask          = 0x0400,
+    kDoubleMask         = 0x0800,
+    kNumberMask         = 0x1000,
+
+    kStringMask         = 0x2000,
+    kCopyStringMask     = 0x4000,
+    kInlineStringMask   = 0x8000,
 
     kNumberBoolMask     = kNumberMask | kIntegerMask | kBoolMask,
 
@@ -103,9 +103,9 @@ enum ValueTypeMask {
     kObjectFlags        = kObjectType,
     kNullFlags          = kNullType,
 
-    // Value type mask
-    kTypeMask           = 0xFF,
-    kFlagMask           = 0xFFFFFF00
+    // Value type mask, the flags are saved in 16 bits (see BasicValue)
+    kTypeMask           = 0x000F,
+    kFlagMask           = 0xFFF0
 };
 
 /****************************************************************
@@ -135,10 +135,92 @@ class BasicMember;
 template <bool IsConst, typename EncodingT, typename PoolAllocatorT>
 class BasicMemberIterator;
 
-// Save and setting the packing alignment
-#pragma pack(push)
-#pragma pack(1)
+namespace internal {
+
+//
+// Copy the objects by raw memory, like the values moved from the stack to
+// the pool allocator, the copies are not constructed, so the sources must
+// not be destructed again.
+//
+template <typename T>
+static inline
+void CopyRaw(T * dest, const T * src, size_t count) {
+    ::memcpy(static_cast<void *>(dest), static_cast<const void *>(src), count * sizeof(T));
+}
+
+#if JSONFX_VALUE_PACKED_POINTER
+
+// The pointer is restored by the sign extension of bit 47, so the 57 bits
+// addresses (LA57, only mapped by a hint) can't be packed.
+JIMI_NOINLINE_DECLARE(inline void) PackedPointerOverflow(const void * ptr) {
+    ::fprintf(stderr, "JsonFx: the pointer %p can't be packed into 48 bits, "
+                      "define JSONFX_VALUE_PACKED_POINTER to 0.\n", ptr);
+    ::abort();
+}
+
+// The pointer packed into 48 bits (3 words), it's 2 bytes aligned, so the
+// type flags of value follow it.
+class PackedPointer {
+private:
+    uint16_t    mWords[3];
+
+public:
+    PackedPointer() { mWords[0] = mWords[1] = mWords[2] = 0; }
+
+    void * get() const {
+        uint64_t bits = static_cast<uint64_t>(mWords[0]) | (static_cast<uint64_t>(mWords[1]) << 16)
+                      | (static_cast<uint64_t>(mWords[2]) << 32);
+        // Sign extend the bit 47.
+        int64_t address = static_cast<int64_t>(bits << 16) >> 16;
+        return reinterpret_cast<void *>(static_cast<uintptr_t>(address));
+    }
+
+    void set(const void * ptr) {
+        uint64_t bits = static_cast<uint64_t>(static_cast<int64_t>(reinterpret_cast<intptr_t>(ptr)));
+        // The top 17 bits must be the same, the check is kept in release builds.
+        if (((bits + (UINT64_C(1) << 47)) >> 48) != 0)
+            PackedPointerOverflow(ptr);
+        mWords[0] = static_cast<uint16_t>(bits);
+        mWords[1] = static_cast<uint16_t>(bits >> 16);
+        mWords[2] = static_cast<uint16_t>(bits >> 32);
+    }
+};
 
+#else  /* !JSONFX_VALUE_PACKED_POINTER */
+
+// The full width pointer.
+class PackedPointer {
+private:
+    void *      mPointer;
+
+public:
+    PackedPointer() : mPointer(NULL) {}
+
+    void * get() const           { return mPointer; }
+    void   set(const void * ptr) { mPointer = const_cast<void *>(ptr); }
+};
+
+#endif  /* JSONFX_VALUE_PACKED_POINTER */
+
+}  // namespace internal
+
+//
+// The value is 16 bytes and aligned to 8 bytes:
+//
+//   offset 0:   the payload (8 bytes), the number, or the size and the hash
+//               code of string, or the size and capacity of array, ...
+//   offset 8:   the pointer of string, elements or members (48 bits, the
+//               user space addresses of x86-64 are 48 bits, the pointer is
+//               sign extended when it's read).
+//   offset 14:  the type flags (16 bits).
+//
+// If JSONFX_VALUE_PACKED_POINTER is 0, the pointer is 8 bytes, the flags
+// are at offset 16, and the value is 24 bytes.
+//
+// The short string (kShortStringFlags) is stored inline in the bytes before
+// the flags, its last char is (kMaxShortStringLength - length), so it's also
+// the '\0' terminator when the string is full.
+//
 template <typename EncodingT /* = JSONFX_DEFAULT_ENCODING */,
           typename PoolAllocatorT /* = DefaultPoolAllocator */>
 class BasicValue {
@@ -161,6 +243,18 @@ public:
     typedef uint32_t                        SizeType;
     typedef uint32_t                        ValueType;
 
+    //
+    // The objects which have this count of members or more have a hash index
+    // of the members (an open addressing table of the member indexes), it's
+    // allocated after the members and built at the first lookup, then the
+    // obj.hashCode is the size of the table.
+    //
+    static const SizeType kMemberIndexThreshold = 32;
+
+    // The bytes of the short string in the value, and the max length of it.
+    static const size_t   kShortStringBytes = 8 + sizeof(internal::PackedPointer);
+    static const SizeType kMaxShortStringLength = kShortStringBytes / sizeof(CharType) - 1;
+
 public:
     union Number {
         char        c;
@@ -177,61 +271,85 @@ public:
     };
 
     struct String {
-        SizeType         size;
-        SizeType         capacity;
-        unsigned int     hashCode;
-        const CharType * data;
-    };
-
-    struct SmallString {
-        SizeType         size;
-        SizeType         capacity;
-        unsigned int     hashCode;
-        const CharType * data;
-
-        SizeType GetLength() const { return size; }
-    };
-
-    struct Element {
-        void * data;
+        SizeType        size;
+        uint32_t        hashCode;
     };
 
     struct Array {
         SizeType        size;
         SizeType        capacity;
-        unsigned int    hashCode;
-        BasicValue *    elements;
     };
 
     struct Object {
         SizeType        size;
-        SizeType        capacity;
-        unsigned int    hashCode;
-        MemberType *    members;
+        uint32_t        hashCode;
     };
 
     union ValueData {
         String      str;
-        SmallString sso;
         Number      num;
         Array       array;
         Object      obj;
     };
 
 private:
-    ValueType   mValueType;
     ValueData   mValueData;
+    internal::PackedPointer mPointer;
+    uint16_t    mValueType;
 
 public:
-    BasicValue() : mValueType(kNullFlags), mValueData() {}
+    BasicValue() : mValueData(), mPointer(), mValueType(kNullFlags) {}
+
+    BasicValue(const CharType * str) : mValueData(), mPointer(), mValueType() {
+        setStringRaw(str, static_cast<SizeType>(internal::StrLen(str)));
+    }
+
+    explicit BasicValue(StringRefType str) : mValueData(), mPointer(), mValueType() {
+        setStringRaw(str);
+    }
+
+    //! Constructor with a value type, like kObjectType, kArrayType.
+    explicit BasicValue(JsonFx::ValueType type) : mValueData(), mPointer(), mValueType() {
+        static const ValueType kDefaultFlags[kMaxValueType] = {
+            kObjectFlags, kConstStringFlags, kIntFlags, kTrueFlags, kFalseFlags, kArrayFlags, kNullFlags
+        };
+        jimi_assert(type < kMaxValueType);
+        mValueType = static_cast<uint16_t>(kDefaultFlags[type]);
+    }
+
+    explicit BasicValue(bool b) : mValueData(), mPointer(),
+                                  mValueType(b ? kTrueFlags : kFalseFlags) {}
+
+    explicit BasicValue(int i) : mValueData(), mPointer(), mValueType(kIntFlags) {
+        mValueData.num.i64 = i;
+    }
+
+    explicit BasicValue(unsigned int u) : mValueData(), mPointer(), mValueType(kUIntFlags) {
+        mValueData.num.u64 = u;
+    }
+
+    explicit BasicValue(int64_t i64) : mValueData(), mPointer(), mValueType(kInt64Flags) {
+        mValueData.num.i64 = i64;
+    }
 
-    BasicValue(const CharType * str) {
-        mValueType = kStringFlags;
-        mValueData.str.data = str;
-        mValueData.str.size = ::strlen(str);
+    explicit BasicValue(uint64_t u64) : mValueData(), mPointer(), mValueType(kUInt64Flags) {
+        mValueData.num.u64 = u64;
     }
 
-    explicit BasicValue(StringRefType str) : mValueData(), mValueType() { setStringRaw(str); }
+    explicit BasicValue(double d) : mValueData(), mPointer(), mValueType(kDoubleFlags) {
+        mValueData.num.d = d;
+    }
+
+    //! Constructor for constant string, the string is only referenced (not copied).
+    BasicValue(const CharType * str, SizeType length) : mValueData(), mPointer(), mValueType() {
+        setStringRaw(str, length);
+    }
+
+    //! Constructor for copy string, the string is copied to the pool allocator or inline.
+    BasicValue(const CharType * str, SizeType length, PoolAllocatorType * allocator)
+        : mValueData(), mPointer(), mValueType() {
+        setStringRaw(str, length, allocator);
+    }
 
     ~BasicValue() { release(); }
 
@@ -239,6 +357,24 @@ private:
     //! Copy constructor is not permitted.
     BasicValue(const BasicValue & rhs);
 
+    void * getPointer() const           { return mPointer.get(); }
+    void   setPointer(const void * ptr) { mPointer.set(ptr); }
+
+    BasicValue * getElements() const    { return static_cast<BasicValue *>(getPointer()); }
+    MemberType * getMembers() const     { return static_cast<MemberType *>(getPointer()); }
+
+    CharType * getShortString() {
+        return reinterpret_cast<CharType *>(this);
+    }
+    const CharType * getShortString() const {
+        return reinterpret_cast<const CharType *>(this);
+    }
+
+    // The hash code saved in the value, 0 if it's not saved.
+    uint32_t getSavedStringHash() const {
+        return ((mValueType & kInlineStringMask) ? 0 : mValueData.str.hashCode);
+    }
+
 public:
     void visit();
 
@@ -248,25 +384,27 @@ public:
         if (PoolAllocatorType::kNeedFree) {
             switch (mValueType) {
             case kArrayFlags:
-                for (BasicValue * v = mValueData.array.elements; v != mValueData.array.elements + mValueData.array.size; ++v) {
+                for (BasicValue * v = getElements(); v != getElements() + mValueData.array.size; ++v) {
                     v->~BasicValue();
                 }
-                PoolAllocatorType::deallocate(mValueData.array.elements);
+                PoolAllocatorType::deallocate(getElements());
                 break;
 
             case kObjectFlags:
                 for (MemberIterator m = getMemberBegin(); m != getMemberEnd(); ++m) {
                     m->~MemberType();
                 }
-                PoolAllocatorType::deallocate(mValueData.obj.members);
+                PoolAllocatorType::deallocate(getMembers());
                 break;
 
             case kCopyStringFlags:
-                PoolAllocatorType::deallocate(const_cast<CharType *>(mValueData.str.data));
+                PoolAllocatorType::deallocate(getPointer());
                 break;
 
+            case kShortStringFlags:
+                break;  // The chars are in the value.
+
             default:
-                printf("JsonFx::BasicValue::release() -- switch(mValueType) branch = default, mValueType = 0x%08X\n", mValueType);
                 break;  // Do nothing for other types.
             }
         }
@@ -274,16 +412,161 @@ public:
     }
 
     void setStringRaw(StringRefType str) {
-        mValueType = kConstStringMask;
-        mValueData.str.data = str.mData;
-        mValueData.str.size = str.mSize;
+        setStringRaw(str.mData, static_cast<SizeType>(str.mSize));
+    }
+
+    void setStringRaw(const CharType * str, SizeType length) {
+        mValueType = kConstStringFlags;
+        mValueData.str.size     = length;
+        mValueData.str.hashCode = 0;
+        setPointer(str);
+    }
+
+    void setStringRaw(const CharType * str, SizeType length, PoolAllocatorType * allocator) {
+        if (length <= kMaxShortStringLength) {
+            // The short string is stored in the value, it needn't the allocator.
+            CharType * chars = getShortString();
+            ::memcpy(chars, str, length * sizeof(CharType));
+            chars[length] = '\0';
+            chars[kMaxShortStringLength] = static_cast<CharType>(kMaxShortStringLength - length);
+            mValueType = kShortStringFlags;
+            return;
+        }
+
+        jimi_assert(allocator != NULL);
+        CharType * newStr = static_cast<CharType *>(
+            allocateRaw(allocator, (length + 1) * sizeof(CharType)));
+        ::memcpy(newStr, str, length * sizeof(CharType));
+        newStr[length] = '\0';
+
+        mValueType = kCopyStringFlags;
+        mValueData.str.size     = length;
+        mValueData.str.hashCode = 0;
+        setPointer(newStr);
     }
 
+    // Save the hash code of string, it must be internal::HashString() of the chars.
+    void setStringHashRaw(uint32_t hash) {
+        jimi_assert(isString());
+        // The short string has no room for it, it's hashed when it's needed.
+        if (!(mValueType & kInlineStringMask))
+            mValueData.str.hashCode = hash;
+    }
+
+    //
+    // Set the array with the elements, they are copied to the pool allocator
+    // by raw memory, so the source elements can not be destructed again.
+    //
+    void setArrayRaw(BasicValue * elements, SizeType count, PoolAllocatorType * allocator) {
+        mValueType = kArrayFlags;
+        if (count > 0) {
+            jimi_assert(allocator != NULL);
+            BasicValue * newElements = static_cast<BasicValue *>(
+                allocateRaw(allocator, count * sizeof(BasicValue)));
+            internal::CopyRaw(newElements, elements, count);
+            setPointer(newElements);
+        }
+        else {
+            setPointer(NULL);
+        }
+        mValueData.array.size     = count;
+        mValueData.array.capacity = count;
+    }
+
+    //
+    // Set the object with the members, they are copied to the pool allocator
+    // by raw memory, so the source members can not be destructed again.
+    //
+    void setObjectRaw(MemberType * members, SizeType count, PoolAllocatorType * allocator) {
+        mValueType = kObjectFlags;
+        if (count > 0) {
+            jimi_assert(allocator != NULL);
+            // Reserve the space of member index for the large object.
+            size_t indexSize = (count >= kMemberIndexThreshold) ? getMemberIndexSize(count) : 0;
+            MemberType * newMembers = static_cast<MemberType *>(
+                allocateRaw(allocator, count * sizeof(MemberType) + indexSize * sizeof(uint32_t)));
+            internal::CopyRaw(newMembers, members, count);
+            setPointer(newMembers);
+        }
+        else {
+            setPointer(NULL);
+        }
+        mValueData.obj.size     = count;
+        mValueData.obj.hashCode = 0;
+    }
+
+    //
+    // Move the raw value from rhs to this, and set the rhs to null,
+    // the original value of this is not released.
+    //
+    void moveRaw(BasicValue & rhs) {
+        internal::CopyRaw(this, &rhs, 1);
+        rhs.mValueType = kNullFlags;
+    }
+
+private:
+    static void * allocateRaw(PoolAllocatorType * allocator, size_t size) {
+        // The large block is allocated alone, don't waste the remain space of chunk.
+        if (size <= PoolAllocatorType::kChunkCapacity / 2)
+            return allocator->allocate(size);
+        else
+            return allocator->allocateLarge(size);
+    }
+
+    // The size of member index is a power of 2, and at least 2 times of the count.
+    static SizeType getMemberIndexSize(SizeType count) {
+        SizeType size = kMemberIndexThreshold * 2;
+        while (size < count * 2) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    uint32_t * getMemberIndex() {
+        return reinterpret_cast<uint32_t *>(getMembers() + mValueData.obj.size);
+    }
+
+    // Each slot is the index of member plus 1, 0 is an empty slot.
+    void buildMemberIndex() {
+        SizeType indexSize = getMemberIndexSize(mValueData.obj.size);
+        uint32_t mask = indexSize - 1;
+        uint32_t * index = getMemberIndex();
+        MemberType * members = getMembers();
+        ::memset(index, 0, indexSize * sizeof(uint32_t));
+        for (SizeType i = 0; i < mValueData.obj.size; ++i) {
+            BasicValue & name = members[i].name;
+            uint32_t hash = name.getStringHash();
+            name.setStringHashRaw(hash);
+            uint32_t slot = hash & mask;
+            while (index[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            index[slot] = i + 1;
+        }
+        mValueData.obj.hashCode = indexSize;
+    }
+
+    template <typename SourceAllocatorT>
+    MemberIterator findIndexedMember(const BasicValue<EncodingT, SourceAllocatorT> & name, uint32_t hash) {
+        if (mValueData.obj.hashCode == 0)
+            buildMemberIndex();
+        uint32_t mask = mValueData.obj.hashCode - 1;
+        const uint32_t * index = getMemberIndex();
+        for (uint32_t slot = hash & mask; index[slot] != 0; slot = (slot + 1) & mask) {
+            MemberType * member = getMembers() + (index[slot] - 1);
+            uint32_t memberHash = member->name.getSavedStringHash();
+            if ((memberHash == 0 || memberHash == hash) && name.stringEqual(member->name))
+                return MemberIterator(member);
+        }
+        return getMemberEnd();
+    }
+
+public:
     void setObject() {
         mValueType = kObjectMask;
-        mValueData.obj.members = NULL;
+        setPointer(NULL);
         mValueData.obj.size = 0;
-        mValueData.obj.capacity = 0;
+        mValueData.obj.hashCode = 0;
     }
 
     ValueType getType()  const { return static_cast<ValueType>(mValueType & kTypeMask); }
@@ -316,15 +599,29 @@ public:
         return const_cast<BasicValue &>(*this).findMember(name);
     }
 
+    //
+    // The large object is looked up by the member index, the others are
+    // scanned, and the names which have a different hash code are skipped
+    // without comparing the chars. Notice: the first lookup of a large object
+    // builds the member index, so it can't be done by several threads at once.
+    //
     template <typename SourceAllocatorT>
     MemberIterator findMember(const BasicValue<EncodingT, SourceAllocatorT> & name) {
         jimi_assert(isObject());
         jimi_assert(name.isString());
+        uint32_t hash = name.getStringHash();
+        if (mValueData.obj.size >= kMemberIndexThreshold)
+            return findIndexedMember(name, hash);
+
         MemberIterator member = getMemberBegin();
-        for ( ; member != getMemberEnd(); ++member)
+        for ( ; member != getMemberEnd(); ++member) {
+            uint32_t memberHash = member->name.getSavedStringHash();
+            if (memberHash != 0 && memberHash != hash)
+                continue;
             if (name.stringEqual(member->name)) {
                 break;
             }
+        }
         return member;
     }
 
@@ -335,20 +632,20 @@ public:
 
     MemberIterator getMemberBegin() {
         jimi_assert(isObject());
-        return MemberIterator(mValueData.obj.members);
+        return MemberIterator(getMembers());
     }
     MemberIterator getMemberEnd()   {
         jimi_assert(isObject());
-        return MemberIterator(mValueData.obj.members + mValueData.obj.size);
+        return MemberIterator(getMembers() + mValueData.obj.size);
     }
 
     ConstMemberIterator getMemberBegin() const {
         jimi_assert(isObject());
-        return ConstMemberIterator(mValueData.obj.members);
+        return ConstMemberIterator(getMembers());
     }
     ConstMemberIterator getMemberEnd() const   {
         jimi_assert(isObject());
-        return ConstMemberIterator(mValueData.obj.members + mValueData.obj.size);
+        return ConstMemberIterator(getMembers() + mValueData.obj.size);
     }
 
     bool hasMember(const CharType * name) const {
@@ -370,7 +667,7 @@ public:
             // See above note
             jimi_assert(false);
             static BasicValue nullValue;
-            return NullValue;
+            return nullValue;
         }
     }
 
@@ -393,17 +690,43 @@ public:
 
     const CharType * getString() const {
         jimi_assert(isString());
-        return ((mValueType & kInlineStringMask) ? mValueData.sso.data : mValueData.str.data);
+        return ((mValueType & kInlineStringMask) ? getShortString()
+                                                 : static_cast<const CharType *>(getPointer()));
     }
 
     SizeType getStringLength() const {
         jimi_assert(isString());
-        return ((mValueType & kInlineStringMask) ? (mValueData.sso.GetLength()) : mValueData.str.size);
+        return ((mValueType & kInlineStringMask)
+                ? (kMaxShortStringLength - static_cast<SizeType>(getShortString()[kMaxShortStringLength]))
+                : mValueData.str.size);
     }
-};
 
-// Recover the packing alignment
-#pragma pack(pop)
+    // The hash code of string, it's saved by the reader for the member names.
+    uint32_t getStringHash() const {
+        jimi_assert(isString());
+        uint32_t hash = getSavedStringHash();
+        if (hash != 0)
+            return hash;
+        return internal::HashString(getString(), getStringLength());
+    }
+
+    // The count of members or elements.
+    SizeType getSize() const {
+        jimi_assert(isObject() || isArray());
+        return (isObject() ? mValueData.obj.size : mValueData.array.size);
+    }
+
+    const BasicValue & operator[] (SizeType index) const {
+        jimi_assert(isArray());
+        jimi_assert(index < mValueData.array.size);
+        return getElements()[index];
+    }
+
+    // The integers are saved as 64 bits, the signed ones are sign extended.
+    int64_t  getInt64() const  { jimi_assert(isNumber()); return mValueData.num.i64; }
+    uint64_t getUint64() const { jimi_assert(isNumber()); return mValueData.num.u64; }
+    double   getDouble() const { jimi_assert(isDouble()); return mValueData.num.d;   }
+};
 
 template <typename EncodingT, typename PoolAllocatorT>
 void BasicValue<EncodingT, PoolAllocatorT>::visit()
@@ -0,0 +1,325 @@
+
+#include "UnitTest.h"
+
+#include "JsonFx/Document.h"
+#include "JsonFx/Allocator.h"
+#include "JsonFx/Allocator/ThreadArenaAllocator.h"
+#include "JsonFx/Internal/Thread.h"
+
+#include <string.h>
+
+using namespace JsonFx;
+using namespace JsonFxTest;
+
+// The chunk source which counts the allocations.
+static internal::AtomicCounter sMallocCount(0);
+
+class CountingAllocator : public TrivialAllocator {
+public:
+    static void * aligned_malloc(size_t size, size_t alignment) {
+        sMallocCount.increment();
+        return TrivialAllocator::aligned_malloc(size, alignment);
+    }
+
+    static long getCount() {
+        // The counter only knows the increment and the decrement.
+        sMallocCount.increment();
+        return sMallocCount.decrement();
+    }
+};
+
+typedef FastPoolAllocator<gDefaultChunkCapacity, gDefaultInnerChunkCapacity, CountingAllocator>  CountingPoolAllocator;
+typedef SlabPoolAllocator<gDefaultChunkCapacity, gDefaultInnerChunkCapacity, CountingAllocator>  CountingSlabAllocator;
+
+static std::string MakeItems(int count) {
+    std::string json = "{\"items\": [";
+    for (int i = 0; i < count; ++i) {
+        json += "{\"id\": " + ToString(i) + ", \"name\": \"item-name-" + ToString(i)
+              + "-long-enough-to-copy\", \"tags\": [\"a\\n\", \"b\"]},";
+    }
+    return json + "{}], \"big\": \"" + std::string(200000, 'x') + "\\t\"}";
+}
+
+static std::string ParseToText(const std::string & json) {
+    Document document;
+    document.parse(json.c_str());
+    return DumpValue(document);
+}
+
+JFX_TEST(AllocatorTest_FastPoolRecycle) {
+    std::string json = MakeItems(4000);
+    std::string expected = ParseToText(json);
+
+    CountingPoolAllocator pool;
+    BasicDocument<DefaultEncoding, CountingPoolAllocator> document(&pool);
+    document.parse(json.c_str());
+    JFX_EXPECT_STR_EQ(expected, DumpValue(document));
+
+    // The chunk size is adapted by the first reset(), the next parses don't allocate.
+    document.reset();
+    document.parse(json.c_str());
+    long count = CountingAllocator::getCount();
+    for (int i = 0; i < 20; ++i) {
+        document.reset();
+        document.parse(json.c_str());
+    }
+    JFX_EXPECT(CountingAllocator::getCount() == count);
+    JFX_EXPECT_STR_EQ(expected, DumpValue(document));
+
+    // No chunk is retained without the limit.
+    pool.setRetainLimit(0);
+    JFX_EXPECT(pool.getFreeChunkCount() == 0);
+}
+
+JFX_TEST(AllocatorTest_FastPoolGrowth) {
+    // The chunks grow, so the large strings share the chunks.
+    std::string json = "[";
+    Random random(23);
+    for (int i = 0; i < 2000; ++i)
+        json += ((i != 0) ? ", \"" : "\"") + std::string(1024 + random.next(50 * 1024), 'a' + (i % 26)) + "\"";
+    json += "]";
+
+    CountingPoolAllocator pool;
+    BasicDocument<DefaultEncoding, CountingPoolAllocator> document(&pool);
+    long count = CountingAllocator::getCount();
+    document.parse(json.c_str());
+    JFX_EXPECT(CountingAllocator::getCount() - count < 40);
+    JFX_EXPECT(document.isArray() && document.getSize() == 2000);
+    JFX_EXPECT(pool.getChunkCapacity() > gDefaultChunkCapacity);
+
+    // The size hint raises the start capacity.
+    CountingPoolAllocator hinted;
+    hinted.setSizeHint(1024 * 1024);
+    JFX_EXPECT(hinted.getChunkCapacity() >= 1024 * 1024);
+}
+
+JFX_TEST(AllocatorTest_FastPoolFreeList) {
+    // The released chunks are kept in the free list, up to the retain limit.
+    // The chunk size is adapted by the first reset().
+    CountingPoolAllocator pool;
+    for (int round = 0; round < 2; ++round) {
+        for (int i = 0; i < 20; ++i)
+            JFX_EXPECT(pool.allocate(30000) != NULL);
+        pool.reset();
+    }
+    long count = CountingAllocator::getCount();
+    JFX_EXPECT(pool.getFreeChunkCount() > 0);
+    for (int i = 0; i < 20; ++i)
+        JFX_EXPECT(pool.allocate(30000) != NULL);
+    JFX_EXPECT(CountingAllocator::getCount() == count);
+
+    pool.reset();
+    pool.trim();
+    JFX_EXPECT(pool.getFreeChunkCount() == 0);
+    pool.allocate(30000);
+    JFX_EXPECT(CountingAllocator::getCount() > count);
+
+    pool.reset();
+    pool.setRetainLimit(0);
+    JFX_EXPECT(pool.getFreeChunkCount() == 0);
+}
+
+JFX_TEST(AllocatorTest_FastPoolRetainLimit) {
+    // The DOM of 3 MB is under the retain limit, the chunks don't grow over
+    // the limit, so all of them are kept by reset().
+    std::string json = MakeItems(15000);
+    std::string expected = ParseToText(json);
+
+    CountingPoolAllocator pool;
+    BasicDocument<DefaultEncoding, CountingPoolAllocator> document(&pool);
+    for (int i = 0; i < 3; ++i) {
+        document.reset();
+        document.parse(json.c_str());
+    }
+    JFX_EXPECT(pool.getUsed() > JSONFX_POOL_RETAIN_LIMIT / 2);
+    JFX_EXPECT(pool.getChunkCapacity() <= pool.getRetainLimit());
+    long count = CountingAllocator::getCount();
+    for (int i = 0; i < 10; ++i) {
+        document.reset();
+        document.parse(json.c_str());
+    }
+    JFX_EXPECT(CountingAllocator::getCount() == count);
+    JFX_EXPECT_STR_EQ(expected, DumpValue(document));
+}
+
+JFX_TEST(AllocatorTest_SlabPoolReuse) {
+    std::string json = MakeItems(3000);
+    std::string expected = ParseToText(json);
+
+    CountingSlabAllocator slab;
+    {
+        BasicDocument<DefaultEncoding, CountingSlabAllocator> document(&slab);
+        document.parse(json.c_str());
+        JFX_EXPECT_STR_EQ(expected, DumpValue(document));
+
+        // The old values are freed by the next parse, the pool doesn't grow.
+        size_t used = slab.getUsed();
+        size_t capacity = slab.getCapacity();
+        for (int i = 0; i < 20; ++i)
+            document.parse(json.c_str());
+        JFX_EXPECT(slab.getUsed() == used);
+        JFX_EXPECT(slab.getCapacity() == capacity);
+        JFX_EXPECT_STR_EQ(expected, DumpValue(document));
+
+        // The values of the failed parses are freed too.
+        size_t brokenUsed = 0;
+        for (int i = 1; i < 8; ++i) {
+            document.parse(json.substr(0, json.size() * i / 8).c_str());
+            JFX_EXPECT(document.hasParseError());
+            if (i == 1)
+                brokenUsed = slab.getUsed();
+            JFX_EXPECT(slab.getUsed() == brokenUsed);
+            document.parse(json.c_str());
+            JFX_EXPECT(slab.getUsed() == used);
+        }
+    }
+    // All the blocks are freed with the document.
+    JFX_EXPECT(slab.getUsed() == 0);
+}
+
+JFX_TEST(AllocatorTest_SlabBlocks) {
+    // The freed blocks are reused by the same size class.
+    CountingSlabAllocator slab;
+    void * blocks[100];
+    for (int i = 0; i < 100; ++i)
+        blocks[i] = slab.allocate(24 + i);
+    size_t used = slab.getUsed();
+    JFX_EXPECT(used >= 100 * 24);
+    void * freed = blocks[50];
+    CountingSlabAllocator::deallocate(freed);
+    JFX_EXPECT(slab.getUsed() < used);
+    blocks[50] = slab.allocate(24 + 50);
+    JFX_EXPECT(blocks[50] == freed);
+    JFX_EXPECT(slab.getUsed() == used);
+
+    // The large blocks have their own chunks.
+    void * large = slab.allocate(100000);
+    JFX_EXPECT(large != NULL && slab.getUsed() == used + 100000);
+    ::memset(large, 'x', 100000);
+    CountingSlabAllocator::deallocate(large);
+    for (int i = 0; i < 100; ++i)
+        CountingSlabAllocator::deallocate(blocks[i]);
+    JFX_EXPECT(slab.getUsed() == 0);
+}
+
+JFX_TEST(AllocatorTest_PoolStackReuse) {
+    std::string json = MakeItems(2000);
+    std::string expected = ParseToText(json);
+
+    // The stacks draw from the own pool of the document, the repeated parses
+    // only add the values to the pool, as the documents with the heap stacks.
+    BasicDocument<DefaultEncoding, FastPoolAllocator<>, FastPoolAllocator<> > pooled;
+    Document heap;
+    pooled.parse(json.c_str());
+    heap.parse(json.c_str());
+    size_t pooledUsed = pooled.getPoolAllocator()->getUsed();
+    size_t heapUsed = heap.getPoolAllocator()->getUsed();
+    for (int i = 0; i < 10; ++i) {
+        pooled.parse(json.c_str());
+        heap.parse(json.c_str());
+    }
+    JFX_EXPECT(pooled.getPoolAllocator()->getUsed() - pooledUsed == heap.getPoolAllocator()->getUsed() - heapUsed);
+    JFX_EXPECT_STR_EQ(expected, DumpValue(pooled));
+
+    // The own stack allocator is reset with the stacks, its chunk size is
+    // adapted by the first reset.
+    BasicDocument<DefaultEncoding, SlabPoolAllocator<>, FastPoolAllocator<> > slab;
+    slab.parse(json.c_str());
+    slab.parse(json.c_str());
+    size_t stackCapacity = slab.getStackAllocator()->getCapacity();
+    for (int i = 0; i < 10; ++i)
+        slab.parse(json.c_str());
+    JFX_EXPECT(slab.getStackAllocator()->getCapacity() == stackCapacity);
+    JFX_EXPECT_STR_EQ(expected, DumpValue(slab));
+}
+
+JFX_TEST(AllocatorTest_HugePagePool) {
+    std::string json = MakeItems(40000);
+    std::string expected = ParseToText(json);
+
+    HugePagePoolAllocator pool;
+    BasicDocument<DefaultEncoding, HugePagePoolAllocator> document(&pool);
+    for (int i = 0; i < 3; ++i) {
+        document.reset();
+        document.parse(json.c_str());
+        JFX_EXPECT_STR_EQ(expected, DumpValue(document));
+    }
+
+#if defined(JSONFX_HUGE_PAGE_MMAP)
+    // The header is out of the huge pages, a chunk of 4 MB is mapped on 2 huge pages.
+    size_t size = 2 * HugePageAllocator::kHugePageSize;
+    char * chunk = reinterpret_cast<char *>(HugePageAllocator::aligned_malloc(size, 64));
+    JFX_EXPECT(chunk != NULL);
+    if (chunk != NULL) {
+        JFX_EXPECT((reinterpret_cast<uintptr_t>(chunk) & (HugePageAllocator::kHugePageSize - 1)) == 0);
+        ::memset(chunk, 'x', size);
+        HugePageAllocator::aligned_free(chunk);
+    }
+#endif
+}
+
+JFX_TEST(AllocatorTest_HugePageChunks) {
+    // The small and the large chunks are aligned and writable.
+    static const size_t kSizes[] = {
+        4096, HugePageAllocator::kThreshold - 1, HugePageAllocator::kThreshold, 3 * 1024 * 1024 + 17
+    };
+    for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); ++i) {
+        char * chunk = reinterpret_cast<char *>(HugePageAllocator::aligned_malloc(kSizes[i], 64));
+        JFX_EXPECT(chunk != NULL);
+        if (chunk != NULL) {
+            JFX_EXPECT((reinterpret_cast<uintptr_t>(chunk) & 63) == 0);
+            ::memset(chunk, 'x', kSizes[i]);
+            HugePageAllocator::aligned_free(chunk);
+        }
+    }
+}
+
+typedef BasicThreadArenaAllocator<CountingAllocator>    CountingArenaAllocator;
+typedef FastPoolAllocator<gDefaultChunkCapacity, gDefaultInnerChunkCapacity, CountingArenaAllocator>  CountingArenaPoolAllocator;
+typedef BasicDocument<DefaultEncoding, CountingArenaPoolAllocator>  ArenaDocument;
+
+// Parse a document on the worker thread, it's destroyed by the main thread.
+struct ArenaParser {
+    const std::string * json;
+    ArenaDocument *     document;
+
+    void run() {
+        document = new ArenaDocument();
+        document->parse(json->c_str());
+    }
+};
+
+JFX_TEST(AllocatorTest_ThreadArena) {
+    std::string json = MakeItems(2000);
+    std::string expected = ParseToText(json);
+
+    // The chunks of a document are cached by the arena of the thread.
+    ArenaDocument * document = new ArenaDocument();
+    document->parse(json.c_str());
+    delete document;
+    long count = CountingAllocator::getCount();
+    for (int i = 0; i < 10; ++i) {
+        document = new ArenaDocument();
+        document->parse(json.c_str());
+        JFX_EXPECT_STR_EQ(expected, DumpValue(*document));
+        delete document;
+    }
+    JFX_EXPECT(CountingAllocator::getCount() == count);
+    JFX_EXPECT(CountingArenaAllocator::getThreadCacheBytes() > 0);
+
+    // The chunks are returned to the arena of the worker thread after it exits.
+    for (int i = 0; i < 4; ++i) {
+        ArenaParser parser = { &json, NULL };
+        internal::Thread thread;
+        JFX_EXPECT(thread.start(&parser));
+        thread.join();
+        JFX_EXPECT(parser.document != NULL);
+        if (parser.document != NULL) {
+            JFX_EXPECT_STR_EQ(expected, DumpValue(*parser.document));
+            delete parser.document;
+        }
+    }
+
+    CountingArenaAllocator::trimThreadCache();
+    JFX_EXPECT(CountingArenaAllocator::getThreadCacheBytes() == 0);
+}
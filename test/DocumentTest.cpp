@@ -0,0 +1,422 @@
+
+#include "UnitTest.h"
+
+#include "JsonFx/Document.h"
+#include "JsonFx/ParallelDocument.h"
+#include "JsonFx/LazyDocument.h"
+#include "JsonFx/TapeDocument.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace JsonFx;
+using namespace JsonFxTest;
+
+typedef Document::ValueType     Value;
+
+static std::vector<std::string> MakeDocuments(uint32_t seed, int count) {
+    Random random(seed);
+    std::vector<std::string> documents;
+    for (int i = 0; i < count; ++i)
+        documents.push_back(" " + RandomJson(random) + " ");
+    return documents;
+}
+
+// The DOM of the serial Document is the reference of the other documents.
+static std::string ParseToText(const std::string & json) {
+    Document document;
+    document.parse(json.c_str());
+    if (document.hasParseError())
+        return "error " + ToString(document.getParseResult().getError());
+    return DumpValue(document);
+}
+
+JFX_TEST(DocumentTest_Values) {
+    // The values are built on the stack, and moved to the pool by the containers.
+    Document document;
+    document.parse("{\"a\": [1, -2, 4294967296, 2.5, true, null, \"s\"], \"b\": {\"c\": \"d\", \"e\": []}}");
+    JFX_EXPECT(!document.hasParseError());
+    JFX_EXPECT(document.isObject() && document.getSize() == 2);
+    Value::ConstMemberIterator member = document.getMemberBegin();
+    JFX_EXPECT(::strcmp(member->name.getString(), "a") == 0);
+    const Value & a = member->value;
+    JFX_EXPECT(a.isArray() && a.getSize() == 7);
+    if (a.isArray() && a.getSize() == 7) {
+        JFX_EXPECT(a[0U].isInt() && a[0U].getInt64() == 1);
+        JFX_EXPECT(a[1U].isInt() && a[1U].getInt64() == -2);
+        JFX_EXPECT(a[2U].isInt64() && a[2U].getInt64() == (INT64_C(1) << 32));
+        JFX_EXPECT(a[3U].isDouble() && a[3U].getDouble() == 2.5);
+        JFX_EXPECT(a[4U].isTrue() && a[5U].isNull());
+        JFX_EXPECT(a[6U].isString() && ::strcmp(a[6U].getString(), "s") == 0);
+    }
+    ++member;
+    const Value & b = member->value;
+    JFX_EXPECT(::strcmp(member->name.getString(), "b") == 0);
+    JFX_EXPECT(b.isObject() && b.getSize() == 2);
+    JFX_EXPECT(b.hasMember("c") && b.hasMember("e") && !b.hasMember("a"));
+    if (b.hasMember("c") && b.hasMember("e")) {
+        JFX_EXPECT(b.findMember("c")->value.getStringLength() == 1);
+        JFX_EXPECT(b.findMember("e")->value.isArray() && b.findMember("e")->value.getSize() == 0);
+    }
+
+    document.parse("[1, 2");
+    JFX_EXPECT(document.getParseResult().getError() == kArrayMissCommaOrSquareBracketError);
+}
+
+JFX_TEST(DocumentTest_ParseFlags) {
+    std::vector<std::string> documents = MakeDocuments(11, 2000);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const std::string & json = documents[i];
+        std::string expected = ParseToText(json);
+
+        Document document;
+        document.parse<kStructuralIndexParseFlag>(json.c_str());
+        JFX_EXPECT_STR_EQ(expected, DumpValue(document));
+
+        document.parseStream(json.c_str());
+        JFX_EXPECT(!document.hasParseError());
+        JFX_EXPECT_STR_EQ(expected, DumpValue(document));
+
+        std::vector<char> buffer(json.begin(), json.end());
+        buffer.push_back('\0');
+        document.parseInsitu(&buffer[0]);
+        JFX_EXPECT_STR_EQ(expected, DumpValue(document));
+    }
+}
+
+JFX_TEST(DocumentTest_Insitu) {
+    // The string values point into the text.
+    char text[] = "{\"name\": \"a\\tb\", \"list\": [\"x\", \"\"]}";
+    Document document;
+    document.parseInsitu(text);
+    JFX_EXPECT(!document.hasParseError());
+    JFX_EXPECT(document.hasMember("name") && document.hasMember("list"));
+    if (document.hasMember("name") && document.hasMember("list")) {
+        const Value & name = document.findMember("name")->value;
+        JFX_EXPECT(name.getString() >= text && name.getString() < text + sizeof(text));
+        JFX_EXPECT(::strcmp(name.getString(), "a\tb") == 0 && name.getStringLength() == 3);
+        const Value & list = document.findMember("list")->value;
+        JFX_EXPECT(list.getSize() == 2 && list[1U].getStringLength() == 0);
+    }
+}
+
+JFX_TEST(DocumentTest_Strings) {
+    // Many strings with the escapes, they cross the bottoms of the pool chunks.
+    Random random(13);
+    std::vector<std::string> strings;
+    std::string json = "[";
+    for (int i = 0; i < 20000; ++i) {
+        std::string escaped, unescaped;
+        uint32_t length = random.next(40);
+        for (uint32_t k = 0; k < length; ++k) {
+            if (random.next(4) == 0) {
+                escaped += "\\n";
+                unescaped += '\n';
+            }
+            else {
+                char ch = static_cast<char>('a' + random.next(26));
+                escaped += ch;
+                unescaped += ch;
+            }
+        }
+        json += (i > 0 ? ",\"" : "\"") + escaped + "\"";
+        strings.push_back(unescaped);
+    }
+    json += "]";
+
+    Document document;
+    document.parse(json.c_str());
+    JFX_EXPECT(!document.hasParseError());
+    JFX_EXPECT(document.isArray() && document.getSize() == strings.size());
+    if (document.isArray() && document.getSize() == strings.size()) {
+        for (Value::SizeType i = 0; i < document.getSize(); ++i) {
+            JFX_EXPECT(document[i].getStringLength() == strings[i].size());
+            JFX_EXPECT(document[i].getString() == strings[i]);
+        }
+    }
+}
+
+JFX_TEST(DocumentTest_Reparse) {
+    // The document (and its pool) is reused by the parses.
+    std::vector<std::string> documents = MakeDocuments(12, 500);
+    Document document;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        document.parse(documents[i].c_str());
+        JFX_EXPECT_STR_EQ(ParseToText(documents[i]), DumpValue(document));
+    }
+}
+
+JFX_TEST(DocumentTest_FindMember) {
+    // The large objects are looked up by the member index.
+    std::string json = "{";
+    for (int i = 0; i < 1000; ++i)
+        json += "\"key" + ToString(i) + "\": " + ToString(i) + ", ";
+    json += "\"k\\u0065y\": \"escaped\"}";
+    Document document;
+    document.parse(json.c_str());
+    JFX_EXPECT(document.isObject());
+    JFX_EXPECT(document.getSize() == 1001);
+    for (int i = 0; i < 1000; i += 7) {
+        std::string name = "key" + ToString(i);
+        Value::ConstMemberIterator member = document.findMember(name.c_str());
+        JFX_EXPECT(member != document.getMemberEnd());
+        JFX_EXPECT(member != document.getMemberEnd() && member->value.getInt64() == i);
+    }
+    JFX_EXPECT(document.hasMember("key"));
+    JFX_EXPECT(!document.hasMember("key1000"));
+}
+
+static std::string MakeHugeArray(Random & random, int count, bool scalars) {
+    std::string json = "[";
+    for (int i = 0; i < count; ++i) {
+        if (i != 0)
+            json += (i % 3) ? ",\n  " : ",";
+        json += scalars ? RandomNumber(random) : RandomJson(random, 1);
+    }
+    return json + "]";
+}
+
+JFX_TEST(DocumentTest_ParallelDocument) {
+    Random random(13);
+    std::vector<std::string> documents;
+    documents.push_back(MakeHugeArray(random, 30000, false));
+    documents.push_back(MakeHugeArray(random, 100000, true));
+    documents.push_back(MakeHugeArray(random, 30000, false) + " x");
+    std::string broken = MakeHugeArray(random, 30000, false);
+    broken[broken.size() / 2] = '}';
+    documents.push_back(broken);
+    documents.push_back("{\"a\": [1, 2, 3]}");
+
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const std::string & json = documents[i];
+        Document document;
+        document.parse(json.c_str());
+        for (size_t threads = 1; threads <= 4; ++threads) {
+            ParallelDocument parallel(threads);
+            // The second parse reuses the arenas.
+            for (int k = 0; k < 2; ++k) {
+                parallel.parse(json.c_str(), json.size());
+                JFX_EXPECT(parallel.getParseResult().getError() == document.getParseResult().getError());
+                JFX_EXPECT(parallel.getParseResult().getErrorOffset() == document.getParseResult().getErrorOffset());
+                if (!document.hasParseError())
+                    JFX_EXPECT(DumpValue(parallel) == DumpValue(document));
+            }
+        }
+    }
+}
+
+JFX_TEST(DocumentTest_ParallelValues) {
+    // The elements of the huge array are in order, whichever shard parsed them.
+    std::string json = "[";
+    for (int i = 0; i < 50000; ++i)
+        json += ((i != 0) ? ", " : "") + std::string("{\"i\": ") + ToString(i) + ", \"s\": \"v" + ToString(i % 10) + "\"}";
+    json += "]";
+    for (size_t threads = 1; threads <= 4; ++threads) {
+        ParallelDocument parallel(threads);
+        parallel.parse(json.c_str(), json.size());
+        JFX_EXPECT(!parallel.hasParseError());
+        JFX_EXPECT(parallel.isArray() && parallel.getSize() == 50000);
+        if (parallel.isArray() && parallel.getSize() == 50000) {
+            for (Value::SizeType i = 0; i < parallel.getSize(); i += 97) {
+                const Value & element = parallel[i];
+                JFX_EXPECT(element.findMember("i")->value.getInt64() == static_cast<int64_t>(i));
+                JFX_EXPECT(element.findMember("s")->value.getString() == "v" + ToString(i % 10));
+            }
+        }
+    }
+}
+
+template <typename LazyValueT>
+static void DumpLazyValue(const LazyValueT & value, std::string & out) {
+    if (value.isObject()) {
+        out += "{";
+        for (typename LazyValueT::ConstMemberIterator member = value.getMemberBegin();
+             member != value.getMemberEnd(); ++member) {
+            DumpValue(member->name, out);
+            out += ":";
+            DumpLazyValue(member->value, out);
+            out += ",";
+        }
+        out += "}";
+    }
+    else if (value.isArray()) {
+        out += "[";
+        for (typename LazyValueT::SizeType i = 0; i < value.getSize(); ++i) {
+            DumpLazyValue(value[i], out);
+            out += ",";
+        }
+        out += "]";
+    }
+    else {
+        DumpValue(value.getValue(), out);
+    }
+}
+
+JFX_TEST(DocumentTest_LazyDocument) {
+    std::vector<std::string> documents = MakeDocuments(14, 2000);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        LazyDocument document;
+        document.parse(documents[i].c_str());
+        std::string text;
+        DumpLazyValue(document, text);
+        JFX_EXPECT(!document.hasParseError());
+        JFX_EXPECT_STR_EQ(ParseToText(documents[i]), text);
+    }
+}
+
+JFX_TEST(DocumentTest_LazyValues) {
+    // The values are decoded when they are read.
+    LazyDocument document;
+    document.parse("{\"a\": [1, \"x\\ty\", {\"b\": 2.5}, [], -7], \"c\": true, \"d\": 12345678901, "
+                   "\"e\": 18446744073709551615, \"f\": false}");
+    JFX_EXPECT(!document.hasParseError());
+    JFX_EXPECT(document.isObject() && document.getSize() == 5);
+    JFX_EXPECT(document.hasMember("a") && document.hasMember("c") && !document.hasMember("b"));
+    if (document.hasMember("a") && document.hasMember("c") && document.hasMember("d")
+        && document.hasMember("e") && document.hasMember("f")) {
+        const LazyDocument::LazyValueType & a = document["a"];
+        JFX_EXPECT(a.isArray() && a.getSize() == 5);
+        JFX_EXPECT(a[0U].isInt() && a[0U].getInt64() == 1);
+        JFX_EXPECT(a[1U].isString() && ::strcmp(a[1U].getString(), "x\ty") == 0 && a[1U].getStringLength() == 3);
+        JFX_EXPECT(a[2U].isObject() && a[2U]["b"].getDouble() == 2.5);
+        JFX_EXPECT(a[3U].isArray() && a[3U].getSize() == 0);
+        JFX_EXPECT(a[4U].getInt64() == -7 && a[4U].isInt());
+        JFX_EXPECT(document["c"].isTrue() && document["c"].getBool());
+        JFX_EXPECT(document["d"].isInt64() && document["d"].getInt64() == INT64_C(12345678901));
+        JFX_EXPECT(document["e"].getUint64() == UINT64_C(18446744073709551615) && document["e"].isUint64());
+        JFX_EXPECT(document["f"].isBool() && !document["f"].getBool());
+    }
+}
+
+JFX_TEST(DocumentTest_LazyInvalidScalars) {
+    // The scalars are only parsed when they are accessed, the rest of the token is invalid.
+    static const char * const kDocuments[] = { "[106n9]", "{\"a\":12abc}", "[nullx]", "1.5e3x" };
+    static const size_t kErrorOffsets[] = { 4, 7, 5, 5 };
+    for (size_t i = 0; i < sizeof(kDocuments) / sizeof(kDocuments[0]); ++i) {
+        LazyDocument document;
+        document.parse(kDocuments[i]);
+        JFX_EXPECT(!document.hasParseError());
+        std::string text;
+        DumpLazyValue(document, text);
+        JFX_EXPECT(document.getParseResult().getError() == kValueInvalidError);
+        JFX_EXPECT(document.getParseResult().getErrorOffset() == kErrorOffsets[i]);
+        JFX_EXPECT(text.find("null") != std::string::npos);
+    }
+}
+
+// The tape only knows the signed, unsigned 64 bits integers and the doubles.
+static void DumpPlainNumber(const Value & value, std::string & out) {
+    char buf[40];
+    if (value.getFlags() & kDoubleMask)
+        sprintf(buf, "%.17g", value.getDouble());
+    else if (value.getFlags() & (kUInt32Mask | kUInt64Mask))
+        sprintf(buf, "%llu", static_cast<unsigned long long>(value.getUint64()));
+    else
+        sprintf(buf, "%lld", static_cast<long long>(value.getInt64()));
+    out += buf;
+}
+
+static void DumpPlainValue(const Value & value, std::string & out) {
+    if (value.isObject()) {
+        out += "{";
+        for (Value::ConstMemberIterator member = value.getMemberBegin(); member != value.getMemberEnd(); ++member) {
+            DumpValue(member->name, out);
+            out += ":";
+            DumpPlainValue(member->value, out);
+            out += ",";
+        }
+        out += "}";
+    }
+    else if (value.isArray()) {
+        out += "[";
+        for (Value::SizeType i = 0; i < value.getSize(); ++i) {
+            DumpPlainValue(value[i], out);
+            out += ",";
+        }
+        out += "]";
+    }
+    else if (value.isNull() || value.isTrue() || value.isFalse() || (value.getFlags() & kStringMask) != 0) {
+        DumpValue(value, out);
+    }
+    else {
+        DumpPlainNumber(value, out);
+    }
+}
+
+static void DumpTapeValue(const TapeValue & value, std::string & out) {
+    char buf[40];
+    switch (value.getType()) {
+    case kTapeStartObjectType:
+        out += "{";
+        for (TapeValue name = value.getFirstChild(); name.isValid(); name = name.getNextMember()) {
+            out += "\"" + std::string(name.getString(), name.getStringLength()) + "\":";
+            DumpTapeValue(name.getMemberValue(), out);
+            out += ",";
+        }
+        out += "}";
+        break;
+    case kTapeStartArrayType:
+        out += "[";
+        for (TapeValue element = value.getFirstChild(); element.isValid(); element = element.getNextSibling()) {
+            DumpTapeValue(element, out);
+            out += ",";
+        }
+        out += "]";
+        break;
+    case kTapeStringType:
+        out += "\"" + std::string(value.getString(), value.getStringLength()) + "\"";
+        break;
+    case kTapeInt64Type:
+        sprintf(buf, "%lld", static_cast<long long>(value.getInt64()));
+        out += buf;
+        break;
+    case kTapeUint64Type:
+        sprintf(buf, "%llu", static_cast<unsigned long long>(value.getUint64()));
+        out += buf;
+        break;
+    case kTapeDoubleType:
+        sprintf(buf, "%.17g", value.getDouble());
+        out += buf;
+        break;
+    case kTapeNullType:
+        out += "null";
+        break;
+    case kTapeTrueType:
+        out += "true";
+        break;
+    case kTapeFalseType:
+        out += "false";
+        break;
+    default:
+        out += "?";
+        break;
+    }
+}
+
+JFX_TEST(DocumentTest_TapeDocument) {
+    std::vector<std::string> documents = MakeDocuments(15, 2000);
+    TapeDocument tape;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        Document document;
+        document.parse(documents[i].c_str());
+        tape.parse(documents[i].c_str());
+        JFX_EXPECT(!tape.hasParseError());
+
+        std::string expected, text;
+        DumpPlainValue(document, expected);
+        DumpTapeValue(tape.getRoot(), text);
+        JFX_EXPECT_STR_EQ(expected, text);
+    }
+}
+
+JFX_TEST(DocumentTest_TapeValues) {
+    TapeDocument tape;
+    tape.parse("{\"a\": [1, -2, 2.5, \"s\\n\", null, true, false, 18446744073709551615], \"b\": {}, \"c\": [[]]}");
+    JFX_EXPECT(!tape.hasParseError());
+    std::string text;
+    DumpTapeValue(tape.getRoot(), text);
+    JFX_EXPECT_STR_EQ("{\"a\":[1,-2,2.5,\"s\n\",null,true,false,18446744073709551615,],\"b\":{},\"c\":[[],],}", text);
+
+    tape.parse("[1, 2");
+    JFX_EXPECT(tape.getParseResult().getError() == kArrayMissCommaOrSquareBracketError);
+}
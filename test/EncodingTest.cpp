@@ -0,0 +1,339 @@
+
+#include "UnitTest.h"
+
+#include "JsonFx/Reader.h"
+#include "JsonFx/Internal/StringScanner.h"
+#include "JsonFx/Stream/StringInputStream.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+using namespace JsonFx;
+using namespace JsonFxTest;
+
+typedef TextHandler<char>   Handler;
+
+template <size_t parseFlags>
+static ParseResult ParseText(const std::string & json, Handler & handler) {
+    BasicReader<parseFlags, DefaultEncoding, DefaultEncoding> reader;
+    StringInputStream is(json.c_str());
+    return reader.parse(is, handler);
+}
+
+static const char * const kInvalidUtf8[] = {
+    "\x80", "\xBF", "\xC0\x80", "\xC1\xBF", "\xC3", "\xC3\x28", "\xE0\x80\x80", "\xE0\x9F\xBF",
+    "\xE2\x82", "\xED\xA0\x80", "\xED\xBF\xBF", "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80",
+    "\xF5\x80\x80\x80", "\xF8\x88\x80\x80\x80", "\xFE", "\xFF"
+};
+
+static const char * const kValidUtf8[] = {
+    "\x7F", "\xC2\x80", "\xC3\xA9", "\xDF\xBF", "\xE0\xA0\x80", "\xE2\x82\xAC", "\xED\x9F\xBF",
+    "\xEE\x80\x80", "\xEF\xBF\xBF", "\xF0\x90\x80\x80", "\xF0\x9F\x98\x80", "\xF4\x8F\xBF\xBF"
+};
+
+// The random UTF-8 text, some of the bytes are broken.
+static std::string RandomUtf8(Random & random, uint32_t length, bool broken) {
+    std::string text;
+    while (text.size() < length) {
+        uint32_t kind = random.next(broken ? 6 : 5);
+        uint32_t codepoint;
+        if (kind == 0)
+            codepoint = 0x80 + random.next(0x800 - 0x80);
+        else if (kind == 1)
+            codepoint = 0x800 + random.next(0x10000 - 0x800);
+        else if (kind == 2)
+            codepoint = 0x10000 + random.next(0x110000 - 0x10000);
+        else if (kind == 5) {
+            text += static_cast<char>(0x80 + random.next(0x80));
+            continue;
+        }
+        else {
+            text += static_cast<char>('a' + random.next(26));
+            continue;
+        }
+        if (codepoint >= 0xD800 && codepoint <= 0xDFFF)
+            codepoint = 0xFFFD;
+        if (codepoint < 0x800) {
+            text += static_cast<char>(0xC0 | (codepoint >> 6));
+        }
+        else if (codepoint < 0x10000) {
+            text += static_cast<char>(0xE0 | (codepoint >> 12));
+            text += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        }
+        else {
+            text += static_cast<char>(0xF0 | (codepoint >> 18));
+            text += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+            text += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        }
+        text += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+    return text;
+}
+
+JFX_TEST(EncodingTest_InvalidUtf8) {
+    // Each sequence at each position of the short and the long strings, in
+    // the values and in the keys, the error offset is its position.
+    for (size_t i = 0; i < sizeof(kInvalidUtf8) / sizeof(kInvalidUtf8[0]); ++i) {
+        JFX_EXPECT(!IsValidUtf8(kInvalidUtf8[i]));
+        for (size_t pos = 0; pos < 100; pos += (pos < 70 ? 1 : 29)) {
+            std::string chars = std::string(pos, 'a') + kInvalidUtf8[i] + std::string(pos % 7, 'b');
+            std::string json = "[\"" + chars + "\", {\"" + chars + "\": 1}]";
+            Handler handler, unchecked;
+            ParseResult result = ParseText<kValidateEncodingParseFlag>(json, handler);
+            JFX_EXPECT(result.getError() == kStringInvalidEncodingError);
+            JFX_EXPECT(result.getErrorOffset() == 2 + pos);
+            JFX_EXPECT(!ParseText<kNoneParseFlag>(json, unchecked).hasError());
+
+            json = "{\"" + chars + "\": 1}";
+            Handler keyHandler;
+            JFX_EXPECT(ParseText<kValidateEncodingParseFlag>(json, keyHandler).getError() == kStringInvalidEncodingError);
+        }
+    }
+
+    // The long strings are parsed out of the pool chunk.
+    std::string json = "\"" + std::string(100000, 'a') + "\xC0\xAF" + "\"";
+    Handler handler;
+    JFX_EXPECT(ParseText<kValidateEncodingParseFlag>(json, handler).getError() == kStringInvalidEncodingError);
+}
+
+JFX_TEST(EncodingTest_ValidUtf8) {
+    for (size_t i = 0; i < sizeof(kValidUtf8) / sizeof(kValidUtf8[0]); ++i) {
+        JFX_EXPECT(IsValidUtf8(kValidUtf8[i]));
+        for (size_t pos = 0; pos < 100; pos += (pos < 70 ? 1 : 29)) {
+            std::string chars = std::string(pos, 'a') + kValidUtf8[i] + "\\n" + kValidUtf8[i];
+            std::string json = "[\"" + chars + "\"]";
+            Handler handler;
+            JFX_EXPECT(!ParseText<kValidateEncodingParseFlag>(json, handler).hasError());
+            JFX_EXPECT_STR_EQ("[ s'" + std::string(pos, 'a') + kValidUtf8[i] + "\n" + kValidUtf8[i] + "' ]1 ", handler.text);
+        }
+    }
+}
+
+JFX_TEST(EncodingTest_RandomUtf8) {
+    // The validation of the reader is the same as the reference validator.
+    Random random(14);
+    for (int i = 0; i < 20000; ++i) {
+        uint32_t length = (random.next(50) == 0) ? random.next(100000) : random.next(200);
+        std::string chars = RandomUtf8(random, length, random.next(2) != 0);
+        std::string json = "[\"" + chars + "\"]";
+        Handler handler;
+        ParseResult result = ParseText<kValidateEncodingParseFlag>(json, handler);
+        if (IsValidUtf8(chars)) {
+            JFX_EXPECT(!result.hasError());
+            JFX_EXPECT(handler.text == "[ s'" + chars + "' ]1 ");
+        }
+        else {
+            JFX_EXPECT(result.getError() == kStringInvalidEncodingError);
+        }
+    }
+}
+
+JFX_TEST(EncodingTest_ScanStringValidate) {
+    // The kernels stop at the quote, and check the run before it.
+    std::vector<internal::ScanStringValidateFunc> kernels;
+    kernels.push_back(&internal::ScanStringValidateScalar<char>);
+#if defined(JSONFX_SIMD_X86)
+    if (internal::HasCpuFeatures(internal::kCpuFeatureAVX2Kernels))
+        kernels.push_back(&internal::ScanStringValidateAVX2);
+#endif
+
+    Random random(15);
+    std::vector<char> buffer(512, '\0');
+    char * base = &buffer[0] + (64 - (reinterpret_cast<uintptr_t>(&buffer[0]) & 63)) % 64;
+    for (uint32_t offset = 0; offset < 64; ++offset) {
+        for (int i = 0; i < 300; ++i) {
+            std::string chars = RandomUtf8(random, random.next(200), random.next(2) != 0);
+            ::memcpy(base + offset, chars.c_str(), chars.size());
+            base[offset + chars.size()] = '"';
+            bool expected = IsValidUtf8(chars);
+            for (size_t k = 0; k < kernels.size(); ++k) {
+                bool valid = true;
+                JFX_EXPECT(kernels[k](base + offset, '"', valid) == base + offset + chars.size());
+                JFX_EXPECT(valid == expected);
+            }
+        }
+    }
+}
+
+// Keep the raw bytes of the strings in the target encoding, one string for
+// each key and value.
+template <typename CharT>
+struct BytesHandler : public TextHandler<char> {
+    std::vector<std::string> strings;
+
+    bool saxString(const CharT * str, size_t length, bool copy) {
+        (void)copy;
+        strings.push_back(std::string(reinterpret_cast<const char *>(str), length * sizeof(CharT)));
+        return true;
+    }
+    bool saxKey(const CharT * str, size_t length, bool copy) {
+        return saxString(str, length, copy);
+    }
+};
+
+// The reference encoder of the code points.
+static std::string EncodeUnits(const std::vector<uint32_t> & codepoints, size_t unitSize, bool bigEndian) {
+    std::vector<uint32_t> units;
+    for (size_t i = 0; i < codepoints.size(); ++i) {
+        uint32_t codepoint = codepoints[i];
+        if (unitSize == 1) {
+            if (codepoint < 0x80) {
+                units.push_back(codepoint);
+            }
+            else if (codepoint < 0x800) {
+                units.push_back(0xC0 | (codepoint >> 6));
+                units.push_back(0x80 | (codepoint & 0x3F));
+            }
+            else if (codepoint < 0x10000) {
+                units.push_back(0xE0 | (codepoint >> 12));
+                units.push_back(0x80 | ((codepoint >> 6) & 0x3F));
+                units.push_back(0x80 | (codepoint & 0x3F));
+            }
+            else {
+                units.push_back(0xF0 | (codepoint >> 18));
+                units.push_back(0x80 | ((codepoint >> 12) & 0x3F));
+                units.push_back(0x80 | ((codepoint >> 6) & 0x3F));
+                units.push_back(0x80 | (codepoint & 0x3F));
+            }
+        }
+        else if (unitSize == 2 && codepoint >= 0x10000) {
+            units.push_back(0xD800 + ((codepoint - 0x10000) >> 10));
+            units.push_back(0xDC00 + ((codepoint - 0x10000) & 0x3FF));
+        }
+        else {
+            units.push_back(codepoint);
+        }
+    }
+    std::string bytes;
+    for (size_t i = 0; i < units.size(); ++i) {
+        for (size_t k = 0; k < unitSize; ++k) {
+            size_t shift = (bigEndian ? (unitSize - 1 - k) : k) * 8;
+            bytes += static_cast<char>((units[i] >> shift) & 0xFF);
+        }
+    }
+    return bytes;
+}
+
+// The UTF-8 text and the \u escapes of a code point.
+static std::string EscapeCodepoint(uint32_t codepoint) {
+    char buf[16];
+    if (codepoint < 0x10000) {
+        sprintf(buf, "\\u%04X", codepoint);
+    }
+    else {
+        sprintf(buf, "\\u%04x\\u%04x", 0xD800 + ((codepoint - 0x10000) >> 10), 0xDC00 + ((codepoint - 0x10000) & 0x3FF));
+    }
+    return std::string(buf);
+}
+
+// A random string with the plain chars, the escapes and the \u escapes, and
+// its code points.
+static std::string RandomEscapedString(Random & random, std::vector<uint32_t> & codepoints) {
+    std::string json;
+    uint32_t length = (random.next(20) == 0) ? random.next(3000) : random.next(80);
+    for (uint32_t i = 0; i < length; ++i) {
+        uint32_t codepoint;
+        switch (random.next(8)) {
+        case 0:  codepoint = 0x80 + random.next(0x780); break;
+        case 1:  codepoint = 0x800 + random.next(0xF800); break;
+        case 2:  codepoint = 0x10000 + random.next(0x100000); break;
+        case 3:  codepoint = '\n'; break;
+        default: codepoint = 0x20 + random.next(0x5F); break;
+        }
+        if (codepoint >= 0xD800 && codepoint <= 0xDFFF)
+            codepoint = 0xFFFD;
+        codepoints.push_back(codepoint);
+        if (codepoint == '\n') {
+            json += "\\n";
+        }
+        else if (codepoint == '"' || codepoint == '\\' || random.next(3) == 0) {
+            json += EscapeCodepoint(codepoint);
+        }
+        else {
+            std::vector<uint32_t> one(1, codepoint);
+            json += EncodeUnits(one, 1, false);
+        }
+    }
+    return json;
+}
+
+template <typename TargetEncodingT>
+static void CheckTranscoding(size_t unitSize, bool bigEndian) {
+    typedef typename TargetEncodingT::CharType TargetCharType;
+    // The known strings.
+    static const char * const kStrings[] = {
+        "a", "\\u00e9", "\xc3\xa9", "\\u20AC\xe2\x82\xac", "\\ud83d\\ude00\xf0\x9f\x98\x80", "\\u0000", "\\uFFFF\\n"
+    };
+    static const uint32_t kCodepoints[][4] = {
+        { 1, 'a' }, { 1, 0xE9 }, { 1, 0xE9 }, { 2, 0x20AC, 0x20AC }, { 2, 0x1F600, 0x1F600 }, { 1, 0 }, { 2, 0xFFFF, '\n' }
+    };
+    for (size_t i = 0; i < sizeof(kStrings) / sizeof(kStrings[0]); ++i) {
+        std::string json = std::string("[\"") + kStrings[i] + "\"]";
+        std::vector<uint32_t> codepoints(&kCodepoints[i][1], &kCodepoints[i][1] + kCodepoints[i][0]);
+        BytesHandler<TargetCharType> handler;
+        BasicReader<kNoneParseFlag, DefaultEncoding, TargetEncodingT> reader;
+        StringInputStream is(json.c_str());
+        JFX_EXPECT(!reader.parse(is, handler).hasError());
+        JFX_EXPECT(handler.strings.size() == 1);
+        if (handler.strings.size() == 1)
+            JFX_EXPECT(handler.strings[0] == EncodeUnits(codepoints, unitSize, bigEndian));
+    }
+
+    // The random strings, in the values and in the keys.
+    Random random(16);
+    for (int i = 0; i < 2000; ++i) {
+        std::vector<uint32_t> keyCodepoints, valueCodepoints;
+        std::string key = RandomEscapedString(random, keyCodepoints);
+        std::string value = RandomEscapedString(random, valueCodepoints);
+        std::string json = "{\"" + key + "\": \"" + value + "\"}";
+        BytesHandler<TargetCharType> handler;
+        BasicReader<kNoneParseFlag, DefaultEncoding, TargetEncodingT> reader;
+        StringInputStream is(json.c_str());
+        JFX_EXPECT(!reader.parse(is, handler).hasError());
+        JFX_EXPECT(handler.strings.size() == 2);
+        if (handler.strings.size() == 2) {
+            JFX_EXPECT(handler.strings[0] == EncodeUnits(keyCodepoints, unitSize, bigEndian));
+            JFX_EXPECT(handler.strings[1] == EncodeUnits(valueCodepoints, unitSize, bigEndian));
+        }
+    }
+}
+
+JFX_TEST(EncodingTest_Utf8) {
+    CheckTranscoding<BasicEncoding<char, kUTF8> >(1, false);
+}
+
+JFX_TEST(EncodingTest_Utf16) {
+    CheckTranscoding<BasicEncoding<uint16_t, kUTF16LE> >(2, false);
+    CheckTranscoding<BasicEncoding<uint16_t, kUTF16BE> >(2, true);
+}
+
+JFX_TEST(EncodingTest_Utf32) {
+    CheckTranscoding<BasicEncoding<uint32_t, kUTF32LE> >(4, false);
+    CheckTranscoding<BasicEncoding<uint32_t, kUTF32BE> >(4, true);
+}
+
+JFX_TEST(EncodingTest_Surrogates) {
+    // The broken or lone surrogates are the errors.
+    static const char * const kBrokenStrings[] = {
+        "\"\\ud800\"", "\"\\ud800x\"", "\"\\ud800\\n\"", "\"\\ud800\\u0041\"", "\"\\udc00\"", "\"\\udfff\\ud800\""
+    };
+    for (size_t i = 0; i < sizeof(kBrokenStrings) / sizeof(kBrokenStrings[0]); ++i) {
+        Handler handler;
+        JFX_EXPECT(ParseText<kNoneParseFlag>(kBrokenStrings[i], handler).getError() == kStringUnicodeSurrogateInvalidError);
+    }
+}
+
+JFX_TEST(EncodingTest_InvalidSource) {
+    // The invalid UTF-8 units are transcoded to U+FFFD.
+    std::string json = "[\"a\xff" "b\"]";
+    std::vector<uint32_t> codepoints;
+    codepoints.push_back('a');
+    codepoints.push_back(0xFFFD);
+    codepoints.push_back('b');
+    BytesHandler<uint16_t> handler;
+    BasicReader<kNoneParseFlag, DefaultEncoding, BasicEncoding<uint16_t, kUTF16LE> > reader;
+    StringInputStream is(json.c_str());
+    JFX_EXPECT(!reader.parse(is, handler).hasError());
+    JFX_EXPECT(handler.strings.size() == 1 && handler.strings[0] == EncodeUnits(codepoints, 2, false));
+}
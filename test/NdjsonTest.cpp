@@ -0,0 +1,201 @@
+
+#include "UnitTest.h"
+
+#include "JsonFx/Document.h"
+#include "JsonFx/NdjsonReader.h"
+#include "JsonFx/ParallelNdjsonReader.h"
+
+#include <vector>
+
+using namespace JsonFx;
+using namespace JsonFxTest;
+
+//
+// The records are one line, a few of them are broken, and a few lines are blank.
+// If lineFeeds is true, a few records keep the line feeds, in the whitespaces
+// or in the strings.
+//
+static std::string MakeRecords(Random & random, int count, std::vector<std::string> & records,
+                               bool lineFeeds = false) {
+    std::string text;
+    for (int i = 0; i < count; ++i) {
+        std::string record = "{\"id\": " + ToString(i) + ", \"value\": " + RandomJson(random, 2) + "}";
+        if (lineFeeds && random.next(20) == 0) {
+            record.insert(random.next(static_cast<uint32_t>(record.size())), 1, '\n');
+        }
+        else {
+            for (size_t pos = 0; pos < record.size(); ++pos) {
+                if (record[pos] == '\n')
+                    record[pos] = ' ';
+            }
+        }
+        if (random.next(50) == 0)
+            record.resize(record.size() / 2);
+        records.push_back(record);
+        text += record + ((random.next(10) == 0) ? "\r\n\n" : "\n");
+    }
+    return text;
+}
+
+static std::string ParseToText(const std::string & json) {
+    Document document;
+    document.parse(json.c_str());
+    if (document.hasParseError())
+        return "error";
+    return DumpValue(document);
+}
+
+struct NdjsonCollector {
+    std::vector<std::string> texts;
+
+    bool operator ()(NdjsonReader & reader) {
+        texts.push_back(reader.hasParseError() ? std::string("error") : DumpValue(reader.getDocument()));
+        return true;
+    }
+};
+
+JFX_TEST(NdjsonTest_Records) {
+    Random random(21);
+    std::vector<std::string> records;
+    std::string text = MakeRecords(random, 2000, records);
+
+    NdjsonReader reader(text.c_str());
+    NdjsonCollector collector;
+    size_t count = reader.forEach(collector);
+    JFX_EXPECT(count == records.size());
+    for (size_t i = 0; i < records.size() && i < collector.texts.size(); ++i)
+        JFX_EXPECT_STR_EQ(ParseToText(records[i]), collector.texts[i]);
+}
+
+JFX_TEST(NdjsonTest_LineNumbers) {
+    const char * text = "{\"a\": 1}\n\n[1,\n2]\n  \"x\"  \r\n";
+    NdjsonReader reader(text);
+    JFX_EXPECT(reader.next() && !reader.hasParseError() && reader.getLine() == 1);
+    // The record which runs over its line is invalid, the next line is a record.
+    JFX_EXPECT(reader.next() && reader.hasParseError() && reader.getLine() == 3);
+    JFX_EXPECT(reader.getParseResult().getError() == kValueInvalidError);
+    JFX_EXPECT(reader.getParseResult().getErrorOffset() == 3);
+    JFX_EXPECT(reader.next() && reader.hasParseError() && reader.getLine() == 4);
+    JFX_EXPECT(reader.next() && !reader.hasParseError() && reader.getLine() == 5);
+    JFX_EXPECT(reader.getDocument().isString());
+    JFX_EXPECT(!reader.next());
+}
+
+JFX_TEST(NdjsonTest_LineFeedInString) {
+    // The raw line feeds end the records, the lines in the string are records.
+    const char * text = "\"abc\n1\n2\n\" 7\n{\"b\":2}\n";
+    NdjsonReader reader(text);
+    NdjsonCollector collector;
+    JFX_EXPECT(reader.forEach(collector) == 5);
+    static const char * const kExpected[] = { "error", "n1220:1", "n1220:2", "error", "{\"b\":n1220:2,}" };
+    for (size_t i = 0; i < collector.texts.size() && i < 5; ++i)
+        JFX_EXPECT_STR_EQ(kExpected[i], collector.texts[i]);
+}
+
+JFX_TEST(NdjsonTest_BrokenLines) {
+    // The open containers don't make the parser read the following lines,
+    // each broken record is only parsed to its line feed.
+    static const size_t kBrokenLines = 20000;
+    std::string text;
+    for (size_t i = 0; i < kBrokenLines; ++i)
+        text += "{\"a\": [1, \n";
+    text += "{\"b\": 2}\n";
+
+    NdjsonReader reader(text.c_str());
+    size_t broken = 0;
+    while (reader.next() && reader.hasParseError()) {
+        if (reader.getParseResult().getError() == kValueInvalidError
+            && reader.getParseResult().getErrorOffset() == 10 && reader.getLine() == broken + 1)
+            ++broken;
+    }
+    JFX_EXPECT(broken == kBrokenLines);
+    JFX_EXPECT(!reader.hasParseError() && reader.getLine() == kBrokenLines + 1);
+    JFX_EXPECT(reader.getDocument().isObject() && reader.getDocument().hasMember("b"));
+    JFX_EXPECT(!reader.next());
+}
+
+struct ParallelCollector {
+    std::vector<std::string> texts;
+    std::vector<size_t>      offsets;
+
+    bool operator ()(const ParallelNdjsonReader::Record & record) {
+        texts.push_back(record.hasParseError() ? std::string("error") : DumpValue(record.getValue()));
+        offsets.push_back(record.getOffset());
+        return true;
+    }
+};
+
+static void CheckParallelNdjsonReader(const std::string & text) {
+    NdjsonReader reader(text.c_str());
+    NdjsonCollector expected;
+    std::vector<size_t> offsets;
+    while (reader.next()) {
+        expected(reader);
+        offsets.push_back(reader.getRecordOffset());
+    }
+
+    for (size_t threads = 1; threads <= 4; ++threads) {
+        ParallelNdjsonReader parallel(threads);
+        ParallelCollector collector;
+        size_t count = parallel.forEach(text.c_str(), text.size(), collector);
+        JFX_EXPECT(count == expected.texts.size());
+        JFX_EXPECT(collector.texts == expected.texts);
+        JFX_EXPECT(collector.offsets == offsets);
+    }
+}
+
+JFX_TEST(NdjsonTest_ParallelRecords) {
+    // The known records and their offsets, on a thread and on the shards.
+    std::string text = "1\n[2]\n\n{\"a\": 3}\r\n[4,\n\"five\"\n";
+    for (int i = 0; i < 200; ++i)
+        text += "{\"n\": " + ToString(i) + "}\n";
+    for (size_t threads = 1; threads <= 4; ++threads) {
+        ParallelNdjsonReader parallel(threads);
+        ParallelCollector collector;
+        size_t count = parallel.forEach(text.c_str(), text.size(), collector);
+        JFX_EXPECT(count == 205);
+        JFX_EXPECT(collector.texts.size() == 205);
+        if (collector.texts.size() == 205) {
+            JFX_EXPECT_STR_EQ(ParseToText("1"), collector.texts[0]);
+            JFX_EXPECT_STR_EQ(ParseToText("[2]"), collector.texts[1]);
+            JFX_EXPECT_STR_EQ(ParseToText("{\"a\": 3}"), collector.texts[2]);
+            JFX_EXPECT(collector.offsets[0] == 0 && collector.offsets[1] == 2 && collector.offsets[2] == 7);
+            for (int i = 0; i < 200; ++i)
+                JFX_EXPECT_STR_EQ(ParseToText("{\"n\": " + ToString(i) + "}"), collector.texts[5 + i]);
+        }
+    }
+}
+
+JFX_TEST(NdjsonTest_ParallelNdjsonReader) {
+    Random random(22);
+    std::vector<std::string> records;
+    CheckParallelNdjsonReader(MakeRecords(random, 20000, records));
+}
+
+JFX_TEST(NdjsonTest_ParallelLineFeeds) {
+    // The records are the same as the serial ones, wherever the shards are cut.
+    Random random(23);
+    std::vector<std::string> records;
+    CheckParallelNdjsonReader(MakeRecords(random, 20000, records, true));
+}
+
+JFX_TEST(NdjsonTest_ParallelBrokenLines) {
+    // The workers parse the broken records only to their line feeds too,
+    // the text is cut into a few shards.
+    static const int kLines = 30000;
+    std::string text;
+    for (int i = 0; i < kLines; ++i)
+        text += (i % 3 == 0) ? "{\"n\": " + ToString(i) + "}\n" : std::string("{\"a\": [1, \n");
+    for (size_t threads = 1; threads <= 4; ++threads) {
+        ParallelNdjsonReader parallel(threads);
+        ParallelCollector collector;
+        JFX_EXPECT(parallel.forEach(text.c_str(), text.size(), collector) == kLines);
+        JFX_EXPECT(collector.texts.size() == kLines);
+        for (int i = 0; i < kLines && i < static_cast<int>(collector.texts.size()); i += 3) {
+            JFX_EXPECT_STR_EQ(ParseToText("{\"n\": " + ToString(i) + "}"), collector.texts[i]);
+            if (i + 1 < kLines)
+                JFX_EXPECT_STR_EQ("error", collector.texts[i + 1]);
+        }
+    }
+    CheckParallelNdjsonReader(text);
+}
@@ -0,0 +1,195 @@
+
+#include "UnitTest.h"
+
+#include "JsonFx/Reader.h"
+#include "JsonFx/Stream/StringInputStream.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace JsonFx;
+using namespace JsonFxTest;
+
+// Keep the type and the raw bits of the last number.
+struct NumberHandler : public TextHandler<char> {
+    char        type;
+    int64_t     i;
+    uint64_t    u;
+    double      d;
+
+    NumberHandler() : type('\0'), i(0), u(0), d(0.0) {}
+
+    bool saxInt(int value)          { type = 'i'; i = value; return true; }
+    bool saxUint(unsigned value)    { type = 'u'; u = value; return true; }
+    bool saxInt64(int64_t value)    { type = 'I'; i = value; return true; }
+    bool saxUint64(uint64_t value)  { type = 'U'; u = value; return true; }
+    bool saxDouble(double value)    { type = 'd'; d = value; return true; }
+};
+
+static std::string Summary(const ParseResult & result, const NumberHandler & handler) {
+    if (result.hasError())
+        return "error " + ToString(result.getError());
+    return std::string(1, handler.type);
+}
+
+static ParseResult ParseNumber(const std::string & number, NumberHandler & handler) {
+    std::string json = "[" + number + "]";
+    BasicReader<kNoneParseFlag, DefaultEncoding, DefaultEncoding> reader;
+    StringInputStream is(json.c_str());
+    return reader.parse(is, handler);
+}
+
+// The double must be the correctly rounded one, the same bits as strtod().
+// The numbers which overflow are the errors.
+static void ExpectDouble(const std::string & number) {
+    NumberHandler handler;
+    ParseResult result = ParseNumber(number, handler);
+    double expected = ::strtod(number.c_str(), NULL);
+    if (expected - expected != 0.0) {
+        // The infinities are not the JSON numbers.
+        JFX_EXPECT(result.getError() == kNumberTooBigError);
+    }
+    else if (result.hasError() || handler.type != 'd') {
+        ReportFailure(__FILE__, __LINE__, "a double", number, Summary(result, handler));
+    }
+    else if (::memcmp(&handler.d, &expected, sizeof(double)) != 0) {
+        char expectedText[40], actualText[40];
+        sprintf(expectedText, "%a", expected);
+        sprintf(actualText, "%a", handler.d);
+        ReportFailure(__FILE__, __LINE__, number.c_str(), expectedText, actualText);
+    }
+}
+
+// The digits without the leading zero.
+static std::string RandomDigits(Random & random, uint32_t count) {
+    std::string digits(1, static_cast<char>('1' + random.next(9)));
+    for (uint32_t i = 1; i < count; ++i)
+        digits += static_cast<char>('0' + random.next(10));
+    return digits;
+}
+
+JFX_TEST(NumberTest_KnownDoubles) {
+    static const char * const kNumbers[] = {
+        "0.0", "-0.0", "1.5", "0.1", "0.3", "3.14159", "1e23", "8.41e21", "5e-324", "4.9e-324",
+        "2.4703282292062327e-324", "2.4703282292062328e-324", "2.2250738585072011e-308",
+        "2.2250738585072012e-308", "2.2250738585072014e-308", "1.7976931348623157e308",
+        "1.7976931348623158e308", "9007199254740993.0", "9007199254740992.5", "9007199254740993.00000000001",
+        "123456789012345678901234567890e-10", "7.3177701707893310e+15", "1e-400", "-1e-400",
+        "18446744073709551616", "-9223372036854775809", "100000000000000000000000",
+        "0.000000000000000000000000000000000000000000001", "1E+2", "1e-2", "1.0e+0",
+        "179769313486231580793728971405301e276", "4.4501477170144023e-308",
+        "2.225073858507201136057409796709131975934819546351645648e-308"
+    };
+    for (size_t i = 0; i < sizeof(kNumbers) / sizeof(kNumbers[0]); ++i)
+        ExpectDouble(kNumbers[i]);
+}
+
+JFX_TEST(NumberTest_RandomDoubles) {
+    Random random(6);
+    char buf[64];
+    for (int i = 0; i < 200000; ++i) {
+        std::string number;
+        switch (random.next(5)) {
+        case 0: {
+            // The shortest round trip strings of the random doubles.
+            uint64_t bits = (static_cast<uint64_t>(random.next()) << 32) | random.next();
+            double d;
+            ::memcpy(&d, &bits, sizeof(double));
+            if (d != d || d - d != 0.0)
+                continue;
+            sprintf(buf, "%.17g", d);
+            number = buf;
+            if (number.find_first_of(".e") == std::string::npos)
+                number += ".0";
+            break;
+        }
+        case 1:
+            // Up to 19 digits, the fast paths.
+            number = RandomDigits(random, 1 + random.next(19)) + "e" + ToString(static_cast<int>(random.next(60)) - 30);
+            break;
+        case 2:
+            // The long significands, they are truncated.
+            number = "0." + RandomDigits(random, 20 + random.next(60)) + "e" + ToString(static_cast<int>(random.next(640)) - 320);
+            break;
+        case 3: {
+            // Near the halfway of two doubles, the exact comparison decides.
+            double d = static_cast<double>(random.next()) * ::pow(2.0, static_cast<int>(random.next(200)) - 100);
+            sprintf(buf, "%.16e", d);
+            std::string s = buf;
+            size_t e = s.find('e');
+            number = s.substr(0, e) + (random.next(2) ? "5" : "4999999") + std::string(random.next(30), (random.next(2) ? '0' : '9'))
+                     + (random.next(2) ? "1" : "") + s.substr(e);
+            break;
+        }
+        default:
+            number = "-" + RandomDigits(random, 1 + random.next(25)) + "." + RandomDigits(random, 1 + random.next(25));
+            break;
+        }
+        ExpectDouble(number);
+    }
+}
+
+JFX_TEST(NumberTest_Integers) {
+    // The integers are sent by the smallest type, the others are the doubles.
+    static const struct { const char * number; char type; int64_t i; uint64_t u; } kIntegers[] = {
+        { "0",                      'i', 0, 0 },
+        { "-1",                     'i', -1, 0 },
+        { "2147483647",             'i', INT64_C(2147483647), 0 },
+        { "2147483648",             'u', 0, UINT64_C(2147483648) },
+        { "4294967295",             'u', 0, UINT64_C(4294967295) },
+        { "4294967296",             'I', INT64_C(4294967296), 0 },
+        { "9223372036854775807",    'I', INT64_C(9223372036854775807), 0 },
+        { "9223372036854775808",    'U', 0, UINT64_C(9223372036854775808) },
+        { "18446744073709551615",   'U', 0, UINT64_C(18446744073709551615) },
+        { "-2147483648",            'i', -INT64_C(2147483647) - 1, 0 },
+        { "-2147483649",            'I', -INT64_C(2147483649), 0 },
+        { "-9223372036854775808",   'I', -INT64_C(9223372036854775807) - 1, 0 },
+        { "12345678901234",         'I', INT64_C(12345678901234), 0 }
+    };
+    for (size_t i = 0; i < sizeof(kIntegers) / sizeof(kIntegers[0]); ++i) {
+        NumberHandler handler;
+        JFX_EXPECT(!ParseNumber(kIntegers[i].number, handler).hasError());
+        JFX_EXPECT(handler.type == kIntegers[i].type);
+        if (handler.type == 'i' || handler.type == 'I')
+            JFX_EXPECT(handler.i == kIntegers[i].i);
+        else
+            JFX_EXPECT(handler.u == kIntegers[i].u);
+    }
+
+    // The random integers of each width.
+    Random random(7);
+    for (int i = 0; i < 100000; ++i) {
+        uint64_t u = (static_cast<uint64_t>(random.next()) << 32) | random.next();
+        u >>= random.next(64);
+        bool negative = (random.next(2) != 0) && (u <= UINT64_C(9223372036854775808));
+        char buf[32];
+        sprintf(buf, "%s%llu", (negative ? "-" : ""), static_cast<unsigned long long>(u));
+        NumberHandler handler;
+        JFX_EXPECT(!ParseNumber(buf, handler).hasError());
+        if (negative) {
+            int64_t expected = static_cast<int64_t>(UINT64_C(0) - u);
+            JFX_EXPECT((handler.type == 'i' || handler.type == 'I') && handler.i == expected);
+        }
+        else if (handler.type == 'i' || handler.type == 'I') {
+            JFX_EXPECT(static_cast<uint64_t>(handler.i) == u);
+        }
+        else {
+            JFX_EXPECT((handler.type == 'u' || handler.type == 'U') && handler.u == u);
+        }
+    }
+}
+
+JFX_TEST(NumberTest_Errors) {
+    static const char * const kNumbers[] = { "1e309", "-1e400", "1.8e308", "123456789e999" };
+    for (size_t i = 0; i < sizeof(kNumbers) / sizeof(kNumbers[0]); ++i) {
+        NumberHandler handler;
+        JFX_EXPECT(ParseNumber(kNumbers[i], handler).getError() == kNumberTooBigError);
+    }
+    static const char * const kBrokenNumbers[] = { "1.", "1e", "1e+", "-", ".5", "-.5" };
+    for (size_t i = 0; i < sizeof(kBrokenNumbers) / sizeof(kBrokenNumbers[0]); ++i) {
+        NumberHandler handler;
+        JFX_EXPECT(ParseNumber(kBrokenNumbers[i], handler).hasError());
+    }
+}
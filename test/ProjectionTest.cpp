@@ -0,0 +1,250 @@
+
+#include "UnitTest.h"
+
+#include "JsonFx/Document.h"
+#include "JsonFx/Projection.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace JsonFx;
+using namespace JsonFxTest;
+
+typedef Document::ValueType                 Value;
+typedef std::vector<std::string>            Path;
+typedef std::vector<Path>                   PathList;
+
+// The member names in the text, and the names after unescaping.
+static const char * const kEscapedNames[] = { "a", "b", "c", "0", "1", "x\\\"y", "\\u0061" };
+static const char * const kNames[]        = { "a", "b", "c", "0", "1", "x\"y",    "a"      };
+static const size_t kNameCount = sizeof(kNames) / sizeof(kNames[0]);
+
+static std::string RandomDocument(Random & random, int depth) {
+    switch (random.next(depth > 4 ? 4 : 7)) {
+    case 0:
+        return "null";
+    case 1:
+        return ToString(random.next(1000));
+    case 2:
+    case 3:
+        return RandomString(random, false);
+    case 4:
+    case 5: {
+        std::string json = "[";
+        uint32_t count = random.next(5);
+        for (uint32_t i = 0; i < count; ++i)
+            json += ((i != 0) ? "," : "") + RandomDocument(random, depth + 1);
+        return json + "]";
+    }
+    default: {
+        std::string json = "{";
+        uint32_t count = random.next(5);
+        for (uint32_t i = 0; i < count; ++i) {
+            json += ((i != 0) ? ", \"" : "\"") + std::string(kEscapedNames[random.next(kNameCount)]) + "\": ";
+            json += RandomDocument(random, depth + 1);
+        }
+        return json + "}";
+    }
+    }
+}
+
+static bool IsIndex(const std::string & step, uint32_t index) {
+    if (step.empty() || step.size() > 9 || (step.size() > 1 && step[0] == '0'))
+        return false;
+    for (size_t i = 0; i < step.size(); ++i) {
+        if (step[i] < '0' || step[i] > '9')
+            return false;
+    }
+    return (static_cast<uint32_t>(::atoi(step.c_str())) == index);
+}
+
+// The rest paths of a child, the exact steps hide the wildcards.
+static PathList ChildPaths(const PathList & paths, const std::string * name, uint32_t index) {
+    PathList exact, wildcard;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        const std::string & step = paths[i][0];
+        if ((name != NULL) ? (step == *name) : IsIndex(step, index))
+            exact.push_back(Path(paths[i].begin() + 1, paths[i].end()));
+        else if (step == "*")
+            wildcard.push_back(Path(paths[i].begin() + 1, paths[i].end()));
+    }
+    return (exact.empty() ? wildcard : exact);
+}
+
+// The reference projection on the full DOM.
+static bool Project(const Value & value, const PathList & paths, std::string & out) {
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (paths[i].empty()) {
+            DumpValue(value, out);
+            return true;
+        }
+    }
+    if (paths.empty() || !(value.isObject() || value.isArray()))
+        return false;
+
+    if (value.isObject()) {
+        out += "{";
+        for (Value::ConstMemberIterator member = value.getMemberBegin(); member != value.getMemberEnd(); ++member) {
+            std::string name(member->name.getString(), member->name.getStringLength());
+            PathList childPaths = ChildPaths(paths, &name, 0);
+            if (childPaths.empty())
+                continue;
+            std::string child;
+            DumpValue(member->name, child);
+            child += ":";
+            if (Project(member->value, childPaths, child))
+                out += child + ",";
+        }
+        out += "}";
+    }
+    else {
+        out += "[";
+        for (Value::SizeType i = 0; i < value.getSize(); ++i) {
+            PathList childPaths = ChildPaths(paths, NULL, i);
+            if (childPaths.empty())
+                continue;
+            std::string child;
+            if (Project(value[i], childPaths, child))
+                out += child + ",";
+        }
+        out += "]";
+    }
+    return true;
+}
+
+JFX_TEST(ProjectionTest_Paths) {
+    Random random(31);
+    for (int it = 0; it < 5000; ++it) {
+        std::string json = RandomDocument(random, 0);
+        Document full;
+        full.parse(json.c_str());
+        JFX_EXPECT(!full.hasParseError());
+
+        Projection projection;
+        PathList paths;
+        uint32_t pathCount = 1 + random.next(3);
+        for (uint32_t i = 0; i < pathCount; ++i) {
+            Path path;
+            std::string pointer, keyPath;
+            uint32_t depth = 1 + random.next(3);
+            for (uint32_t j = 0; j < depth; ++j) {
+                uint32_t step = random.next(kNameCount);
+                std::string name = (step + 1 == kNameCount) ? "*" : kNames[step];
+                path.push_back(name);
+                pointer += "/" + name;
+                keyPath += ((j != 0) ? "." : "") + name;
+            }
+            paths.push_back(path);
+            if (random.next(2))
+                projection.addPointer(pointer.c_str());
+            else
+                projection.addKeyPath(keyPath.c_str());
+        }
+
+        std::string expected;
+        if (!Project(full, paths, expected))
+            expected = "null";
+
+        Document projected;
+        projected.parse(json.c_str(), projection);
+        JFX_EXPECT(!projected.hasParseError());
+        JFX_EXPECT_STR_EQ(expected, DumpValue(projected));
+    }
+}
+
+JFX_TEST(ProjectionTest_Document) {
+    Projection projection;
+    projection.addPointer("/user/name");
+    projection.addKeyPath("items.*.id");
+
+    Document document;
+    document.parse("{\"user\": {\"name\": \"bob\", \"age\": 3}, \"items\": [{\"id\": 1, \"x\": [1, 2]},"
+                   " {\"y\": 2}, {\"id\": \"3\"}], \"z\": \"zz\"}", projection);
+    JFX_EXPECT(!document.hasParseError());
+    JFX_EXPECT(document.isObject() && document.getSize() == 2);
+    JFX_EXPECT(document.hasMember("user") && document.hasMember("items"));
+    if (document.hasMember("user") && document.hasMember("items")) {
+        const Value & user = document.findMember("user")->value;
+        JFX_EXPECT(::strcmp(user.findMember("name")->value.getString(), "bob") == 0);
+        JFX_EXPECT(!user.hasMember("age"));
+        const Value & items = document.findMember("items")->value;
+        JFX_EXPECT(items.getSize() == 3);
+        JFX_EXPECT(DumpValue(items[2U]) == "{\"id\":\"3\",}");
+    }
+    JFX_EXPECT(!document.hasMember("z"));
+}
+
+static std::string MakeMembers(const char * prefix) {
+    std::string json = "{";
+    for (int i = 0; i < 1000; ++i)
+        json += "\"" + std::string(prefix) + "-long-enough-name-" + ToString(i) + "\": [" + ToString(i) + "], ";
+    return json + "\"sel\\u0065cted\": {\"n\\u0061me\": \"value\"}}";
+}
+
+JFX_TEST(ProjectionTest_SkippedNames) {
+    // The skipped names are only compared, the escaped ones are not stored
+    // in the pool as well as the plain ones.
+    Projection projection;
+    projection.addPointer("/selected");
+    std::string plain = MakeMembers("plain");
+    std::string escaped = MakeMembers("\\u0065scaped");
+
+    Document plainDocument, escapedDocument;
+    plainDocument.parse(plain.c_str(), projection);
+    escapedDocument.parse(escaped.c_str(), projection);
+    JFX_EXPECT(!escapedDocument.hasParseError());
+    JFX_EXPECT_STR_EQ("{\"selected\":{\"name\":\"value\",},}", DumpValue(escapedDocument));
+    JFX_EXPECT_STR_EQ(DumpValue(plainDocument), DumpValue(escapedDocument));
+    JFX_EXPECT(escapedDocument.getPoolAllocator()->getUsed() == plainDocument.getPoolAllocator()->getUsed());
+}
+
+JFX_TEST(ProjectionTest_LongSkippedNames) {
+    // The long escaped names don't fit in the scratch space of the pool, they
+    // are not stored in the pool either, only the selected ones are kept.
+    Projection projection;
+    projection.addPointer("/selected");
+    std::string name(100000, 'x');
+    std::string plain = "{", escaped = "{";
+    for (int i = 0; i < 20; ++i) {
+        plain += "\"" + name + ToString(i) + "\": " + ToString(i) + ", ";
+        escaped += "\"\\u0078\\n" + name + ToString(i) + "\": " + ToString(i) + ", ";
+    }
+    plain += "\"selected\": [\"value\"]}";
+    escaped += "\"sel\\u0065cted\": [\"value\"]}";
+
+    Document plainDocument, escapedDocument;
+    plainDocument.parse(plain.c_str(), projection);
+    escapedDocument.parse(escaped.c_str(), projection);
+    JFX_EXPECT(!escapedDocument.hasParseError());
+    JFX_EXPECT_STR_EQ("{\"selected\":[\"value\",],}", DumpValue(escapedDocument));
+    JFX_EXPECT(escapedDocument.getPoolAllocator()->getUsed() == plainDocument.getPoolAllocator()->getUsed());
+    JFX_EXPECT(escapedDocument.getPoolAllocator()->getUsed() < name.size());
+
+    // The escaped names are still checked.
+    escapedDocument.parse("{\"\\u00x0\": 1, \"selected\": 2}", projection);
+    JFX_EXPECT(escapedDocument.getParseResult().getError() == kStringUnicodeEscapeInvalidHexError);
+    escapedDocument.parse("{\"a\\u0062\": 1, \"selected\"", projection);
+    JFX_EXPECT(escapedDocument.getParseResult().getError() == kObjectMissColonError);
+}
+
+JFX_TEST(ProjectionTest_SlabPoolNames) {
+    // The SlabPool frees the scratch space of the escaped names, the selected
+    // names must be stored in the values, not point to the scratch.
+    Projection projection;
+    projection.addPointer("/abcdefghijklmnopqrstuvwxyz/k");
+    std::string json = "{\"pad\":1,\"a\\u0062cdefghijklmnopqrstuvwxyz\":{\"k\":\""
+                     + std::string(100000, 'A') + "\"},\"q\\u0031\":2}";
+    std::string expected = "{\"abcdefghijklmnopqrstuvwxyz\":{\"k\":\"" + std::string(100000, 'A') + "\",},}";
+
+    BasicDocument<DefaultEncoding, SlabPoolAllocator<> > document;
+    document.parse(json.c_str(), projection);
+    JFX_EXPECT(!document.hasParseError());
+    JFX_EXPECT_STR_EQ(expected, DumpValue(document));
+
+    std::vector<char> buffer(json.begin(), json.end());
+    buffer.push_back('\0');
+    document.parse<kInsituParseFlag>(&buffer[0], projection);
+    JFX_EXPECT(!document.hasParseError());
+    JFX_EXPECT_STR_EQ(expected, DumpValue(document));
+}
@@ -0,0 +1,565 @@
+
+#include "UnitTest.h"
+
+#include "JsonFx/Reader.h"
+#include "JsonFx/PushReader.h"
+#include "JsonFx/PullReader.h"
+#include "JsonFx/Stream/StringInputStream.h"
+#include "JsonFx/Internal/SkipWhiteSpaces.h"
+#include "JsonFx/Internal/StringScanner.h"
+
+#include <string.h>
+#include <vector>
+
+using namespace JsonFx;
+using namespace JsonFxTest;
+
+typedef TextHandler<char>   Handler;
+
+// Some random documents, a third of them are broken.
+static std::vector<std::string> MakeDocuments(uint32_t seed, int count) {
+    Random random(seed);
+    std::vector<std::string> documents;
+    for (int i = 0; i < count; ++i) {
+        std::string json = " " + RandomJson(random) + (random.next(2) ? " " : "");
+        if (random.next(3) == 0) {
+            size_t pos = random.next(static_cast<uint32_t>(json.size()));
+            switch (random.next(4)) {
+            case 0: json.erase(pos, 1); break;
+            case 1: json.insert(pos, 1, "{}[],:\"x0 "[random.next(10)]); break;
+            case 2: json.resize(pos); break;
+            default: json += " 1"; break;
+            }
+        }
+        documents.push_back(json);
+    }
+    return documents;
+}
+
+template <size_t parseFlags>
+static ParseResult ParseText(const std::string & json, Handler & handler) {
+    BasicReader<parseFlags, DefaultEncoding, DefaultEncoding> reader;
+    StringInputStream is(json.c_str());
+    return reader.parse(is, handler);
+}
+
+// The events of a valid document, or the error code of a broken one.
+static std::string Summary(const ParseResult & result, const Handler & handler) {
+    if (result.hasError())
+        return "error " + ToString(result.getError());
+    return handler.text;
+}
+
+JFX_TEST(ReaderTest_ParseFlags) {
+    std::vector<std::string> documents = MakeDocuments(1, 3000);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const std::string & json = documents[i];
+        Handler expected;
+        ParseResult result = ParseText<kNoneParseFlag>(json, expected);
+        std::string summary = Summary(result, expected);
+
+        Handler indexed;
+        JFX_EXPECT_STR_EQ(summary, Summary(ParseText<kStructuralIndexParseFlag>(json, indexed), indexed));
+
+        // The broken texts may split the UTF-8 chars, they must be rejected.
+        Handler validated;
+        ParseResult validatedResult = ParseText<kValidateEncodingParseFlag>(json, validated);
+        if (IsValidUtf8(json))
+            JFX_EXPECT_STR_EQ(summary, Summary(validatedResult, validated));
+        else if (!result.hasError())
+            JFX_EXPECT(validatedResult.getError() == kStringInvalidEncodingError);
+        else
+            JFX_EXPECT(validatedResult.hasError());
+
+        // The strings are unescaped in the copy of the text.
+        std::vector<char> buffer(json.begin(), json.end());
+        buffer.push_back('\0');
+        Handler insitu;
+        BasicReader<kInsituParseFlag, DefaultEncoding, DefaultEncoding> reader;
+        StringInputStream is(&buffer[0]);
+        JFX_EXPECT_STR_EQ(summary, Summary(reader.parse(is, insitu), insitu));
+    }
+}
+
+JFX_TEST(ReaderTest_Events) {
+    // The documents and their events, the integers are sent by the smallest type.
+    static const char * const kDocuments[][2] = {
+        { "{\"a\": [1, -2, 3.5, true, false, null, \"s\"], \"b\": {}}",
+          "{ k'a' [ i1 i-2 d3.5 true false null s's' ]7 k'b' { }0 }2 " },
+        { "[2147483647, 2147483648, 4294967296, 9223372036854775808, -2147483648, -2147483649]",
+          "[ i2147483647 u2147483648 I4294967296 U9223372036854775808 i-2147483648 I-2147483649 ]6 " },
+        { " \"str\\n\\t\\\"\\\\\\/\xc3\xa9\" ", "s'str\n\t\"\\/\xc3\xa9' " },
+        { "[[], [[]], {\"x\": {\"y\": [0]}}]", "[ [ ]0 [ [ ]0 ]1 { k'x' { k'y' [ i0 ]1 }1 }1 ]3 " },
+        { "0.5e1", "d5 " },
+        // The structural chars and the escaped quotes inside the strings.
+        { "[\"a\\\"[{,:\", \"\\\\\", \"]}\\\\\\\"\"]", "[ s'a\"[{,:' s'\\' s']}\\\"' ]3 " }
+    };
+    for (size_t i = 0; i < sizeof(kDocuments) / sizeof(kDocuments[0]); ++i) {
+        Handler handler;
+        ParseResult result = ParseText<kNoneParseFlag>(kDocuments[i][0], handler);
+        JFX_EXPECT(!result.hasError());
+        JFX_EXPECT_STR_EQ(kDocuments[i][1], handler.text);
+
+        Handler indexed;
+        JFX_EXPECT(!ParseText<kStructuralIndexParseFlag>(kDocuments[i][0], indexed).hasError());
+        JFX_EXPECT_STR_EQ(kDocuments[i][1], indexed.text);
+    }
+}
+
+JFX_TEST(ReaderTest_ErrorCodes) {
+    static const char * const kBrokenDocuments[] = {
+        "", "[1] 2", "{\"a\" 1}", "{1: 2}", "{\"a\": 1 \"b\": 2}", "[1 2]", "[\"abc", "[1.]", "[1e+]", "[nul]"
+    };
+    static const ParseErrorCode kErrorCodes[] = {
+        kDocumentEmptyError, kDocumentRootNotSingularError, kObjectMissColonError, kObjectMissNameError,
+        kObjectMissCommaOrCurlyBracketError, kArrayMissCommaOrSquareBracketError, kValueStringMissQuoteError,
+        kNumberMissFractionError, kNumberMissExponentError, kValueInvalidError
+    };
+    for (size_t i = 0; i < sizeof(kBrokenDocuments) / sizeof(kBrokenDocuments[0]); ++i) {
+        Handler handler;
+        ParseResult result = ParseText<kNoneParseFlag>(kBrokenDocuments[i], handler);
+        JFX_EXPECT(result.getError() == kErrorCodes[i]);
+        Handler indexed;
+        JFX_EXPECT(ParseText<kStructuralIndexParseFlag>(kBrokenDocuments[i], indexed).getError() == kErrorCodes[i]);
+    }
+}
+
+JFX_TEST(ReaderTest_ErrorOffsets) {
+    static const char * const kBrokenDocuments[] = {
+        "", "  ", "[1,]", "{\"a\" 1}", "{\"a\":}", "[\"abc", "[1 2]", "[nul]", "{\"a\":1,}", "[1] 2"
+    };
+    for (size_t i = 0; i < sizeof(kBrokenDocuments) / sizeof(kBrokenDocuments[0]); ++i) {
+        Handler handler;
+        ParseResult result = ParseText<kNoneParseFlag>(kBrokenDocuments[i], handler);
+        JFX_EXPECT(result.hasError());
+        JFX_EXPECT(result.getErrorOffset() <= ::strlen(kBrokenDocuments[i]));
+    }
+}
+
+JFX_TEST(ReaderTest_DeepNesting) {
+    // The containers are parsed on the explicit stack, the depth is only
+    // limited by the heap, not by the call stack.
+    static const int kDepth = 200000;
+    std::string json = std::string(kDepth, '[') + std::string(kDepth, ']');
+    std::string expected;
+    for (int i = 0; i < kDepth; ++i)
+        expected += "[ ";
+    expected += "]0 ";
+    for (int i = 1; i < kDepth; ++i)
+        expected += "]1 ";
+    Handler handler;
+    JFX_EXPECT(!ParseText<kNoneParseFlag>(json, handler).hasError());
+    JFX_EXPECT(handler.text == expected);
+
+    json.clear();
+    for (int i = 0; i < kDepth; ++i)
+        json += "{\"a\":";
+    json += "0" + std::string(kDepth, '}');
+    Handler objectHandler;
+    JFX_EXPECT(!ParseText<kNoneParseFlag>(json, objectHandler).hasError());
+
+    // The missing brackets are found at the end.
+    json = std::string(kDepth, '[') + "1";
+    Handler brokenHandler;
+    ParseResult result = ParseText<kNoneParseFlag>(json, brokenHandler);
+    JFX_EXPECT(result.getError() == kArrayMissCommaOrSquareBracketError);
+    JFX_EXPECT(result.getErrorOffset() == json.size());
+}
+
+static std::string RandomWhiteSpaces(Random & random, uint32_t length) {
+    static const char kWhiteSpaces[] = " \t\n\r";
+    std::string spaces;
+    for (uint32_t i = 0; i < length; ++i)
+        spaces += kWhiteSpaces[random.next(4)];
+    return spaces;
+}
+
+JFX_TEST(ReaderTest_SkipWhiteSpaces) {
+    // The runs of any length at any alignment, the kernels stop at the first
+    // char which is not a whitespace, even if its low nibble is the same.
+    static const char kStops[] = { 'x', '\0', '\x0B', '\x0C', ')', '\x8A', '\xA0', '\x19', '-' };
+    std::vector<internal::SkipWhiteSpacesFunc> kernels;
+    kernels.push_back(&internal::SkipWhiteSpacesScalar<char>);
+#if defined(JSONFX_SIMD_X86)
+    if (internal::HasCpuFeatures(internal::kCpuFeatureSSE2))
+        kernels.push_back(&internal::SkipWhiteSpacesSSE2);
+    if (internal::HasCpuFeatures(internal::kCpuFeatureAVX2Kernels))
+        kernels.push_back(&internal::SkipWhiteSpacesAVX2);
+#endif
+
+    // The kernels read the aligned blocks, the buffer is padded.
+    Random random(6);
+    std::vector<char> buffer(512, 'y');
+    char * base = &buffer[0] + (64 - (reinterpret_cast<uintptr_t>(&buffer[0]) & 63)) % 64;
+    for (uint32_t offset = 0; offset < 64; ++offset) {
+        for (uint32_t length = 0; length <= 130; ++length) {
+            std::string spaces = RandomWhiteSpaces(random, length);
+            ::memcpy(base + offset, spaces.c_str(), length);
+            base[offset + length] = kStops[random.next(sizeof(kStops))];
+            for (size_t k = 0; k < kernels.size(); ++k)
+                JFX_EXPECT(kernels[k](base + offset) == base + offset + length);
+        }
+    }
+}
+
+JFX_TEST(ReaderTest_WhiteSpaces) {
+    // The tokens are separated by the runs of random whitespaces.
+    static const char * const kTokens[] = {
+        "{", "\"a\"", ":", "[", "1", ",", "-2", ",", "3.5", ",", "true", "]", ",", "\"b\"", ":", "{", "}", "}"
+    };
+    Random random(7);
+    for (int i = 0; i < 1000; ++i) {
+        std::string json = RandomWhiteSpaces(random, random.next(70));
+        for (size_t k = 0; k < sizeof(kTokens) / sizeof(kTokens[0]); ++k)
+            json += kTokens[k] + RandomWhiteSpaces(random, random.next(70));
+        Handler handler;
+        JFX_EXPECT(!ParseText<kNoneParseFlag>(json, handler).hasError());
+        JFX_EXPECT_STR_EQ("{ k'a' [ i1 i-2 d3.5 true ]4 k'b' { }0 }2 ", handler.text);
+    }
+}
+
+// The plain chars of the strings, the UTF-8 bytes are not the control chars.
+static std::string RandomPlainChars(Random & random, uint32_t length, char quote) {
+    std::string chars;
+    while (chars.size() < length) {
+        char ch = static_cast<char>(0x20 + random.next(0xE0));
+        if (ch != quote && ch != '\\' && ch != '\x7F')
+            chars += ch;
+    }
+    return chars;
+}
+
+JFX_TEST(ReaderTest_ScanString) {
+    // The kernels stop at the quote, the backslash or the control chars.
+    static const char kStops[] = { '"', '\'', '\\', '\0', '\x01', '\n', '\x1F' };
+    std::vector<internal::ScanStringFunc> kernels;
+    kernels.push_back(&internal::ScanStringScalar<char>);
+#if defined(JSONFX_SIMD_X86)
+    if (internal::HasCpuFeatures(internal::kCpuFeatureSSE2))
+        kernels.push_back(&internal::ScanStringSSE2);
+    if (internal::HasCpuFeatures(internal::kCpuFeatureAVX2Kernels))
+        kernels.push_back(&internal::ScanStringAVX2);
+#endif
+
+    Random random(8);
+    std::vector<char> buffer(512, '\0');
+    char * base = &buffer[0] + (64 - (reinterpret_cast<uintptr_t>(&buffer[0]) & 63)) % 64;
+    for (uint32_t offset = 0; offset < 64; ++offset) {
+        for (uint32_t length = 0; length <= 130; ++length) {
+            char quote = (random.next(2) ? '"' : '\'');
+            char stop;
+            do {
+                stop = kStops[random.next(sizeof(kStops))];
+            } while (stop == ((quote == '"') ? '\'' : '"'));
+            std::string chars = RandomPlainChars(random, length, quote);
+            // The other quote is a plain char.
+            if (length > 0)
+                chars[random.next(length)] = ((quote == '"') ? '\'' : '"');
+            ::memcpy(base + offset, chars.c_str(), length);
+            base[offset + length] = stop;
+            for (size_t k = 0; k < kernels.size(); ++k)
+                JFX_EXPECT(kernels[k](base + offset, quote) == base + offset + length);
+        }
+    }
+}
+
+JFX_TEST(ReaderTest_Strings) {
+    // An escape at each position of the short and the long strings.
+    static const char * const kEscapes[][2] = {
+        { "\\\"", "\"" }, { "\\\\", "\\" }, { "\\/", "/" }, { "\\b", "\b" },
+        { "\\f", "\f" }, { "\\n", "\n" }, { "\\r", "\r" }, { "\\t", "\t" }
+    };
+    static const uint32_t kLengths[] = { 0, 1, 15, 16, 17, 31, 32, 33, 100, 5000, 70000, 200000 };
+    Random random(9);
+    for (size_t i = 0; i < sizeof(kLengths) / sizeof(kLengths[0]); ++i) {
+        std::string chars = RandomPlainChars(random, kLengths[i], '"');
+        for (uint32_t k = 0; k < 40; ++k) {
+            size_t pos = (k < 34) ? k : random.next(kLengths[i] + 1);
+            if (pos > chars.size())
+                pos = chars.size();
+            size_t e = random.next(sizeof(kEscapes) / sizeof(kEscapes[0]));
+            std::string json = "[\"" + chars.substr(0, pos) + kEscapes[e][0] + chars.substr(pos) + "\"]";
+            std::string expected = "[ s'" + chars.substr(0, pos) + kEscapes[e][1] + chars.substr(pos) + "' ]1 ";
+            Handler handler;
+            JFX_EXPECT(!ParseText<kNoneParseFlag>(json, handler).hasError());
+            JFX_EXPECT(handler.text == expected);
+        }
+        // The raw control chars are kept as the plain chars.
+        std::string json = "\"" + chars + "\x01\t" + chars + "\"";
+        Handler handler;
+        JFX_EXPECT(!ParseText<kNoneParseFlag>(json, handler).hasError());
+        JFX_EXPECT(handler.text == "s'" + chars + "\x01\t" + chars + "' ");
+    }
+}
+
+JFX_TEST(ReaderTest_Insitu) {
+    // The strings are unescaped in place, and terminated over the closing quote.
+    static const char * const kDocuments[][2] = {
+        { "[\"abc\", \"\"]", "[\"abc\0, \"\0]" },
+        { "{\"k\\\"ey\": \"a\\nb\\\\c\"}", "{\"k\"ey\0\": \"a\nb\\c\0c\"}" },
+        { "\"\\t\\/\\b\\f\\r\"", "\"\t/\b\f\r\0\\f\\r\"" }
+    };
+    for (size_t i = 0; i < sizeof(kDocuments) / sizeof(kDocuments[0]); ++i) {
+        std::string json = kDocuments[i][0];
+        std::vector<char> buffer(json.begin(), json.end());
+        buffer.push_back('\0');
+        Handler insitu, expected;
+        BasicReader<kInsituParseFlag, DefaultEncoding, DefaultEncoding> reader;
+        StringInputStream is(&buffer[0]);
+        JFX_EXPECT(!reader.parse(is, insitu).hasError());
+        JFX_EXPECT(!ParseText<kNoneParseFlag>(json, expected).hasError());
+        JFX_EXPECT_STR_EQ(expected.text, insitu.text);
+        JFX_EXPECT(std::string(&buffer[0], json.size()) == std::string(kDocuments[i][1], json.size()));
+    }
+
+    // The long strings with an escape at each position.
+    Random random(10);
+    std::string chars = RandomPlainChars(random, 100000, '"');
+    for (size_t pos = 0; pos < chars.size(); pos += 997) {
+        std::string json = "[\"" + chars.substr(0, pos) + "\\n" + chars.substr(pos) + "\"]";
+        std::vector<char> buffer(json.begin(), json.end());
+        buffer.push_back('\0');
+        Handler insitu;
+        BasicReader<kInsituParseFlag, DefaultEncoding, DefaultEncoding> reader;
+        StringInputStream is(&buffer[0]);
+        JFX_EXPECT(!reader.parse(is, insitu).hasError());
+        JFX_EXPECT(insitu.text == "[ s'" + chars.substr(0, pos) + "\n" + chars.substr(pos) + "' ]1 ");
+    }
+}
+
+JFX_TEST(ReaderTest_StructuralIndex) {
+    // The runs of backslashes and the escaped quotes across the 64 bytes blocks.
+    for (size_t pad = 0; pad < 140; ++pad) {
+        for (size_t count = 0; count < 6; ++count) {
+            std::string chars = std::string(pad, 'a') + std::string(count, '\\');
+            std::string escaped = std::string(pad, 'a') + std::string(count * 2, '\\');
+            std::string json = "[\"" + escaped + "\\\"]\", \"" + escaped + "\", {\"k\": [" + std::string(pad, ' ') + "1]}]";
+            Handler handler;
+            JFX_EXPECT(!ParseText<kStructuralIndexParseFlag>(json, handler).hasError());
+            JFX_EXPECT_STR_EQ("[ s'" + chars + "\"]' s'" + chars + "' { k'k' [ i1 ]1 }1 ]3 ", handler.text);
+        }
+    }
+}
+
+JFX_TEST(ReaderTest_PushReader) {
+    Random random(2);
+    std::vector<std::string> documents = MakeDocuments(2, 3000);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const std::string & json = documents[i];
+        Handler expected;
+        ParseResult result = ParseText<kNoneParseFlag>(json, expected);
+
+        // Feed the text by the chunks of 1 byte, a few bytes or a few hundreds of bytes.
+        Handler handler;
+        BasicPushReader<Handler> pushReader(handler);
+        uint32_t mode = random.next(3);
+        for (size_t pos = 0; pos < json.size(); ) {
+            size_t length = (mode == 0) ? 1 : ((mode == 1) ? 1 + random.next(7) : 1 + random.next(200));
+            if (length > json.size() - pos)
+                length = json.size() - pos;
+            std::vector<char> chunk(json.begin() + pos, json.begin() + pos + length);
+            pushReader.feed(&chunk[0], length);
+            pos += length;
+        }
+        ParseResult pushResult = pushReader.finish();
+
+        JFX_EXPECT(pushResult.getError() == result.getError());
+        JFX_EXPECT(pushResult.getErrorOffset() == result.getErrorOffset());
+        JFX_EXPECT_STR_EQ(expected.text, handler.text);
+    }
+}
+
+JFX_TEST(ReaderTest_PushReaderSplits) {
+    // The text is split at each position, the tokens and the strings are
+    // carried across the chunks.
+    static const char * const kDocuments[][2] = {
+        { "{\"a\": [1, -2, 3.5, true, false, null, \"s\"], \"b\": {}}",
+          "{ k'a' [ i1 i-2 d3.5 true false null s's' ]7 k'b' { }0 }2 " },
+        { "[12345678901, \"str\\n\\u00e9\\ud83d\\ude00\", -0.25e-3, [[]]]",
+          "[ I12345678901 s'str\n\xc3\xa9\xf0\x9f\x98\x80' d-0.00025000000000000001 [ [ ]0 ]1 ]4 " }
+    };
+    for (size_t i = 0; i < sizeof(kDocuments) / sizeof(kDocuments[0]); ++i) {
+        std::string json = kDocuments[i][0];
+        for (size_t pos = 0; pos <= json.size(); ++pos) {
+            Handler handler;
+            BasicPushReader<Handler> pushReader(handler);
+            std::string head = json.substr(0, pos), tail = json.substr(pos);
+            pushReader.feed(head.c_str(), head.size());
+            pushReader.feed(tail.c_str(), tail.size());
+            JFX_EXPECT(!pushReader.finish().hasError());
+            JFX_EXPECT_STR_EQ(kDocuments[i][1], handler.text);
+        }
+    }
+
+    // The document is not finished.
+    Handler handler;
+    BasicPushReader<Handler> pushReader(handler);
+    pushReader.feed("[1, 2", 5);
+    JFX_EXPECT(pushReader.finish().hasError());
+}
+
+static void DumpToken(const PullReader::TokenType & token, std::string & text) {
+    Handler handler;
+    switch (token.getKind()) {
+    case kTokenNull:        handler.saxNull(); break;
+    case kTokenTrue:        handler.saxBool(true); break;
+    case kTokenFalse:       handler.saxBool(false); break;
+    case kTokenInt:         handler.saxInt(token.getInt()); break;
+    case kTokenUint:        handler.saxUint(token.getUint()); break;
+    case kTokenInt64:       handler.saxInt64(token.getInt64()); break;
+    case kTokenUint64:      handler.saxUint64(token.getUint64()); break;
+    case kTokenDouble:      handler.saxDouble(token.getDouble()); break;
+    case kTokenString:      handler.saxString(token.getString(), token.getStringLength(), false); break;
+    case kTokenKey:         handler.saxKey(token.getString(), token.getStringLength(), false); break;
+    case kTokenStartObject: handler.saxStartObject(); break;
+    case kTokenStartArray:  handler.saxStartArray(); break;
+    case kTokenEndObject:   handler.saxEndObject(token.getCount()); break;
+    case kTokenEndArray:    handler.saxEndArray(token.getCount()); break;
+    default:
+        break;
+    }
+    text += handler.text;
+}
+
+JFX_TEST(ReaderTest_PullReader) {
+    std::vector<std::string> documents = MakeDocuments(3, 3000);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const std::string & json = documents[i];
+        Handler expected;
+        ParseResult result = ParseText<kNoneParseFlag>(json, expected);
+
+        StringInputStream is(json.c_str());
+        PullReader pullReader(is);
+        std::string text;
+        TokenKind kind;
+        while ((kind = pullReader.next()) != kTokenNone && kind != kTokenError)
+            DumpToken(pullReader.getToken(), text);
+
+        JFX_EXPECT(pullReader.getParseResult().getError() == result.getError());
+        if (!result.hasError())
+            JFX_EXPECT_STR_EQ(expected.text, text);
+    }
+}
+
+JFX_TEST(ReaderTest_PullReaderTokens) {
+    // The tokens of a known document.
+    const char * json = "{\"a\": [1, {\"x\": null}], \"b\": \"s\", \"c\": 2.5}";
+    StringInputStream is(json);
+    PullReader pullReader(is);
+    JFX_EXPECT(pullReader.next() == kTokenStartObject);
+    JFX_EXPECT(pullReader.next() == kTokenKey);
+    JFX_EXPECT(::strcmp(pullReader.getToken().getString(), "a") == 0);
+    JFX_EXPECT(pullReader.next() == kTokenStartArray);
+    JFX_EXPECT(pullReader.next() == kTokenInt && pullReader.getToken().getInt() == 1);
+    JFX_EXPECT(pullReader.next() == kTokenStartObject);
+    JFX_EXPECT(pullReader.next() == kTokenKey);
+    JFX_EXPECT(pullReader.next() == kTokenNull);
+    JFX_EXPECT(pullReader.next() == kTokenEndObject && pullReader.getToken().getCount() == 1);
+    JFX_EXPECT(pullReader.next() == kTokenEndArray && pullReader.getToken().getCount() == 2);
+    JFX_EXPECT(pullReader.next() == kTokenKey);
+    JFX_EXPECT(pullReader.next() == kTokenString);
+    JFX_EXPECT(pullReader.getToken().getStringLength() == 1 && ::strcmp(pullReader.getToken().getString(), "s") == 0);
+    JFX_EXPECT(pullReader.next() == kTokenKey);
+    JFX_EXPECT(pullReader.next() == kTokenDouble && pullReader.getToken().getDouble() == 2.5);
+    JFX_EXPECT(pullReader.next() == kTokenEndObject && pullReader.getToken().getCount() == 3);
+    JFX_EXPECT(pullReader.next() == kTokenNone);
+    JFX_EXPECT(!pullReader.getParseResult().hasError());
+
+    StringInputStream brokenStream("[1, }");
+    PullReader brokenReader(brokenStream);
+    TokenKind kind;
+    while ((kind = brokenReader.next()) != kTokenNone && kind != kTokenError) {}
+    JFX_EXPECT(kind == kTokenError);
+    JFX_EXPECT(brokenReader.getParseResult().hasError());
+}
+
+JFX_TEST(ReaderTest_SkipValue) {
+    Random random(4);
+    for (int i = 0; i < 3000; ++i) {
+        std::string value = RandomJson(random);
+        std::string json = value + " , 1";
+        Reader reader;
+        StringInputStream is(json.c_str());
+        reader.attachInputStream(&is);
+        const char * end = reader.skipValue(json.c_str());
+        JFX_EXPECT(!reader.hasParseError());
+        JFX_EXPECT(end == json.c_str() + value.size());
+    }
+}
+
+JFX_TEST(ReaderTest_SkipValueEnds) {
+    // The values and the lengths of them, the brackets in the strings are
+    // not counted.
+    static const char * const kValues[] = {
+        "[1, \"]\", {\"a\": \"[\\\"]\"}]", "\"ab\\\\\\\"cd\"", "123.5e3", "true", "{}", "[[[]], {\"]\": [\"}\"]}]"
+    };
+    for (size_t i = 0; i < sizeof(kValues) / sizeof(kValues[0]); ++i) {
+        std::string json = std::string(kValues[i]) + ", x";
+        Reader reader;
+        StringInputStream is(json.c_str());
+        reader.attachInputStream(&is);
+        const char * end = reader.skipValue(json.c_str());
+        JFX_EXPECT(!reader.hasParseError());
+        JFX_EXPECT(end == json.c_str() + ::strlen(kValues[i]));
+    }
+
+    // The runs of backslashes and the brackets in the strings across the 64 bytes blocks.
+    for (size_t pad = 0; pad < 140; ++pad) {
+        for (size_t count = 0; count < 4; ++count) {
+            std::string value = "[\"" + std::string(pad, ']') + std::string(count * 2, '\\') + "\\\"]\", [[" +
+                                std::string(pad, ' ') + "]]]";
+            std::string json = value + "]";
+            Reader reader;
+            StringInputStream is(json.c_str());
+            reader.attachInputStream(&is);
+            JFX_EXPECT(reader.skipValue(json.c_str()) == json.c_str() + value.size());
+        }
+    }
+
+    // The unclosed strings and containers.
+    static const char * const kBrokenValues[] = { "{\"a\": [1, 2]", "[[\"]\"]", "\"abc\\\"" };
+    static const ParseErrorCode kErrorCodes[] = {
+        kObjectMissCommaOrCurlyBracketError, kArrayMissCommaOrSquareBracketError, kValueStringMissQuoteError
+    };
+    for (size_t i = 0; i < sizeof(kBrokenValues) / sizeof(kBrokenValues[0]); ++i) {
+        Reader reader;
+        StringInputStream is(kBrokenValues[i]);
+        reader.attachInputStream(&is);
+        reader.skipValue(kBrokenValues[i]);
+        JFX_EXPECT(reader.getParseResult().getError() == kErrorCodes[i]);
+    }
+
+    // The pull reader skips the values and the rest of the containers.
+    StringInputStream is("[{\"a\": [1, 2]}, 3, [4, [5]], 6]");
+    PullReader pullReader(is);
+    JFX_EXPECT(pullReader.next() == kTokenStartArray);
+    JFX_EXPECT(pullReader.skipValue());
+    JFX_EXPECT(pullReader.next() == kTokenInt && pullReader.getToken().getInt() == 3);
+    JFX_EXPECT(pullReader.next() == kTokenStartArray);
+    JFX_EXPECT(pullReader.next() == kTokenInt && pullReader.getToken().getInt() == 4);
+    JFX_EXPECT(pullReader.skipContainer());
+    JFX_EXPECT(pullReader.next() == kTokenInt && pullReader.getToken().getInt() == 6);
+    JFX_EXPECT(pullReader.next() == kTokenEndArray);
+    JFX_EXPECT(pullReader.next() == kTokenNone);
+}
+
+JFX_TEST(ReaderTest_SkipContainer) {
+    // The SIMD kernels must stop at the same char as the scalar path, even if
+    // the text is broken, such as the backslashes out of the strings.
+    Random random(5);
+    for (int i = 0; i < 3000; ++i) {
+        std::string json = "[" + RandomJson(random) + "]";
+        for (int k = random.next(3); k > 0; --k) {
+            size_t pos = 1 + random.next(static_cast<uint32_t>(json.size() - 1));
+            json.insert(pos, (random.next(2) ? "\\\"" : "\\"));
+        }
+        if (random.next(4) == 0)
+            json.resize(random.next(static_cast<uint32_t>(json.size())));
+
+        size_t expectedDepth = 1, depth = 1;
+        const char * expected = internal::SkipContainerScalar(json.c_str() + 1, expectedDepth, false);
+        const char * end = internal::SkipContainer(json.c_str() + 1, depth, false);
+        JFX_EXPECT(end == expected);
+        JFX_EXPECT(depth == expectedDepth);
+    }
+}
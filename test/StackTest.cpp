@@ -0,0 +1,68 @@
+
+#include "UnitTest.h"
+
+#include "JsonFx/Stack.h"
+#include "JsonFx/Allocator.h"
+
+using namespace JsonFx;
+using namespace JsonFxTest;
+
+struct Frame {
+    uint32_t    count;
+    uint32_t    index;
+    double      value;
+};
+
+template <typename StackT>
+static void PushAndPop(StackT & stack) {
+    // The items are kept by the growing of the buffer.
+    for (uint32_t i = 0; i < 1000; ++i) {
+        Frame * frame = stack.template push<Frame>();
+        frame->count = i;
+        frame->index = i * 2;
+        frame->value = i * 0.5;
+        JFX_EXPECT(stack.template Top<Frame>() == frame);
+    }
+    JFX_EXPECT(stack.getSize() == 1000 * sizeof(Frame));
+    JFX_EXPECT(stack.getCapacity() >= stack.getSize());
+    const Frame * bottom = stack.template Bottom<Frame>();
+    for (uint32_t i = 0; i < 1000; ++i)
+        JFX_EXPECT(bottom[i].count == i && bottom[i].index == i * 2 && bottom[i].value == i * 0.5);
+
+    // The popped items are still readable until the next push.
+    Frame * popped = stack.template pop<Frame>(10);
+    JFX_EXPECT(popped->count == 990 && popped[9].count == 999);
+    JFX_EXPECT(stack.template Top<Frame>()->count == 989);
+
+    // Push a few items at once.
+    Frame * frames = stack.template push<Frame>(100);
+    JFX_EXPECT(frames == popped);
+    JFX_EXPECT(stack.getSize() == 1090 * sizeof(Frame));
+
+    // The buffer is kept by clear().
+    size_t capacity = stack.getCapacity();
+    stack.clear();
+    JFX_EXPECT(stack.empty());
+    stack.template push<Frame>(1000);
+    JFX_EXPECT(stack.getCapacity() == capacity);
+}
+
+JFX_TEST(StackTest_HeapAllocator) {
+    Stack stack(NULL, 16);
+    JFX_EXPECT(stack.empty() && stack.getCapacity() == 0);
+    PushAndPop(stack);
+    stack.reserve(1 << 20);
+    JFX_EXPECT(stack.getCapacity() >= (1 << 20));
+    JFX_EXPECT(stack.template Bottom<Frame>()[999].count == 999);
+}
+
+JFX_TEST(StackTest_PoolAllocator) {
+    // The buffer grows in the pool, the stack is reset with the pool.
+    FastPoolAllocator<> pool;
+    BasicStack<FastPoolAllocator<> > stack(&pool, 16);
+    PushAndPop(stack);
+    pool.reset();
+    stack.reset();
+    JFX_EXPECT(stack.empty() && stack.getCapacity() == 0);
+    PushAndPop(stack);
+}
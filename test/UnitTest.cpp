@@ -0,0 +1,32 @@
+
+#include "UnitTest.h"
+
+#include <string.h>
+
+//
+// Run all the tests, or the tests whose names contain the argument:
+//
+//   JsonFxUnitTest [filter]
+//
+int main(int argc, char * argv[])
+{
+    using namespace JsonFxTest;
+
+    const char * filter = (argc > 1) ? argv[1] : NULL;
+    TestList & list = GetTestList();
+    int count = 0, failed = 0;
+    for (TestCase * test = list.head; test != NULL; test = test->next) {
+        if (filter != NULL && ::strstr(test->name, filter) == NULL)
+            continue;
+        printf("[ RUN  ] %s\n", test->name);
+        int failures = list.failures;
+        test->func();
+        ++count;
+        if (list.failures != failures) {
+            ++failed;
+            printf("[ FAIL ] %s\n", test->name);
+        }
+    }
+    printf("\n%d tests, %d failed.\n", count, failed);
+    return ((failed == 0) ? 0 : 1);
+}
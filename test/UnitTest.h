@@ -0,0 +1,327 @@
+
+#ifndef _JSONFX_TEST_UNITTEST_H_
+#define _JSONFX_TEST_UNITTEST_H_
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+
+#include "JsonFx/Value.h"
+
+//
+// A tiny test harness, the tests are registered by JFX_TEST(name) in each
+// translation unit, and run by main() in UnitTest.cpp:
+//
+//   JFX_TEST(ReaderTest_Something) {
+//       JFX_EXPECT(1 + 1 == 2);
+//       JFX_EXPECT_STR_EQ(expected, actual);
+//   }
+//
+
+namespace JsonFxTest {
+
+typedef void (*TestFunc)();
+
+struct TestCase {
+    const char *    name;
+    TestFunc        func;
+    TestCase *      next;
+};
+
+struct TestList {
+    TestCase *  head;
+    TestCase *  tail;
+    int         failures;
+};
+
+inline TestList & GetTestList() {
+    static TestList list = { NULL, NULL, 0 };
+    return list;
+}
+
+struct TestRegistrar {
+    TestRegistrar(TestCase * test) {
+        TestList & list = GetTestList();
+        if (list.tail != NULL)
+            list.tail->next = test;
+        else
+            list.head = test;
+        list.tail = test;
+    }
+};
+
+inline void ReportFailure(const char * file, int line, const char * expr) {
+    ++GetTestList().failures;
+    printf("  %s(%d): failed: %s\n", file, line, expr);
+}
+
+inline void ReportFailure(const char * file, int line, const char * expr,
+                          const std::string & expected, const std::string & actual) {
+    ReportFailure(file, line, expr);
+    printf("    expected: %.300s\n", expected.c_str());
+    printf("    actual:   %.300s\n", actual.c_str());
+}
+
+// The pseudo random numbers, the sequence is the same on all platforms.
+class Random {
+private:
+    uint32_t mSeed;
+
+public:
+    Random(uint32_t seed) : mSeed(seed) {}
+
+    uint32_t next() {
+        mSeed = mSeed * 1103515245U + 12345U;
+        return (mSeed >> 8);
+    }
+
+    uint32_t next(uint32_t range) { return (next() % range); }
+};
+
+inline std::string ToString(int64_t i) {
+    char buf[32];
+    sprintf(buf, "%lld", static_cast<long long>(i));
+    return std::string(buf);
+}
+
+//
+// The SAX handler which records the events as text, the texts of the
+// different parse paths are compared.
+//
+template <typename CharT = char>
+class TextHandler {
+public:
+    std::string text;
+
+    bool saxNull()              { text += "null "; return true; }
+    bool saxBool(bool b)        { text += (b ? "true " : "false "); return true; }
+    bool saxInt(int i)          { text += "i" + ToString(i) + " "; return true; }
+    bool saxUint(unsigned u)    { text += "u" + ToString(u) + " "; return true; }
+    bool saxInt64(int64_t i)    { text += "I" + ToString(i) + " "; return true; }
+    bool saxUint64(uint64_t u)  {
+        char buf[32];
+        sprintf(buf, "U%llu ", static_cast<unsigned long long>(u));
+        text += buf;
+        return true;
+    }
+    bool saxDouble(double d) {
+        char buf[40];
+        sprintf(buf, "d%.17g ", d);
+        text += buf;
+        return true;
+    }
+    bool saxString(const CharT * str, size_t length, bool copy) {
+        (void)copy;
+        text += "s'" + std::string(str, str + length) + "' ";
+        return true;
+    }
+    bool saxKey(const CharT * str, size_t length, bool copy) {
+        (void)copy;
+        text += "k'" + std::string(str, str + length) + "' ";
+        return true;
+    }
+    bool saxStartObject()               { text += "{ "; return true; }
+    bool saxEndObject(size_t count)     { text += "}" + ToString(count) + " "; return true; }
+    bool saxStartArray()                { text += "[ "; return true; }
+    bool saxEndArray(size_t count)      { text += "]" + ToString(count) + " "; return true; }
+};
+
+// The numbers are dumped with its flags and raw bits, so the same type is required.
+template <typename ValueT>
+void DumpNumber(const ValueT & value, std::string & out) {
+    char buf[48];
+    sprintf(buf, "n%x:%llx", static_cast<unsigned>(value.getFlags()),
+             static_cast<unsigned long long>(value.getUint64()));
+    out += buf;
+}
+
+//
+// Dump the DOM as text, the values (BasicValue) and the documents are
+// compared by the texts. The types are checked by the exact flags, the
+// string mask is shared by the containers.
+//
+template <typename ValueT>
+void DumpValue(const ValueT & value, std::string & out) {
+    if (value.isNull()) {
+        out += "null";
+    }
+    else if (value.isTrue()) {
+        out += "true";
+    }
+    else if (value.isFalse()) {
+        out += "false";
+    }
+    else if (value.isObject()) {
+        out += "{";
+        for (typename ValueT::ConstMemberIterator member = value.getMemberBegin();
+             member != value.getMemberEnd(); ++member) {
+            DumpValue(member->name, out);
+            out += ":";
+            DumpValue(member->value, out);
+            out += ",";
+        }
+        out += "}";
+    }
+    else if (value.isArray()) {
+        out += "[";
+        for (typename ValueT::SizeType i = 0; i < value.getSize(); ++i) {
+            DumpValue(value[i], out);
+            out += ",";
+        }
+        out += "]";
+    }
+    else if ((value.getFlags() & JsonFx::kStringMask) != 0) {
+        out += "\"" + std::string(value.getString(), value.getString() + value.getStringLength()) + "\"";
+    }
+    else {
+        DumpNumber(value, out);
+    }
+}
+
+template <typename ValueT>
+std::string DumpValue(const ValueT & value) {
+    std::string out;
+    DumpValue(value, out);
+    return out;
+}
+
+// The reference UTF-8 validator, it decodes one char at a time.
+inline bool IsValidUtf8(const std::string & text) {
+    size_t i = 0;
+    while (i < text.size()) {
+        unsigned char ch = static_cast<unsigned char>(text[i]);
+        size_t trails;
+        uint32_t codepoint, minCodepoint;
+        if (ch < 0x80) {
+            ++i;
+            continue;
+        }
+        else if ((ch & 0xE0) == 0xC0) {
+            trails = 1; codepoint = ch & 0x1F; minCodepoint = 0x80;
+        }
+        else if ((ch & 0xF0) == 0xE0) {
+            trails = 2; codepoint = ch & 0x0F; minCodepoint = 0x800;
+        }
+        else if ((ch & 0xF8) == 0xF0) {
+            trails = 3; codepoint = ch & 0x07; minCodepoint = 0x10000;
+        }
+        else {
+            return false;
+        }
+        if (text.size() - i <= trails)
+            return false;
+        for (size_t k = 1; k <= trails; ++k) {
+            unsigned char trail = static_cast<unsigned char>(text[i + k]);
+            if ((trail & 0xC0) != 0x80)
+                return false;
+            codepoint = (codepoint << 6) | (trail & 0x3F);
+        }
+        // The overlongs, the surrogates and the code points above U+10FFFF.
+        if (codepoint < minCodepoint || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF))
+            return false;
+        i += trails + 1;
+    }
+    return true;
+}
+
+//
+// Generate a random JSON value, with the escapes, the unicode escapes, the
+// UTF-8 chars, the long strings and all kinds of numbers.
+//
+inline std::string RandomString(Random & random, bool isKey) {
+    std::string str = "\"";
+    size_t length = (!isKey && random.next(40) == 0) ? random.next(20000) : random.next(24);
+    for (size_t i = 0; i < length; ++i) {
+        switch (random.next(40)) {
+        case 0: str += "\\n"; break;
+        case 1: str += "\\\""; break;
+        case 2: str += "\\\\"; break;
+        case 3: str += "\\u00e9"; break;
+        case 4: str += "\\ud83d\\ude00"; break;
+        case 5: str += "\xc3\xa9"; break;
+        case 6: str += "]},{["; break;
+        case 7: str += "\\t\\/"; break;
+        default:
+            str += static_cast<char>('a' + random.next(26));
+            break;
+        }
+    }
+    str += "\"";
+    return str;
+}
+
+inline std::string RandomNumber(Random & random) {
+    char buf[64];
+    switch (random.next(6)) {
+    case 0: sprintf(buf, "%d", static_cast<int>(random.next()) - (1 << 23)); break;
+    case 1: sprintf(buf, "%u", random.next() << 8); break;
+    case 2: sprintf(buf, "-%u%u", random.next(), random.next()); break;
+    case 3: sprintf(buf, "%.17g", static_cast<double>(random.next()) / 7e3); break;
+    case 4: sprintf(buf, "%ue-%u", random.next(1000), random.next(30)); break;
+    default: sprintf(buf, "18446744073709551615"); break;
+    }
+    return std::string(buf);
+}
+
+inline std::string RandomJson(Random & random, int depth = 0) {
+    switch (random.next(depth > 4 ? 5 : 8)) {
+    case 0:
+        return "null";
+    case 1:
+        return (random.next(2) ? "true" : "false");
+    case 2:
+        return RandomNumber(random);
+    case 3:
+    case 4:
+        return RandomString(random, false);
+    case 5:
+    case 6: {
+        std::string json = "[";
+        uint32_t count = random.next(6);
+        for (uint32_t i = 0; i < count; ++i) {
+            if (i != 0)
+                json += (random.next(2) ? "," : " ,\n ");
+            json += RandomJson(random, depth + 1);
+        }
+        return json + "]";
+    }
+    default: {
+        std::string json = "{";
+        uint32_t count = random.next(6);
+        for (uint32_t i = 0; i < count; ++i) {
+            if (i != 0)
+                json += ", ";
+            json += RandomString(random, true) + " : " + RandomJson(random, depth + 1);
+        }
+        return json + "}";
+    }
+    }
+}
+
+}  // namespace JsonFxTest
+
+#define JFX_TEST(name) \
+    static void name(); \
+    static JsonFxTest::TestCase name##_case = { #name, &name, NULL }; \
+    static JsonFxTest::TestRegistrar name##_registrar(&name##_case); \
+    static void name()
+
+#define JFX_EXPECT(cond) \
+    do { \
+        if (!(cond)) \
+            JsonFxTest::ReportFailure(__FILE__, __LINE__, #cond); \
+    } while (0)
+
+#define JFX_EXPECT_STR_EQ(expected, actual) \
+    do { \
+        const std::string & expected_ = (expected); \
+        const std::string & actual_ = (actual); \
+        if (expected_ != actual_) \
+            JsonFxTest::ReportFailure(__FILE__, __LINE__, #expected " == " #actual, expected_, actual_); \
+    } while (0)
+
+#endif  /* !_JSONFX_TEST_UNITTEST_H_ */
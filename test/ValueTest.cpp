@@ -0,0 +1,91 @@
+
+#include "UnitTest.h"
+
+#include "JsonFx/Document.h"
+
+#include <stddef.h>
+#include <string.h>
+
+using namespace JsonFx;
+using namespace JsonFxTest;
+
+typedef Document::ValueType     Value;
+
+struct AlignedValue {
+    char    c;
+    Value   value;
+};
+
+// The string is inline if it's stored in the value itself.
+static bool IsInline(const Value & value) {
+    const char * str = value.getString();
+    return (str >= reinterpret_cast<const char *>(&value) && str < reinterpret_cast<const char *>(&value + 1));
+}
+
+JFX_TEST(ValueTest_Layout) {
+#if JSONFX_VALUE_PACKED_POINTER
+    // A naturally aligned 16 bytes cell, the pointer is packed into 48 bits.
+    JFX_EXPECT(sizeof(Value) == 16);
+    JFX_EXPECT(Value::kMaxShortStringLength == 13);
+#else
+    // The pointer is 8 bytes, the flags follow it.
+    JFX_EXPECT(sizeof(Value) == 24);
+    JFX_EXPECT(Value::kMaxShortStringLength == 15);
+#endif
+    JFX_EXPECT(offsetof(AlignedValue, value) == 8);
+}
+
+JFX_TEST(ValueTest_ShortStrings) {
+    // The copied strings up to kMaxShortStringLength chars are inline.
+    FastPoolAllocator<> pool;
+    const char * chars = "abcdefghijklmnopqrstuvwxyz";
+    for (Value::SizeType length = 0; length <= 20; ++length) {
+        Value value(chars, length, &pool);
+        JFX_EXPECT(value.isString() && value.getStringLength() == length);
+        JFX_EXPECT(::memcmp(value.getString(), chars, length) == 0 && value.getString()[length] == '\0');
+        JFX_EXPECT(IsInline(value) == (length <= Value::kMaxShortStringLength));
+        if (length <= Value::kMaxShortStringLength)
+            JFX_EXPECT((value.getFlags() & kInlineStringMask) != 0);
+    }
+}
+
+JFX_TEST(ValueTest_Document) {
+    // The short keys and values of the document are inline, and the long
+    // ones are in the pool.
+    std::string json = "{";
+    for (int length = 0; length <= 20; ++length) {
+        std::string str(length, static_cast<char>('a' + length));
+        json += ((length != 0) ? ", \"" : "\"") + str + "\": [\"" + str + "\", " + ToString(-length) + "]";
+    }
+    json += "}";
+    Document document;
+    document.parse(json.c_str());
+    JFX_EXPECT(!document.hasParseError());
+    JFX_EXPECT(document.isObject() && document.getSize() == 21);
+    int length = 0;
+    for (Value::ConstMemberIterator member = document.getMemberBegin();
+         member != document.getMemberEnd(); ++member, ++length) {
+        std::string str(length, static_cast<char>('a' + length));
+        bool inlined = (static_cast<Value::SizeType>(length) <= Value::kMaxShortStringLength);
+        JFX_EXPECT(member->name.getString() == str && member->name.getStringLength() == static_cast<Value::SizeType>(length));
+        JFX_EXPECT(IsInline(member->name) == inlined);
+        const Value & array = member->value;
+        JFX_EXPECT(array.isArray() && array.getSize() == 2);
+        if (array.isArray() && array.getSize() == 2) {
+            JFX_EXPECT(array[0U].getString() == str && IsInline(array[0U]) == inlined);
+            JFX_EXPECT(array[1U].isInt() && array[1U].getInt64() == -length);
+        }
+    }
+    JFX_EXPECT(document.hasMember("ddd") && document.findMember("ddd")->value[0U].getString() == std::string("ddd"));
+}
+
+JFX_TEST(ValueTest_Numbers) {
+    // The numbers are kept in the 8 bytes payload, with their type flags.
+    JFX_EXPECT(Value(-5).isInt() && Value(-5).getInt64() == -5);
+    JFX_EXPECT(Value(4000000000U).isUint() && Value(4000000000U).getUint64() == 4000000000U);
+    JFX_EXPECT(Value(INT64_C(-5000000000)).isInt64() && Value(INT64_C(-5000000000)).getInt64() == INT64_C(-5000000000));
+    JFX_EXPECT(Value(UINT64_C(18446744073709551615)).isUint64());
+    JFX_EXPECT(Value(UINT64_C(18446744073709551615)).getUint64() == UINT64_C(18446744073709551615));
+    JFX_EXPECT(Value(-0.125).isDouble() && Value(-0.125).getDouble() == -0.125);
+    JFX_EXPECT(Value(true).isTrue() && Value(false).isFalse() && Value().isNull());
+}